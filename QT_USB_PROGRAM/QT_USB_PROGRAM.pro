@@ -10,39 +10,22 @@
 #
 #
 ################################################################################
-QT       += core gui core5compat
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
-CONFIG += c++17
-
-# You can make your code fail to compile if it uses deprecated APIs.
-# In order to do so, uncomment the following line.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
-INCLUDEPATH += 3rdparty/
-
-SOURCES += \
-        main.cpp \
-        mainwindow.cpp \
-        usbcomm.cpp
-        usbcomm.cpp
-
-HEADERS += \
-        mainwindow.h \
-        usbcomm.h
-        usbcomm.h
-
-FORMS += \
-    mainwindow.ui
-
-################################################################################
+#
+# 빌드 구성:
+# 	usbcomm : USB 통신 library (GUI 의존성 없음, 기본 static lib)
+# 	app     : QApplication 기반 GUI (QT_USB_PROGRAM)
+# 	cli     : QCoreApplication 기반 headless CLI/daemon (qt_usb_cli)
+#
+# shared lib 로 빌드하려면:
+# 	$ qmake CONFIG+=usbcomm_shared
 #
 ################################################################################
-LIBS += -L./3rdparty/libusb-1.0/lib -lusb-1.0
+TEMPLATE = subdirs
 
+SUBDIRS += \
+        usbcomm \
+        app \
+        cli
 
-# Default rules for deployment.
-qnx: target.path = /tmp/$${TARGET}/bin
-else: unix:!android: target.path = /opt/$${TARGET}/bin
-!isEmpty(target.path): INSTALLS += target
+app.depends = usbcomm
+cli.depends = usbcomm
@@ -0,0 +1,52 @@
+################################################################################
+#
+# Linux PC:
+# 	$ sudo apt install libusb-1.0-0-dev
+#
+# Mac OS:
+#
+#
+# Windows PC:
+#
+#
+################################################################################
+TARGET = QT_USB_PROGRAM
+
+QT       += core gui core5compat
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++17
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+SOURCES += \
+        capturefile.cpp \
+    descriptortreemodel.cpp \
+        hexview.cpp \
+        main.cpp \
+        mainwindow.cpp \
+        usbtransferworker.cpp
+
+HEADERS += \
+        capturefile.h \
+    descriptortreemodel.h \
+        hexview.h \
+        mainwindow.h \
+        usbtransferworker.h
+
+FORMS += \
+    mainwindow.ui
+
+################################################################################
+# usbcomm library
+################################################################################
+include(../usbcomm/usbcomm.pri)
+
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
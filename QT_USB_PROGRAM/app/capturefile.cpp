@@ -0,0 +1,206 @@
+/********************************************************************************/
+/* capture 파일 (hex viewer 용) */
+/********************************************************************************/
+#include "capturefile.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+#include <algorithm>
+#include <functional>
+#include <cctype>
+
+/* 검색 1회에 훑는 크기 (취소/진행률 확인 단위) */
+static const qint64 kSearchBlockSize = 64 * 1024 * 1024;
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+CaptureFile::CaptureFile(QObject *parent) : QObject(parent)
+{
+    mapped = NULL;
+    mappedSize = 0;
+    openGeneration = 0;
+    searchWatcher = NULL;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+CaptureFile::~CaptureFile()
+{
+    close();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 파일 열기 (memory map 만 한다)
+ *@param:   path: 파일 경로
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool CaptureFile::open(const QString &path)
+{
+    close();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "CaptureFile: cannot open" << path << file.errorString();
+        return false;
+    }
+
+    mappedSize = file.size();
+    if (mappedSize == 0)
+        return true;
+
+    mapped = file.map(0, mappedSize);
+    if (mapped == NULL) {
+        qDebug() << "CaptureFile: map failed" << file.errorString();
+        file.close();
+        mappedSize = 0;
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 파일 닫기 (검색중이면 취소하고 끝날 때까지 기다린다)
+ *
+ * NOTE: 끝난 검색의 결과는 보내지 않는다 (watcher 를 지운다). 이미 queue 에 들어간 signal 은
+ * 		generation 이 바뀌었으므로 받는 쪽에서 버린다.
+ *
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void CaptureFile::close()
+{
+    cancelSearch();
+    searchFuture.waitForFinished();
+    delete searchWatcher;
+    searchWatcher = NULL;
+    openGeneration++;
+
+    if (mapped != NULL)
+        file.unmap((uchar *)mapped);
+    mapped = NULL;
+    mappedSize = 0;
+    if (file.isOpen())
+        file.close();
+}
+
+/********************************************************************************/
+/*
+ *@brief: pattern 검색 시작
+ *@param:   pattern: 찾을 bytes
+ *@param:   from: 검색 시작 offset
+ *@return:  true=OK  false=NG (파일이 없음/검색중)
+ */
+/********************************************************************************/
+bool CaptureFile::startSearch(const QByteArray &pattern, qint64 from)
+{
+    if (!isOpen() || pattern.isEmpty() || isSearching())
+        return false;
+
+    /* 끝났지만 아직 finished 를 보내지 않은 이전 검색의 결과는 버린다 (보낸 watcher 는 스스로 지워진다) */
+    delete searchWatcher;
+    searchWatcher = NULL;
+
+    int generation = openGeneration;
+    searchCancelled.storeRelaxed(0);
+    searchFuture = QtConcurrent::run([this, pattern, from, generation]() {
+        return search(pattern, from, generation);
+    });
+
+    QFutureWatcher<qint64> *watcher = new QFutureWatcher<qint64>(this);
+    connect(watcher, &QFutureWatcher<qint64>::finished, this, [this, watcher, generation]() {
+        emit sigSearchFinished(generation, watcher->result());
+        if (searchWatcher == watcher)
+            searchWatcher = NULL;
+        watcher->deleteLater();
+    });
+    watcher->setFuture(searchFuture);
+    searchWatcher = watcher;
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 검색 취소 (sigSearchFinished(-1) 로 끝난다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void CaptureFile::cancelSearch()
+{
+    searchCancelled.storeRelaxed(1);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 검색 본체 (검색 thread)
+ *
+ * NOTE: block 경계에 걸친 pattern 도 찾도록 block 을 pattern 길이 - 1 만큼 겹쳐서 훑는다.
+ *
+ *@param:
+ *@param:   generation: 시작했을 때의 generation() (진행률 signal 에 붙인다)
+ *@return:  찾은 offset, 없거나 취소됐으면 -1
+ */
+/********************************************************************************/
+qint64 CaptureFile::search(const QByteArray &pattern, qint64 from, int generation)
+{
+    const quint8 *first = (const quint8 *)pattern.constData();
+    const quint8 *last = first + pattern.size();
+    std::boyer_moore_horspool_searcher<const quint8 *> searcher(first, last);
+
+    int lastPercent = -1;
+    for (qint64 begin = qMax<qint64>(0, from); begin + pattern.size() <= mappedSize; begin += kSearchBlockSize) {
+        if (searchCancelled.loadRelaxed())
+            return -1;
+
+        qint64 end = qMin(mappedSize, begin + kSearchBlockSize + pattern.size() - 1);
+        const quint8 *hit = std::search(mapped + begin, mapped + end, searcher);
+        if (hit != mapped + end)
+            return hit - mapped;
+
+        int percent = (int)(end * 100 / mappedSize);
+        if (percent != lastPercent) {
+            lastPercent = percent;
+            emit sigSearchProgress(generation, percent);
+        }
+    }
+    return -1;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 검색 pattern 변환
+ *@param:   text: "de ad be ef" / "deadbeef" (hex) 또는 "\"text\"" (ASCII)
+ *@return:  bytes (잘못된 hex 면 빈 값)
+ */
+/********************************************************************************/
+QByteArray CaptureFile::parsePattern(const QString &text)
+{
+    QString trimmed = text.trimmed();
+    if (trimmed.size() >= 2 && trimmed.startsWith('"') && trimmed.endsWith('"'))
+        return trimmed.mid(1, trimmed.size() - 2).toLatin1();
+
+    QString hex = trimmed;
+    hex.remove(' ');
+    if (hex.startsWith("0x", Qt::CaseInsensitive))
+        hex = hex.mid(2);
+    if (hex.isEmpty() || (hex.size() % 2) != 0)
+        return QByteArray();
+    for (int i = 0; i < hex.size(); i++) {
+        if (!isxdigit(hex.at(i).toLatin1()))
+            return QByteArray();
+    }
+    return QByteArray::fromHex(hex.toLatin1());
+}
@@ -0,0 +1,74 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * capture 파일 (hex viewer 용)
+ *
+ * 파일 전체를 memory map 만 하고 읽어들이지 않는다. 화면에 보이는 부분만 OS 가 page in 하므로
+ * 수 GB 파일도 여는 시간과 memory 사용량이 파일 크기와 무관하다.
+ *
+ * pattern 검색은 background thread (QtConcurrent) 에서 map 된 영역을 block 단위로 훑는다.
+ * 진행률과 결과는 signal 로 알린다 (GUI thread 에서 queued 로 받는다).
+ * signal 에는 검색을 시작했을 때의 generation() 이 붙는다. 파일을 다시 열면 generation() 이 바뀌므로,
+ * 받는 쪽은 이전 파일의 검색에서 늦게 도착한 signal 을 구분해서 버린다.
+ */
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <QObject>
+#include <QFile>
+#include <QByteArray>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+
+class CaptureFile : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CaptureFile(QObject *parent = 0);
+    ~CaptureFile();
+
+    /* 파일 열기 (이전 파일은 닫는다) */
+    bool open(const QString &path);
+    void close();
+
+    bool isOpen() const {return mapped != NULL;}
+    /* close() 할 때마다 바뀐다 (검색 signal 이 지금 파일의 것인지 확인용) */
+    int generation() const {return openGeneration;}
+    QString fileName() const {return file.fileName();}
+    qint64 size() const {return mappedSize;}
+    /* map 된 영역 (isOpen() 일 때만 유효) */
+    const quint8 *data() const {return mapped;}
+
+    /* from 부터 pattern 검색 시작 (결과는 sigSearchFinished, 검색중이면 false) */
+    bool startSearch(const QByteArray &pattern, qint64 from);
+    void cancelSearch();
+    bool isSearching() const {return searchFuture.isRunning();}
+
+    /* 검색 pattern 변환: "de ad be ef" (hex) 또는 "\"text\"" (따옴표 안은 ASCII), 잘못된 hex 면 빈 값 */
+    static QByteArray parsePattern(const QString &text);
+
+signals:
+    /* 검색 진행률 (0~100, 검색 thread 에서 발생) */
+    void sigSearchProgress(int generation, int percent);
+    /* 검색 결과 (찾은 offset, 없거나 취소됐으면 -1) */
+    void sigSearchFinished(int generation, qint64 offset);
+
+private:
+    /* 검색 본체 (검색 thread) */
+    qint64 search(const QByteArray &pattern, qint64 from, int generation);
+
+    QFile file;
+    const quint8 *mapped;
+    qint64 mappedSize;
+
+    int openGeneration;
+
+    QFuture<qint64> searchFuture;
+    /* 검색 1회마다 만든다. close() 에서 지우면 아직 전달되지 않은 finished 도 함께 없어진다 */
+    QFutureWatcher<qint64> *searchWatcher;
+    QAtomicInt searchCancelled;
+};
+
+#endif // CAPTUREFILE_H
@@ -0,0 +1,450 @@
+/********************************************************************************/
+/* USB descriptor tree model (device browser) */
+/********************************************************************************/
+#include "descriptortreemodel.h"
+#include <QJsonArray>
+#include <QDebug>
+#include <algorithm>
+
+/* enum libusb_speed 의 이름 */
+static QString speedName(int speed)
+{
+    static const char *names[] = {"unknown", "low", "full", "high", "super", "super+"};
+    if (speed < 0 || speed >= (int)(sizeof(names) / sizeof(names[0])))
+        return QString::number(speed);
+    return names[speed];
+}
+
+/* enum libusb_transfer_type 의 이름 */
+static QString transferTypeName(int type)
+{
+    static const char *names[] = {"control", "isochronous", "bulk", "interrupt"};
+    return names[type & 0x03];
+}
+
+static QString hex(int value, int width)
+{
+    return QString("0x%1").arg(value, width, 16, QChar('0'));
+}
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+DescriptorTreeModel::DescriptorTreeModel(QObject *parent) : QAbstractItemModel(parent)
+{
+    root = newNode(Root, NULL);
+    root->fetched = true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자 (잡고 있는 device 의 ref 를 놓는다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+DescriptorTreeModel::~DescriptorTreeModel()
+{
+    deleteNode(root);
+}
+
+/********************************************************************************/
+/*
+ *@brief: device 목록 다시 읽기
+ *
+ * NOTE: libusb 는 ref 가 남아있는 device 에 대해 같은 libusb_device 를 돌려주므로,
+ * 	pointer 가 같은 device 는 이전 node (이미 읽은 configuration 포함) 를 그대로 쓴다.
+ *
+ *@param:   usbComm: device 목록을 읽을 UsbComm
+ *@return:
+ */
+/********************************************************************************/
+void DescriptorTreeModel::refresh(UsbComm *usbComm)
+{
+    const QList<libusb_device *> devices = usbComm->getDeviceList();
+
+    beginResetModel();
+
+    QHash<libusb_device *, Node *> previous;
+    for (int i = 0; i < root->children.size(); i++)
+        previous.insert(root->children.at(i)->device, root->children.at(i));
+    root->children.clear();
+
+    for (int i = 0; i < devices.size(); i++) {
+        Node *node = previous.take(devices.at(i));
+        if (node != NULL) {
+            /* 이전 node 가 ref 를 잡고 있으므로 목록의 ref 는 놓는다 */
+            libusb_unref_device(devices.at(i));
+        } else {
+            node = newDeviceNode(devices.at(i));
+        }
+        node->parent = root;
+        root->children.append(node);
+    }
+
+    /* 분리된 device */
+    for (QHash<libusb_device *, Node *>::iterator it = previous.begin(); it != previous.end(); ++it)
+        deleteNode(it.value());
+
+    std::sort(root->children.begin(), root->children.end(), [](const Node *a, const Node *b) {
+        return a->fields.value("portPath").toString() < b->fields.value("portPath").toString();
+    });
+
+    endResetModel();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 전체 tree 를 JSON 으로
+ *@param:
+ *@return:  {"devices": [{..., "configurations": [{..., "interfaces": [{..., "altSettings": [{..., "endpoints": [...]}]}]}]}]}
+ */
+/********************************************************************************/
+QJsonDocument DescriptorTreeModel::toJson()
+{
+    fetchAll(root);
+
+    QJsonArray devices;
+    for (int i = 0; i < root->children.size(); i++)
+        devices.append(toJson(root->children.at(i)));
+
+    QJsonObject object;
+    object.insert("devices", devices);
+    return QJsonDocument(object);
+}
+
+/********************************************************************************/
+/*
+ *@brief: QAbstractItemModel 구현
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+QModelIndex DescriptorTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    Node *parentNode = nodeOf(parent);
+    if (row < 0 || row >= parentNode->children.size() || column != 0)
+        return QModelIndex();
+    return createIndex(row, column, parentNode->children.at(row));
+}
+
+QModelIndex DescriptorTreeModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid())
+        return QModelIndex();
+
+    Node *parentNode = nodeOf(child)->parent;
+    if (parentNode == NULL || parentNode == root)
+        return QModelIndex();
+    return createIndex(parentNode->parent->children.indexOf(parentNode), 0, parentNode);
+}
+
+int DescriptorTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return 0;
+    return nodeOf(parent)->children.size();
+}
+
+int DescriptorTreeModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return 1;
+}
+
+QVariant DescriptorTreeModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    Node *node = nodeOf(index);
+    if (role == Qt::DisplayRole)
+        return node->text;
+
+    if (role == Qt::ToolTipRole) {
+        QStringList lines;
+        for (QVariantMap::const_iterator it = node->fields.constBegin(); it != node->fields.constEnd(); ++it)
+            lines << it.key() + ": " + it.value().toString();
+        return lines.join("\n");
+    }
+    return QVariant();
+}
+
+QVariant DescriptorTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (section == 0 && orientation == Qt::Horizontal && role == Qt::DisplayRole)
+        return QString("Descriptor");
+    return QVariant();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 하위 node 유무 (아직 읽지 않은 node 는 descriptor 의 개수로 판단한다, I/O 없음)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+bool DescriptorTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    Node *node = nodeOf(parent);
+    if (node->fetched)
+        return !node->children.isEmpty();
+    if (node->type == Device)
+        return node->fields.value("bNumConfigurations").toInt() > 0;
+    return node->type == Configuration;
+}
+
+bool DescriptorTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    return parent.isValid() && !nodeOf(parent)->fetched;
+}
+
+/********************************************************************************/
+/*
+ *@brief: node 를 펼칠 때 하위 node 를 읽는다 (Device: configuration 목록, Configuration: config descriptor parse)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void DescriptorTreeModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent))
+        return;
+
+    Node *node = nodeOf(parent);
+    QList<Node *> children = readChildren(node);
+    node->fetched = true;
+
+    if (!children.isEmpty()) {
+        beginInsertRows(parent, 0, children.size() - 1);
+        node->children = children;
+        endInsertRows();
+    }
+    /* configuration 은 읽은 값으로 표시 문자열이 바뀐다 */
+    emit dataChanged(parent, parent);
+}
+
+/********************************************************************************/
+/*
+ *@brief: index 의 node (무효 index 는 root)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+DescriptorTreeModel::Node *DescriptorTreeModel::nodeOf(const QModelIndex &index) const
+{
+    return index.isValid() ? (Node *)index.internalPointer() : root;
+}
+
+/********************************************************************************/
+/*
+ *@brief: node 생성 / 삭제 (삭제는 하위 node 포함, Device 는 ref 를 놓는다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+DescriptorTreeModel::Node *DescriptorTreeModel::newNode(NodeType type, Node *parent)
+{
+    Node *node = new Node;
+    node->type = type;
+    node->parent = parent;
+    node->fetched = (type != Device && type != Configuration);
+    node->device = NULL;
+    node->configIndex = -1;
+    return node;
+}
+
+void DescriptorTreeModel::deleteNode(Node *node)
+{
+    for (int i = 0; i < node->children.size(); i++)
+        deleteNode(node->children.at(i));
+    if (node->device != NULL)
+        libusb_unref_device(node->device);
+    delete node;
+}
+
+/********************************************************************************/
+/*
+ *@brief: device node 작성 (device descriptor 는 libusb 가 cache 하고 있으므로 I/O 없음)
+ *@param:   usbDevice: ref 된 device (node 가 ref 를 가져간다)
+ *@return:
+ */
+/********************************************************************************/
+DescriptorTreeModel::Node *DescriptorTreeModel::newDeviceNode(libusb_device *usbDevice)
+{
+    Node *node = newNode(Device, root);
+    node->device = usbDevice;
+
+    QString portPath = UsbDeviceMatcher::portPathOf(usbDevice);
+    node->fields.insert("portPath", portPath);
+    node->fields.insert("bus", (int)libusb_get_bus_number(usbDevice));
+    node->fields.insert("address", (int)libusb_get_device_address(usbDevice));
+    node->fields.insert("speed", speedName(libusb_get_device_speed(usbDevice)));
+
+    libusb_device_descriptor deviceDesc;
+    int err = libusb_get_device_descriptor(usbDevice, &deviceDesc);
+    if (err != LIBUSB_SUCCESS) {
+        node->fields.insert("error", QString(libusb_error_name(err)));
+        node->fetched = true;
+        node->text = QString("%1  (error: %2)").arg(portPath, QString(libusb_error_name(err)));
+        return node;
+    }
+
+    node->fields.insert("idVendor", hex(deviceDesc.idVendor, 4));
+    node->fields.insert("idProduct", hex(deviceDesc.idProduct, 4));
+    node->fields.insert("bcdUSB", hex(deviceDesc.bcdUSB, 4));
+    node->fields.insert("bcdDevice", hex(deviceDesc.bcdDevice, 4));
+    node->fields.insert("bDeviceClass", hex(deviceDesc.bDeviceClass, 2));
+    node->fields.insert("bDeviceSubClass", hex(deviceDesc.bDeviceSubClass, 2));
+    node->fields.insert("bDeviceProtocol", hex(deviceDesc.bDeviceProtocol, 2));
+    node->fields.insert("bMaxPacketSize0", (int)deviceDesc.bMaxPacketSize0);
+    node->fields.insert("bNumConfigurations", (int)deviceDesc.bNumConfigurations);
+
+    node->text = QString("%1  %2:%3  class %4, %5 speed")
+                 .arg(portPath)
+                 .arg(deviceDesc.idVendor, 4, 16, QChar('0')).arg(deviceDesc.idProduct, 4, 16, QChar('0'))
+                 .arg(hex(deviceDesc.bDeviceClass, 2), node->fields.value("speed").toString());
+    return node;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 하위 node 작성
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+QList<DescriptorTreeModel::Node *> DescriptorTreeModel::readChildren(Node *node)
+{
+    QList<Node *> children;
+
+    if (node->type == Device) {
+        /* configuration 은 목록만 만들고, descriptor 는 펼칠 때 읽는다 */
+        int count = node->fields.value("bNumConfigurations").toInt();
+        for (int i = 0; i < count; i++) {
+            Node *config = newNode(Configuration, node);
+            config->device = libusb_ref_device(node->device);
+            config->configIndex = i;
+            config->fields.insert("index", i);
+            config->text = QString("Configuration #%1").arg(i);
+            children.append(config);
+        }
+    } else if (node->type == Configuration) {
+        children = readConfiguration(node);
+    }
+    return children;
+}
+
+/********************************************************************************/
+/*
+ *@brief: configuration descriptor 1개를 읽어서 interface/altsetting/endpoint node 로 만든다
+ *@param:   node: Configuration node (fields/text 도 갱신한다)
+ *@return:  interface node 목록
+ */
+/********************************************************************************/
+QList<DescriptorTreeModel::Node *> DescriptorTreeModel::readConfiguration(Node *node)
+{
+    QList<Node *> interfaces;
+
+    libusb_config_descriptor *configDesc = NULL;
+    int err = libusb_get_config_descriptor(node->device, node->configIndex, &configDesc);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_get_config_descriptor error:" << libusb_error_name(err);
+        node->fields.insert("error", QString(libusb_error_name(err)));
+        node->text = QString("Configuration #%1  (error: %2)").arg(node->configIndex).arg(QString(libusb_error_name(err)));
+        return interfaces;
+    }
+
+    node->fields.insert("bConfigurationValue", (int)configDesc->bConfigurationValue);
+    node->fields.insert("bNumInterfaces", (int)configDesc->bNumInterfaces);
+    node->fields.insert("bmAttributes", hex(configDesc->bmAttributes, 2));
+    node->fields.insert("MaxPower", (int)configDesc->MaxPower);
+    node->text = QString("Configuration %1: %2 interfaces, %3%4")
+                 .arg(configDesc->bConfigurationValue).arg(configDesc->bNumInterfaces)
+                 .arg(QString((configDesc->bmAttributes & 0x40) ? "self powered" : "bus powered"))
+                 .arg(QString((configDesc->bmAttributes & 0x20) ? ", remote wakeup" : ""));
+
+    for (int j = 0; j < (int)configDesc->bNumInterfaces; j++) {
+        const libusb_interface *usbInterface = &configDesc->interface[j];
+        Node *interfaceNode = newNode(Interface, node);
+        int interfaceNumber = usbInterface->num_altsetting > 0 ? usbInterface->altsetting[0].bInterfaceNumber : j;
+        interfaceNode->fields.insert("bInterfaceNumber", interfaceNumber);
+        interfaceNode->fields.insert("numAltSettings", usbInterface->num_altsetting);
+        interfaceNode->text = QString("Interface %1").arg(interfaceNumber);
+
+        for (int k = 0; k < usbInterface->num_altsetting; k++) {
+            const libusb_interface_descriptor *interfaceDesc = &usbInterface->altsetting[k];
+            Node *altNode = newNode(AltSetting, interfaceNode);
+            altNode->fields.insert("bAlternateSetting", (int)interfaceDesc->bAlternateSetting);
+            altNode->fields.insert("bInterfaceClass", hex(interfaceDesc->bInterfaceClass, 2));
+            altNode->fields.insert("bInterfaceSubClass", hex(interfaceDesc->bInterfaceSubClass, 2));
+            altNode->fields.insert("bInterfaceProtocol", hex(interfaceDesc->bInterfaceProtocol, 2));
+            altNode->fields.insert("bNumEndpoints", (int)interfaceDesc->bNumEndpoints);
+            altNode->text = QString("Alt %1: class %2, %3 endpoints")
+                            .arg(interfaceDesc->bAlternateSetting).arg(hex(interfaceDesc->bInterfaceClass, 2))
+                            .arg(interfaceDesc->bNumEndpoints);
+
+            for (int m = 0; m < (int)interfaceDesc->bNumEndpoints; m++) {
+                const libusb_endpoint_descriptor *endpointDesc = &interfaceDesc->endpoint[m];
+                Node *endpointNode = newNode(Endpoint, altNode);
+                bool in = endpointDesc->bEndpointAddress & LIBUSB_ENDPOINT_IN;
+                endpointNode->fields.insert("bEndpointAddress", hex(endpointDesc->bEndpointAddress, 2));
+                endpointNode->fields.insert("direction", QString(in ? "IN" : "OUT"));
+                endpointNode->fields.insert("transferType", transferTypeName(endpointDesc->bmAttributes));
+                endpointNode->fields.insert("wMaxPacketSize", (int)endpointDesc->wMaxPacketSize);
+                endpointNode->fields.insert("bInterval", (int)endpointDesc->bInterval);
+                endpointNode->text = QString("%1 %2 %3, %4 bytes")
+                                     .arg(hex(endpointDesc->bEndpointAddress, 2), transferTypeName(endpointDesc->bmAttributes),
+                                          QString(in ? "IN" : "OUT"))
+                                     .arg(endpointDesc->wMaxPacketSize & 0x7ff);
+                altNode->children.append(endpointNode);
+            }
+            interfaceNode->children.append(altNode);
+        }
+        interfaces.append(interfaceNode);
+    }
+
+    libusb_free_config_descriptor(configDesc);
+    return interfaces;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 하위 node 를 모두 읽는다 (toJson 용, view 에는 fetchMore 와 같은 signal 로 알린다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void DescriptorTreeModel::fetchAll(Node *node)
+{
+    if (!node->fetched && node->parent != NULL)
+        fetchMore(createIndex(node->parent->children.indexOf(node), 0, node));
+
+    for (int i = 0; i < node->children.size(); i++)
+        fetchAll(node->children.at(i));
+}
+
+/********************************************************************************/
+/*
+ *@brief: node 1개와 하위 node 의 JSON
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+QJsonObject DescriptorTreeModel::toJson(Node *node)
+{
+    QJsonObject object = QJsonObject::fromVariantMap(node->fields);
+
+    static const char *childKeys[] = {"devices", "configurations", "interfaces", "altSettings", "endpoints", ""};
+    if (!node->children.isEmpty()) {
+        QJsonArray children;
+        for (int i = 0; i < node->children.size(); i++)
+            children.append(toJson(node->children.at(i)));
+        object.insert(childKeys[node->type], children);
+    }
+    return object;
+}
@@ -0,0 +1,90 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * USB descriptor tree model (device browser)
+ *
+ * 	device
+ * 		->configuration
+ * 			->interface
+ * 				->altsetting
+ * 					->endpoint
+ *
+ * refresh() 는 device 목록과 device descriptor(libusb 가 cache, I/O 없음) 만 읽는다.
+ * configuration descriptor 는 node 를 펼칠 때 (canFetchMore/fetchMore) 그 configuration 1개만 읽어서 parse 하고,
+ * 결과는 node 로 남겨둔다 (다시 펼쳐도, refresh() 후에도 같은 device 면 다시 읽지 않는다).
+ *
+ * toJson() 은 전체 tree 를 내보낸다 (아직 읽지 않은 configuration 은 이때 읽는다).
+ */
+#ifndef DESCRIPTORTREEMODEL_H
+#define DESCRIPTORTREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QVariantMap>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <usbcomm.h>
+
+class DescriptorTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    explicit DescriptorTreeModel(QObject *parent = 0);
+    ~DescriptorTreeModel();
+
+    /* device 목록 다시 읽기 (이미 읽은 device 의 하위 node 는 유지한다) */
+    void refresh(UsbComm *usbComm);
+
+    /* 전체 tree 를 JSON 으로 (펼치지 않은 node 도 읽는다) */
+    QJsonDocument toJson();
+
+    /* QAbstractItemModel */
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+private:
+    enum NodeType {
+        Root,
+        Device,
+        Configuration,
+        Interface,
+        AltSetting,
+        Endpoint
+    };
+
+    struct Node
+    {
+        NodeType type;
+        Node *parent;
+        QList<Node *> children;
+        bool fetched;					/* 하위 node 를 읽었다 (Device/Configuration 만 lazy) */
+        libusb_device *device;			/* Device/Configuration: ref 해서 잡고 있다 */
+        int configIndex;				/* Configuration: libusb_get_config_descriptor 의 index */
+        QString text;					/* 표시 문자열 */
+        QVariantMap fields;				/* descriptor 값 (tooltip, JSON) */
+    };
+
+    Node *nodeOf(const QModelIndex &index) const;
+    static Node *newNode(NodeType type, Node *parent);
+    static void deleteNode(Node *node);
+
+    /* 하위 node 작성 (beginInsertRows 는 호출 측) */
+    QList<Node *> readChildren(Node *node);
+    Node *newDeviceNode(libusb_device *usbDevice);
+    QList<Node *> readConfiguration(Node *node);
+
+    /* 하위 node 를 읽지 않았으면 읽는다 (toJson 용) */
+    void fetchAll(Node *node);
+    QJsonObject toJson(Node *node);
+
+    Node *root;
+};
+
+#endif // DESCRIPTORTREEMODEL_H
@@ -0,0 +1,218 @@
+/********************************************************************************/
+/* 가상화된 hex/ASCII viewer */
+/********************************************************************************/
+#include "hexview.h"
+#include "capturefile.h"
+#include <QPainter>
+#include <QScrollBar>
+#include <QFontDatabase>
+#include <limits>
+
+/* 행의 문자 위치: "oooooooooooo  xx xx xx xx xx xx xx xx  xx xx xx xx xx xx xx xx  aaaaaaaaaaaaaaaa" */
+static const int kOffsetDigits = 12;
+static const int kHexColumn = kOffsetDigits + 2;
+static const int kAsciiColumn = kHexColumn + HexView::BytesPerRow * 3 + 2;
+static const int kMargin = 4;
+
+/* byte i 의 hex 문자 위치 (8 bytes 마다 1칸 띄운다) */
+static int hexColumnOf(int i)
+{
+    return kHexColumn + i * 3 + (i >= HexView::BytesPerRow / 2 ? 1 : 0);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+HexView::HexView(QWidget *parent) : QAbstractScrollArea(parent)
+{
+    file = NULL;
+    rowsPerStep = 1;
+    highlightOffset = -1;
+    highlightLength = 0;
+
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    charWidth = fontMetrics().horizontalAdvance(QLatin1Char('0'));
+    lineHeight = fontMetrics().height();
+
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 표시할 파일
+ *@param:   file: capture 파일 (NULL 이면 비운다)
+ *@return:
+ */
+/********************************************************************************/
+void HexView::setCaptureFile(CaptureFile *file)
+{
+    this->file = file;
+    highlightOffset = -1;
+    highlightLength = 0;
+    updateScrollBars();
+    verticalScrollBar()->setValue(0);
+    viewport()->update();
+}
+
+/********************************************************************************/
+/*
+ *@brief: offset 이 있는 행을 화면 맨 위로
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void HexView::scrollToOffset(qint64 offset)
+{
+    qint64 row = qMax<qint64>(0, offset) / BytesPerRow;
+    verticalScrollBar()->setValue((int)qMin<qint64>(row / rowsPerStep, verticalScrollBar()->maximum()));
+}
+
+/********************************************************************************/
+/*
+ *@brief: 강조 표시
+ *@param:   offset: 시작 offset
+ *@param:   length: bytes (0 이면 해제)
+ *@return:
+ */
+/********************************************************************************/
+void HexView::setHighlight(qint64 offset, int length)
+{
+    highlightOffset = offset;
+    highlightLength = length;
+    viewport()->update();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 화면 맨 위 행의 offset
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+qint64 HexView::topOffset() const
+{
+    return (qint64)verticalScrollBar()->value() * rowsPerStep * BytesPerRow;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 화면에 보이는 행만 만들어서 그린다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void HexView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event)
+
+    QPainter painter(viewport());
+    painter.fillRect(viewport()->rect(), palette().base());
+    if (file == NULL || !file->isOpen())
+        return;
+
+    static const char digits[] = "0123456789abcdef";
+    const quint8 *data = file->data();
+    qint64 size = file->size();
+    qint64 topRow = (qint64)verticalScrollBar()->value() * rowsPerStep;
+    int x0 = kMargin - horizontalScrollBar()->value();
+    int ascent = fontMetrics().ascent();
+    QColor highlightColor = palette().highlight().color();
+
+    QString line;
+    line.reserve(kAsciiColumn + BytesPerRow);
+
+    for (int r = 0; r <= visibleRows(); r++) {
+        qint64 offset = (topRow + r) * BytesPerRow;
+        if (offset >= size)
+            break;
+        int count = (int)qMin<qint64>(BytesPerRow, size - offset);
+        int y = r * lineHeight;
+
+        line.fill(QLatin1Char(' '), kAsciiColumn + count);
+        for (int i = 0; i < kOffsetDigits; i++)
+            line[kOffsetDigits - 1 - i] = QLatin1Char(digits[(offset >> (i * 4)) & 0xf]);
+        for (int i = 0; i < count; i++) {
+            quint8 b = data[offset + i];
+            line[hexColumnOf(i)] = QLatin1Char(digits[b >> 4]);
+            line[hexColumnOf(i) + 1] = QLatin1Char(digits[b & 0xf]);
+            line[kAsciiColumn + i] = QLatin1Char((b >= 0x20 && b < 0x7f) ? (char)b : '.');
+        }
+
+        /* 검색 결과 등의 강조 (hex 와 ASCII 양쪽) */
+        if (highlightLength > 0 && offset < highlightOffset + highlightLength && highlightOffset < offset + count) {
+            int from = (int)qMax<qint64>(0, highlightOffset - offset);
+            int to = (int)qMin<qint64>(count, highlightOffset + highlightLength - offset);
+            for (int i = from; i < to; i++) {
+                painter.fillRect(x0 + hexColumnOf(i) * charWidth, y, charWidth * 2, lineHeight, highlightColor);
+                painter.fillRect(x0 + (kAsciiColumn + i) * charWidth, y, charWidth, lineHeight, highlightColor);
+            }
+        }
+
+        painter.drawText(x0, y + ascent, line);
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: 크기 변경 시 scroll bar 범위 재계산
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void HexView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 전체 행 수
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+qint64 HexView::rowCount() const
+{
+    if (file == NULL || !file->isOpen())
+        return 0;
+    return (file->size() + BytesPerRow - 1) / BytesPerRow;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 화면에 다 들어가는 행 수
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int HexView::visibleRows() const
+{
+    return qMax(1, viewport()->height() / lineHeight);
+}
+
+/********************************************************************************/
+/*
+ *@brief: scroll bar 범위 (행 수가 int 범위를 넘으면 1 단계를 여러 행으로 한다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void HexView::updateScrollBars()
+{
+    qint64 maxTopRow = qMax<qint64>(0, rowCount() - visibleRows());
+    rowsPerStep = 1 + maxTopRow / std::numeric_limits<int>::max();
+
+    verticalScrollBar()->setRange(0, (int)((maxTopRow + rowsPerStep - 1) / rowsPerStep));
+    verticalScrollBar()->setPageStep((int)qMax<qint64>(1, visibleRows() / rowsPerStep));
+    verticalScrollBar()->setSingleStep(1);
+
+    int lineWidth = (kAsciiColumn + BytesPerRow) * charWidth + kMargin * 2;
+    horizontalScrollBar()->setRange(0, qMax(0, lineWidth - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+}
@@ -0,0 +1,56 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * 가상화된 hex/ASCII viewer
+ *
+ * QPlainTextEdit/QTableView 는 행마다 layout 정보를 가지므로 수억 행(수 GB)에서는 쓸 수 없다.
+ * 이 view 는 scroll 위치에서 화면에 보이는 행만 계산해서 그 행만 문자열로 만들어 그린다.
+ * 따라서 scroll/다시 그리기 비용은 파일 크기와 무관하게 (화면 행 수) 로 일정하다.
+ *
+ * 행 수가 scroll bar 의 int 범위를 넘으면 scroll bar 1 단계를 여러 행으로 한다 (rowsPerStep).
+ */
+#ifndef HEXVIEW_H
+#define HEXVIEW_H
+
+#include <QAbstractScrollArea>
+
+class CaptureFile;
+
+class HexView : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    static const int BytesPerRow = 16;
+
+    explicit HexView(QWidget *parent = 0);
+
+    /* 표시할 파일 (NULL 이면 비운다), 파일을 다시 열었으면 다시 호출한다 */
+    void setCaptureFile(CaptureFile *file);
+
+    /* offset 이 있는 행을 화면 맨 위로 */
+    void scrollToOffset(qint64 offset);
+    /* 강조 표시 (검색 결과 등, length 0 이면 해제) */
+    void setHighlight(qint64 offset, int length);
+
+    /* 화면 맨 위 행의 offset */
+    qint64 topOffset() const;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    qint64 rowCount() const;
+    int visibleRows() const;
+    void updateScrollBars();
+
+    CaptureFile *file;
+    qint64 rowsPerStep;
+    qint64 highlightOffset;
+    int highlightLength;
+    int charWidth;
+    int lineHeight;
+};
+
+#endif // HEXVIEW_H
@@ -0,0 +1,22 @@
+#include "mainwindow.h"
+#include "procstats.h"
+
+#include <QApplication>
+#include <QTimer>
+#include <QDebug>
+
+int main(int argc, char *argv[])
+{
+    QApplication a(argc, argv);
+    MainWindow w;
+    w.show();
+
+    /* --stats: 첫 event loop 진입 시점의 기동 시간/메모리를 출력 (headless build 와 비교용) */
+    if (a.arguments().contains("--stats")) {
+        QTimer::singleShot(0, [&]() {
+            qInfo().noquote() << "[gui]" << ProcStats::summary();
+        });
+    }
+
+    return a.exec();
+}
@@ -0,0 +1,506 @@
+#include "mainwindow.h"
+#include "ui_mainwindow.h"
+#include <QFileDialog>
+#include <QFile>
+
+/* 전송 모니터 갱신 주기 (ms) */
+static const int kTrafficRefreshMs = 100;
+/* read/write 진행 표시 주기 (ms) */
+static const int kTransferRefreshMs = 100;
+
+/********************************************************************************/
+/* */
+/********************************************************************************/
+MainWindow::MainWindow(QWidget *parent)
+    : QMainWindow(parent)
+    , ui(new Ui::MainWindow)
+    , m_transferWorker(&m_usbComm)
+{
+    ui->setupUi(this);
+
+    /*  */
+    ui->listView_vid_pid_list->setModel(&m_model_of_vid_pid_list);
+
+    /*  */
+    connect(&m_usbComm, SIGNAL(sigPutDevInfo2MainUI(QString, QString, QString)), this, SLOT(slotGetDevInfoFromLibusb(QString, QString, QString)));
+    /* string descriptor 는 worker thread 에서 오므로 queued 로 받는다 */
+    connect(&m_usbComm, SIGNAL(sigPutDevStrings2MainUI(QString, QString, QString, QString)),
+            this, SLOT(slotGetDevStringsFromLibusb(QString, QString, QString, QString)), Qt::QueuedConnection);
+
+    /* 전송 모니터 */
+    ui->tableWidget_traffic->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_lastTrafficNs = 0;
+    m_trafficClock.start();
+    connect(&m_trafficTimer, SIGNAL(timeout()), this, SLOT(slotRefreshTraffic()));
+    m_trafficTimer.start(kTrafficRefreshMs);
+
+    /* 캡처 보기 (검색 진행/결과는 검색 thread 에서 오므로 queued) */
+    m_captureMatchOffset = -1;
+    m_captureMatchLength = 0;
+    connect(&m_captureFile, SIGNAL(sigSearchProgress(int, int)), this, SLOT(slotCaptureSearchProgress(int, int)), Qt::QueuedConnection);
+    connect(&m_captureFile, SIGNAL(sigSearchFinished(int, qint64)), this, SLOT(slotCaptureSearchFinished(int, qint64)), Qt::QueuedConnection);
+
+    /* read/write (종료 signal 은 worker thread 에서 오므로 queued) */
+    connect(&m_transferWorker, SIGNAL(sigJobFinished(QString, qint64, double)),
+            this, SLOT(slotTransferFinished(QString, qint64, double)), Qt::QueuedConnection);
+    connect(&m_transferTimer, SIGNAL(timeout()), this, SLOT(slotRefreshTransfer()));
+
+    /* reset */
+    m_resetting = false;
+
+    /* 디스크립터 */
+    ui->treeView_descriptors->setModel(&m_descriptorModel);
+}
+
+/********************************************************************************/
+/* */
+/********************************************************************************/
+MainWindow::~MainWindow()
+{
+    m_transferWorker.cancel();
+    m_transferWorker.wait();
+    delete ui;
+}
+
+/********************************************************************************/
+/* List all USB devices */
+/********************************************************************************/
+void MainWindow::on_pushButton_list_usb_devices_clicked()
+{
+    qDebug() << Q_FUNC_INFO;
+
+    /* USB vid/pid list 지우기 */
+    m_dataList_of_vid_pid_list.clear();
+    m_portPathList_of_vid_pid_list.clear();
+
+    /*  */
+    m_usbComm.findUsbDevices();
+    m_descriptorModel.refresh(&m_usbComm);
+}
+
+
+/********************************************************************************/
+/* 선택한 device 를 reset
+ *
+ * NOTE: libusb_reset_device() 는 재열거를 기다리므로 수 초 걸릴 수 있다.
+ * 	open 과 reset 은 비동기 버전으로 worker pool 에서 하고, 결과는 then(this, ...) 로 GUI thread 에서 받는다.
+ */
+/********************************************************************************/
+void MainWindow::on_pushButton_reset_usb_device_clicked()
+{
+    qDebug() << Q_FUNC_INFO;
+
+    UsbDeviceIdentity identity;
+    if (!selectedDevice(&identity)) {
+        statusBar()->showMessage("select a device");
+        return;
+    }
+    /* 전송중인 device 를 reset 하면 worker 의 handle 이 중간에 바뀌므로 막는다 */
+    if (m_transferWorker.isRunning()) {
+        statusBar()->showMessage("stop read/write before reset");
+        return;
+    }
+    if (m_resetting)
+        return;
+
+    m_resetting = true;
+    ui->pushButton_reset_usb_device->setEnabled(false);
+    statusBar()->showMessage("resetting " + identity.portPath + "...");
+
+    m_usbComm.openUsbDeviceByIdentityAsync(identity).then(this, [this, identity](libusb_device_handle *deviceHandle) {
+        if (deviceHandle == NULL) {
+            statusBar()->showMessage("reset " + identity.portPath + ": open failed");
+            m_resetting = false;
+            ui->pushButton_reset_usb_device->setEnabled(true);
+            return;
+        }
+
+        m_usbComm.resetUsbDeviceAsync(deviceHandle).then(this, [this, identity](bool ok) {
+            statusBar()->showMessage("reset " + identity.portPath + (ok ? ": done" : ": failed"));
+            m_resetting = false;
+            ui->pushButton_reset_usb_device->setEnabled(true);
+        });
+    });
+}
+
+
+/********************************************************************************/
+/* */
+/********************************************************************************/
+void MainWindow::on_pushButton_hot_plug_monitor_clicked()
+{
+    qDebug() << Q_FUNC_INFO;
+
+}
+
+
+/********************************************************************************/
+/* */
+/********************************************************************************/
+void MainWindow::on_pushButton_read_usb_device_clicked()
+{
+    qDebug() << Q_FUNC_INFO;
+
+    startTransfer(false);
+}
+
+
+/********************************************************************************/
+/* */
+/********************************************************************************/
+void MainWindow::on_pushButton_write_usb_device_clicked()
+{
+    qDebug() << Q_FUNC_INFO;
+
+    startTransfer(true);
+}
+
+/********************************************************************************/
+/* read/write 중단 (진행중인 block 이 끝나면 멈춘다) */
+/********************************************************************************/
+void MainWindow::on_pushButton_rw_cancel_clicked()
+{
+    m_transferWorker.cancel();
+}
+
+/********************************************************************************/
+/* device 목록에서 선택한 행의 device */
+/********************************************************************************/
+bool MainWindow::selectedDevice(UsbDeviceIdentity *identity) const
+{
+    int row = ui->listView_vid_pid_list->currentIndex().row();
+    if (row < 0 || row >= m_portPathList_of_vid_pid_list.size())
+        return false;
+
+    /* 행: "0xVVVV, 0xPPPP  string descriptor" */
+    QString ids = m_dataList_of_vid_pid_list.at(row).section("  ", 0, 0);
+    bool vidOk = false, pidOk = false;
+    identity->vid = ids.section(", ", 0, 0).toUShort(&vidOk, 0);
+    identity->pid = ids.section(", ", 1, 1).toUShort(&pidOk, 0);
+    identity->portPath = m_portPathList_of_vid_pid_list.at(row);
+    return vidOk && pidOk;
+}
+
+/********************************************************************************/
+/* 선택한 device 로 read/write 시작
+ *
+ * NOTE: open/claim/전송 모두 worker thread 에서 하므로 여기서는 설정만 만든다 (GUI thread 는 막히지 않는다).
+ */
+/********************************************************************************/
+void MainWindow::startTransfer(bool write)
+{
+    UsbTransferJob job;
+    if (!selectedDevice(&job.device)) {
+        ui->label_rw_status->setText("select a device");
+        return;
+    }
+    /* reset 이 끝나기 전에는 device 가 재열거 중일 수 있다 */
+    if (m_resetting) {
+        ui->label_rw_status->setText("reset in progress");
+        return;
+    }
+
+    bool endpointOk = false;
+    job.endpoint = ui->lineEdit_rw_endpoint->text().trimmed().toUShort(&endpointOk, 0);
+    if (!endpointOk) {
+        ui->label_rw_status->setText("invalid endpoint");
+        return;
+    }
+    if (write == (bool)(job.endpoint & LIBUSB_ENDPOINT_IN)) {
+        ui->label_rw_status->setText(write ? "write needs an OUT endpoint" : "read needs an IN endpoint");
+        return;
+    }
+    job.size = (qint64)ui->spinBox_rw_size_kb->value() * 1024;
+    job.repetitions = ui->spinBox_rw_repetitions->value();
+    job.timeout = ui->spinBox_rw_timeout->value();
+
+    if (!m_transferWorker.startJob(job))
+        return;
+
+    ui->pushButton_read_usb_device->setEnabled(false);
+    ui->pushButton_write_usb_device->setEnabled(false);
+    ui->pushButton_rw_cancel->setEnabled(true);
+    ui->progressBar_rw->setValue(0);
+    ui->label_rw_status->setText(write ? "writing..." : "reading...");
+    m_transferTimer.start(kTransferRefreshMs);
+}
+
+/********************************************************************************/
+/* read/write 진행 표시 (10 Hz, 전송 속도와 무관) */
+/********************************************************************************/
+void MainWindow::slotRefreshTransfer()
+{
+    UsbTransferProgress progress = m_transferWorker.progress();
+    ui->progressBar_rw->setValue(progress.permille());
+    ui->label_rw_status->setText(QString("%1 / %2 MB, %3 MB/s")
+                                 .arg(progress.bytesDone / 1e6, 0, 'f', 1).arg(progress.bytesTotal / 1e6, 0, 'f', 1)
+                                 .arg(progress.MBps(), 0, 'f', 1));
+}
+
+/********************************************************************************/
+/* read/write 종료 */
+/********************************************************************************/
+void MainWindow::slotTransferFinished(QString error, qint64 bytesDone, double elapsedSec)
+{
+    m_transferTimer.stop();
+    slotRefreshTransfer();
+
+    QString result = QString("%1 MB in %2 s, %3 MB/s").arg(bytesDone / 1e6, 0, 'f', 1).arg(elapsedSec, 0, 'f', 2)
+                     .arg(elapsedSec > 0 ? bytesDone / 1e6 / elapsedSec : 0, 0, 'f', 1);
+    ui->label_rw_status->setText(error.isEmpty() ? result : result + "  (" + error + ")");
+
+    ui->pushButton_read_usb_device->setEnabled(true);
+    ui->pushButton_write_usb_device->setEnabled(true);
+    ui->pushButton_rw_cancel->setEnabled(false);
+}
+
+/********************************************************************************/
+/* */
+/********************************************************************************/
+void MainWindow::slotGetDevInfoFromLibusb(QString vid, QString pid, QString portPath)
+{
+    qDebug() << Q_FUNC_INFO << "VID:" << vid << "PID:" << pid << "Port:" << portPath;
+
+    /* 누적 추가한다 */
+    m_dataList_of_vid_pid_list << vid + ", " + pid;
+    m_portPathList_of_vid_pid_list << portPath;
+
+    m_model_of_vid_pid_list.setStringList(m_dataList_of_vid_pid_list);
+}
+
+/********************************************************************************/
+/* string descriptor 를 받으면 해당 device 의 행만 갱신한다 */
+/********************************************************************************/
+void MainWindow::slotGetDevStringsFromLibusb(QString portPath, QString manufacturer, QString product, QString serialNumber)
+{
+    int row = m_portPathList_of_vid_pid_list.indexOf(portPath);
+    if (row < 0)
+        return;
+
+    QStringList strings;
+    if (!manufacturer.isEmpty())
+        strings << manufacturer;
+    if (!product.isEmpty())
+        strings << product;
+    if (!serialNumber.isEmpty())
+        strings << "SN " + serialNumber;
+    if (strings.isEmpty())
+        return;
+
+    QString text = m_dataList_of_vid_pid_list.at(row).section("  ", 0, 0) + "  " + strings.join(" / ");
+    m_dataList_of_vid_pid_list[row] = text;
+    m_model_of_vid_pid_list.setData(m_model_of_vid_pid_list.index(row), text);
+}
+
+/********************************************************************************/
+/* 전송 모니터 갱신 (10 Hz)
+ *
+ * NOTE: counter 는 전송 측이 lock 없이 증가시키고, 여기서는 읽기만 한다.
+ * 	갱신 1회의 비용은 endpoint 수에만 비례하고 전송 속도와는 무관하다. 탭이 보이지 않으면 읽지 않는다.
+ */
+/********************************************************************************/
+void MainWindow::slotRefreshTraffic()
+{
+    qint64 nowNs = m_trafficClock.nsecsElapsed();
+    double intervalSec = (nowNs - m_lastTrafficNs) / 1e9;
+    m_lastTrafficNs = nowNs;
+
+    if (ui->tabWidget->currentWidget() != ui->tab_3) {
+        /* 다시 보일 때 숨어있던 구간의 평균이 아니라 다음 구간부터 표시한다 */
+        m_lastTraffic.clear();
+        return;
+    }
+
+    const QList<UsbTrafficEndpoint> endpoints = m_usbComm.getTrafficSnapshots();
+    QHash<QPair<libusb_device_handle *, quint8>, UsbTrafficSnapshot> current;
+
+    /* 행: device 합계 1행 + endpoint 별 행 (getTrafficSnapshots 는 port path 순이므로 같은 device 의 endpoint 는 연속이다) */
+    QList<QStringList> rows;
+    double totalMBps = 0;
+    double totalTransfersPerSec = 0;
+
+    auto rowOf = [](const QString &name, const UsbTrafficRate &rate) {
+        return QStringList() << name << QString::number(rate.MBps, 'f', 2) << QString::number(rate.transfersPerSec, 'f', 0)
+                             << QString::number(rate.errors) << QString::number(rate.timeouts)
+                             << QString::number(rate.p50Us, 'f', 0) << QString::number(rate.p99Us, 'f', 0);
+    };
+    auto addTo = [](UsbTrafficSnapshot *sum, const UsbTrafficSnapshot &snapshot) {
+        sum->bytes += snapshot.bytes;
+        sum->transfers += snapshot.transfers;
+        sum->errors += snapshot.errors;
+        sum->timeouts += snapshot.timeouts;
+        for (int i = 0; i < UsbTrafficSnapshot::LatencyBuckets; i++)
+            sum->latencyBuckets[i] += snapshot.latencyBuckets[i];
+    };
+
+    int i = 0;
+    while (i < endpoints.size()) {
+        libusb_device_handle *deviceHandle = endpoints.at(i).deviceHandle;
+        QString portPath = endpoints.at(i).portPath;
+        int deviceRow = rows.size();
+        rows.append(QStringList());
+
+        UsbTrafficSnapshot devicePrevious, deviceCurrent;
+        for (; i < endpoints.size() && endpoints.at(i).deviceHandle == deviceHandle; i++) {
+            const UsbTrafficEndpoint &ep = endpoints.at(i);
+            QPair<libusb_device_handle *, quint8> key(deviceHandle, ep.endpoint);
+            /* 처음 보는 endpoint 는 이번 값을 기준으로 한다 (속도 0) */
+            UsbTrafficSnapshot previous = m_lastTraffic.value(key, ep.snapshot);
+            current.insert(key, ep.snapshot);
+
+            rows.append(rowOf(QString("    ep 0x%1").arg(ep.endpoint, 2, 16, QChar('0')),
+                              UsbTrafficRate::between(previous, ep.snapshot, intervalSec)));
+            addTo(&devicePrevious, previous);
+            addTo(&deviceCurrent, ep.snapshot);
+        }
+
+        UsbTrafficRate deviceRate = UsbTrafficRate::between(devicePrevious, deviceCurrent, intervalSec);
+        rows[deviceRow] = rowOf(portPath, deviceRate);
+        totalMBps += deviceRate.MBps;
+        totalTransfersPerSec += deviceRate.transfersPerSec;
+    }
+    m_lastTraffic = current;
+
+    /* 바뀐 cell 만 다시 그린다 */
+    QTableWidget *table = ui->tableWidget_traffic;
+    table->setRowCount(rows.size());
+    for (int row = 0; row < rows.size(); row++) {
+        for (int column = 0; column < rows.at(row).size(); column++) {
+            QTableWidgetItem *item = table->item(row, column);
+            if (item == NULL) {
+                item = new QTableWidgetItem;
+                if (column > 0)
+                    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                table->setItem(row, column, item);
+            }
+            if (item->text() != rows.at(row).at(column))
+                item->setText(rows.at(row).at(column));
+        }
+    }
+
+    ui->label_traffic_total->setText(QString("Total %1 MB/s, %2 transfers/s, %3 endpoints")
+                                     .arg(totalMBps, 0, 'f', 2).arg(totalTransfersPerSec, 0, 'f', 0).arg(endpoints.size()));
+}
+
+/********************************************************************************/
+/* 캡처 파일 열기 (memory map 만 하므로 파일 크기와 무관하게 바로 열린다) */
+/********************************************************************************/
+void MainWindow::on_pushButton_capture_open_clicked()
+{
+    QString path = ui->lineEdit_capture_path->text();
+    if (path.isEmpty()) {
+        path = QFileDialog::getOpenFileName(this, "Open capture");
+        if (path.isEmpty())
+            return;
+        ui->lineEdit_capture_path->setText(path);
+    }
+
+    ui->hexView_capture->setCaptureFile(NULL);
+    m_captureMatchOffset = -1;
+    /* 이전 파일의 검색은 open() 이 취소하고, 그 결과는 generation 이 달라서 무시된다 */
+    ui->pushButton_capture_search->setText("Find Next");
+    if (!m_captureFile.open(path)) {
+        ui->label_capture_status->setText("open failed");
+        return;
+    }
+    ui->hexView_capture->setCaptureFile(&m_captureFile);
+    ui->label_capture_status->setText(QString("%1 bytes").arg(m_captureFile.size()));
+}
+
+/********************************************************************************/
+/* offset 으로 이동 ("0x" 로 시작하면 16진수) */
+/********************************************************************************/
+void MainWindow::on_pushButton_capture_goto_clicked()
+{
+    bool ok = false;
+    qint64 offset = ui->lineEdit_capture_offset->text().trimmed().toLongLong(&ok, 0);
+    if (!ok || offset < 0 || offset >= m_captureFile.size()) {
+        ui->label_capture_status->setText("invalid offset");
+        return;
+    }
+    ui->hexView_capture->scrollToOffset(offset);
+    ui->hexView_capture->setHighlight(offset, 1);
+}
+
+/********************************************************************************/
+/* 다음 일치 위치 검색 (background), 검색중에 누르면 취소 */
+/********************************************************************************/
+void MainWindow::on_pushButton_capture_search_clicked()
+{
+    if (m_captureFile.isSearching()) {
+        m_captureFile.cancelSearch();
+        return;
+    }
+
+    QByteArray pattern = CaptureFile::parsePattern(ui->lineEdit_capture_pattern->text());
+    if (pattern.isEmpty()) {
+        ui->label_capture_status->setText("invalid pattern");
+        return;
+    }
+
+    /* 이전 결과 다음부터, 없으면 화면 맨 위부터 */
+    qint64 from = m_captureMatchOffset >= 0 ? m_captureMatchOffset + 1 : ui->hexView_capture->topOffset();
+    if (!m_captureFile.startSearch(pattern, from))
+        return;
+
+    m_captureMatchLength = pattern.size();
+    ui->pushButton_capture_search->setText("Cancel");
+    ui->label_capture_status->setText("searching...");
+}
+
+/********************************************************************************/
+/* 검색 진행률 (다시 열기 전의 파일의 검색이면 무시) */
+/********************************************************************************/
+void MainWindow::slotCaptureSearchProgress(int generation, int percent)
+{
+    if (generation != m_captureFile.generation())
+        return;
+
+    ui->label_capture_status->setText(QString("searching... %1%").arg(percent));
+}
+
+/********************************************************************************/
+/* 검색 결과 (다시 열기 전의 파일의 검색이면 무시) */
+/********************************************************************************/
+void MainWindow::slotCaptureSearchFinished(int generation, qint64 offset)
+{
+    if (generation != m_captureFile.generation())
+        return;
+
+    ui->pushButton_capture_search->setText("Find Next");
+
+    if (offset < 0) {
+        ui->label_capture_status->setText("not found");
+        return;
+    }
+
+    m_captureMatchOffset = offset;
+    ui->hexView_capture->scrollToOffset(offset);
+    ui->hexView_capture->setHighlight(offset, m_captureMatchLength);
+    ui->label_capture_status->setText(QString("found at 0x%1").arg(offset, 0, 16));
+}
+
+/********************************************************************************/
+/* 디스크립터 tree 다시 읽기 (이미 펼친 device 는 다시 읽지 않는다) */
+/********************************************************************************/
+void MainWindow::on_pushButton_descriptor_refresh_clicked()
+{
+    m_descriptorModel.refresh(&m_usbComm);
+}
+
+/********************************************************************************/
+/* 디스크립터 tree 를 JSON 파일로 저장 (펼치지 않은 configuration 도 읽는다) */
+/********************************************************************************/
+void MainWindow::on_pushButton_descriptor_export_clicked()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Export descriptors", "descriptors.json", "JSON (*.json)");
+    if (path.isEmpty())
+        return;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "open error:" << path;
+        return;
+    }
+    file.write(m_descriptorModel.toJson().toJson());
+}
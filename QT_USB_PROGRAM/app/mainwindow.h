@@ -0,0 +1,100 @@
+#ifndef MAINWINDOW_H
+#define MAINWINDOW_H
+
+#include <QMainWindow>
+#include <usbcomm.h>
+#include <QStringListModel>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include "capturefile.h"
+#include "descriptortreemodel.h"
+#include "usbtransferworker.h"
+
+QT_BEGIN_NAMESPACE
+namespace Ui {
+class MainWindow;
+}
+QT_END_NAMESPACE
+
+class MainWindow : public QMainWindow
+{
+    Q_OBJECT
+
+public:
+    MainWindow(QWidget *parent = nullptr);
+    ~MainWindow();
+
+    /* */
+    UsbComm		m_usbComm;
+
+public slots:
+    void slotGetDevInfoFromLibusb(QString vid, QString pid, QString portPath);
+    void slotGetDevStringsFromLibusb(QString portPath, QString manufacturer, QString product, QString serialNumber);
+
+private slots:
+    void on_pushButton_list_usb_devices_clicked();
+
+    void on_pushButton_reset_usb_device_clicked();
+
+    void on_pushButton_hot_plug_monitor_clicked();
+
+    void on_pushButton_read_usb_device_clicked();
+
+    void on_pushButton_write_usb_device_clicked();
+
+    void on_pushButton_rw_cancel_clicked();
+    /* read/write 진행 표시 (m_transferTimer) / 종료 */
+    void slotRefreshTransfer();
+    void slotTransferFinished(QString error, qint64 bytesDone, double elapsedSec);
+
+    /* 전송 모니터 갱신 (m_trafficTimer) */
+    void slotRefreshTraffic();
+
+    /* 캡처 보기 */
+    void on_pushButton_capture_open_clicked();
+    void on_pushButton_capture_goto_clicked();
+    void on_pushButton_capture_search_clicked();
+    void slotCaptureSearchProgress(int generation, int percent);
+    void slotCaptureSearchFinished(int generation, qint64 offset);
+
+    /* 디스크립터 */
+    void on_pushButton_descriptor_refresh_clicked();
+    void on_pushButton_descriptor_export_clicked();
+
+private:
+    /* device 목록에서 선택한 행의 device (선택하지 않았거나 행을 해석할 수 없으면 false) */
+    bool selectedDevice(UsbDeviceIdentity *identity) const;
+    /* 선택한 device 로 read/write 시작 (worker thread) */
+    void startTransfer(bool write);
+
+    Ui::MainWindow *ui;
+
+    QStringListModel	m_model_of_vid_pid_list;
+    QStringList			m_dataList_of_vid_pid_list;
+    /* m_dataList_of_vid_pid_list 의 각 행의 port path (string descriptor 를 받으면 해당 행만 갱신한다) */
+    QStringList			m_portPathList_of_vid_pid_list;
+
+    /* 전송 모니터: 전송마다 signal 을 받지 않고 10 Hz timer 로 counter 를 읽는다 (GUI 비용은 전송 속도와 무관) */
+    QTimer				m_trafficTimer;
+    QElapsedTimer		m_trafficClock;
+    qint64				m_lastTrafficNs;
+    /* 이전 갱신 때의 counter 값 (<handle, endpoint>) */
+    QHash<QPair<libusb_device_handle *, quint8>, UsbTrafficSnapshot> m_lastTraffic;
+
+    /* read/write: 전송은 worker thread 에서 하고, 진행 상황은 10 Hz timer 로 읽는다 */
+    UsbTransferWorker	m_transferWorker;
+    QTimer				m_transferTimer;
+
+    /* reset: open/reset 모두 UsbComm 의 worker pool 에서 하고, 끝나면 GUI thread 에서 결과를 표시한다 */
+    bool				m_resetting;
+
+    /* 캡처 보기: memory map 한 파일과 마지막 검색 결과 (없으면 -1) */
+    CaptureFile			m_captureFile;
+    qint64				m_captureMatchOffset;
+    int					m_captureMatchLength;
+
+    /* 디스크립터: configuration 이하는 tree 를 펼칠 때 읽는다 */
+    DescriptorTreeModel	m_descriptorModel;
+};
+#endif // MAINWINDOW_H
@@ -0,0 +1,146 @@
+/********************************************************************************/
+/* MainWindow 의 read/write 동작을 실행하는 worker thread */
+/********************************************************************************/
+#include "usbtransferworker.h"
+#include <QByteArray>
+#include <QDebug>
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:   usbComm: 전송에 사용할 UsbComm
+ *@return:
+ */
+/********************************************************************************/
+UsbTransferWorker::UsbTransferWorker(UsbComm *usbComm, QObject *parent) : QThread(parent)
+{
+    this->usbComm = usbComm;
+    bytesTotal = 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 실행 시작
+ *@param:   job: 전송 설정
+ *@return:  true=OK  false=NG (실행중 / 잘못된 설정)
+ */
+/********************************************************************************/
+bool UsbTransferWorker::startJob(const UsbTransferJob &job)
+{
+    if (isRunning() || job.size <= 0 || job.repetitions <= 0 || job.blockSize <= 0)
+        return false;
+
+    this->job = job;
+    cancelled.storeRelaxed(0);
+    bytesDone.storeRelaxed(0);
+    elapsedNs.storeRelaxed(0);
+    bytesTotal = job.size * job.repetitions;
+    timer.start();
+
+    start();
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 진행 상황
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbTransferProgress UsbTransferWorker::progress() const
+{
+    UsbTransferProgress p;
+    p.bytesDone = bytesDone.loadRelaxed();
+    p.bytesTotal = bytesTotal;
+    p.elapsedSec = (isRunning() ? timer.nsecsElapsed() : elapsedNs.loadRelaxed()) / 1e9;
+    return p;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 대상 device open + endpoint 의 interface 선언 (worker thread)
+ *@param:   error: 실패 이유
+ *@return:  device handle, 실패하면 NULL
+ */
+/********************************************************************************/
+libusb_device_handle *UsbTransferWorker::prepareDevice(QString *error)
+{
+    libusb_device_handle *deviceHandle = usbComm->openUsbDeviceByIdentity(job.device);
+    if (deviceHandle == NULL) {
+        *error = "open failed";
+        return NULL;
+    }
+
+    UsbEndpoint endpoint = usbComm->getEndpoint(deviceHandle, job.endpoint);
+    if (!endpoint.isValid() || !endpoint.info().isBulk()) {
+        *error = QString("no bulk endpoint 0x%1").arg(job.endpoint, 2, 16, QChar('0'));
+        return NULL;
+    }
+
+    if (!usbComm->claimUsbInterface(deviceHandle, endpoint.info().interfaceNumber)) {
+        *error = QString("claim interface %1 failed").arg(endpoint.info().interfaceNumber);
+        return NULL;
+    }
+    return deviceHandle;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 전송 본체 (worker thread)
+ *
+ * NOTE: 반복 1회의 마지막 block 은 (OUT 이면) ZLP 로 끝을 알린다.
+ * 	IN 에서 device 가 요청보다 짧게 보내면 받은 만큼 세고 다음 block 으로 넘어간다 (throughput test 용).
+ *
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbTransferWorker::run()
+{
+    QString error;
+    libusb_device_handle *deviceHandle = prepareDevice(&error);
+
+    if (deviceHandle != NULL) {
+        bool in = job.endpoint & LIBUSB_ENDPOINT_IN;
+        int blockSize = (int)qMin<qint64>(job.blockSize, job.size);
+        QByteArray buffer(blockSize, 0);
+        if (!in) {
+            for (int i = 0; i < blockSize; i++)
+                buffer[i] = (char)i;
+        }
+
+        for (int rep = 0; rep < job.repetitions && error.isEmpty(); rep++) {
+            qint64 remain = job.size;
+            while (remain > 0) {
+                if (cancelled.loadRelaxed()) {
+                    error = "cancelled";
+                    break;
+                }
+
+                int length = (int)qMin<qint64>(remain, blockSize);
+                qint64 done = usbComm->bulkTransferLarge(deviceHandle, job.endpoint, (quint8 *)buffer.data(), length,
+                                                         job.timeout, !in && length == remain);
+                if (done < 0) {
+                    error = libusb_error_name((int)done);
+                    break;
+                }
+                if (done == 0) {
+                    error = "timeout";
+                    break;
+                }
+                bytesDone.fetchAndAddRelaxed(done);
+                if (!in && done < length) {
+                    error = QString("short write (%1 / %2)").arg(done).arg(length);
+                    break;
+                }
+                remain -= length;
+            }
+        }
+    }
+
+    elapsedNs.storeRelaxed(timer.nsecsElapsed());
+    if (!error.isEmpty())
+        qDebug() << "UsbTransferWorker:" << error;
+    emit sigJobFinished(error, bytesDone.loadRelaxed(), elapsedNs.loadRelaxed() / 1e9);
+}
@@ -0,0 +1,87 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * MainWindow 의 read/write 동작을 실행하는 worker thread
+ *
+ * device open, interface 선언, bulk 전송(blocking) 을 모두 이 thread 에서 하므로 GUI thread 는 막히지 않는다.
+ * 진행 상황은 atomic counter 로만 남기고 signal 을 보내지 않는다. GUI 는 timer 로 progress() 를 읽는다.
+ * (전송 속도가 빨라도 GUI 로 가는 event 수는 늘지 않는다)
+ *
+ * 전송은 blockSize 단위로 나누어 하므로, 한 번에 수 GB 를 지정해도 memory 는 blockSize 만 쓰고
+ * cancel() 은 block 1개(최대 timeout) 안에 반영된다.
+ */
+#ifndef USBTRANSFERWORKER_H
+#define USBTRANSFERWORKER_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <usbcomm.h>
+
+/********************************************************************************/
+/* 전송 설정 */
+/********************************************************************************/
+struct UsbTransferJob
+{
+    UsbDeviceIdentity device;		/* 대상 device (open 되어있지 않으면 worker 가 open 한다) */
+    quint8 endpoint = 0x81;			/* IN 이면 read, OUT 이면 write */
+    qint64 size = 1024 * 1024;		/* 반복 1회의 bytes */
+    int repetitions = 1;
+    quint32 timeout = 1000;			/* block 1개의 timeout (ms) */
+    int blockSize = 16 * 1024 * 1024;
+};
+
+/********************************************************************************/
+/* 진행 상황 */
+/********************************************************************************/
+struct UsbTransferProgress
+{
+    qint64 bytesDone = 0;
+    qint64 bytesTotal = 0;
+    double elapsedSec = 0;
+
+    double MBps() const {return elapsedSec > 0 ? bytesDone / 1e6 / elapsedSec : 0;}
+    int permille() const {return bytesTotal > 0 ? (int)(bytesDone * 1000 / bytesTotal) : 0;}
+};
+
+/********************************************************************************/
+/* worker thread Class */
+/********************************************************************************/
+class UsbTransferWorker : public QThread
+{
+    Q_OBJECT
+public:
+    UsbTransferWorker(UsbComm *usbComm, QObject *parent = 0);
+
+    /* 실행 시작 (실행중이면 false) */
+    bool startJob(const UsbTransferJob &job);
+    /* 중단 요청 (진행중인 block 이 끝나면 멈춘다) */
+    void cancel() {cancelled.storeRelaxed(1);}
+
+    /* 현재 진행 상황 (어느 thread 에서든 호출 가능) */
+    UsbTransferProgress progress() const;
+
+signals:
+    /* 종료 (worker thread 에서 발생, error 가 비어있으면 성공) */
+    void sigJobFinished(QString error, qint64 bytesDone, double elapsedSec);
+
+protected:
+    virtual void run();
+
+private:
+    /* open + interface 선언 (이미 open 되어있으면 그 handle) */
+    libusb_device_handle *prepareDevice(QString *error);
+
+    UsbComm *usbComm;
+    UsbTransferJob job;
+
+    QAtomicInt cancelled;
+    QAtomicInteger<qint64> bytesDone;
+    QAtomicInteger<qint64> elapsedNs;
+    qint64 bytesTotal;
+    QElapsedTimer timer;
+};
+
+#endif // USBTRANSFERWORKER_H
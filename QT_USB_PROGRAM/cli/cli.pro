@@ -0,0 +1,29 @@
+################################################################################
+#
+# headless CLI / daemon (GUI 의존성 없음)
+#
+################################################################################
+TARGET = qt_usb_cli
+
+QT       = core
+
+CONFIG += c++20 console
+CONFIG -= app_bundle
+
+SOURCES += \
+        main.cpp \
+        usbcli.cpp
+
+HEADERS += \
+        usbcli.h
+
+################################################################################
+# usbcomm library
+################################################################################
+include(../usbcomm/usbcomm.pri)
+
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
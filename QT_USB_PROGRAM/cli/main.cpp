@@ -0,0 +1,41 @@
+#include "usbcli.h"
+#include "procstats.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QLoggingCategory>
+#include <QDebug>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("qt_usb_cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("headless USB tool (usbcomm)");
+    parser.addHelpOption();
+    parser.addPositionalArgument("command", "list | monitor | stream | stream-credit | record | replay | bench-chunk | bench-framing | rpc-bench | autotune | event-jitter | bench-shards | bring-up | flash | fleet");
+    UsbCli::addOptions(parser);
+    parser.process(a);
+
+    /* usbcomm 의 debug log 는 --verbose 일 때만 출력 */
+    if (!parser.isSet("verbose"))
+        QLoggingCategory::setFilterRules("default.debug=false");
+
+    if (parser.isSet("stats"))
+        qInfo().noquote() << "[cli]" << ProcStats::summary();
+
+    const QStringList args = parser.positionalArguments();
+    if (args.isEmpty())
+        parser.showHelp(1);
+
+    UsbCli::installSignalHandlers();
+
+    UsbCli cli;
+    int ret = cli.exec(args.first(), parser);
+
+    if (parser.isSet("stats"))
+        qInfo().noquote() << "[cli]" << ProcStats::summary();
+
+    return ret;
+}
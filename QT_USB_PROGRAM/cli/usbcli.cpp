@@ -0,0 +1,1332 @@
+/********************************************************************************/
+/* headless CLI / daemon */
+/********************************************************************************/
+#include "usbcli.h"
+#include <usbrecorder.h>
+#include <usbreplayer.h>
+#include <usbframeparser.h>
+#include <usbrpcclient.h>
+#include <usbstreamreader.h>
+#include <usbretry.h>
+#include <usbfirmware.h>
+#include <usbfleet.h>
+#include <QThread>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QDebug>
+#include <csignal>
+
+namespace {
+/* SIGINT/SIGTERM flag (signal handler 에서는 flag 만 세운다) */
+volatile std::sig_atomic_t g_stopRequested = 0;
+
+void stopSignalHandler(int)
+{
+    g_stopRequested = 1;
+}
+}
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbCli::UsbCli(QObject *parent) : QObject(parent), m_out(stdout)
+{
+}
+
+/********************************************************************************/
+/*
+ *@brief: command line option 등록
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbCli::addOptions(QCommandLineParser &parser)
+{
+    parser.addOptions({
+        {"device",    "open 할 device (VID:PID, 16진수)", "vid:pid"},
+        {"index",     "같은 VID:PID 가 여러개일 때 사용할 device index (default: 0)", "n", "0"},
+        {"serial",    "serial number 로 device 1개를 지정한다 (다른 device 는 열지 않는다)", "serial"},
+        {"port-path", "연결 위치로 device 1개를 지정한다 (예: 1-1.2)", "path"},
+        {"interface", "선언할 interface 번호 (default: 0)", "n", "0"},
+        {"configuration", "bring-up/fleet 에서 활성화할 configuration 번호 (지정하지 않으면 변경하지 않는다)", "n"},
+        {"parallel",  "bring-up 에서 동시에 초기화하는 device 수 (default: 0 = device 수 만큼)", "n", "0"},
+        {"endpoint",  "전송 endpoint 주소 (예: 0x81), stream 은 생략하면 bulk IN endpoint 를 찾는다", "ep"},
+        {"size",      "1회 전송 크기 bytes (default: 65536)", "bytes", "65536"},
+        {"timeout",   "1회 전송 timeout ms (default: 1000)", "ms", "1000"},
+        {"adaptive-timeout", "stream 에서 endpoint 의 지연 통계로 timeout 을 정한다 (--timeout 무시)"},
+        {"retries",   "stream 에서 실패한 전송의 재시도 횟수, STALL 은 clear halt 후 재시도 (default: 0)", "n", "0"},
+        {"bytes",     "전송할 총 bytes, 0 이면 SIGINT 까지 (default: 0)", "bytes", "0"},
+        {"output",    "record 출력 파일", "file"},
+        {"transfers", "동시에 submit 하는 전송 수 (default: 8)", "n", "8"},
+        {"block-size", "record 의 disk write 단위 bytes (default: 8388608)", "bytes", "8388608"},
+        {"blocks",    "record 의 write queue 깊이 (default: 8)", "n", "8"},
+        {"no-direct-io", "record 에서 O_DIRECT 를 사용하지 않는다"},
+        {"timestamp-index", "record 시 전송 완료 시각 index(<output>.idx)를 같이 기록한다"},
+        {"input",     "replay 입력 파일 / flash 의 firmware image", "file"},
+        {"verify",    "flash 의 검증 방법 (none / readback / crc, default: crc)", "mode", "crc"},
+        {"rate",      "replay 목표 속도 bytes/s (지정하지 않으면 최대 속도)", "bytes/s"},
+        {"timestamps", "replay 를 기록 시의 timestamp index 대로 pacing 한다"},
+        {"sizes",     "bench-chunk/autotune 에서 측정할 전송(chunk) 크기 목록 (쉼표 구분)", "list",
+                      "16384,65536,131072,262144,524288,1048576,2097152,4194304"},
+        {"depths",    "autotune 에서 측정할 동시 전송 수 목록 (쉼표 구분)", "list", "2,4,8,16,32"},
+        {"report",    "autotune 결과 report 파일 (.json 이면 JSON, 그 외는 CSV)", "file"},
+        {"no-save",   "autotune 결과를 설정 파일에 저장하지 않는다"},
+        {"frame-size", "bench-framing 의 최대 payload bytes (default: 1024)", "bytes", "1024"},
+        {"credits",   "stream-credit 의 처음 credit 수 (처리한 chunk 마다 1 credit 을 돌려준다, 지정하지 않으면 watermark 만 사용)", "n"},
+        {"high-watermark", "stream-credit 의 처리 대기 chunk 상한 (default: 32)", "n", "32"},
+        {"low-watermark", "stream-credit 의 수신 재개 기준 (default: 8)", "n", "8"},
+        {"consumer-delay", "stream-credit 에서 chunk 1개 처리에 걸리는 시간 us (느린 소비 측 모의, default: 0)", "us", "0"},
+        {"in-endpoint", "rpc-bench 의 응답 / flash 의 검증 IN endpoint 주소 (예: 0x81)", "ep"},
+        {"depth",     "rpc-bench 의 pipeline 깊이 (동시에 응답을 기다리는 요청 수, default: 8)", "n", "8"},
+        {"count",     "rpc-bench 의 요청 수 (default: 10000)", "n", "10000"},
+        {"delimiter", "bench-framing 을 delimiter('\\n') frame 으로 측정한다 (default: length-prefix)"},
+        {"sched-policy", "event thread, worker thread, replay submit thread 의 scheduling policy (other / fifo / rr)", "policy"},
+        {"sched-priority", "fifo/rr 의 실시간 우선순위 (1 ~ 99, default: 50)", "n", "50"},
+        {"sched-cpus", "event thread, worker thread, replay submit thread 를 실행할 CPU 목록 (쉼표 구분)", "list"},
+        {"mlock",     "process memory 를 RAM 에 고정한다 (page fault 지연 방지)"},
+        {"seconds",   "event-jitter/bench-shards 측정 시간 / fleet 실행 시간 (default: 10, fleet 은 0 이면 SIGINT 까지)", "sec", "10"},
+        {"shards",    "libusb context/event thread 수, device 를 나눠서 처리한다 (default: 1)", "n", "1"},
+        {"shard-mode", "device 를 shard 에 나누는 기준 (bus / port, default: port)", "mode", "port"},
+        {"stats",     "기동 시간/상주 메모리 출력"},
+        {"verbose",   "usbcomm debug log 출력"},
+    });
+}
+
+/********************************************************************************/
+/*
+ *@brief: SIGINT/SIGTERM 수신 여부
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+bool UsbCli::isStopRequested()
+{
+    return g_stopRequested != 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: SIGINT/SIGTERM handler 설치 (daemon 종료, 긴 전송 중단에 사용)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbCli::installSignalHandlers()
+{
+    std::signal(SIGINT, stopSignalHandler);
+    std::signal(SIGTERM, stopSignalHandler);
+}
+
+/********************************************************************************/
+/*
+ *@brief: command 실행
+ *@param:   command: list / monitor / stream / stream-credit / record / replay / bench-chunk / bench-framing / rpc-bench
+ * 			/ autotune / event-jitter / bench-shards / bring-up / flash / fleet
+ *@return:  process 종료 코드
+ */
+/********************************************************************************/
+int UsbCli::exec(const QString &command, const QCommandLineParser &parser)
+{
+    /* 모든 command 공통: event thread 와 worker thread (recorder writer, firmware/bring-up/fleet pool 등) 의 scheduling 설정 */
+    if (!schedFromOptions(parser, &m_schedConfig))
+        return 1;
+    m_usbComm.setEventThreadSchedConfig(m_schedConfig);
+    m_usbComm.setWorkerThreadSchedConfig(m_schedConfig);
+
+    /* 모든 command 공통: context/event thread 분할 (device open 전에 설정) */
+    if (parser.value("shards").toInt() > 1) {
+        UsbShardConfig shardConfig;
+        shardConfig.shardCount = parser.value("shards").toInt();
+        QString mode = parser.value("shard-mode");
+        if (mode == "bus") {
+            shardConfig.mode = UsbShardConfig::ByBus;
+        } else if (mode != "port") {
+            m_out << "invalid --shard-mode (bus / port)" << Qt::endl;
+            return 1;
+        }
+        if (!m_usbComm.setShardConfig(shardConfig)) {
+            m_out << "shard setting failed" << Qt::endl;
+            return 1;
+        }
+    }
+
+    if (command == "list")
+        return runList(parser);
+    if (command == "monitor")
+        return runMonitor();
+    if (command == "stream")
+        return runStream(parser);
+    if (command == "stream-credit")
+        return runStreamCredit(parser);
+    if (command == "record")
+        return runRecord(parser);
+    if (command == "replay")
+        return runReplay(parser);
+    if (command == "bench-chunk")
+        return runBenchChunk(parser);
+    if (command == "bench-framing")
+        return runBenchFraming(parser);
+    if (command == "rpc-bench")
+        return runRpcBench(parser);
+    if (command == "autotune")
+        return runAutoTune(parser);
+    if (command == "event-jitter")
+        return runEventJitter(parser);
+    if (command == "bench-shards")
+        return runBenchShards(parser);
+    if (command == "bring-up")
+        return runBringUp(parser);
+    if (command == "flash")
+        return runFlash(parser);
+    if (command == "fleet")
+        return runFleet(parser);
+
+    m_out << "unknown command: " << command << Qt::endl;
+    return 1;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 접속된 usb device 목록 출력 (--device 를 지정하면 그 device 의 endpoint 목록)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runList(const QCommandLineParser &parser)
+{
+    if (parser.isSet("device")) {
+        libusb_device_handle *deviceHandle = openFromOptions(parser);
+        if (deviceHandle == NULL)
+            return 1;
+
+        static const char *typeNames[] = {"control", "isochronous", "bulk", "interrupt"};
+        const QList<UsbEndpointInfo> endpoints = m_usbComm.getEndpoints(deviceHandle);
+        for (int i = 0; i < endpoints.size(); i++) {
+            const UsbEndpointInfo &info = endpoints.at(i);
+            UsbEndpoint ep(deviceHandle, info);
+            m_out << QString("if %1 alt %2  ep 0x%3 %4 %5  maxPacket %6 x%7  burst %8  interval %9  -> transfer %10 bytes, depth %11")
+                     .arg(info.interfaceNumber).arg(info.altSetting)
+                     .arg((int)info.address, 2, 16, QChar('0')).arg(info.isIn() ? "IN " : "OUT").arg(typeNames[info.transferType & 0x03])
+                     .arg(info.maxPacketSize).arg(info.packetsPerMicroframe * info.mult).arg(info.maxBurst).arg(info.interval)
+                     .arg(ep.suggestedTransferSize()).arg(ep.suggestedQueueDepth())
+                  << Qt::endl;
+        }
+        return 0;
+    }
+
+    connect(&m_usbComm, &UsbComm::sigPutDevInfo2MainUI, this, [this](QString vid, QString pid) {
+        m_out << vid << ", " << pid << Qt::endl;
+    });
+
+    m_usbComm.findUsbDevices();
+    return 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: daemon mode, hot plug event 를 SIGINT/SIGTERM 까지 출력한다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runMonitor()
+{
+    UsbMonitor monitor;
+
+    connect(&monitor, &UsbMonitor::deviceHotplugSig, this, [this](bool isAttached) {
+        m_out << (isAttached ? "attached" : "detached") << Qt::endl;
+    });
+
+    if (!monitor.registerHotplugMonitorService()) {
+        m_out << "hotplug monitor is not available" << Qt::endl;
+        return 1;
+    }
+
+    /* signal handler 는 flag 만 세우므로, event loop 에서 주기적으로 확인한다 */
+    QEventLoop loop;
+    QTimer stopTimer;
+    connect(&stopTimer, &QTimer::timeout, &loop, [&loop]() {
+        if (isStopRequested())
+            loop.quit();
+    });
+    stopTimer.start(100);
+
+    loop.exec();
+
+    monitor.deregisterHotplugMonitorService();
+    return 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: IN endpoint 를 연속으로 읽어, 1초 마다 전송 속도를 출력한다 (데이터는 버린다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runStream(const QCommandLineParser &parser)
+{
+    libusb_device_handle *deviceHandle = openFromOptions(parser);
+    if (deviceHandle == NULL)
+        return 1;
+
+    bool ok = false;
+    quint8 endpoint = parseNumber(parser.value("endpoint"), &ok);
+    int size = parser.value("size").toInt();
+    quint32 timeout = parser.value("timeout").toUInt();
+
+    /* --endpoint 를 지정하지 않으면 선언한 interface 의 bulk IN endpoint 를 사용한다 (--size 도 지정하지 않으면 endpoint 에 맞춘다) */
+    if (!parser.isSet("endpoint")) {
+        UsbEndpoint ep = m_usbComm.findEndpoint(deviceHandle, LIBUSB_TRANSFER_TYPE_BULK, true, parser.value("interface").toInt());
+        ok = ep.isValid();
+        if (ok) {
+            endpoint = ep.address();
+            if (!parser.isSet("size"))
+                size = ep.suggestedTransferSize();
+            m_out << QString("endpoint 0x%1, size %2").arg((int)endpoint, 2, 16, QChar('0')).arg(size) << Qt::endl;
+        }
+    }
+    qint64 totalBytes = parser.value("bytes").toLongLong();
+    if (!ok || size <= 0) {
+        m_out << "invalid --endpoint/--size" << Qt::endl;
+        return 1;
+    }
+
+    QByteArray buffer(size, 0);
+    qint64 received = 0;
+    qint64 receivedInSecond = 0;
+    QElapsedTimer totalTimer, secondTimer;
+    totalTimer.start();
+    secondTimer.start();
+
+    /* --adaptive-timeout: endpoint 의 지연 통계로 timeout 을 정하고, timeout 과 short read 를 구분해서 센다 */
+    bool adaptive = parser.isSet("adaptive-timeout");
+
+    /* --retries: 실패한 전송을 backoff 후 재시도한다 (STALL 이면 clear halt) */
+    int retries = parser.value("retries").toInt();
+    UsbRetryExecutor retryExecutor(&m_usbComm);
+    UsbRetryPolicy retryPolicy;
+    retryPolicy.maxAttempts = qMax(0, retries) + 1;
+    retryExecutor.setPolicy(retryPolicy);
+
+    while (!isStopRequested() && (totalBytes == 0 || received < totalBytes)) {
+        int len;
+        if (adaptive) {
+            UsbTransferResult result = m_usbComm.bulkTransferEx(deviceHandle, endpoint, (quint8 *)buffer.data(), size, 0);
+            if (result.status == UsbTransferResult::Error) {
+                m_out << "bulkTransferEx error: " << libusb_error_name(result.error) << Qt::endl;
+                return 1;
+            }
+            len = result.actualLength;
+        } else {
+            if (retries > 0) {
+                /* 재시도 판단은 이 thread 의 event loop 에서 하므로 waitForFinished() 가 아니라 event loop 로 기다린다 */
+                QFutureWatcher<int> watcher;
+                QEventLoop loop;
+                connect(&watcher, &QFutureWatcher<int>::finished, &loop, &QEventLoop::quit);
+                watcher.setFuture(retryExecutor.bulkTransfer(deviceHandle, endpoint, (quint8 *)buffer.data(), size, timeout));
+                if (!watcher.isFinished())
+                    loop.exec();
+                len = watcher.result();
+            } else {
+                len = m_usbComm.bulkTransfer(deviceHandle, endpoint, (quint8 *)buffer.data(), size, timeout);
+            }
+            if (len < 0) {
+                m_out << "bulkTransfer error: " << libusb_error_name(len) << Qt::endl;
+                return 1;
+            }
+        }
+        received += len;
+        receivedInSecond += len;
+
+        if (secondTimer.elapsed() >= 1000) {
+            m_out << QString("%1 MB/s").arg(receivedInSecond / 1e3 / secondTimer.elapsed(), 0, 'f', 2);
+            if (adaptive) {
+                UsbLatencyStats s = m_usbComm.getLatencyStats(deviceHandle, endpoint);
+                m_out << QString(", latency mean %1 us / p99 %2 us, timeout %3 ms, timeouts %4, short reads %5")
+                         .arg(s.meanUs, 0, 'f', 0).arg(s.percentileUs, 0, 'f', 0).arg(s.timeoutMs)
+                         .arg(s.timeouts).arg(s.shortReads);
+            }
+            if (retries > 0) {
+                UsbRecoveryCounters c = retryExecutor.counters();
+                m_out << QString(", retries %1 (clear halt %2, recovered %3)").arg(c.retries).arg(c.clearHalts).arg(c.recovered);
+            }
+            m_out << Qt::endl;
+            receivedInSecond = 0;
+            secondTimer.restart();
+        }
+    }
+
+    m_out << QString("total %1 bytes, %2 MB/s").arg(received).arg(received / 1e3 / qMax<qint64>(1, totalTimer.elapsed()), 0, 'f', 2) << Qt::endl;
+    return 0;
+}
+
+/********************************************************************************/
+/*
+ * UsbStreamReader 로 IN endpoint 를 읽는다 (credit/watermark 흐름 제어)
+ *
+ * --consumer-delay 로 느린 소비 측을 모의해서, 수신이 멈췄다가 재개되는 동작과 stall 시간을 확인한다.
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runStreamCredit(const QCommandLineParser &parser)
+{
+    libusb_device_handle *deviceHandle = openFromOptions(parser);
+    if (deviceHandle == NULL)
+        return 1;
+
+    bool ok = false;
+    quint8 endpoint = parseNumber(parser.value("endpoint"), &ok);
+    quint64 totalBytes = parser.value("bytes").toULongLong();
+    unsigned long consumerDelayUs = parser.value("consumer-delay").toULong();
+    if (!ok) {
+        m_out << "invalid --endpoint" << Qt::endl;
+        return 1;
+    }
+
+    UsbStreamConfig config;
+    config.transferSize = parser.value("size").toInt();
+    config.transferCount = parser.value("transfers").toInt();
+    config.highWatermark = parser.value("high-watermark").toInt();
+    config.lowWatermark = parser.value("low-watermark").toInt();
+    bool useCredits = parser.isSet("credits");
+    if (useCredits)
+        config.initialCredits = parser.value("credits").toInt();
+
+    UsbStreamReader reader(&m_usbComm);
+    if (!reader.start(deviceHandle, endpoint, config)) {
+        m_out << "stream start failed" << Qt::endl;
+        return 1;
+    }
+
+    QElapsedTimer reportTimer;
+    reportTimer.start();
+    UsbStreamChunk chunk;
+    quint64 consumed = 0;
+
+    while (!isStopRequested() && reader.isStreaming() && (totalBytes == 0 || consumed < totalBytes)) {
+        if (reader.read(&chunk, 100)) {
+            consumed += chunk.length;
+            if (consumerDelayUs > 0)
+                QThread::usleep(consumerDelayUs);
+            reader.release(&chunk);
+            if (useCredits)
+                reader.grantCredits(1);
+        }
+
+        if (reportTimer.elapsed() >= 1000) {
+            UsbStreamStats s = reader.stats();
+            m_out << QString("%1 MB/s, pending %2 (max %3), credits %4, pauses %5, stall %6 s")
+                     .arg(s.receiveMBps(), 0, 'f', 2).arg(s.pending).arg(s.maxPending).arg(s.credits)
+                     .arg(s.pauseEvents).arg(s.stallSec, 0, 'f', 3) << Qt::endl;
+            reportTimer.restart();
+        }
+    }
+
+    if (reader.hasFailed())
+        m_out << "stream stopped by transfer error" << Qt::endl;
+    reader.stop();
+
+    UsbStreamStats s = reader.stats();
+    m_out << QString("received %1 bytes in %2 s (%3 MB/s), max pending %4, pauses %5, stall %6 s, %7 transfer errors")
+             .arg(s.bytesReceived).arg(s.elapsedSec, 0, 'f', 2).arg(s.receiveMBps(), 0, 'f', 2).arg(s.maxPending)
+             .arg(s.pauseEvents).arg(s.stallSec, 0, 'f', 3).arg(s.transferErrors) << Qt::endl;
+
+    return s.transferErrors ? 2 : 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: IN endpoint 를 읽어서 파일에 기록한다 (UsbRecorder), 1초 마다 기록 통계를 출력한다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runRecord(const QCommandLineParser &parser)
+{
+    libusb_device_handle *deviceHandle = openFromOptions(parser);
+    if (deviceHandle == NULL)
+        return 1;
+
+    bool ok = false;
+    quint8 endpoint = parseNumber(parser.value("endpoint"), &ok);
+    quint64 totalBytes = parser.value("bytes").toULongLong();
+    if (!ok || !parser.isSet("output")) {
+        m_out << "invalid --endpoint/--output" << Qt::endl;
+        return 1;
+    }
+
+    UsbRecorderConfig config;
+    config.transferSize = parser.value("size").toInt();
+    config.transferCount = parser.value("transfers").toInt();
+    config.blockSize = parser.value("block-size").toInt();
+    config.blockCount = parser.value("blocks").toInt();
+    config.directIo = !parser.isSet("no-direct-io");
+    config.timestampIndex = parser.isSet("timestamp-index");
+
+    UsbRecorder recorder(&m_usbComm);
+    bool failed = false;
+    connect(&recorder, &UsbRecorder::sigRecordError, this, [this, &failed](QString message) {
+        m_out << message << Qt::endl;
+        failed = true;
+    });
+
+    if (!recorder.start(deviceHandle, endpoint, parser.value("output"), config)) {
+        m_out << "record start failed" << Qt::endl;
+        return 1;
+    }
+
+    QEventLoop loop;
+    QTimer timer;
+    int ticks = 0;
+    connect(&timer, &QTimer::timeout, &loop, [&]() {
+        UsbRecorderStats s = recorder.stats();
+        if (++ticks % 10 == 0) {
+            m_out << QString("received %1 MB, written %2 MB (%3 MB/s), dropped %4 bytes, queue max %5")
+                     .arg(s.bytesReceived / 1e6, 0, 'f', 1).arg(s.bytesWritten / 1e6, 0, 'f', 1)
+                     .arg(s.writeMBps(), 0, 'f', 2).arg(s.bytesDropped).arg(s.maxQueueDepth) << Qt::endl;
+        }
+        if (isStopRequested() || failed || !recorder.isRecording() || (totalBytes > 0 && s.bytesReceived >= totalBytes))
+            loop.quit();
+    });
+    timer.start(100);
+    loop.exec();
+
+    recorder.stop();
+
+    UsbRecorderStats s = recorder.stats();
+    m_out << QString("recorded %1 bytes in %2 s: %3 MB/s sustained, disk %4 MB/s, dropped %5 bytes (%6 events), %7 transfer errors, O_DIRECT %8")
+             .arg(s.bytesWritten).arg(s.elapsedSec, 0, 'f', 2).arg(s.writeMBps(), 0, 'f', 2)
+             .arg(s.diskMBps(), 0, 'f', 2).arg(s.bytesDropped).arg(s.dropEvents)
+             .arg(s.transferErrors).arg(s.directIo ? "on" : "off") << Qt::endl;
+    if (s.indexDropped > 0)
+        m_out << QString("timestamp index: %1 entries dropped (block index full)").arg(s.indexDropped) << Qt::endl;
+
+    return (failed || s.bytesDropped > 0) ? 2 : 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 기록 파일을 OUT endpoint 로 재생한다 (UsbReplayer), 1초 마다 재생 통계를 출력한다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runReplay(const QCommandLineParser &parser)
+{
+    libusb_device_handle *deviceHandle = openFromOptions(parser);
+    if (deviceHandle == NULL)
+        return 1;
+
+    bool ok = false;
+    quint8 endpoint = parseNumber(parser.value("endpoint"), &ok);
+    if (!ok || !parser.isSet("input")) {
+        m_out << "invalid --endpoint/--input" << Qt::endl;
+        return 1;
+    }
+
+    UsbReplayConfig config;
+    config.transferSize = parser.value("size").toInt();
+    config.transferCount = parser.value("transfers").toInt();
+    config.timeout = parser.value("timeout").toUInt();
+    if (parser.isSet("timestamps")) {
+        config.mode = UsbReplayConfig::Timestamps;
+    } else if (parser.isSet("rate")) {
+        config.mode = UsbReplayConfig::ByteRate;
+        config.bytesPerSec = parser.value("rate").toDouble();
+    }
+    config.submitterSched = m_schedConfig;
+
+    UsbReplayer replayer(&m_usbComm);
+    if (!replayer.start(deviceHandle, endpoint, parser.value("input"), config)) {
+        m_out << "replay start failed" << Qt::endl;
+        return 1;
+    }
+
+    QEventLoop loop;
+    QTimer timer;
+    int ticks = 0;
+    connect(&timer, &QTimer::timeout, &loop, [&]() {
+        if (++ticks % 10 == 0) {
+            UsbReplayStats s = replayer.stats();
+            m_out << QString("sent %1 / %2 MB (%3 MB/s)").arg(s.bytesSent / 1e6, 0, 'f', 1)
+                     .arg(s.bytesTotal / 1e6, 0, 'f', 1).arg(s.sendMBps(), 0, 'f', 2) << Qt::endl;
+        }
+        if (isStopRequested() || !replayer.isReplaying())
+            loop.quit();
+    });
+    timer.start(100);
+    loop.exec();
+
+    replayer.stop();
+
+    UsbReplayStats s = replayer.stats();
+    m_out << QString("replayed %1 / %2 bytes in %3 s: %4 MB/s, %5 transfer errors")
+             .arg(s.bytesSent).arg(s.bytesTotal).arg(s.elapsedSec, 0, 'f', 2)
+             .arg(s.sendMBps(), 0, 'f', 2).arg(s.transferErrors) << Qt::endl;
+    if (s.pacedSubmits > 0) {
+        m_out << QString("pacing jitter: mean %1 us, stddev %2 us, min %3 us, max %4 us, late %5 / %6")
+                 .arg(s.jitterMeanUs, 0, 'f', 1).arg(s.jitterStdDevUs, 0, 'f', 1)
+                 .arg(s.jitterMinUs, 0, 'f', 1).arg(s.jitterMaxUs, 0, 'f', 1)
+                 .arg(s.lateSubmits).arg(s.pacedSubmits) << Qt::endl;
+    }
+
+    return (s.transferErrors == 0 && s.bytesSent == s.bytesTotal) ? 0 : 2;
+}
+
+/********************************************************************************/
+/*
+ *@brief: bulkTransferLarge 의 chunk 크기 sweep benchmark, 가장 빠른 크기를 출력한다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runBenchChunk(const QCommandLineParser &parser)
+{
+    libusb_device_handle *deviceHandle = openFromOptions(parser);
+    if (deviceHandle == NULL)
+        return 1;
+
+    bool ok = false;
+    quint8 endpoint = parseNumber(parser.value("endpoint"), &ok);
+    qint64 bytesPerRun = parser.value("bytes").toLongLong();
+    if (!ok) {
+        m_out << "invalid --endpoint" << Qt::endl;
+        return 1;
+    }
+    if (bytesPerRun <= 0)
+        bytesPerRun = 64 * 1024 * 1024;
+
+    QList<int> chunkSizes;
+    const QStringList sizes = parser.value("sizes").split(',', Qt::SkipEmptyParts);
+    for (const QString &size : sizes)
+        chunkSizes.append(size.trimmed().toInt());
+
+    m_usbComm.setLargeTransferQueueDepth(parser.value("transfers").toInt());
+    QList<UsbChunkBenchResult> results = m_usbComm.benchmarkChunkSizes(deviceHandle, endpoint, bytesPerRun, chunkSizes);
+
+    m_out << "chunk bytes\tMB/s\tresult" << Qt::endl;
+    for (const UsbChunkBenchResult &result : results) {
+        m_out << result.chunkSize << "\t" << QString::number(result.mbps, 'f', 2) << "\t"
+              << (result.error ? libusb_error_name(result.error) : "OK") << Qt::endl;
+    }
+    m_out << "best chunk size: " << m_usbComm.getLargeTransferChunkSize() << Qt::endl;
+
+    return 0;
+}
+
+/********************************************************************************/
+/*
+ * 전송 크기 x 동시 전송 수 자동 조정
+ *
+ * 결과는 VID/PID + 속도 + endpoint 를 key 로 설정 파일에 저장되고 (--no-save 로 생략),
+ * 이후 같은 device 를 open 하면 bulkTransferLarge 에 적용된다.
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runAutoTune(const QCommandLineParser &parser)
+{
+    libusb_device_handle *deviceHandle = openFromOptions(parser);
+    if (deviceHandle == NULL)
+        return 1;
+
+    bool ok = false;
+    quint8 endpoint = parseNumber(parser.value("endpoint"), &ok);
+    qint64 bytesPerRun = parser.value("bytes").toLongLong();
+    if (!ok) {
+        m_out << "invalid --endpoint" << Qt::endl;
+        return 1;
+    }
+    if (bytesPerRun <= 0)
+        bytesPerRun = 64 * 1024 * 1024;
+
+    QList<int> transferSizes, queueDepths;
+    const QStringList sizes = parser.value("sizes").split(',', Qt::SkipEmptyParts);
+    for (const QString &size : sizes)
+        transferSizes.append(size.trimmed().toInt());
+    const QStringList depths = parser.value("depths").split(',', Qt::SkipEmptyParts);
+    for (const QString &depth : depths)
+        queueDepths.append(depth.trimmed().toInt());
+
+    QList<UsbTuneResult> results = m_usbComm.autoTune(deviceHandle, endpoint, bytesPerRun, transferSizes, queueDepths,
+                                                      !parser.isSet("no-save"));
+
+    m_out << "transfer bytes\tdepth\tMB/s\tcpu %\tresult" << Qt::endl;
+    for (const UsbTuneResult &result : results) {
+        m_out << result.transferSize << "\t" << result.queueDepth << "\t" << QString::number(result.mbps, 'f', 2) << "\t"
+              << QString::number(result.cpuPercent, 'f', 1) << "\t"
+              << (result.error ? libusb_error_name(result.error) : "OK") << Qt::endl;
+    }
+
+    UsbTuneProfile best = m_usbComm.getTunedProfile(deviceHandle, endpoint);
+    if (!best.isValid()) {
+        m_out << "no successful run" << Qt::endl;
+        return 1;
+    }
+    m_out << QString("best: transfer %1 bytes, depth %2 (%3 MB/s, %4 % cpu)")
+             .arg(best.transferSize).arg(best.queueDepth).arg(best.mbps, 0, 'f', 2).arg(best.cpuPercent, 0, 'f', 1) << Qt::endl;
+    if (!parser.isSet("no-save"))
+        m_out << "saved to " << m_usbComm.getTuningStorePath() << Qt::endl;
+
+    if (parser.isSet("report") && !UsbTuning::exportReport(parser.value("report"), best, results)) {
+        m_out << "report write failed" << Qt::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/********************************************************************************/
+/*
+ * UsbFrameParser benchmark (device 불필요)
+ *
+ * 임의 길이(1 ~ --frame-size)의 frame 을 이어붙인 stream 을 --size 단위 수신 buffer 로 나누어 미리 만들어두고,
+ * --bytes 만큼 반복해서 parser 에 넣는다. frames/s 와 frame 당 복사 bytes 를 출력한다.
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runBenchFraming(const QCommandLineParser &parser)
+{
+    int bufferSize = parser.value("size").toInt();
+    int maxPayload = parser.value("frame-size").toInt();
+    qint64 totalBytes = parser.value("bytes").toLongLong();
+    if (bufferSize <= 0 || maxPayload <= 0) {
+        m_out << "invalid --size/--frame-size" << Qt::endl;
+        return 1;
+    }
+    if (totalBytes <= 0)
+        totalBytes = 1024LL * 1024 * 1024;
+
+    UsbFrameConfig config;
+    if (parser.isSet("delimiter"))
+        config.mode = UsbFrameConfig::Delimiter;
+    config.maxFrameSize = maxPayload;
+
+    /* frame 경계에서 끝나는 stream (반복해서 넣어도 frame 이 이어진다) */
+    QByteArray stream;
+    quint32 seed = 1;
+    while (stream.size() < 64 * 1024 * 1024) {
+        seed = seed * 1103515245 + 12345;
+        int payload = 1 + (seed >> 8) % maxPayload;
+        if (config.mode == UsbFrameConfig::LengthPrefix) {
+            for (int i = 0; i < 4; i++)
+                stream.append((char)(payload >> (i * 8)));
+            stream.append(payload, 'a');
+        } else {
+            stream.append(payload, 'a');
+            stream.append(config.delimiter);
+        }
+    }
+
+    QList<QByteArray> buffers;
+    for (int offset = 0; offset < stream.size(); offset += bufferSize)
+        buffers.append(stream.mid(offset, bufferSize));
+    stream.clear();
+
+    UsbFrameParser frameParser(config);
+    UsbFrame frame;
+    quint64 payloadBytes = 0;
+    qint64 fedBytes = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    while (fedBytes < totalBytes && !isStopRequested()) {
+        for (int i = 0; i < buffers.size(); i++) {
+            const QByteArray &buffer = buffers.at(i);
+            frameParser.feed(buffer);
+            while (frameParser.next(&frame))
+                payloadBytes += frame.length;
+            fedBytes += buffer.size();
+        }
+    }
+    frame.release();
+    double sec = timer.nsecsElapsed() / 1e9;
+
+    const UsbFrameStats &stats = frameParser.stats();
+    m_out << "mode: " << (config.mode == UsbFrameConfig::LengthPrefix ? "length-prefix" : "delimiter")
+          << ", buffer " << bufferSize << " bytes, payload 1~" << maxPayload << " bytes" << Qt::endl;
+    m_out << "frames: " << stats.frames << " (" << QString::number(sec > 0 ? stats.frames / sec : 0, 'f', 0)
+          << " frames/s, " << QString::number(sec > 0 ? fedBytes / 1e6 / sec : 0, 'f', 1) << " MB/s)" << Qt::endl;
+    m_out << "copied: " << stats.bytesCopied << " bytes, " << stats.copiedFrames << " frames ("
+          << QString::number(stats.copiedBytesPerFrame(), 'f', 2) << " bytes/frame)" << Qt::endl;
+    m_out << "payload: " << payloadBytes << " bytes, errors: " << stats.errors << Qt::endl;
+
+    return stats.errors ? 1 : 0;
+}
+
+/********************************************************************************/
+/*
+ * UsbRpcClient 처리량 benchmark
+ *
+ * device 는 요청 frame 을 같은 id 로 그대로 돌려주는(echo) firmware 를 가정한다.
+ * 항상 --depth 개의 요청이 응답 대기중이 되도록 보내고, requests/s 와 평균 왕복 시간을 출력한다.
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runRpcBench(const QCommandLineParser &parser)
+{
+    libusb_device_handle *deviceHandle = openFromOptions(parser);
+    if (deviceHandle == NULL)
+        return 1;
+
+    bool outOk = false, inOk = false;
+    quint8 outEndpoint = parseNumber(parser.value("endpoint"), &outOk);
+    quint8 inEndpoint = parseNumber(parser.value("in-endpoint"), &inOk);
+    int depth = parser.value("depth").toInt();
+    int count = parser.value("count").toInt();
+    int timeoutMs = parser.value("timeout").toInt();
+    if (!outOk || !inOk || depth <= 0 || count <= 0) {
+        m_out << "invalid --endpoint/--in-endpoint/--depth/--count" << Qt::endl;
+        return 1;
+    }
+
+    UsbRpcConfig config;
+    config.maxOutstanding = depth;
+    UsbRpcClient client(&m_usbComm);
+    if (!client.start(deviceHandle, outEndpoint, inEndpoint, config)) {
+        m_out << "rpc start failed" << Qt::endl;
+        return 1;
+    }
+
+    QByteArray payload(qMin(parser.value("frame-size").toInt(), config.maxRequestSize - 8), 'r');
+    QHash<quint32, qint64> sentAt;
+    QElapsedTimer timer;
+    int issued = 0, completed = 0, failed = 0;
+    qint64 latencyNs = 0;
+
+    QEventLoop loop;
+    auto issue = [&]() {
+        while (issued < count && client.outstanding() < depth) {
+            quint32 id = client.call(payload, timeoutMs);
+            if (id == 0)
+                break;
+            sentAt.insert(id, timer.nsecsElapsed());
+            issued++;
+        }
+    };
+    auto finish = [&](quint32 id, bool ok) {
+        qint64 start = sentAt.take(id);
+        if (ok)
+            latencyNs += timer.nsecsElapsed() - start;
+        else
+            failed++;
+        if (++completed == count)
+            loop.quit();
+        else
+            issue();
+    };
+
+    connect(&client, &UsbRpcClient::sigResponse, &loop, [&](quint32 id, QByteArray) {finish(id, true);});
+    connect(&client, &UsbRpcClient::sigRequestFailed, &loop, [&](quint32 id, int) {finish(id, false);});
+
+    QTimer stopTimer;
+    connect(&stopTimer, &QTimer::timeout, &loop, [&]() {
+        if (isStopRequested())
+            loop.quit();
+        else
+            issue();
+    });
+    stopTimer.start(100);
+
+    timer.start();
+    issue();
+    loop.exec();
+    double sec = timer.nsecsElapsed() / 1e9;
+
+    client.stop();
+
+    UsbRpcStats s = client.stats();
+    int succeeded = completed - failed;
+    m_out << QString("depth %1: %2 requests in %3 s, %4 req/s, avg round trip %5 us")
+             .arg(depth).arg(succeeded).arg(sec, 0, 'f', 2).arg(sec > 0 ? succeeded / sec : 0, 0, 'f', 0)
+             .arg(succeeded ? latencyNs / 1e3 / succeeded : 0, 0, 'f', 1) << Qt::endl;
+    m_out << QString("timeouts %1, errors %2, unmatched %3").arg(s.timeouts).arg(s.errors).arg(s.unmatched) << Qt::endl;
+
+    return (failed == 0 && completed == count) ? 0 : 2;
+}
+
+/********************************************************************************/
+/*
+ *@brief: --device, --index, --interface option 으로 device 를 open 하고 interface 를 선언한다
+ *@param:
+ *@return:  device handle, 실패하면 NULL
+ */
+/********************************************************************************/
+libusb_device_handle *UsbCli::openFromOptions(const QCommandLineParser &parser)
+{
+    QStringList ids = parser.value("device").split(':');
+    bool vidOk = false, pidOk = false;
+    quint16 vid = ids.value(0).toUShort(&vidOk, 16);
+    quint16 pid = ids.value(1).toUShort(&pidOk, 16);
+    if (ids.size() != 2 || !vidOk || !pidOk) {
+        m_out << "invalid --device (VID:PID)" << Qt::endl;
+        return NULL;
+    }
+
+    libusb_device_handle *deviceHandle = NULL;
+    if (parser.isSet("serial") || parser.isSet("port-path")) {
+        /* --serial/--port-path: 일치하는 device 1개만 연다 */
+        UsbDeviceIdentity identity;
+        identity.vid = vid;
+        identity.pid = pid;
+        identity.serialNumber = parser.value("serial");
+        identity.portPath = parser.value("port-path");
+        deviceHandle = m_usbComm.openUsbDeviceByIdentity(identity);
+        if (deviceHandle == NULL) {
+            m_out << "no device matches --serial/--port-path" << Qt::endl;
+            return NULL;
+        }
+    } else {
+        QMultiMap<quint16, quint16> vpidMap;
+        vpidMap.insert(vid, pid);
+        if (!m_usbComm.openUsbDevice(vpidMap)) {
+            m_out << "no device opened" << Qt::endl;
+            return NULL;
+        }
+
+        deviceHandle = m_usbComm.getDeviceHandleFromIndex(parser.value("index").toInt());
+        if (deviceHandle == NULL) {
+            m_out << "invalid --index" << Qt::endl;
+            return NULL;
+        }
+    }
+
+    if (!m_usbComm.claimUsbInterface(deviceHandle, parser.value("interface").toInt())) {
+        m_out << "claim interface failed" << Qt::endl;
+        return NULL;
+    }
+
+    return deviceHandle;
+}
+
+/********************************************************************************/
+/*
+ * event thread 의 jitter 측정 (device 불필요)
+ *
+ * event thread 를 1ms 마다 깨워서 예정보다 늦게 깨어난 시간을 1초마다 출력한다.
+ * 부하(stress 등)를 건 상태에서 --sched-policy fifo --sched-cpus 의 유무로 비교한다.
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runEventJitter(const QCommandLineParser &parser)
+{
+    int seconds = parser.value("seconds").toInt();
+
+    m_usbComm.setEventThreadJitterProbe(1);
+    if (!m_usbComm.startEventHandler()) {
+        m_out << "event thread start failed" << Qt::endl;
+        return 1;
+    }
+    m_out << "event thread: " << UsbThreadSched::describe(m_schedConfig) << Qt::endl;
+
+    for (int i = 0; (seconds <= 0 || i < seconds) && !isStopRequested(); i++) {
+        QThread::sleep(1);
+        UsbJitterStats s = m_usbComm.getEventThreadJitterStats();
+        m_out << QString("wakeups %1, late mean %2 us / stddev %3 us / max %4 us, >1ms %5")
+                 .arg(s.samples).arg(s.meanUs, 0, 'f', 1).arg(s.stdDevUs, 0, 'f', 1).arg(s.maxUs, 0, 'f', 1)
+                 .arg(s.lateSamples) << Qt::endl;
+    }
+
+    m_usbComm.setEventThreadJitterProbe(0);
+    return 0;
+}
+
+/********************************************************************************/
+/*
+ * 여러 device 동시 수신 (context/event thread 분할 효과 측정)
+ *
+ * --device 의 VID:PID 와 일치하는 모든 device 에서 bulk IN 을 UsbStreamReader 로 동시에 수신하고,
+ * 1초마다 전체 MB/s 와 chunk(전송 완료)/s 를 출력한다. --shards 1 과 --shards N 을 비교한다.
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runBenchShards(const QCommandLineParser &parser)
+{
+    QStringList ids = parser.value("device").split(':');
+    bool vidOk = false, pidOk = false;
+    quint16 vid = ids.value(0).toUShort(&vidOk, 16);
+    quint16 pid = ids.value(1).toUShort(&pidOk, 16);
+    if (ids.size() != 2 || !vidOk || !pidOk) {
+        m_out << "invalid --device (VID:PID)" << Qt::endl;
+        return 1;
+    }
+
+    QMultiMap<quint16, quint16> vpidMap;
+    vpidMap.insert(vid, pid);
+    if (!m_usbComm.openUsbDevice(vpidMap)) {
+        m_out << "no device opened" << Qt::endl;
+        return 1;
+    }
+
+    UsbStreamConfig config;
+    config.transferSize = parser.value("size").toInt();
+    config.transferCount = parser.value("transfers").toInt();
+    int interfaceNumber = parser.value("interface").toInt();
+    int seconds = parser.value("seconds").toInt();
+
+    /* 모든 device 에서 수신 시작 */
+    QList<UsbStreamReader *> readers;
+    QVector<int> devicesPerShard(m_usbComm.getShardCount(), 0);
+    for (int i = 0; i < m_usbComm.getOpenedDeviceCount(); i++) {
+        libusb_device_handle *deviceHandle = m_usbComm.getDeviceHandleFromIndex(i);
+        if (!m_usbComm.claimUsbInterface(deviceHandle, interfaceNumber)) {
+            m_out << "device " << i << ": claim interface failed" << Qt::endl;
+            continue;
+        }
+
+        bool ok = parser.isSet("endpoint");
+        quint8 endpoint = ok ? parseNumber(parser.value("endpoint"), &ok) : 0;
+        if (!parser.isSet("endpoint")) {
+            UsbEndpoint ep = m_usbComm.findEndpoint(deviceHandle, LIBUSB_TRANSFER_TYPE_BULK, true, interfaceNumber);
+            ok = ep.isValid();
+            endpoint = ep.address();
+        }
+        if (!ok) {
+            m_out << "device " << i << ": no bulk IN endpoint" << Qt::endl;
+            continue;
+        }
+
+        UsbStreamReader *reader = new UsbStreamReader(&m_usbComm, this);
+        if (!reader->start(deviceHandle, endpoint, config)) {
+            m_out << "device " << i << ": stream start failed" << Qt::endl;
+            delete reader;
+            continue;
+        }
+        readers.append(reader);
+        devicesPerShard[qMax(0, m_usbComm.getDeviceShard(deviceHandle))]++;
+    }
+    if (readers.isEmpty())
+        return 1;
+
+    QStringList shardText;
+    for (int i = 0; i < devicesPerShard.size(); i++)
+        shardText.append(QString::number(devicesPerShard.at(i)));
+    m_out << readers.size() << " devices, " << m_usbComm.getShardCount() << " shards (devices per shard: "
+          << shardText.join(' ') << ")" << Qt::endl;
+
+    /* 수신한 chunk 는 바로 돌려준다 (측정 대상은 USB 완료 처리) */
+    quint64 lastBytes = 0, lastChunks = 0;
+    QElapsedTimer totalTimer, secondTimer;
+    totalTimer.start();
+    secondTimer.start();
+    while (!isStopRequested() && (seconds <= 0 || totalTimer.elapsed() < seconds * 1000LL)) {
+        bool idle = true;
+        int streaming = 0;
+        for (int i = 0; i < readers.size(); i++) {
+            UsbStreamChunk chunk;
+            while (readers.at(i)->read(&chunk, 0)) {
+                readers.at(i)->release(&chunk);
+                idle = false;
+            }
+            if (readers.at(i)->isStreaming())
+                streaming++;
+        }
+        /* 모든 device 가 전송 에러(분리 등)로 멈췄다 */
+        if (streaming == 0) {
+            m_out << "all streams stopped" << Qt::endl;
+            break;
+        }
+        if (idle)
+            QThread::usleep(100);
+
+        if (secondTimer.elapsed() >= 1000) {
+            quint64 bytes = 0, chunks = 0, errors = 0;
+            for (int i = 0; i < readers.size(); i++) {
+                UsbStreamStats s = readers.at(i)->stats();
+                bytes += s.bytesReceived;
+                chunks += s.chunks;
+                errors += s.transferErrors;
+            }
+            double sec = secondTimer.elapsed() / 1e3;
+            m_out << QString("%1 MB/s, %2 completions/s, errors %3")
+                     .arg((bytes - lastBytes) / 1e6 / sec, 0, 'f', 2).arg((chunks - lastChunks) / sec, 0, 'f', 0).arg(errors)
+                  << Qt::endl;
+            lastBytes = bytes;
+            lastChunks = chunks;
+            secondTimer.restart();
+        }
+    }
+
+    for (int i = 0; i < readers.size(); i++)
+        readers.at(i)->stop();
+    qDeleteAll(readers);
+    return 0;
+}
+
+/********************************************************************************/
+/*
+ * 여러 device 병렬 bring-up (시험 지그용)
+ *
+ * --device 의 VID:PID 와 일치하는 모든 device 를 병렬로 open + configuration + claim + device descriptor read 하고,
+ * device 별 단계 시간과 전체 시간을 출력한다. --parallel 1 로 순차 처리와 비교할 수 있다.
+ *@param:
+ *@return:  모든 device 가 성공하면 0
+ */
+/********************************************************************************/
+int UsbCli::runBringUp(const QCommandLineParser &parser)
+{
+    QStringList ids = parser.value("device").split(':');
+    bool vidOk = false, pidOk = false;
+    quint16 vid = ids.value(0).toUShort(&vidOk, 16);
+    quint16 pid = ids.value(1).toUShort(&pidOk, 16);
+    if (ids.size() != 2 || !vidOk || !pidOk) {
+        m_out << "invalid --device (VID:PID)" << Qt::endl;
+        return 1;
+    }
+
+    UsbDeviceMatcher matcher;
+    matcher.addId(vid, pid);
+    if (parser.isSet("serial"))
+        matcher.setSerialNumber(parser.value("serial"));
+    if (parser.isSet("port-path") && !matcher.setPortPath(parser.value("port-path"))) {
+        m_out << "invalid --port-path" << Qt::endl;
+        return 1;
+    }
+
+    UsbBringUpConfig config;
+    if (parser.isSet("configuration"))
+        config.configuration = parser.value("configuration").toInt();
+    config.interfaces.append(parser.value("interface").toInt());
+    config.controlReads.append(UsbControlRead());		/* device descriptor */
+    config.maxParallel = parser.value("parallel").toInt();
+
+    QElapsedTimer timer;
+    timer.start();
+    const QList<UsbBringUpResult> results = m_usbComm.bringUpDevices(matcher, config);
+    double wallMs = timer.nsecsElapsed() / 1e6;
+
+    if (results.isEmpty()) {
+        m_out << "no device found" << Qt::endl;
+        return 1;
+    }
+
+    int failed = 0;
+    double sumMs = 0;
+    for (int i = 0; i < results.size(); i++) {
+        const UsbBringUpResult &r = results.at(i);
+        m_out << QString("%1  shard %2  wait %3  open %4  config %5  claim %6  init %7  total %8 ms  %9")
+                 .arg(r.portPath, -10).arg(r.shard)
+                 .arg(r.waitMs, 0, 'f', 1).arg(r.openMs, 0, 'f', 1).arg(r.configMs, 0, 'f', 1)
+                 .arg(r.claimMs, 0, 'f', 1).arg(r.initMs, 0, 'f', 1).arg(r.totalMs, 0, 'f', 1)
+                 .arg(r.ok ? QString("ok") : "FAILED: " + r.error) << Qt::endl;
+        sumMs += r.totalMs;
+        if (!r.ok)
+            failed++;
+    }
+    m_out << QString("%1 devices (%2 failed), wall %3 ms, sum of device times %4 ms")
+             .arg(results.size()).arg(failed).arg(wallMs, 0, 'f', 1).arg(sumMs, 0, 'f', 1) << Qt::endl;
+
+    return failed == 0 ? 0 : 1;
+}
+
+/********************************************************************************/
+/*
+ * 여러 device 에 firmware 동시 download
+ *
+ * --device 의 VID:PID 와 일치하는 모든 device 에 --input image 를 --endpoint(OUT) 로 보내고,
+ * --verify 방법으로 --in-endpoint 에서 검증한다. 1초마다 device 별 진행률/MB/s 를 출력한다.
+ *@param:
+ *@return:  모든 device 가 성공하면 0
+ */
+/********************************************************************************/
+int UsbCli::runFlash(const QCommandLineParser &parser)
+{
+    UsbFirmwareConfig config;
+    bool outOk = false, inOk = true;
+    config.outEndpoint = parseNumber(parser.value("endpoint"), &outOk);
+    if (parser.isSet("in-endpoint"))
+        config.inEndpoint = parseNumber(parser.value("in-endpoint"), &inOk);
+    if (!outOk || !inOk) {
+        m_out << "invalid --endpoint/--in-endpoint" << Qt::endl;
+        return 1;
+    }
+    config.transferSize = parser.value("size").toInt();
+    config.transferCount = parser.value("transfers").toInt();
+    config.timeout = parser.value("timeout").toUInt();
+
+    QString verify = parser.value("verify");
+    if (verify == "none") {
+        config.verify = UsbFirmwareConfig::None;
+    } else if (verify == "readback") {
+        config.verify = UsbFirmwareConfig::ReadBack;
+    } else if (verify != "crc") {
+        m_out << "invalid --verify (none / readback / crc)" << Qt::endl;
+        return 1;
+    }
+
+    UsbFirmwareLoader loader(&m_usbComm);
+    if (!loader.loadImage(parser.value("input"))) {
+        m_out << "cannot load --input" << Qt::endl;
+        return 1;
+    }
+
+    /* 같은 VID:PID 의 모든 device (openFromOptions 가 --index 의 interface 를 선언한다) */
+    if (openFromOptions(parser) == NULL)
+        return 1;
+    QList<libusb_device_handle *> devices;
+    for (int i = 0; i < m_usbComm.getOpenedDeviceCount(); i++) {
+        libusb_device_handle *deviceHandle = m_usbComm.getDeviceHandleFromIndex(i);
+        if (m_usbComm.claimUsbInterface(deviceHandle, parser.value("interface").toInt()))
+            devices.append(deviceHandle);
+    }
+
+    m_out << QString("image %1 bytes, crc %2, %3 devices")
+             .arg(loader.imageSize()).arg(loader.imageCrc(), 8, 16, QChar('0')).arg(devices.size()) << Qt::endl;
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!loader.start(devices, config)) {
+        m_out << "flash start failed" << Qt::endl;
+        return 1;
+    }
+
+    static const char *stateNames[] = {"pending", "prepare", "download", "verify", "done", "FAILED"};
+    while (!loader.waitForFinished(1000)) {
+        if (isStopRequested())
+            loader.cancel();
+
+        const QList<UsbFirmwareProgress> list = loader.progress();
+        QStringList items;
+        for (int i = 0; i < list.size(); i++)
+            items.append(QString("#%1 %2 %3% %4MB/s").arg(i).arg(stateNames[list.at(i).state])
+                         .arg(list.at(i).percent(), 0, 'f', 0).arg(list.at(i).downloadMBps(), 0, 'f', 1));
+        m_out << items.join("  ") << Qt::endl;
+    }
+    double wallSec = timer.nsecsElapsed() / 1e9;
+
+    int failed = 0;
+    double longestSec = 0;
+    const QList<UsbFirmwareProgress> list = loader.progress();
+    for (int i = 0; i < list.size(); i++) {
+        const UsbFirmwareProgress &p = list.at(i);
+        longestSec = qMax(longestSec, p.downloadSec + p.verifySec);
+        m_out << QString("#%1 %2  download %3 s (%4 MB/s)  verify %5 s  %6")
+                 .arg(i).arg(stateNames[p.state]).arg(p.downloadSec, 0, 'f', 2).arg(p.downloadMBps(), 0, 'f', 1)
+                 .arg(p.verifySec, 0, 'f', 2).arg(p.error) << Qt::endl;
+        if (p.state != UsbFirmwareProgress::Done)
+            failed++;
+    }
+    m_out << QString("%1 devices (%2 failed), wall %3 s, slowest device %4 s, aggregate %5 MB/s")
+             .arg(list.size()).arg(failed).arg(wallSec, 0, 'f', 2).arg(longestSec, 0, 'f', 2)
+             .arg(wallSec > 0 ? loader.imageSize() * (list.size() - failed) / 1e6 / wallSec : 0, 0, 'f', 1) << Qt::endl;
+
+    return failed == 0 ? 0 : 1;
+}
+
+/********************************************************************************/
+/*
+ * 여러 device 의 lifecycle 관리
+ *
+ * --device 의 VID:PID 와 일치하는 device 를 UsbFleetManager 로 관리한다 (접속 감지 -> bring-up -> 분리 시 close, 에러 시 reset).
+ * 1초마다 상태별 device 수를 출력하고, 상태가 바뀐 device 를 출력한다. --seconds 0 이면 SIGINT 까지 실행한다.
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbCli::runFleet(const QCommandLineParser &parser)
+{
+    QStringList ids = parser.value("device").split(':');
+    bool vidOk = false, pidOk = false;
+    quint16 vid = ids.value(0).toUShort(&vidOk, 16);
+    quint16 pid = ids.value(1).toUShort(&pidOk, 16);
+    if (ids.size() != 2 || !vidOk || !pidOk) {
+        m_out << "invalid --device (VID:PID)" << Qt::endl;
+        return 1;
+    }
+
+    QMultiMap<quint16, quint16> vpidMap;
+    vpidMap.insert(vid, pid);
+
+    UsbFleetConfig config;
+    if (parser.isSet("configuration"))
+        config.bringUp.configuration = parser.value("configuration").toInt();
+    config.bringUp.interfaces.append(parser.value("interface").toInt());
+
+    UsbFleetManager fleet(&m_usbComm);
+    fleet.setDeviceIds(vpidMap);
+    fleet.setConfig(config);
+    if (!fleet.start()) {
+        m_out << "fleet start failed" << Qt::endl;
+        return 1;
+    }
+
+    int seconds = parser.value("seconds").toInt();
+    QElapsedTimer timer;
+    timer.start();
+    QHash<QString, quint64> lastTransitions;
+    while (!isStopRequested() && (seconds <= 0 || timer.elapsed() < seconds * 1000LL)) {
+        QThread::msleep(1000);
+        /* 전송 counter 반영 (Streaming/Error), backoff 가 끝난 복구 재시도 */
+        fleet.poll();
+
+        /* 상태가 바뀐 device 만 출력 (device 수가 많아도 출력량은 변화량에 비례) */
+        const QList<UsbFleetDevice> list = fleet.snapshot();
+        for (int i = 0; i < list.size(); i++) {
+            const UsbFleetDevice &d = list.at(i);
+            if (lastTransitions.value(d.portPath) == d.transitions)
+                continue;
+            lastTransitions.insert(d.portPath, d.transitions);
+            m_out << QString("%1  %2:%3  %4  %5")
+                     .arg(d.portPath, -10).arg(d.vid, 4, 16, QChar('0')).arg(d.pid, 4, 16, QChar('0'))
+                     .arg(UsbFleetManager::stateName(d.state)).arg(d.lastError) << Qt::endl;
+        }
+
+        const QVector<int> counts = fleet.stateCounts();
+        QStringList items;
+        for (int state = 0; state < counts.size(); state++)
+            items.append(QString("%1 %2").arg(UsbFleetManager::stateName(state)).arg(counts.at(state)));
+        m_out << items.join("  ") << Qt::endl;
+    }
+
+    fleet.stop();
+    return 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: --sched-policy/--sched-priority/--sched-cpus/--mlock 변환
+ *@param:
+ *@return:  true=OK  false=NG (잘못된 값)
+ */
+/********************************************************************************/
+bool UsbCli::schedFromOptions(const QCommandLineParser &parser, UsbThreadSchedConfig *config)
+{
+    if (parser.isSet("sched-policy") && !UsbThreadSched::parsePolicy(parser.value("sched-policy"), &config->policy)) {
+        m_out << "invalid --sched-policy (other / fifo / rr)" << Qt::endl;
+        return false;
+    }
+    config->priority = parser.value("sched-priority").toInt();
+
+    if (parser.isSet("sched-cpus") && !UsbThreadSched::parseCpuList(parser.value("sched-cpus"), &config->cpus)) {
+        m_out << "invalid --sched-cpus" << Qt::endl;
+        return false;
+    }
+    config->lockMemory = parser.isSet("mlock");
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: "0x81" (16진수) 또는 "129" (10진수) 문자열 변환
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+quint32 UsbCli::parseNumber(const QString &text, bool *ok)
+{
+    if (text.startsWith("0x", Qt::CaseInsensitive))
+        return text.mid(2).toUInt(ok, 16);
+    return text.toUInt(ok, 10);
+}
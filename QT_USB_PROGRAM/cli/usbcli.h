@@ -0,0 +1,71 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * headless CLI / daemon
+ *
+ * GUI 없이 QCoreApplication 위에서 usbcomm library 를 사용한다.
+ * 각 command 는 UsbCli 의 run 메서드 하나로 구현되며, process 종료 코드를 반환한다.
+ */
+#ifndef USBCLI_H
+#define USBCLI_H
+
+#include <QObject>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <usbcomm.h>
+
+class UsbCli : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UsbCli(QObject *parent = 0);
+
+    /* command line option 등록 */
+    static void addOptions(QCommandLineParser &parser);
+
+    /* command 실행 (종료 코드 반환) */
+    int exec(const QString &command, const QCommandLineParser &parser);
+
+    /* SIGINT/SIGTERM 수신 여부 */
+    static bool isStopRequested();
+    static void installSignalHandlers();
+
+private:
+    /********************************************************************************/
+    /* command */
+    /********************************************************************************/
+    int runList(const QCommandLineParser &parser);
+    int runMonitor();
+    int runStream(const QCommandLineParser &parser);
+    int runStreamCredit(const QCommandLineParser &parser);
+    int runRecord(const QCommandLineParser &parser);
+    int runReplay(const QCommandLineParser &parser);
+    int runBenchChunk(const QCommandLineParser &parser);
+    int runBenchFraming(const QCommandLineParser &parser);
+    int runRpcBench(const QCommandLineParser &parser);
+    int runAutoTune(const QCommandLineParser &parser);
+    int runEventJitter(const QCommandLineParser &parser);
+    int runBenchShards(const QCommandLineParser &parser);
+    int runBringUp(const QCommandLineParser &parser);
+    int runFlash(const QCommandLineParser &parser);
+    int runFleet(const QCommandLineParser &parser);
+
+    /********************************************************************************/
+    /* 공통 처리 */
+    /********************************************************************************/
+    /* --device VID:PID (--serial/--port-path 를 지정하면 그 device 1개) 를 open 하고, --interface 를 선언한다 */
+    libusb_device_handle *openFromOptions(const QCommandLineParser &parser);
+
+    /* "0x81", "129" 등의 숫자 문자열 변환 */
+    static quint32 parseNumber(const QString &text, bool *ok);
+
+    /* --sched-policy/--sched-priority/--sched-cpus/--mlock 변환 */
+    bool schedFromOptions(const QCommandLineParser &parser, UsbThreadSchedConfig *config);
+
+    UsbComm		m_usbComm;
+    UsbThreadSchedConfig m_schedConfig;
+    QTextStream	m_out;
+};
+
+#endif // USBCLI_H
@@ -0,0 +1,142 @@
+/********************************************************************************/
+/* process 자원 측정 (startup 시간, 상주 메모리, CPU 시간) */
+/********************************************************************************/
+#include "procstats.h"
+#include <QFile>
+#include <QByteArray>
+#include <QList>
+
+#ifdef Q_OS_LINUX
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/********************************************************************************/
+/*
+ *@brief: /proc/self/status 에서 지정 항목(KB 단위) 값을 읽는다
+ *@param:   key: "VmRSS:", "VmHWM:" 등
+ *@return:  KB, 취득 불가면 -1
+ */
+/********************************************************************************/
+qint64 readStatusKb(const QByteArray &key)
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith(key)) {
+            /* "VmRSS:	   12345 kB" */
+            return line.mid(key.size()).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+#else
+    Q_UNUSED(key)
+#endif
+    return -1;
+}
+
+}
+
+/********************************************************************************/
+/*
+ *@brief: process 생성 시점부터의 경과 시간
+ *
+ * /proc/self/stat 의 starttime(22번째 항목, boot 이후 clock tick)과
+ * CLOCK_BOOTTIME 의 차이로 계산한다. shared lib 로딩 시간까지 포함되므로
+ * widgets 스택의 기동 비용을 비교할 수 있다. (해상도: 1 clock tick, 보통 10ms)
+ *
+ *@return:  ms, 취득 불가면 -1
+ */
+/********************************************************************************/
+qint64 ProcStats::uptimeMs()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/stat");
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+
+    /* comm 항목에 공백이 있을 수 있으므로 마지막 ')' 이후부터 자른다 */
+    QByteArray stat = file.readAll();
+    int pos = stat.lastIndexOf(')');
+    if (pos < 0)
+        return -1;
+
+    /* ')' 이후 첫 항목은 3번째(state) 항목이므로, starttime 은 index 19 */
+    QList<QByteArray> fields = stat.mid(pos + 2).split(' ');
+    if (fields.size() <= 19)
+        return -1;
+
+    qint64 startTicks = fields.at(19).toLongLong();
+    long ticksPerSec = sysconf(_SC_CLK_TCK);
+    if (ticksPerSec <= 0)
+        return -1;
+
+    struct timespec now;
+    if (clock_gettime(CLOCK_BOOTTIME, &now) != 0)
+        return -1;
+
+    qint64 nowMs = (qint64)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    return nowMs - startTicks * 1000 / ticksPerSec;
+#else
+    return -1;
+#endif
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 상주 메모리
+ *@return:  KB, 취득 불가면 -1
+ */
+/********************************************************************************/
+qint64 ProcStats::rssKb()
+{
+    return readStatusKb("VmRSS:");
+}
+
+/********************************************************************************/
+/*
+ *@brief: 최대 상주 메모리
+ *@return:  KB, 취득 불가면 -1
+ */
+/********************************************************************************/
+qint64 ProcStats::peakRssKb()
+{
+    return readStatusKb("VmHWM:");
+}
+
+/********************************************************************************/
+/*
+ *@brief: process 의 누적 CPU 시간 (libusb event thread 등 모든 thread 포함)
+ *@return:  us, 취득 불가면 -1
+ */
+/********************************************************************************/
+qint64 ProcStats::cpuTimeUs()
+{
+#ifdef Q_OS_LINUX
+    struct timespec cpu;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu) != 0)
+        return -1;
+    return (qint64)cpu.tv_sec * 1000000 + cpu.tv_nsec / 1000;
+#else
+    return -1;
+#endif
+}
+
+/********************************************************************************/
+/*
+ *@brief: 측정 결과 요약 문자열
+ *@return:
+ */
+/********************************************************************************/
+QString ProcStats::summary()
+{
+    return QString("startup: %1 ms, rss: %2 KB, peak rss: %3 KB")
+            .arg(uptimeMs())
+            .arg(rssKb())
+            .arg(peakRssKb());
+}
@@ -0,0 +1,35 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * process 자원 측정 (startup 시간, 상주 메모리, CPU 시간)
+ *
+ * GUI build 와 headless build 의 기동 비용을 같은 기준으로 비교하기 위해
+ * app, cli 양쪽에서 "--stats" 옵션으로 사용한다.
+ */
+#ifndef PROCSTATS_H
+#define PROCSTATS_H
+
+#include <QtGlobal>
+#include <QString>
+
+namespace ProcStats {
+
+/* process 생성 시점부터 현재까지의 경과 시간 (ms), 취득 불가면 -1 */
+qint64 uptimeMs();
+
+/* 현재 상주 메모리 (VmRSS, KB), 취득 불가면 -1 */
+qint64 rssKb();
+
+/* 최대 상주 메모리 (VmHWM, KB), 취득 불가면 -1 */
+qint64 peakRssKb();
+
+/* process 의 누적 CPU 시간 (user + system, 모든 thread, us), 취득 불가면 -1 */
+qint64 cpuTimeUs();
+
+/* "startup: xx ms, rss: xx KB, peak rss: xx KB" 형식의 요약 문자열 */
+QString summary();
+
+}
+
+#endif // PROCSTATS_H
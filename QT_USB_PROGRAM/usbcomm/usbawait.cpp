@@ -0,0 +1,376 @@
+/********************************************************************************/
+/* C++20 coroutine 비동기 USB 전송 */
+/********************************************************************************/
+#include "usbawait.h"
+#include <QDebug>
+#include <cstring>
+#include <thread>
+
+/********************************************************************************/
+/* Part1: UsbCancelToken */
+/********************************************************************************/
+
+/********************************************************************************/
+/*
+ *@brief: 취소 (진행중인 전송이 있으면 libusb_cancel_transfer)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbCancelToken::cancel()
+{
+    QMutexLocker locker(&mutex);
+    cancelled = true;
+    if (transfer != NULL)
+        libusb_cancel_transfer(transfer);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 취소 여부
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+bool UsbCancelToken::isCancelled() const
+{
+    QMutexLocker locker(&mutex);
+    return cancelled;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 완료된 전송의 등록 해제 (전송 완료 callback 에서 호출)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbCancelToken::detach(libusb_transfer *transfer)
+{
+    QMutexLocker locker(&mutex);
+    if (this->transfer == transfer)
+        this->transfer = NULL;
+}
+
+/********************************************************************************/
+/* Part2: UsbTransferAwaiter */
+/********************************************************************************/
+
+/********************************************************************************/
+/*
+ *@brief: 생성자 (bulk / interrupt)
+ *@param:   type: LIBUSB_TRANSFER_TYPE_BULK 또는 LIBUSB_TRANSFER_TYPE_INTERRUPT
+ *@return:
+ */
+/********************************************************************************/
+UsbTransferAwaiter::UsbTransferAwaiter(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 type,
+                                       quint8 endpoint, quint8 *data, int length, quint32 timeout,
+                                       QObject *resumeContext, UsbCancelToken *token)
+{
+    this->usbComm = usbComm;
+    this->deviceHandle = deviceHandle;
+    this->type = type;
+    this->endpoint = endpoint;
+    this->data = data;
+    this->length = length;
+    this->timeout = timeout;
+    this->resumeContext = resumeContext;
+    this->token = token;
+
+    transfer = NULL;
+    result.error = LIBUSB_SUCCESS;
+    result.actualLength = 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 생성자 (control), setup packet 과 송신 data 를 전송 buffer 에 채워둔다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbTransferAwaiter::UsbTransferAwaiter(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 bmRequestType,
+                                       quint8 bRequest, quint16 wValue, quint16 wIndex, quint8 *data, quint16 wLength,
+                                       quint32 timeout, QObject *resumeContext, UsbCancelToken *token)
+    : UsbTransferAwaiter(usbComm, deviceHandle, LIBUSB_TRANSFER_TYPE_CONTROL, bmRequestType, data, wLength, timeout,
+                         resumeContext, token)
+{
+    controlBuffer.resize(LIBUSB_CONTROL_SETUP_SIZE + wLength);
+    unsigned char *buffer = (unsigned char *)controlBuffer.data();
+    libusb_fill_control_setup(buffer, bmRequestType, bRequest, wValue, wIndex, wLength);
+    if (!(bmRequestType & LIBUSB_ENDPOINT_IN) && wLength > 0)
+        memcpy(buffer + LIBUSB_CONTROL_SETUP_SIZE, data, wLength);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbTransferAwaiter::~UsbTransferAwaiter()
+{
+    libusb_free_transfer(transfer);
+}
+
+/********************************************************************************/
+/*
+ * 전송 submit 후 coroutine 을 중단한다
+ *
+ * NOTE:
+ * 	submit 직후부터 event thread 에서 완료 callback -> coroutine 재개가 일어날 수 있고,
+ * 	재개되면 이 awaiter 가 파괴될 수 있으므로, submit 성공 후에는 멤버를 건드리지 않는다.
+ *
+ *@param:   handle: 중단되는 coroutine
+ *@return:  true=중단  false=submit 실패, 바로 재개 (await_resume 에서 에러 반환)
+ */
+/********************************************************************************/
+bool UsbTransferAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    this->handle = handle;
+
+    if (!usbComm->isUsbDeviceOpened(deviceHandle)) {
+        result.error = LIBUSB_ERROR_NO_DEVICE;
+        return false;
+    }
+
+    if (!usbComm->startEventHandler()) {
+        result.error = LIBUSB_ERROR_OTHER;
+        return false;
+    }
+
+    transfer = libusb_alloc_transfer(0);
+    if (transfer == NULL) {
+        result.error = LIBUSB_ERROR_NO_MEM;
+        return false;
+    }
+
+    switch (type) {
+    case LIBUSB_TRANSFER_TYPE_CONTROL:
+        libusb_fill_control_transfer(transfer, deviceHandle, (unsigned char *)controlBuffer.data(), transferCallback,
+                                     this, timeout);
+        break;
+    case LIBUSB_TRANSFER_TYPE_INTERRUPT:
+        libusb_fill_interrupt_transfer(transfer, deviceHandle, endpoint, data, length, transferCallback, this, timeout);
+        break;
+    default:
+        libusb_fill_bulk_transfer(transfer, deviceHandle, endpoint, data, length, transferCallback, this, timeout);
+        break;
+    }
+
+    /* 취소와 submit 이 엇갈리지 않도록 token 의 mutex 안에서 submit 하고 등록한다 */
+    UsbCancelToken *token = this->token;
+    if (token != NULL) {
+        token->mutex.lock();
+        if (token->cancelled) {
+            token->mutex.unlock();
+            result.error = LIBUSB_ERROR_INTERRUPTED;
+            return false;
+        }
+        token->transfer = transfer;
+    }
+
+    int err = libusb_submit_transfer(transfer);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_submit_transfer error:" << libusb_error_name(err);
+        if (token != NULL) {
+            token->transfer = NULL;
+            token->mutex.unlock();
+        }
+        result.error = err;
+        return false;
+    }
+
+    if (token != NULL)
+        token->mutex.unlock();
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 전송 결과 (control IN 이면 수신 data 를 호출자 buffer 로 복사)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbAwaitResult UsbTransferAwaiter::await_resume()
+{
+    if (type == LIBUSB_TRANSFER_TYPE_CONTROL && (endpoint & LIBUSB_ENDPOINT_IN) && result.actualLength > 0)
+        memcpy(data, controlBuffer.constData() + LIBUSB_CONTROL_SETUP_SIZE, result.actualLength);
+
+    libusb_free_transfer(transfer);
+    transfer = NULL;
+    return result;
+}
+
+/********************************************************************************/
+/*
+ * @brief: 전송 완료 callback (UsbComm event thread 에서 실행), 결과를 저장하고 coroutine 을 재개한다
+ *@return:
+ */
+/********************************************************************************/
+void LIBUSB_CALL UsbTransferAwaiter::transferCallback(libusb_transfer *transfer)
+{
+    UsbTransferAwaiter *awaiter = (UsbTransferAwaiter *)transfer->user_data;
+
+    switch (transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED:	awaiter->result.error = LIBUSB_SUCCESS;				break;
+    case LIBUSB_TRANSFER_TIMED_OUT:	awaiter->result.error = LIBUSB_ERROR_TIMEOUT;		break;
+    case LIBUSB_TRANSFER_CANCELLED:	awaiter->result.error = LIBUSB_ERROR_INTERRUPTED;	break;
+    case LIBUSB_TRANSFER_STALL:		awaiter->result.error = LIBUSB_ERROR_PIPE;			break;
+    case LIBUSB_TRANSFER_NO_DEVICE:	awaiter->result.error = LIBUSB_ERROR_NO_DEVICE;		break;
+    case LIBUSB_TRANSFER_OVERFLOW:	awaiter->result.error = LIBUSB_ERROR_OVERFLOW;		break;
+    default:						awaiter->result.error = LIBUSB_ERROR_IO;			break;
+    }
+    awaiter->result.actualLength = transfer->actual_length;
+
+    if (awaiter->token != NULL)
+        awaiter->token->detach(transfer);
+
+    /* 재개 후에는 awaiter 가 파괴될 수 있으므로 필요한 값을 먼저 꺼낸다 */
+    std::coroutine_handle<> handle = awaiter->handle;
+    QObject *resumeContext = awaiter->resumeContext;
+
+    if (resumeContext != NULL)
+        QMetaObject::invokeMethod(resumeContext, [handle]() {handle.resume();}, Qt::QueuedConnection);
+    else
+        handle.resume();
+}
+
+/********************************************************************************/
+/*
+ *@brief: co_await 할 수 있는 bulk 전송
+ *@param:   endpoint: LIBUSB_ENDPOINT_IN 이면 수신, 아니면 송신
+ *@param:   resumeContext: 재개할 thread 의 QObject (NULL 이면 event thread)
+ *@param:   token: 취소 token (NULL 이면 취소하지 않는다)
+ *@return:
+ */
+/********************************************************************************/
+UsbTransferAwaiter usbBulkAsync(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data,
+                                int length, quint32 timeout, QObject *resumeContext, UsbCancelToken *token)
+{
+    return UsbTransferAwaiter(usbComm, deviceHandle, LIBUSB_TRANSFER_TYPE_BULK, endpoint, data, length, timeout,
+                              resumeContext, token);
+}
+
+/********************************************************************************/
+/*
+ *@brief: co_await 할 수 있는 interrupt 전송
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbTransferAwaiter usbInterruptAsync(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 endpoint,
+                                     quint8 *data, int length, quint32 timeout, QObject *resumeContext,
+                                     UsbCancelToken *token)
+{
+    return UsbTransferAwaiter(usbComm, deviceHandle, LIBUSB_TRANSFER_TYPE_INTERRUPT, endpoint, data, length, timeout,
+                              resumeContext, token);
+}
+
+/********************************************************************************/
+/*
+ *@brief: co_await 할 수 있는 control 전송
+ *@param:   data: data stage (bmRequestType 이 IN 이면 수신 buffer)
+ *@return:
+ */
+/********************************************************************************/
+UsbTransferAwaiter usbControlAsync(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 bmRequestType,
+                                   quint8 bRequest, quint16 wValue, quint16 wIndex, quint8 *data, quint16 wLength,
+                                   quint32 timeout, QObject *resumeContext, UsbCancelToken *token)
+{
+    return UsbTransferAwaiter(usbComm, deviceHandle, bmRequestType, bRequest, wValue, wIndex, data, wLength, timeout,
+                              resumeContext, token);
+}
+
+/********************************************************************************/
+/* Part3: UsbTask */
+/********************************************************************************/
+
+/********************************************************************************/
+/*
+ *@brief: coroutine 종료 시, onFinished 함수 호출 후 co_await 하던 쪽(있으면)으로 이어간다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+std::coroutine_handle<> UsbTask::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+{
+    promise_type &promise = handle.promise();
+
+    if (promise.finished)
+        promise.finished();
+
+    /* 끝났다고 표시하면서 continuation 을 가져온다 (이후 co_await 하는 쪽은 CAS 에 실패하고 바로 이어간다) */
+    void *continuation = promise.continuation.fetchAndStoreOrdered(handle.address());
+
+    /* done 이후에는 다른 thread 에서 UsbTask 가 파괴될 수 있으므로 promise 를 건드리지 않는다 */
+    promise.done.storeRelease(1);
+
+    if (continuation != NULL)
+        return std::coroutine_handle<>::from_address(continuation);
+    return std::noop_coroutine();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자 (끝나지 않은 coroutine 은 전송 callback 이 참조하므로 파괴하지 않는다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbTask::~UsbTask()
+{
+    if (!handle)
+        return;
+
+    if (handle.promise().done.loadAcquire())
+        handle.destroy();
+    else
+        qDebug() << "UsbTask: destroyed while running, coroutine frame is leaked";
+}
+
+/********************************************************************************/
+/*
+ *@brief: 실행 시작
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbTask::start()
+{
+    if (!handle || !handle.promise().started.testAndSetOrdered(0, 1))
+        return;
+
+    handle.resume();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 다른 UsbTask 안에서 co_await (이 task 를 시작하고, 끝나면 continuation 을 재개한다)
+ *
+ * NOTE: 이미 start() 된 task 는 전송 완료 callback 이 재개하므로 여기서 resume 하지 않는다 (2중 resume 이 된다).
+ * 	continuation 만 등록하고, 그 사이에 끝났으면 (CAS 실패) 바로 이어간다.
+ *
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+std::coroutine_handle<> UsbTask::await_suspend(std::coroutine_handle<> continuation)
+{
+    promise_type &promise = handle.promise();
+
+    if (promise.started.testAndSetOrdered(0, 1)) {
+        promise.continuation.storeRelease(continuation.address());
+        return handle;
+    }
+
+    if (promise.continuation.testAndSetRelease(NULL, continuation.address()))
+        return std::noop_coroutine();
+
+    /* final_suspend 가 done 을 쓸 때까지 (몇 명령 사이) 기다린다. 그 전에 이어가면 task 파괴 시 done 이 0 일 수 있다 */
+    while (!promise.done.loadAcquire())
+        std::this_thread::yield();
+    return continuation;
+}
@@ -0,0 +1,190 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * C++20 coroutine 으로 쓰는 비동기 USB 전송
+ *
+ * callback 대신 co_await 로 bulk/interrupt/control 전송의 완료를 기다린다.
+ * 전송은 libusb 비동기 전송으로 submit 되고, 완료되면 coroutine 이 재개된다.
+ * thread 를 막지 않으므로 device 마다 thread 를 두지 않고도 여러 전송을 동시에 진행할 수 있다.
+ *
+ * 사용 예:
+ * 	UsbTask script(UsbComm *usb, libusb_device_handle *h)
+ * 	{
+ * 		quint8 cmd[4] = {...}, rsp[64];
+ * 		UsbAwaitResult r = co_await usbBulkAsync(usb, h, 0x01, cmd, sizeof(cmd), 1000);
+ * 		if (r.error != LIBUSB_SUCCESS)
+ * 			co_return;
+ * 		r = co_await usbBulkAsync(usb, h, 0x81, rsp, sizeof(rsp), 1000);
+ * 		...
+ * 	}
+ * 	UsbTask task = script(&usbComm, handle);
+ * 	task.start();
+ *
+ * 재개되는 thread:
+ * 	resumeContext == NULL	: UsbComm event thread 의 완료 callback 안에서 바로 재개한다.
+ * 							  (coroutine 안에서 blocking 처리를 하면 다른 전송의 완료 처리가 멈춘다)
+ * 	resumeContext != NULL	: 그 QObject 가 속한 thread 의 event loop 에서 재개한다. (GUI thread 등)
+ *
+ * NOTE:
+ * 	전송의 buffer 는 co_await 가 끝날 때까지 유효해야 한다 (coroutine 의 지역 변수면 된다).
+ * 	전송을 기다리는 중인 UsbTask 는 파괴하면 안 된다. 중단하려면 UsbCancelToken 을 사용한다.
+ */
+#ifndef USBAWAIT_H
+#define USBAWAIT_H
+
+#include <QObject>
+#include <QMutex>
+#include <QByteArray>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <coroutine>
+#include <functional>
+#include <exception>
+#include <usbcomm.h>
+
+/********************************************************************************/
+/* 전송 결과 */
+/********************************************************************************/
+struct UsbAwaitResult
+{
+    int error;			/* LIBUSB_SUCCESS 또는 LIBUSB_ERROR_xxx (취소: LIBUSB_ERROR_INTERRUPTED) */
+    int actualLength;	/* 전송된 bytes (control 은 data stage 의 bytes) */
+};
+
+/********************************************************************************/
+/* 전송 취소 */
+/********************************************************************************/
+/*
+ * 여러 co_await 에 같은 token 을 넘겨두면, cancel() 시 진행중인 전송이 취소되고
+ * 이후의 전송은 submit 되지 않고 바로 LIBUSB_ERROR_INTERRUPTED 로 끝난다. 어느 thread 에서든 호출할 수 있다.
+ */
+class UsbCancelToken
+{
+public:
+    UsbCancelToken() : cancelled(false), transfer(NULL) {}
+
+    void cancel();
+    bool isCancelled() const;
+
+private:
+    friend class UsbTransferAwaiter;
+    Q_DISABLE_COPY(UsbCancelToken)
+
+    /* 완료된 전송의 등록 해제 (등록은 UsbTransferAwaiter 가 submit 과 함께 mutex 안에서 한다) */
+    void detach(libusb_transfer *transfer);
+
+    bool cancelled;
+    libusb_transfer *transfer;
+    mutable QMutex mutex;
+};
+
+/********************************************************************************/
+/* 전송 1개의 awaiter (usbBulkAsync 등으로 생성한다) */
+/********************************************************************************/
+class UsbTransferAwaiter
+{
+public:
+    UsbTransferAwaiter(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 type, quint8 endpoint,
+                       quint8 *data, int length, quint32 timeout, QObject *resumeContext, UsbCancelToken *token);
+    /* control 전송 (data 는 data stage, bmRequestType 의 방향에 따라 송신/수신) */
+    UsbTransferAwaiter(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 bmRequestType, quint8 bRequest,
+                       quint16 wValue, quint16 wIndex, quint8 *data, quint16 wLength, quint32 timeout,
+                       QObject *resumeContext, UsbCancelToken *token);
+    ~UsbTransferAwaiter();
+
+    bool await_ready() const {return false;}
+    bool await_suspend(std::coroutine_handle<> handle);
+    UsbAwaitResult await_resume();
+
+private:
+    Q_DISABLE_COPY(UsbTransferAwaiter)
+
+    /* 전송 완료 callback (UsbComm event thread 에서 실행) */
+    static void LIBUSB_CALL transferCallback(libusb_transfer *transfer);
+
+    UsbComm *usbComm;
+    libusb_device_handle *deviceHandle;
+    quint8 type;
+    quint8 endpoint;
+    quint8 *data;
+    int length;
+    quint32 timeout;
+    QObject *resumeContext;
+    UsbCancelToken *token;
+
+    /* control 전송: setup packet + data stage */
+    QByteArray controlBuffer;
+
+    libusb_transfer *transfer;
+    std::coroutine_handle<> handle;
+    UsbAwaitResult result;
+};
+
+/********************************************************************************/
+/* co_await 할 수 있는 전송 */
+/********************************************************************************/
+UsbTransferAwaiter usbBulkAsync(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data,
+                                int length, quint32 timeout, QObject *resumeContext = NULL, UsbCancelToken *token = NULL);
+UsbTransferAwaiter usbInterruptAsync(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 endpoint,
+                                     quint8 *data, int length, quint32 timeout, QObject *resumeContext = NULL,
+                                     UsbCancelToken *token = NULL);
+UsbTransferAwaiter usbControlAsync(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 bmRequestType,
+                                   quint8 bRequest, quint16 wValue, quint16 wIndex, quint8 *data, quint16 wLength,
+                                   quint32 timeout, QObject *resumeContext = NULL, UsbCancelToken *token = NULL);
+
+/********************************************************************************/
+/* coroutine 의 반환 type */
+/********************************************************************************/
+/*
+ * start() 할 때까지 실행되지 않는다 (lazy). 다른 UsbTask 안에서 co_await 하면 끝날 때까지 기다린다.
+ * 끝나면 onFinished() 로 등록한 함수가 coroutine 이 마지막으로 재개된 thread 에서 호출된다.
+ */
+class UsbTask
+{
+public:
+    struct promise_type
+    {
+        /* co_await 하는 쪽의 coroutine address. 끝나면 final_suspend 가 자신의 address 로 바꾼다
+         * (이미 start() 된 task 는 다른 thread 에서 끝날 수 있으므로 CAS 로 등록한다) */
+        QAtomicPointer<void> continuation;
+        std::function<void()> finished;
+        QAtomicInt started;
+        QAtomicInt done;		/* final_suspend 에서 1 (다른 thread 에서 isDone() 으로 확인한다) */
+
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept {return false;}
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+            void await_resume() const noexcept {}
+        };
+
+        UsbTask get_return_object() {return UsbTask(std::coroutine_handle<promise_type>::from_promise(*this));}
+        std::suspend_always initial_suspend() const noexcept {return {};}
+        FinalAwaiter final_suspend() const noexcept {return {};}
+        void return_void() {}
+        void unhandled_exception() {std::terminate();}
+    };
+
+    UsbTask(UsbTask &&other) noexcept : handle(other.handle) {other.handle = {};}
+    ~UsbTask();
+
+    /* 실행 시작 (호출 thread 에서 첫 co_await 까지 실행된다) */
+    void start();
+    bool isDone() const {return !handle || handle.promise().done.loadAcquire();}
+    /* 종료 시 호출할 함수 (start() 전에 등록한다) */
+    void onFinished(std::function<void()> func) {handle.promise().finished = std::move(func);}
+
+    /* 다른 UsbTask 안에서 co_await */
+    bool await_ready() const {return isDone();}
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation);
+    void await_resume() const {}
+
+private:
+    explicit UsbTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Q_DISABLE_COPY(UsbTask)
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+#endif // USBAWAIT_H
@@ -0,0 +1,3065 @@
+/********************************************************************************/
+/* USB "응용레이어" 통신 Part (libusb API 에 한층 더 씌워서, 사용 편의성을 높인다) */
+/********************************************************************************/
+#include "usbcomm.h"
+#include "usbtransferpool.h"
+#include "procstats.h"
+#include <QDebug>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QMutex>
+#include <QThreadPool>
+#include <QPromise>
+#include <QtConcurrent/QtConcurrentRun>
+#include <cstring>
+#include <algorithm>
+
+/********************************************************************************/
+/* Part1: UsbComm */
+/********************************************************************************/
+
+namespace {
+
+/* bulkTransferLarge 의 기본 chunk 크기 / 동시 전송 수 */
+const int kDefaultLargeChunkSize = 256 * 1024;
+const int kDefaultLargeQueueDepth = 4;
+
+/* bulkWriteV 의 전송 pool: slot 크기는 일반적인 max packet(64/512/1024)의 배수 */
+const int kWritePoolSlotCount = 32;
+const int kWritePoolSlotSize = 16 * 1024;
+
+/* bulkTransferLarge 1회 호출의 진행 상태 (호출한 thread 의 stack 에 있고, callback 에서 갱신한다) */
+struct LargeTransferState
+{
+    libusb_device_handle *deviceHandle;
+    quint8 *base;					/* 전송 buffer 시작 */
+    qint64 length;					/* 전체 길이 */
+    qint64 nextOffset;				/* 다음에 submit 할 chunk 의 offset */
+    qint64 endOffset;				/* short packet/timeout 으로 끝난 위치 (없으면 length) */
+    int chunkSize;
+    bool isIn;
+    bool sendZeroLengthPacket;
+    bool stopping;					/* 더 이상 submit 하지 않는다 */
+    int error;						/* 첫 에러 (LIBUSB_ERROR_xxx), 없으면 0 */
+    int inFlight;
+    int allDone;					/* libusb_handle_events_completed() 의 완료 flag */
+    QVector<libusb_transfer *> transfers;
+    QVector<qint64> submitNs;		/* transfers 와 같은 순서, 각 chunk 의 submit 시각 (clock 기준, 지연 계산용) */
+    QElapsedTimer clock;
+    QMutex mutex;					/* 최초 submit 과 callback 사이의 보호 */
+    UsbTrafficCounters *traffic;	/* chunk 별 전송 counter */
+};
+
+/* bulkWriteV 1회 호출의 진행 상태 (호출한 thread 의 stack 에 있고, callback 에서 갱신한다) */
+struct GatherWriteState
+{
+    UsbTransferPool *pool;
+    libusb_device_handle *deviceHandle;
+    quint8 endpoint;
+    quint32 timeout;
+    qint64 total;					/* 전체 길이 */
+    qint64 queued;					/* submit 한 누적 길이 */
+    qint64 bytesDone;				/* 전송 완료된 누적 길이 */
+    bool sendZeroLengthPacket;
+    int error;						/* 첫 에러 (LIBUSB_ERROR_xxx), 없으면 0. 에러 후에는 submit 하지 않는다 */
+    int inFlight;
+    /* submit 해서 아직 완료되지 않은 전송 (앞의 inFlight 개), 에러 시 뒤의 전송을 취소하기 위함.
+     * pool 의 slot 수를 넘지 않으므로 고정 크기로 둔다 (호출마다 heap 할당을 하지 않는다) */
+    libusb_transfer *inFlightTransfers[kWritePoolSlotCount];
+    int wakeup;						/* 전송 완료 시 1 (libusb_handle_events_completed() 용) */
+    QMutex mutex;
+    UsbTrafficCounters *traffic;	/* 전송 별 counter */
+    QElapsedTimer clock;			/* slot->submitNs 의 기준 */
+};
+
+/* bulkTransferAsync 의 전송 1개 상태 */
+struct AsyncTransferState
+{
+    QPromise<int> promise;
+    quint8 endpoint;
+    QSharedPointer<UsbTrafficCounters> traffic;
+    QElapsedTimer timer;			/* submit ~ 완료 지연 */
+};
+
+/* 비동기 버전(open/claim/reset)의 worker 수: libusb 동기 호출에서 대기하는 시간이 대부분이므로 core 수와 무관하게 둔다 */
+const int kAsyncPoolThreadCount = 8;
+
+/* string descriptor 읽기에 실패한 device 를 다시 읽을 때까지의 시간 (enumerate 직후의 일시적인 실패 대응) */
+const qint64 kDeviceStringsRetryMs = 3000;
+
+/* context/event thread 분할 수의 상한 */
+const int kMaxShardCount = 64;
+
+/* cachedTrafficCounters 의 thread 별 cache (최근에 쓴 endpoint 몇 개, generation 0 은 빈 항목) */
+const int kTrafficCacheSize = 4;
+struct TrafficCacheEntry
+{
+    int generation = 0;
+    libusb_device_handle *deviceHandle = NULL;
+    quint8 endpoint = 0;
+    QSharedPointer<UsbTrafficCounters> counters;
+};
+thread_local TrafficCacheEntry trafficCache[kTrafficCacheSize];
+thread_local int trafficCacheNext = 0;
+
+/* generation 은 모든 UsbComm instance 에서 겹치지 않게 발행한다 (다른 instance 의 thread 별 항목과 구분하기 위함) */
+QAtomicInt generationSeed;
+int nextGeneration()
+{
+    return generationSeed.fetchAndAddRelaxed(1) + 1;
+}
+
+/* applyWorkerThreadSchedConfig 로 이 thread 에 적용한 설정의 generation (0 은 기본 설정) */
+thread_local int appliedWorkerSchedGeneration = 0;
+
+/* string descriptor 1개 (index 가 0 이면 빈 문자열, 실패하면 error 에 libusb error code) */
+QString readStringDescriptor(libusb_device_handle *deviceHandle, quint8 index, int *error)
+{
+    if (index == 0)
+        return QString();
+
+    unsigned char text[256];
+    int length = libusb_get_string_descriptor_ascii(deviceHandle, index, text, sizeof(text));
+    if (length < 0) {
+        *error = length;
+        return QString();
+    }
+    return QString::fromLatin1((const char *)text, length);
+}
+
+/* 다른 context 의 device list 에서 같은 device (bus 번호 + device address) 를 찾는다 */
+libusb_device *findSameDevice(libusb_device **devs, ssize_t count, libusb_device *usbDevice)
+{
+    quint8 bus = libusb_get_bus_number(usbDevice);
+    quint8 address = libusb_get_device_address(usbDevice);
+    for (ssize_t i = 0; i < count; i++) {
+        if (libusb_get_bus_number(devs[i]) == bus && libusb_get_device_address(devs[i]) == address)
+            return devs[i];
+    }
+    return NULL;
+}
+
+/* libusb_transfer_status -> libusb_error */
+int transferStatusToError(int status)
+{
+    switch (status) {
+    case LIBUSB_TRANSFER_STALL:		return LIBUSB_ERROR_PIPE;
+    case LIBUSB_TRANSFER_NO_DEVICE:	return LIBUSB_ERROR_NO_DEVICE;
+    case LIBUSB_TRANSFER_OVERFLOW:	return LIBUSB_ERROR_OVERFLOW;
+    case LIBUSB_TRANSFER_TIMED_OUT:	return LIBUSB_ERROR_TIMEOUT;
+    default:						return LIBUSB_ERROR_IO;
+    }
+}
+
+/* 다음 chunk 를 transfer 에 채워서 submit 한다 (state 는 호출자가 보호) */
+bool submitNextChunk(LargeTransferState *state, libusb_transfer *transfer)
+{
+    qint64 offset = state->nextOffset;
+    int length = (int)qMin<qint64>(state->chunkSize, state->length - offset);
+
+    transfer->buffer = state->base + offset;
+    transfer->length = length;
+    transfer->flags = 0;
+
+    /* OUT 의 마지막 chunk 가 max packet 의 배수로 끝나면, 필요에 따라 ZLP 로 전송 끝을 알린다 */
+    if (!state->isIn && state->sendZeroLengthPacket && offset + length == state->length)
+        transfer->flags |= LIBUSB_TRANSFER_ADD_ZERO_PACKET;
+
+    state->submitNs[state->transfers.indexOf(transfer)] = state->clock.nsecsElapsed();
+    int err = libusb_submit_transfer(transfer);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_submit_transfer error:" << libusb_error_name(err);
+        if (state->error == 0)
+            state->error = err;
+        state->stopping = true;
+        return false;
+    }
+
+    state->nextOffset += length;
+    state->inFlight++;
+    return true;
+}
+
+/* 전송 완료(wakeup)를 기다린다. 다른 thread 의 전송만 pool 을 쓰고 있을 수도 있으므로 timeout 을 두고 반복한다 */
+void waitGatherWakeup(libusb_context *context, GatherWriteState *state)
+{
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 10000;
+
+    int err = libusb_handle_events_timeout_completed(context, &tv, &state->wakeup);
+    if (err < 0 && err != LIBUSB_ERROR_INTERRUPTED) {
+        qDebug() << "libusb_handle_events_timeout_completed error:" << libusb_error_name(err);
+    }
+
+    QMutexLocker locker(&state->mutex);
+    state->wakeup = 0;
+}
+
+/* pool 에서 slot 을 취득한다. 비어있으면 전송 완료를 기다린다 (에러 발생 시 NULL) */
+UsbTransferPool::Slot *acquireGatherSlot(libusb_context *context, GatherWriteState *state)
+{
+    forever {
+        {
+            QMutexLocker locker(&state->mutex);
+            if (state->error != 0)
+                return NULL;
+        }
+        UsbTransferPool::Slot *slot = state->pool->acquire();
+        if (slot != NULL) {
+            slot->owner = state;
+            return slot;
+        }
+        waitGatherWakeup(context, state);
+    }
+}
+
+/* slot 의 전송을 buffer/length 로 채워서 submit 한다 (buffer 는 slot 자신의 buffer 또는 호출자의 buffer) */
+bool submitGatherSlot(GatherWriteState *state, UsbTransferPool::Slot *slot, const quint8 *buffer, int length,
+                      libusb_transfer_cb_fn callback)
+{
+    libusb_fill_bulk_transfer(slot->transfer, state->deviceHandle, state->endpoint, (unsigned char *)buffer,
+                              length, callback, slot, state->timeout);
+
+    /* 마지막 전송이 max packet 의 배수로 끝나면 ZLP 로 전송 끝을 알린다 (sendZeroLengthPacket 은 호출 측에서 판단) */
+    slot->transfer->flags = 0;
+    if (state->sendZeroLengthPacket && state->queued + length == state->total)
+        slot->transfer->flags |= LIBUSB_TRANSFER_ADD_ZERO_PACKET;
+
+    QMutexLocker locker(&state->mutex);
+    /* 앞의 전송이 실패했으면 더 보내지 않는다 (device 에 중간이 빠진 데이터가 가지 않도록) */
+    if (state->error != 0) {
+        state->pool->release(slot);
+        return false;
+    }
+
+    slot->submitNs = state->clock.nsecsElapsed();
+    int err = libusb_submit_transfer(slot->transfer);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_submit_transfer error:" << libusb_error_name(err);
+        state->error = err;
+        state->traffic->addError(false);
+        state->pool->release(slot);
+        /* 이미 submit 한 전송도 취소한다 */
+        for (int i = 0; i < state->inFlight; i++)
+            libusb_cancel_transfer(state->inFlightTransfers[i]);
+        return false;
+    }
+
+    state->queued += length;
+    state->inFlightTransfers[state->inFlight++] = slot->transfer;
+    return true;
+}
+
+}
+
+/********************************************************************************/
+/*
+ *@brief: 생성자 함수，libusb에 대해 초기화 작업을 실시한다.
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbComm::UsbComm(QObject *parent): QObject(parent)
+{
+    context = NULL;
+    eventThreadJitterProbeMs = 0;
+    largeChunkSize = kDefaultLargeChunkSize;
+    largeQueueDepth = kDefaultLargeQueueDepth;
+    tuningStorePath = UsbTuning::defaultStorePath();
+    writePool = NULL;
+    trafficGeneration.storeRelease(nextGeneration());
+
+    asyncPool = new QThreadPool(this);
+    asyncPool->setMaxThreadCount(kAsyncPoolThreadCount);
+
+    /* libusb 초기화 */
+    int err = libusb_init(&context);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_init error:" << libusb_error_name(err);
+    }
+
+    /* log level 설정 */
+    libusb_set_debug(context, LIBUSB_LOG_LEVEL_WARNING);	//old ver
+    //libusb_set_option(context, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_WARNING);	//new ver
+
+    /* shard 0 */
+    contexts.append(context);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자 함수，libusb에 대해 De-init작업을 실시한다.
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbComm::~UsbComm()
+{
+    /* 실행중인 비동기 open/claim/reset 이 끝난 후에 닫는다 */
+    asyncPool->waitForDone();
+    closeAllUsbDevice();
+    stopEventHandler();
+    qDeleteAll(eventHandlers);
+    delete writePool;
+    for (int i = 1; i < contexts.size(); i++)
+        libusb_exit(contexts.at(i));
+    libusb_exit(context);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 비동기 전송의 event 처리 thread 시작
+ *
+ * libusb_submit_transfer() 로 submit 한 전송의 callback 은 누군가 libusb_handle_events*() 를
+ * 호출해야 실행된다. 이 thread 가 그 역할을 하며, callback 은 모두 이 thread 에서 실행된다.
+ *
+ * NOTE: 어느 thread 에서든 호출할 수 있다 (eventHandlerMutex). handler 는 호출한 thread 와 관계없이
+ * 		parent 없이 만들고 소멸자/setShardConfig() 에서 지운다 (다른 thread 의 QObject 를 parent 로 할 수 없다).
+ *
+ *@param:
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbComm::startEventHandler()
+{
+    if (context == NULL)
+        return false;
+
+    QMutexLocker locker(&eventHandlerMutex);
+
+    /* shard 마다 1개 */
+    if (eventHandlers.isEmpty()) {
+        for (int i = 0; i < contexts.size(); i++) {
+            UsbEventHandler *handler = new UsbEventHandler(contexts.at(i));
+            if (!eventThreadSchedConfig.isDefault())
+                handler->setSchedConfig(eventThreadSchedConfig);
+            handler->setJitterProbe(eventThreadJitterProbeMs);
+            eventHandlers.append(handler);
+        }
+    }
+
+    for (int i = 0; i < eventHandlers.size(); i++) {
+        if (!eventHandlers.at(i)->isRunning()) {
+            eventHandlers.at(i)->setStopped(false);
+            eventHandlers.at(i)->start();
+        }
+    }
+
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 비동기 전송의 event 처리 thread 종료
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::stopEventHandler()
+{
+    /* lock 을 잡은 채로 기다리지 않는다 (callback 이 다음 비동기 전송을 위해 startEventHandler() 를 호출할 수 있다).
+     * handler 는 실행중이 아닐 때에만 지워지므로 목록을 복사해서 기다려도 된다 */
+    eventHandlerMutex.lock();
+    QVector<UsbEventHandler *> handlers = eventHandlers;
+    eventHandlerMutex.unlock();
+
+    /* 먼저 모두에 정지를 요청하고 나서 기다린다 (shard 수 만큼 기다리지 않도록) */
+    for (int i = 0; i < handlers.size(); i++)
+        handlers.at(i)->setStopped(true);
+    /* 쓰레드 종료를 기다린다 */
+    for (int i = 0; i < handlers.size(); i++)
+        handlers.at(i)->wait();
+}
+
+/********************************************************************************/
+/*
+ *@brief: event 처리 thread 의 scheduling 설정
+ *
+ * NOTE: 실시간 policy 는 권한이 필요하다. 권한이 없으면 qDebug 로 알리고 기본 policy 로 계속 동작한다.
+ *
+ *@param:   config: 설정 (실행중이면 다음 loop(최대 100ms 후)에서 적용, 아직 시작 전이면 시작 시에 적용)
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::setEventThreadSchedConfig(const UsbThreadSchedConfig &config)
+{
+    QMutexLocker locker(&eventHandlerMutex);
+    eventThreadSchedConfig = config;
+    for (int i = 0; i < eventHandlers.size(); i++)
+        eventHandlers.at(i)->setSchedConfig(config);
+}
+
+/********************************************************************************/
+/*
+ *@brief: event 처리 thread 의 scheduling 설정
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbThreadSchedConfig UsbComm::getEventThreadSchedConfig()
+{
+    QMutexLocker locker(&eventHandlerMutex);
+    return eventThreadSchedConfig;
+}
+
+/********************************************************************************/
+/*
+ *@brief: worker thread 의 scheduling 설정
+ *
+ * NOTE: pool 의 thread 는 작업 사이에 재사용되므로 설정 시점에 바로 적용하지 않고,
+ * 		각 작업의 시작(applyWorkerThreadSchedConfig)에서 바뀌었으면 적용한다.
+ *
+ *@param:   config: 설정
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::setWorkerThreadSchedConfig(const UsbThreadSchedConfig &config)
+{
+    QMutexLocker locker(&workerSchedMutex);
+    workerThreadSchedConfig = config;
+    workerSchedGeneration.storeRelease(nextGeneration());
+}
+
+/********************************************************************************/
+/*
+ *@brief: worker thread 의 scheduling 설정
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbThreadSchedConfig UsbComm::getWorkerThreadSchedConfig()
+{
+    QMutexLocker locker(&workerSchedMutex);
+    return workerThreadSchedConfig;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 호출한 worker thread 에 scheduling 설정을 적용한다 (바뀌었을 때만)
+ *
+ * NOTE: 바뀌지 않았으면 atomic 1번 읽기로 끝나므로 작업마다 호출해도 된다.
+ *
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::applyWorkerThreadSchedConfig()
+{
+    if (workerSchedGeneration.loadAcquire() == appliedWorkerSchedGeneration)
+        return;
+
+    QMutexLocker locker(&workerSchedMutex);
+    UsbThreadSchedConfig config = workerThreadSchedConfig;
+    appliedWorkerSchedGeneration = workerSchedGeneration.loadRelaxed();
+    locker.unlock();
+
+    UsbThreadSched::applyToCurrentThread(config);
+}
+
+/********************************************************************************/
+/*
+ *@brief: event 처리 thread 의 jitter 측정 설정 (측정 결과는 초기화된다)
+ *@param:   intervalMs: 측정 간격 (0 이면 측정 안함)
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::setEventThreadJitterProbe(int intervalMs)
+{
+    QMutexLocker locker(&eventHandlerMutex);
+    eventThreadJitterProbeMs = intervalMs;
+    for (int i = 0; i < eventHandlers.size(); i++) {
+        eventHandlers.at(i)->setJitterProbe(intervalMs);
+        eventHandlers.at(i)->resetJitterStats();
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: event 처리 thread 의 jitter 측정 결과
+ *@param:   shard: shard 번호
+ *@return:
+ */
+/********************************************************************************/
+UsbJitterStats UsbComm::getEventThreadJitterStats(int shard)
+{
+    QMutexLocker locker(&eventHandlerMutex);
+    if (shard < 0 || shard >= eventHandlers.size())
+        return UsbJitterStats();
+    return eventHandlers.at(shard)->jitterStats();
+}
+
+/********************************************************************************/
+/*
+ *@brief: device 를 여러 libusb context / event thread 로 나눈다
+ *
+ * NOTE:
+ * 1. context 1개는 내부 lock 과 event thread 1개를 모든 device 가 공유하므로, 수십개의 device 를 동시에
+ * 	streaming 하면 callback 처리가 한 thread 에 몰린다. shard 마다 context 와 event thread 를 따로 두어
+ * 	device 간의 경합을 줄인다.
+ * 2. device 탐색은 항상 shard 0 에서 하고, open 할 때에 shard 의 context 에서 같은 device(bus 번호 + address)를 찾아 연다.
+ * 	handle 을 받는 API 는 handle 로 shard 를 찾으므로 호출하는 쪽은 shard 를 의식하지 않아도 된다.
+ * 3. device 가 open 되어 있거나 event thread 가 실행중이면 변경할 수 없다.
+ *
+ *@param:   config: 설정 (shardCount 1 ~ 64)
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbComm::setShardConfig(const UsbShardConfig &config)
+{
+    QMutexLocker locker(&deviceListMutex);
+    /* contexts 는 startEventHandler() 가 eventHandlerMutex 만 잡고 읽는다 */
+    QMutexLocker handlerLocker(&eventHandlerMutex);
+
+    if (context == NULL)
+        return false;
+
+    if (!deviceHandleList.isEmpty()) {
+        qDebug() << "setShardConfig: close all devices first";
+        return false;
+    }
+    for (int i = 0; i < eventHandlers.size(); i++) {
+        if (eventHandlers.at(i)->isRunning()) {
+            qDebug() << "setShardConfig: stop event handler first";
+            return false;
+        }
+    }
+
+    int shardCount = qBound(1, config.shardCount, kMaxShardCount);
+
+    /* event thread 는 다음 startEventHandler() 에서 shard 수 만큼 다시 만든다 */
+    qDeleteAll(eventHandlers);
+    eventHandlers.clear();
+
+    while (contexts.size() > shardCount)
+        libusb_exit(contexts.takeLast());
+
+    while (contexts.size() < shardCount) {
+        libusb_context *shardContext = NULL;
+        int err = libusb_init(&shardContext);
+        if (err != LIBUSB_SUCCESS) {
+            qDebug() << "libusb_init error:" << libusb_error_name(err);
+            break;
+        }
+        libusb_set_debug(shardContext, LIBUSB_LOG_LEVEL_WARNING);
+        contexts.append(shardContext);
+    }
+
+    shardConfig = config;
+    shardConfig.shardCount = contexts.size();
+    return contexts.size() == shardCount;
+}
+
+/********************************************************************************/
+/*
+ *@brief: device 가 속한 shard
+ *@param:
+ *@return:  shard 번호, open 되지 않은 handle 이면 -1
+ */
+/********************************************************************************/
+int UsbComm::getDeviceShard(libusb_device_handle *deviceHandle)
+{
+    QMutexLocker locker(&deviceListMutex);
+    return handleShards.value(deviceHandle, -1);
+}
+
+/********************************************************************************/
+/*
+ *@brief: device handle 의 context (handle_events 로 직접 전송 완료를 기다릴 때 사용)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+libusb_context *UsbComm::contextOf(libusb_device_handle *deviceHandle)
+{
+    QMutexLocker locker(&deviceListMutex);
+    return contexts.value(handleShards.value(deviceHandle, 0), context);
+}
+
+/********************************************************************************/
+/*
+ *@brief: device 를 open 할 shard 선택
+ *@param:   usbDevice: shard 0 (context) 의 device
+ *@return:  shard 번호
+ */
+/********************************************************************************/
+int UsbComm::selectShard(libusb_device *usbDevice)
+{
+    int shardCount = contexts.size();
+    if (shardCount <= 1)
+        return 0;
+
+    QString path = UsbDeviceMatcher::portPathOf(usbDevice);
+    if (shardConfig.mode == UsbShardConfig::Explicit && shardConfig.explicitShards.contains(path))
+        return qBound(0, shardConfig.explicitShards.value(path), shardCount - 1);
+
+    if (shardConfig.mode == UsbShardConfig::ByBus)
+        return libusb_get_bus_number(usbDevice) % shardCount;
+
+    return qHash(path) % shardCount;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 접속된 모든 USB device 를 탐색하여, device 정보를 출력
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::findUsbDevices()
+{
+    libusb_device **devs;
+
+    /* get device list */
+    ssize_t count = libusb_get_device_list(context, &devs);
+
+    for (int i = 0; i < count; i++)
+        printDevInfo(devs[i]);
+
+    /* string descriptor 는 device 를 open 해야 읽을 수 있으므로 기다리지 않고 worker 에서 읽는다 */
+    for (int i = 0; i < count; i++)
+        requestDeviceStrings(devs[i]);
+
+    /* */
+    libusb_free_device_list(devs, 1);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 접속된 모든 USB device (open 하지 않는다)
+ *
+ * NOTE: 반환한 device 는 모두 libusb_ref_device() 되어 있다. 호출 측이 다 쓰면 libusb_unref_device() 한다.
+ *
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+QList<libusb_device *> UsbComm::getDeviceList()
+{
+    QList<libusb_device *> devices;
+
+    libusb_device **devs;
+    ssize_t count = libusb_get_device_list(context, &devs);
+    if (count < 0) {
+        qDebug() << "libusb_get_device_list is error";
+        return devices;
+    }
+
+    for (int i = 0; i < count; i++)
+        devices.append(libusb_ref_device(devs[i]));
+
+    libusb_free_device_list(devs, 1);
+    return devices;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 일치하는 device 목록 (open 하지 않는다)
+ *@param:   matcher: 매칭 조건 (serial number 조건은 open 이 필요하므로 무시한다)
+ *@return:
+ */
+/********************************************************************************/
+QList<UsbDeviceIdentity> UsbComm::enumerateDevices(const UsbDeviceMatcher &matcher)
+{
+    QList<UsbDeviceIdentity> identities;
+
+    libusb_device **devs;
+    ssize_t count = libusb_get_device_list(context, &devs);
+    if (count < 0) {
+        qDebug() << "libusb_get_device_list is error";
+        return identities;
+    }
+
+    for (int i = 0; i < count; i++) {
+        libusb_device_descriptor deviceDesc;
+        if (libusb_get_device_descriptor(devs[i], &deviceDesc) != LIBUSB_SUCCESS)
+            continue;
+        if (!matcher.matchesDevice(devs[i], deviceDesc))
+            continue;
+
+        UsbDeviceIdentity identity;
+        identity.vid = deviceDesc.idVendor;
+        identity.pid = deviceDesc.idProduct;
+        identity.portPath = UsbDeviceMatcher::portPathOf(devs[i]);
+        identities.append(identity);
+    }
+
+    libusb_free_device_list(devs, 1);
+    return identities;
+}
+
+/********************************************************************************/
+/*
+ *@brief: background 에서 읽어둔 string descriptor
+ *@param:   portPath: "bus-port.port"
+ *@param:   strings: 결과
+ *@return:  true=cache 에 있다  false=아직 읽지 않았다
+ */
+/********************************************************************************/
+bool UsbComm::getDeviceStrings(const QString &portPath, UsbDeviceStrings *strings)
+{
+    QMutexLocker locker(&stringsMutex);
+    if (!deviceStringsCache.contains(portPath))
+        return false;
+    *strings = deviceStringsCache.value(portPath).strings;
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: string descriptor cache 삭제 (다음 findUsbDevices() 에서 다시 읽는다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::clearDeviceStringsCache()
+{
+    QMutexLocker locker(&stringsMutex);
+    deviceStringsCache.clear();
+}
+
+/********************************************************************************/
+/*
+ *@brief: string descriptor 를 cache 에서 알리거나, 없으면 worker 에서 읽기 시작한다
+ *
+ * NOTE: cache 는 port path 를 key 로 하고, 같은 port 에 다시 꽂힌 device(address 가 바뀐다)나
+ * 	다른 device 는 VID/PID/address 로 구분해서 다시 읽는다.
+ * 	읽기에 실패한 결과 (권한 부족, enumerate 직후 등) 는 kDeviceStringsRetryMs 동안만 유효하다.
+ *
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::requestDeviceStrings(libusb_device *usbDevice)
+{
+    libusb_device_descriptor deviceDesc;
+    if (libusb_get_device_descriptor(usbDevice, &deviceDesc) != LIBUSB_SUCCESS)
+        return;
+
+    QString portPath = UsbDeviceMatcher::portPathOf(usbDevice);
+    quint8 address = libusb_get_device_address(usbDevice);
+
+    UsbDeviceStrings strings;
+    {
+        QMutexLocker locker(&stringsMutex);
+        QHash<QString, DeviceStringsEntry>::const_iterator it = deviceStringsCache.constFind(portPath);
+        if (it != deviceStringsCache.constEnd() && it->vid == deviceDesc.idVendor && it->pid == deviceDesc.idProduct
+            && it->address == address && (it->strings.error == 0 || !it->fetched.hasExpired(kDeviceStringsRetryMs))) {
+            strings = it->strings;
+        } else {
+            /* 이미 읽는 중 */
+            if (pendingDeviceStrings.contains(portPath))
+                return;
+
+            /* string descriptor 가 없는 device (hub 등) 는 open 하지 않는다 */
+            if (deviceDesc.iManufacturer != 0 || deviceDesc.iProduct != 0 || deviceDesc.iSerialNumber != 0) {
+                pendingDeviceStrings.insert(portPath);
+                libusb_ref_device(usbDevice);
+                asyncPool->start([this, usbDevice, portPath, deviceDesc]() {
+                    applyWorkerThreadSchedConfig();
+                    fetchDeviceStrings(usbDevice, portPath, deviceDesc);
+                });
+                return;
+            }
+
+            DeviceStringsEntry entry;
+            entry.vid = deviceDesc.idVendor;
+            entry.pid = deviceDesc.idProduct;
+            entry.address = address;
+            deviceStringsCache.insert(portPath, entry);
+        }
+    }
+
+    emit sigPutDevStrings2MainUI(portPath, strings.manufacturer, strings.product, strings.serialNumber);
+}
+
+/********************************************************************************/
+/*
+ *@brief: string descriptor 읽기 (worker thread 에서 실행)
+ *@param:   usbDevice: ref 된 device (이 함수에서 unref 한다)
+ *@param:   portPath: cache key
+ *@param:   deviceDesc: usbDevice 의 device descriptor
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::fetchDeviceStrings(libusb_device *usbDevice, const QString &portPath, const libusb_device_descriptor &deviceDesc)
+{
+    DeviceStringsEntry entry;
+    entry.vid = deviceDesc.idVendor;
+    entry.pid = deviceDesc.idProduct;
+    entry.address = libusb_get_device_address(usbDevice);
+    entry.fetched.start();
+
+    /* open 된 device 목록과는 별개의 handle 로 읽는다 (전송중인 handle 에 영향을 주지 않는다) */
+    libusb_device_handle *deviceHandle = NULL;
+    int err = libusb_open(usbDevice, &deviceHandle);
+    if (err == LIBUSB_SUCCESS) {
+        entry.strings.manufacturer = readStringDescriptor(deviceHandle, deviceDesc.iManufacturer, &entry.strings.error);
+        entry.strings.product = readStringDescriptor(deviceHandle, deviceDesc.iProduct, &entry.strings.error);
+        entry.strings.serialNumber = readStringDescriptor(deviceHandle, deviceDesc.iSerialNumber, &entry.strings.error);
+        libusb_close(deviceHandle);
+    } else {
+        entry.strings.error = err;
+    }
+    libusb_unref_device(usbDevice);
+
+    {
+        QMutexLocker locker(&stringsMutex);
+        deviceStringsCache.insert(portPath, entry);
+        pendingDeviceStrings.remove(portPath);
+    }
+
+    emit sigPutDevStrings2MainUI(portPath, entry.strings.manufacturer, entry.strings.product, entry.strings.serialNumber);
+}
+
+/********************************************************************************/
+/*
+ * 지정한 usb device를 open한다
+ *
+ * NOTE:
+ * 1. 이 함수는 all usb device list를 스캔하여, 지정한 장치를 open하여, 그 핸들러를 맴버변수 deviceHandleList 에 집어넣는다.
+ * 	실은 libusb_open_device_with_vid_pid() 라는 함수로도 지정한 vid/pid 로 usb장비를 열수 있다.
+ * 	함수 내에서도 libusb_get_device_list() 로 모든 device 를 취득하여 device descript를 스캔하여, vid/pid로 비교를 진행한다.
+ * 	비교해서 매칭되는 게 있으면 libusb_open() 로 장비를 열고, 핸들러를 반환하고, device list 를 free한다.
+ *
+ * 	하지만
+ * 	libusb-1.0 의 설명을 보면, 이 함수에 제한이 있다:
+ * 	여러개의 device가 같은 id를 사용하면, 첫번째 것 핸들러만 반환한다고 한다... 따라서, 정식 사용에는 패기?
+ *
+ *
+ * 2. usb device를 열려면 권한이 필요하다.
+ * 	일반 user가 열때는 “LIBUSB_ERROR_ACCESS” Error가 반환될 가능성이 높다.
+ * 	이를 해결하려면, udev 규칙 파일에 해당 usb device 에게 r/w 권한(MODE="0666")을 추가해야 한다.
+ *
+ * @param:   vpidMap: <vid, pid> table
+ * @return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbComm::openUsbDevice(QMultiMap<quint16, quint16> &vpidMap)
+{
+    if (vpidMap.isEmpty()) {
+        qDebug() << "vpidMap is empty";
+        return false;
+    }
+
+    UsbDeviceMatcher matcher;
+    matcher.addIds(vpidMap);
+    return openUsbDevice(matcher);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 매칭 조건과 일치하는 모든 device 를 open 한다 (이미 열린 device 는 먼저 모두 닫는다)
+ *@param:   matcher: 매칭 조건
+ *@return:  true=OK (1개 이상 open)  false=NG
+ */
+/********************************************************************************/
+bool UsbComm::openUsbDevice(const UsbDeviceMatcher &matcher)
+{
+    if (matcher.isEmpty()) {
+        qDebug() << "matcher is empty";
+        return false;
+    }
+
+    QMutexLocker locker(&deviceListMutex);
+
+    /* 먼저 모든 이미 열린 device 를 닫는다 */
+    closeAllUsbDevice();
+
+    QList<QPair<libusb_device_handle *, int> > opened;
+    if (openMatchedDevices(matcher, -1, &opened) < 0)
+        return false;
+
+    for (int i = 0; i < opened.size(); i++) {
+        libusb_device_handle *deviceHandle = opened.at(i).first;
+        registerOpenedDevice(deviceHandle, opened.at(i).second,
+                             readTunedProfiles(tuningStorePath, libusb_get_device(deviceHandle)));
+    }
+
+    return (bool)deviceHandleList.size();
+}
+
+/********************************************************************************/
+/*
+ *@brief: identity 로 device 1개를 open 한다
+ *
+ * NOTE:
+ * 1. 다른 open 된 device 는 닫지 않는다. 이미 open 되어 있으면 그 handle 을 반환한다.
+ * 2. 일치하는 device 가 2개 이상이면 (serial/port path 를 지정하지 않은 경우 등) 어느 것도 열지 않는다.
+ * 3. serial number 는 VID:PID/port path/interface class 가 일치한 device 만 open 해서 읽는다.
+ *
+ *@param:   identity: device 정보
+ *@return:  device handle, 없거나 특정할 수 없으면 NULL
+ */
+/********************************************************************************/
+libusb_device_handle *UsbComm::openUsbDeviceByIdentity(const UsbDeviceIdentity &identity)
+{
+    UsbDeviceMatcher matcher(identity);
+    if (!matcher.isValid())
+        return NULL;
+
+    QMutexLocker locker(&deviceListMutex);
+
+    /* 이미 open 되어 있는지 */
+    for (int i = 0; i < deviceHandleList.size(); i++) {
+        libusb_device_handle *deviceHandle = deviceHandleList.at(i);
+        libusb_device_descriptor deviceDesc;
+        if (libusb_get_device_descriptor(libusb_get_device(deviceHandle), &deviceDesc) != LIBUSB_SUCCESS)
+            continue;
+        if (matcher.matchesDevice(libusb_get_device(deviceHandle), deviceDesc)
+            && matcher.matchesSerialNumber(deviceHandle, deviceDesc))
+            return deviceHandle;
+    }
+
+    /* 2개째가 보이면 그만 찾는다 */
+    QList<QPair<libusb_device_handle *, int> > opened;
+    if (openMatchedDevices(matcher, 2, &opened) < 0)
+        return NULL;
+
+    if (opened.size() != 1) {
+        if (opened.isEmpty())
+            qDebug() << "openUsbDeviceByIdentity: device not found";
+        else
+            qDebug() << "openUsbDeviceByIdentity: identity matches more than one device";
+        for (int i = 0; i < opened.size(); i++)
+            libusb_close(opened.at(i).first);
+        return NULL;
+    }
+
+    libusb_device_handle *deviceHandle = opened.first().first;
+    registerOpenedDevice(deviceHandle, opened.first().second, readTunedProfiles(tuningStorePath, libusb_get_device(deviceHandle)));
+    return opened.first().first;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 매칭 조건과 일치하는 device 를 open 한다 (목록에 등록하지 않는다, deviceListMutex 를 잡고 호출)
+ *@param:   matcher: 매칭 조건
+ *@param:   maxCount: 이 수 만큼 open 하면 그만 찾는다 (-1 이면 모두)
+ *@param:   opened: open 한 <handle, shard>
+ *@return:  open 한 수, device list 취득 실패 시 -1
+ */
+/********************************************************************************/
+int UsbComm::openMatchedDevices(const UsbDeviceMatcher &matcher, int maxCount, QList<QPair<libusb_device_handle *, int> > *opened)
+{
+    libusb_device **devs;
+
+    /* get usb devices list */
+    ssize_t count = libusb_get_device_list(context, &devs);
+    if (count < 0) {
+        qDebug() << "libusb_get_device_list is error";
+        return -1;
+    }
+
+    /* shard 1 이후의 device list (필요할 때 가져온다) */
+    QVector<libusb_device **> shardDevs(contexts.size(), NULL);
+    QVector<ssize_t> shardCounts(contexts.size(), 0);
+
+    for (int i = 0; i < count && (maxCount < 0 || opened->size() < maxCount); i++) {
+        /* device */
+        libusb_device_descriptor deviceDesc;
+
+        int err = libusb_get_device_descriptor(devs[i], &deviceDesc);
+        if (err != LIBUSB_SUCCESS) {
+            qDebug() << "libusb_get_device_descriptor error:" << libusb_error_name(err);
+            continue;
+        }
+
+        /* open 하지 않고 비교할 수 있는 조건 (VID:PID, port path, interface class) */
+        if (!matcher.matchesDevice(devs[i], deviceDesc))
+            continue;
+
+        /* shard 의 context 에서 같은 device 를 찾는다 */
+        int shard = selectShard(devs[i]);
+        libusb_device *usbDevice = devs[i];
+        if (shard > 0) {
+            if (shardDevs[shard] == NULL)
+                shardCounts[shard] = libusb_get_device_list(contexts.at(shard), &shardDevs[shard]);
+            usbDevice = findSameDevice(shardDevs[shard], shardCounts[shard], devs[i]);
+            if (usbDevice == NULL) {
+                qDebug() << "device not found in shard" << shard << UsbDeviceMatcher::portPathOf(devs[i]);
+                continue;
+            }
+        }
+
+        libusb_device_handle *deviceHandle = NULL;
+        err = libusb_open(usbDevice, &deviceHandle);
+        if (err != LIBUSB_SUCCESS) {
+            qDebug() << "libusb_open error:" << libusb_error_name(err);
+            continue;
+        }
+
+        /* serial number 는 open 후에 읽는다 */
+        if (!matcher.matchesSerialNumber(deviceHandle, deviceDesc)) {
+            libusb_close(deviceHandle);
+            continue;
+        }
+
+        opened->append(qMakePair(deviceHandle, shard));
+    }
+
+    /* free device list */
+    libusb_free_device_list(devs, 1);
+    for (int i = 1; i < shardDevs.size(); i++) {
+        if (shardDevs.at(i) != NULL && shardCounts.at(i) >= 0)
+            libusb_free_device_list(shardDevs.at(i), 1);
+    }
+
+    return opened->size();
+}
+
+/********************************************************************************/
+/*
+ *@brief: open 한 device 를 목록에 등록하고 endpoint 목록을 읽는다 (deviceListMutex 를 잡고 호출)
+ *@param:   profiles: readTunedProfiles() 로 미리 읽어둔 자동 조정 설정
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::registerOpenedDevice(libusb_device_handle *deviceHandle, int shard, const QList<UsbTuneProfile> &profiles)
+{
+    deviceHandleList.append(deviceHandle);
+    handleShards.insert(deviceHandle, shard);
+    buildEndpointMap(deviceHandle);
+    for (int i = 0; i < profiles.size(); i++)
+        tunedProfiles.insert(qMakePair(deviceHandle, profiles.at(i).endpoint), profiles.at(i));
+}
+
+/********************************************************************************/
+/*
+ *@brief: 일치하는 device 를 병렬로 bring-up 한다
+ *
+ * NOTE:
+ * 1. 많은 device 를 붙인 시험 지그에서 open + set configuration + claim + 초기 control read 를 device 마다
+ * 	순서대로 하면 수 초가 걸린다. device 마다 worker 에서 실행해서 가장 느린 device 1개 만큼의 시간으로 줄인다.
+ * 2. openUsbDevice() 와 달리 이미 열린 device 는 닫지 않고, 이미 열린 device 와 같은 device 는 건너뛴다.
+ * 3. 어느 단계에서 실패한 device 는 닫고 error 에 단계와 원인을 남긴다 (다른 device 는 계속 진행한다).
+ * 4. serial number 조건은 worker 에서 open 한 후에 비교하고, 일치하지 않는 device 는 결과에 넣지 않는다.
+ *
+ *@param:   matcher: 매칭 조건
+ *@param:   config: 초기화 내용
+ *@return:  device 별 결과 (enumeration 순서)
+ */
+/********************************************************************************/
+QList<UsbBringUpResult> UsbComm::bringUpDevices(const UsbDeviceMatcher &matcher, const UsbBringUpConfig &config)
+{
+    QList<UsbBringUpResult> results;
+    if (matcher.isEmpty()) {
+        qDebug() << "matcher is empty";
+        return results;
+    }
+
+    QElapsedTimer startTimer;
+    startTimer.start();
+
+    /* 1. 대상 device 와 shard (worker 에서 open 할 때까지 ref 해둔다) */
+    QList<QPair<libusb_device *, int> > targets;
+    {
+        QMutexLocker locker(&deviceListMutex);
+
+        libusb_device **devs;
+        ssize_t count = libusb_get_device_list(context, &devs);
+        if (count < 0) {
+            qDebug() << "libusb_get_device_list is error";
+            return results;
+        }
+
+        QVector<libusb_device **> shardDevs(contexts.size(), NULL);
+        QVector<ssize_t> shardCounts(contexts.size(), 0);
+
+        for (int i = 0; i < count; i++) {
+            libusb_device_descriptor deviceDesc;
+            if (libusb_get_device_descriptor(devs[i], &deviceDesc) != LIBUSB_SUCCESS)
+                continue;
+            if (!matcher.matchesDevice(devs[i], deviceDesc))
+                continue;
+
+            /* 이미 열린 device 는 건너뛴다 */
+            bool alreadyOpened = false;
+            for (int j = 0; j < deviceHandleList.size() && !alreadyOpened; j++) {
+                libusb_device *openedDevice = libusb_get_device(deviceHandleList.at(j));
+                alreadyOpened = libusb_get_bus_number(openedDevice) == libusb_get_bus_number(devs[i])
+                                && libusb_get_device_address(openedDevice) == libusb_get_device_address(devs[i]);
+            }
+            if (alreadyOpened)
+                continue;
+
+            int shard = selectShard(devs[i]);
+            libusb_device *usbDevice = devs[i];
+            if (shard > 0) {
+                if (shardDevs[shard] == NULL)
+                    shardCounts[shard] = libusb_get_device_list(contexts.at(shard), &shardDevs[shard]);
+                usbDevice = findSameDevice(shardDevs[shard], shardCounts[shard], devs[i]);
+                if (usbDevice == NULL)
+                    continue;
+            }
+            targets.append(qMakePair(libusb_ref_device(usbDevice), shard));
+        }
+
+        libusb_free_device_list(devs, 1);
+        for (int i = 1; i < shardDevs.size(); i++) {
+            if (shardDevs.at(i) != NULL && shardCounts.at(i) >= 0)
+                libusb_free_device_list(shardDevs.at(i), 1);
+        }
+    }
+
+    if (targets.isEmpty())
+        return results;
+
+    /* 2. device 마다 worker 에서 실행 (asyncPool 의 다른 비동기 요청을 막지 않도록 전용 pool) */
+    QThreadPool bringUpPool;
+    bringUpPool.setMaxThreadCount(config.maxParallel > 0 ? config.maxParallel : targets.size());
+
+    QList<QFuture<UsbBringUpResult> > futures;
+    for (int i = 0; i < targets.size(); i++) {
+        libusb_device *usbDevice = targets.at(i).first;
+        int shard = targets.at(i).second;
+        futures.append(QtConcurrent::run(&bringUpPool, [this, usbDevice, shard, &matcher, &config, &startTimer]() {
+            applyWorkerThreadSchedConfig();
+            return bringUpDevice(usbDevice, shard, matcher, config, startTimer);
+        }));
+    }
+
+    for (int i = 0; i < futures.size(); i++) {
+        UsbBringUpResult result = futures[i].result();
+        /* serial number 가 다른 device (ok == false 인데 error 가 없다) 는 결과에서 뺀다 */
+        if (result.ok || !result.error.isEmpty())
+            results.append(result);
+    }
+    return results;
+}
+
+/********************************************************************************/
+/*
+ *@brief: bringUpDevices() 의 device 1개 처리 (worker thread 에서 실행)
+ *@param:   usbDevice: ref 된 device (이 함수에서 unref 한다)
+ *@param:   shard: usbDevice 의 shard
+ *@param:   startTimer: bring-up 시작 시각
+ *@return:
+ */
+/********************************************************************************/
+UsbBringUpResult UsbComm::bringUpDevice(libusb_device *usbDevice, int shard, const UsbDeviceMatcher &matcher,
+                                        const UsbBringUpConfig &config, const QElapsedTimer &startTimer)
+{
+    UsbBringUpResult result;
+    result.portPath = UsbDeviceMatcher::portPathOf(usbDevice);
+    result.shard = shard;
+    result.waitMs = startTimer.nsecsElapsed() / 1e6;
+
+    QElapsedTimer totalTimer, stepTimer;
+    totalTimer.start();
+
+    /* 1. open */
+    stepTimer.start();
+    libusb_device_descriptor deviceDesc;
+    libusb_get_device_descriptor(usbDevice, &deviceDesc);
+    libusb_device_handle *deviceHandle = NULL;
+    int err = libusb_open(usbDevice, &deviceHandle);
+    libusb_unref_device(usbDevice);
+    if (err != LIBUSB_SUCCESS) {
+        result.error = QString("open: %1").arg(libusb_error_name(err));
+        result.totalMs = totalTimer.nsecsElapsed() / 1e6;
+        return result;
+    }
+    if (!matcher.matchesSerialNumber(deviceHandle, deviceDesc)) {
+        /* 대상이 아니다 (error 를 남기지 않는다) */
+        libusb_close(deviceHandle);
+        return result;
+    }
+    /* 설정 파일은 lock 밖에서 읽는다 (device 마다 파일을 parse 하므로, lock 안에서 읽으면 병렬 open 이 직렬화된다) */
+    const QList<UsbTuneProfile> profiles = readTunedProfiles(getTuningStorePath(), libusb_get_device(deviceHandle));
+    {
+        QMutexLocker locker(&deviceListMutex);
+        registerOpenedDevice(deviceHandle, shard, profiles);
+    }
+    result.openMs = stepTimer.nsecsElapsed() / 1e6;
+
+    /* 2. configuration */
+    stepTimer.restart();
+    if (config.configuration >= 0 && !setUsbConfig(deviceHandle, config.configuration))
+        result.error = QString("set configuration %1").arg(config.configuration);
+    result.configMs = stepTimer.nsecsElapsed() / 1e6;
+
+    /* 3. claim */
+    stepTimer.restart();
+    for (int i = 0; i < config.interfaces.size() && result.error.isEmpty(); i++) {
+        if (!claimUsbInterface(deviceHandle, config.interfaces.at(i)))
+            result.error = QString("claim interface %1").arg(config.interfaces.at(i));
+    }
+    result.claimMs = stepTimer.nsecsElapsed() / 1e6;
+
+    /* 4. 초기 control read, 추가 초기화 */
+    stepTimer.restart();
+    for (int i = 0; i < config.controlReads.size() && result.error.isEmpty(); i++) {
+        const UsbControlRead &read = config.controlReads.at(i);
+        QByteArray data(read.length, 0);
+        int length = libusb_control_transfer(deviceHandle, read.bmRequestType | LIBUSB_ENDPOINT_IN, read.bRequest,
+                                             read.wValue, read.wIndex, (unsigned char *)data.data(), read.length,
+                                             read.timeout);
+        if (length < 0) {
+            result.error = QString("control read %1: %2").arg(i).arg(libusb_error_name(length));
+        } else {
+            data.truncate(length);
+            result.controlData.append(data);
+        }
+    }
+    if (result.error.isEmpty() && config.initialize && !config.initialize(this, deviceHandle))
+        result.error = "initialize";
+    result.initMs = stepTimer.nsecsElapsed() / 1e6;
+
+    if (result.error.isEmpty()) {
+        result.deviceHandle = deviceHandle;
+        result.ok = true;
+    } else {
+        qDebug() << "bringUpDevice:" << result.portPath << result.error;
+        closeUsbDevice(deviceHandle);
+    }
+
+    result.totalMs = totalTimer.nsecsElapsed() / 1e6;
+    return result;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 지정 usb device 닫기
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::closeUsbDevice(libusb_device_handle *deviceHandle)
+{
+    QMutexLocker locker(&deviceListMutex);
+
+    /* device 의 모든 interface 를 free한다 */
+    releaseUsbInterface(deviceHandle, -1);
+
+    /* open 된 device 를 닫는다 */
+    if (deviceHandleList.contains(deviceHandle)) {
+        libusb_close(deviceHandle);
+        deviceHandleList.removeAll(deviceHandle);
+    }
+    handleShards.remove(deviceHandle);
+
+    /* 이 device 의 endpoint 목록, 자동 조정 설정 삭제 */
+    endpointMap.remove(deviceHandle);
+    for (QHash<QPair<libusb_device_handle *, quint8>, UsbTuneProfile>::iterator it = tunedProfiles.begin(); it != tunedProfiles.end();) {
+        if (it.key().first == deviceHandle)
+            it = tunedProfiles.erase(it);
+        else
+            ++it;
+    }
+    for (QHash<QPair<libusb_device_handle *, int>, int>::iterator it = currentAltSettings.begin(); it != currentAltSettings.end();) {
+        if (it.key().first == deviceHandle)
+            it = currentAltSettings.erase(it);
+        else
+            ++it;
+    }
+
+    /* 이 device 의 지연 통계 삭제 */
+    QMutexLocker latencyLocker(&latencyMutex);
+    for (QHash<QPair<libusb_device_handle *, quint8>, UsbLatencyTracker>::iterator it = latencyTrackers.begin();
+         it != latencyTrackers.end();) {
+        if (it.key().first == deviceHandle)
+            it = latencyTrackers.erase(it);
+        else
+            ++it;
+    }
+
+    /* 전송 counter 삭제 (전송중인 쪽이 잡고 있는 counter 는 그쪽이 놓을 때 해제된다) */
+    QMutexLocker trafficLocker(&trafficMutex);
+    for (QHash<QPair<libusb_device_handle *, quint8>, TrafficEntry>::iterator it = trafficCounters.begin();
+         it != trafficCounters.end();) {
+        if (it.key().first == deviceHandle)
+            it = trafficCounters.erase(it);
+        else
+            ++it;
+    }
+    /* 각 thread 의 cache 에 남은 이 handle 의 counter 를 무효로 한다 (같은 주소로 다시 open 되어도 섞이지 않게) */
+    trafficGeneration.storeRelease(nextGeneration());
+}
+
+/********************************************************************************/
+/*
+ *@brief: 모든 device 닫기
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::closeAllUsbDevice()
+{
+    QMutexLocker locker(&deviceListMutex);
+
+    /* closeUsbDevice() 가 list 에서 제거하므로 앞에서부터 닫는다 */
+    while (!deviceHandleList.isEmpty())
+        closeUsbDevice(deviceHandleList.first());
+}
+
+/********************************************************************************/
+/*
+ *usb device 의 현재 config 를 활성화한다 (config가 1개인 usb device 는 default로 활성화되므로 호출안해도 된다)
+ *@param:   deviceHandle: device handle
+ *@param:   bConfigurationValue: config num
+ *@return:  bool:true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbComm::setUsbConfig(libusb_device_handle *deviceHandle, int bConfigurationValue)
+{
+    if (!isUsbDeviceOpened(deviceHandle)) {
+        return false;
+    }
+
+    /* 지정 config 를 활성화한다
+     * (1개 USB Device 에는 config 가 여러개 있을 수 있지만, 동일시각에 1개만 활성화 할 수 있다)
+     * libusb_get_configuration() 로 현재 활성화된 config index? (default: 1)를 가져올 수 있다.
+     * 만약 지정한 config 가 현재와 같으면 "가벼운"동작(USB device 상태 재설정?)으로 끝난다.
+     */
+    int err = libusb_set_configuration(deviceHandle, bConfigurationValue);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_set_configuration error:" << libusb_error_name(err);
+        return false;
+    }
+
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief:
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+bool UsbComm::claimUsbInterface(libusb_device_handle *deviceHandle, int interfaceNumber)
+{
+    if (!isUsbDeviceOpened(deviceHandle)) {
+        return false;
+    }
+
+    if (libusb_kernel_driver_active(deviceHandle, interfaceNumber) == 1) {
+        qDebug() << "Kernel driver active for interface" << interfaceNumber;
+        int err = libusb_detach_kernel_driver(deviceHandle, interfaceNumber);
+        if (err != LIBUSB_SUCCESS) {
+            qDebug() << "libusb_detach_kernel_driver error:" << libusb_error_name(err);
+            return false;
+        }
+    }
+
+    int err = libusb_claim_interface(deviceHandle, interfaceNumber);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_claim_interface error:" <<libusb_error_name(err);
+        return false;
+    }
+
+    QMutexLocker locker(&deviceListMutex);
+    if (handleClaimedInterfacesMap.contains(deviceHandle)) {
+        QList<int> claimedInterfaceList = handleClaimedInterfacesMap.value(deviceHandle);
+        if (!claimedInterfaceList.contains(interfaceNumber)) {
+            claimedInterfaceList.append(interfaceNumber);
+            handleClaimedInterfacesMap.insert(deviceHandle, claimedInterfaceList);
+        }
+    } else {
+        QList<int> claimedInterfaceList;
+        claimedInterfaceList.append(interfaceNumber);
+        handleClaimedInterfacesMap.insert(deviceHandle, claimedInterfaceList);
+    }
+
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief:
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::releaseUsbInterface(libusb_device_handle *deviceHandle,int interfaceNumber)
+{
+    QMutexLocker locker(&deviceListMutex);
+
+    if (!deviceHandleList.contains(deviceHandle))
+        return;
+
+    if (!handleClaimedInterfacesMap.contains(deviceHandle))
+        return;
+
+    QList<int> claimedInterfaceList = handleClaimedInterfacesMap.value(deviceHandle);
+
+    if (interfaceNumber != -1) {
+        if (claimedInterfaceList.contains(interfaceNumber)) {
+            libusb_release_interface(deviceHandle, interfaceNumber);
+            claimedInterfaceList.removeAll(interfaceNumber);
+            handleClaimedInterfacesMap.insert(deviceHandle, claimedInterfaceList);
+        }
+    } else {
+        for (int i = 0; i < claimedInterfaceList.size(); i++)
+            libusb_release_interface(deviceHandle, claimedInterfaceList.at(i));
+
+        handleClaimedInterfacesMap.remove(deviceHandle);
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief:
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+bool UsbComm::setUsbInterfaceAltSetting(libusb_device_handle *deviceHandle, int interfaceNumber, int bAlternateSetting)
+{
+    {
+        QMutexLocker locker(&deviceListMutex);
+        if (!deviceHandleList.contains(deviceHandle))
+            return false;
+
+        if (!handleClaimedInterfacesMap.contains(deviceHandle) || !handleClaimedInterfacesMap.value(deviceHandle).contains(interfaceNumber))
+            return false;
+    }
+
+    int err = libusb_set_interface_alt_setting(deviceHandle, interfaceNumber, bAlternateSetting);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_set_interface_alt_setting error:" << libusb_error_name(err);
+        return false;
+    }
+
+    QMutexLocker locker(&deviceListMutex);
+    currentAltSettings.insert(qMakePair(deviceHandle, interfaceNumber), bAlternateSetting);
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief:
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+bool UsbComm::resetUsbDevice(libusb_device_handle *deviceHandle)
+{
+    if (!isUsbDeviceOpened(deviceHandle)) {
+        return false;
+    }
+
+    int err = libusb_reset_device(deviceHandle);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_reset_device error:" << libusb_error_name(err);
+        /* device 가 다시 enumerate 되어야 하므로 handle 은 더 이상 쓸 수 없다 */
+        if (err == LIBUSB_ERROR_NOT_FOUND)
+            closeUsbDevice(deviceHandle);
+        return false;
+    }
+
+    /* reset 후에는 모든 interface 가 altsetting 0 으로 돌아간다 */
+    QMutexLocker locker(&deviceListMutex);
+    for (QHash<QPair<libusb_device_handle *, int>, int>::iterator it = currentAltSettings.begin(); it != currentAltSettings.end();) {
+        if (it.key().first == deviceHandle)
+            it = currentAltSettings.erase(it);
+        else
+            ++it;
+    }
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: endpoint 의 halt(STALL) 상태 해제
+ *@param:
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbComm::clearHalt(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    if (!isUsbDeviceOpened(deviceHandle)) {
+        return false;
+    }
+
+    int err = libusb_clear_halt(deviceHandle, endpoint);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_clear_halt error:" << libusb_error_name(err);
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief:
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbComm::bulkTransfer(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, int length, quint32 timeout)
+{
+    if (!isUsbDeviceOpened(deviceHandle)) {
+        return -100;
+    }
+
+    int actual_length = 0;
+    QSharedPointer<UsbTrafficCounters> traffic = cachedTrafficCounters(deviceHandle, endpoint);
+    QElapsedTimer timer;
+    timer.start();
+
+    /* blocking전송. 전송이 끝나거나 타임아웃될 경우에만 return한다 */
+    int err = libusb_bulk_transfer(deviceHandle, endpoint, data, length, &actual_length, timeout);
+    if (err == LIBUSB_SUCCESS) {
+        traffic->addTransfer(actual_length, timer.nsecsElapsed() / 1000);
+        return actual_length;
+    } else if (err == LIBUSB_ERROR_TIMEOUT) {
+        traffic->addError(true, actual_length);
+        return actual_length;
+    } else {
+        traffic->addError(false, actual_length);
+        if (err == LIBUSB_ERROR_PIPE) {
+            libusb_clear_halt(deviceHandle, endpoint);
+        }
+        qDebug() << "libusb_bulk_transfer error:" << libusb_error_name(err);
+        return err;
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: endpoint handle 로 bulk 전송
+ *@param:   endpoint: getEndpoint()/findEndpoint() 로 취득한 endpoint
+ *@return:  bulkTransfer() 와 같다
+ */
+/********************************************************************************/
+int UsbComm::bulkTransfer(const UsbEndpoint &endpoint, quint8 *data, int length, quint32 timeout)
+{
+    if (!endpoint.isValid() || !endpoint.info().isBulk())
+        return LIBUSB_ERROR_INVALID_PARAM;
+    return bulkTransfer(endpoint.deviceHandle(), endpoint.address(), data, length, timeout);
+}
+
+/********************************************************************************/
+/*
+ * bulk 전송 (결과 구분 + 적응형 timeout)
+ *
+ * NOTE:
+ * 1. bulkTransfer() 는 timeout 을 성공(그때까지의 길이)으로 반환하므로, 호출 측에서 short read 와 구분할 수 없다.
+ * 	이 함수는 Completed / ShortRead / TimedOut / Error 를 구분해서 반환한다.
+ *
+ * 2. timeout=0 이면 endpoint 별 지연 통계(UsbLatencyTracker)에서 timeout 을 정한다.
+ * 	(libusb 의 timeout=0 (무한 대기) 은 이 함수에서는 사용할 수 없다)
+ * 	응답이 빠른 request/response 형 endpoint 용이다. 데이터가 언제 올지 모르는 streaming IN 에는 고정 timeout 을 사용한다.
+ *
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: bulk endpoint 주소
+ *@param:   data: 전송 buffer
+ *@param:   length: 전송 길이
+ *@param:   timeout: timeout (ms), 0 이면 적응형
+ *@return:  전송 결과
+ */
+/********************************************************************************/
+UsbTransferResult UsbComm::bulkTransferEx(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, int length,
+                                          quint32 timeout)
+{
+    UsbTransferResult result;
+    result.status = UsbTransferResult::Error;
+    result.actualLength = 0;
+    result.error = 0;
+    result.timeoutMs = timeout;
+    result.latencyUs = 0;
+
+    if (!isUsbDeviceOpened(deviceHandle)) {
+        result.error = -100;
+        return result;
+    }
+
+    QPair<libusb_device_handle *, quint8> key(deviceHandle, endpoint);
+    bool adaptive = (timeout == 0);
+    if (adaptive) {
+        QMutexLocker locker(&latencyMutex);
+        result.timeoutMs = latencyTrackers[key].timeoutMs(adaptiveTimeoutConfig);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int err = libusb_bulk_transfer(deviceHandle, endpoint, data, length, &result.actualLength, result.timeoutMs);
+    result.latencyUs = timer.nsecsElapsed() / 1000;
+
+    QSharedPointer<UsbTrafficCounters> traffic = cachedTrafficCounters(deviceHandle, endpoint);
+    if (err == LIBUSB_SUCCESS)
+        traffic->addTransfer(result.actualLength, result.latencyUs);
+    else
+        traffic->addError(err == LIBUSB_ERROR_TIMEOUT, result.actualLength);
+
+    if (err == LIBUSB_SUCCESS) {
+        result.status = (result.actualLength == length) ? UsbTransferResult::Completed : UsbTransferResult::ShortRead;
+    } else if (err == LIBUSB_ERROR_TIMEOUT) {
+        result.status = UsbTransferResult::TimedOut;
+        result.error = err;
+    } else {
+        if (err == LIBUSB_ERROR_PIPE) {
+            libusb_clear_halt(deviceHandle, endpoint);
+        }
+        qDebug() << "libusb_bulk_transfer error:" << libusb_error_name(err);
+        result.error = err;
+        return result;
+    }
+
+    /* 고정 timeout 전송의 지연도 통계에는 반영한다 */
+    QMutexLocker locker(&latencyMutex);
+    UsbLatencyTracker &tracker = latencyTrackers[key];
+    if (result.status == UsbTransferResult::TimedOut)
+        tracker.addTimeout();
+    else
+        tracker.addSample(result.latencyUs, result.status == UsbTransferResult::ShortRead);
+
+    return result;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 적응형 timeout 설정
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::setAdaptiveTimeoutConfig(const UsbAdaptiveTimeoutConfig &config)
+{
+    QMutexLocker locker(&latencyMutex);
+    adaptiveTimeoutConfig = config;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 적응형 timeout 설정 취득
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbAdaptiveTimeoutConfig UsbComm::getAdaptiveTimeoutConfig()
+{
+    QMutexLocker locker(&latencyMutex);
+    return adaptiveTimeoutConfig;
+}
+
+/********************************************************************************/
+/*
+ *@brief: endpoint 의 지연 통계 (bulkTransferEx 를 사용한 전송만 집계된다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbLatencyStats UsbComm::getLatencyStats(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    QMutexLocker locker(&latencyMutex);
+    QPair<libusb_device_handle *, quint8> key(deviceHandle, endpoint);
+    if (!latencyTrackers.contains(key))
+        return UsbLatencyStats();
+    return latencyTrackers[key].stats(adaptiveTimeoutConfig);
+}
+
+/********************************************************************************/
+/*
+ *@brief: endpoint 의 전송 counter (없으면 만든다)
+ *
+ * NOTE:
+ * 1. map 검색에만 trafficMutex 를 잡는다. 연속 전송 측(callback)은 시작할 때 1번 받아둔 pointer 로 lock 없이 센다.
+ * 2. 새로 만들 때는 deviceListMutex 를 잡고 handle 이 아직 open 되어 있을 때만 map 에 넣는다.
+ * 	호출측의 open 확인 후에 closeUsbDevice() 가 끼어들면, 닫힌 handle 의 항목이 snapshot 에 계속 남고
+ * 	해제된 handle 로 libusb_get_device() 를 부르게 되기 때문이다. 닫힌 handle 에는 map 에 넣지 않은 counter 를 돌려준다.
+ *
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: endpoint 주소
+ *@return:  counter (device 를 닫아도 잡고 있는 동안은 유효하다)
+ */
+/********************************************************************************/
+QSharedPointer<UsbTrafficCounters> UsbComm::getTrafficCounters(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    QPair<libusb_device_handle *, quint8> key(deviceHandle, endpoint);
+    {
+        QMutexLocker locker(&trafficMutex);
+        QHash<QPair<libusb_device_handle *, quint8>, TrafficEntry>::iterator it = trafficCounters.find(key);
+        if (it != trafficCounters.end())
+            return it.value().counters;
+    }
+
+    /* lock 순서는 closeUsbDevice() 와 같게 deviceListMutex -> trafficMutex */
+    QMutexLocker deviceLocker(&deviceListMutex);
+    if (!deviceHandleList.contains(deviceHandle))
+        return QSharedPointer<UsbTrafficCounters>::create();
+
+    QMutexLocker locker(&trafficMutex);
+    QHash<QPair<libusb_device_handle *, quint8>, TrafficEntry>::iterator it = trafficCounters.find(key);
+    if (it != trafficCounters.end())
+        return it.value().counters;
+
+    TrafficEntry entry;
+    entry.portPath = UsbDeviceMatcher::portPathOf(libusb_get_device(deviceHandle));
+    entry.counters = QSharedPointer<UsbTrafficCounters>::create();
+    trafficCounters.insert(key, entry);
+    return entry.counters;
+}
+
+/********************************************************************************/
+/*
+ *@brief: getTrafficCounters() 의 thread 별 cache 버전 (bulkTransfer 처럼 호출마다 counter 를 찾는 경로용)
+ *
+ * NOTE: cache 에 있으면 trafficMutex 도 hash 검색도 없이 돌려준다.
+ * 		closeUsbDevice() 가 trafficGeneration 을 바꾸면 이전 generation 의 항목은 모두 빗나간다.
+ * 		generation 은 검색 전에 읽는다 (검색 도중에 삭제되면 다음 호출에서 다시 찾는다).
+ *
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: endpoint 주소
+ *@return:  counter
+ */
+/********************************************************************************/
+QSharedPointer<UsbTrafficCounters> UsbComm::cachedTrafficCounters(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    int generation = trafficGeneration.loadAcquire();
+    for (int i = 0; i < kTrafficCacheSize; i++) {
+        const TrafficCacheEntry &entry = trafficCache[i];
+        if (entry.generation == generation && entry.deviceHandle == deviceHandle && entry.endpoint == endpoint)
+            return entry.counters;
+    }
+
+    TrafficCacheEntry &entry = trafficCache[trafficCacheNext];
+    trafficCacheNext = (trafficCacheNext + 1) % kTrafficCacheSize;
+    entry.generation = generation;
+    entry.deviceHandle = deviceHandle;
+    entry.endpoint = endpoint;
+    entry.counters = getTrafficCounters(deviceHandle, endpoint);
+    return entry.counters;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 모든 endpoint 의 전송 counter 현재 값
+ *@param:
+ *@return:  port path, endpoint 순
+ */
+/********************************************************************************/
+QList<UsbTrafficEndpoint> UsbComm::getTrafficSnapshots()
+{
+    QList<UsbTrafficEndpoint> list;
+
+    QMutexLocker locker(&trafficMutex);
+    for (QHash<QPair<libusb_device_handle *, quint8>, TrafficEntry>::const_iterator it = trafficCounters.constBegin();
+         it != trafficCounters.constEnd(); ++it) {
+        UsbTrafficEndpoint item;
+        item.deviceHandle = it.key().first;
+        item.portPath = it.value().portPath;
+        item.endpoint = it.key().second;
+        item.snapshot = it.value().counters->snapshot();
+        list.append(item);
+    }
+    locker.unlock();
+
+    std::sort(list.begin(), list.end(), [](const UsbTrafficEndpoint &a, const UsbTrafficEndpoint &b) {
+        return a.portPath != b.portPath ? a.portPath < b.portPath : a.endpoint < b.endpoint;
+    });
+    return list;
+}
+
+/********************************************************************************/
+/*
+ * 대용량 bulk 전송
+ *
+ * NOTE:
+ * 1. length 를 그대로 libusb 에 넘기면, usbfs 의 메모리 제한(usbfs_memory_mb)에 걸려 실패하거나
+ * 	kernel 안에서 하나씩 순서대로 처리되어 bus 가 놀게 된다.
+ * 	그래서 wMaxPacketSize 의 배수인 chunk 로 나누고, largeQueueDepth 개를 동시에 in flight 로 둔다.
+ *
+ * 2. IN 전송에서 short packet(요청보다 짧은 수신)은 device 쪽 전송의 끝을 의미하므로,
+ * 	그 chunk 까지를 결과로 하고 뒤에 submit 해둔 chunk 들은 취소한다.
+ * 	(device 가 한번에 보내는 양이 length 보다 작은 protocol 이라면, 취소 전에 뒤 chunk 가
+ * 	 다음 메시지의 데이터를 받을 수 있으므로 이 함수 대신 bulkTransfer() 를 사용해야 한다)
+ *
+ * 3. OUT 전송에서 sendZeroLengthPacket=true 이고 length 가 max packet 의 배수이면
+ * 	마지막에 ZLP 를 보내서 device 가 전송 끝을 알 수 있게 한다.
+ *
+ * 4. timeout 은 chunk 1개 기준이며, timeout 시에는 bulkTransfer() 와 같이 그때까지의 길이를 반환한다.
+ *
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: bulk endpoint 주소
+ *@param:   data: 전송 buffer
+ *@param:   length: 전송 길이
+ *@param:   timeout: chunk 1개의 timeout (ms)
+ *@param:   sendZeroLengthPacket: OUT 전송 끝의 ZLP 여부
+ *@return:  전송된 bytes, 에러면 음수 (libusb error code)
+ */
+/********************************************************************************/
+qint64 UsbComm::bulkTransferLarge(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, qint64 length,
+                                  quint32 timeout, bool sendZeroLengthPacket)
+{
+    /* autoTune() 결과가 있는 endpoint 는 그 설정을 사용한다 */
+    UsbTuneProfile profile = getTunedProfile(deviceHandle, endpoint);
+    if (profile.isValid())
+        return bulkTransferLargeImpl(deviceHandle, endpoint, data, length, timeout, sendZeroLengthPacket,
+                                     profile.transferSize, profile.queueDepth);
+
+    return bulkTransferLargeImpl(deviceHandle, endpoint, data, length, timeout, sendZeroLengthPacket,
+                                 largeChunkSize, largeQueueDepth);
+}
+
+/********************************************************************************/
+/*
+ *@brief: bulkTransferLarge 본체
+ *@param:   chunkSize: chunk 크기 (max packet 의 배수로 내린다)
+ *@param:   queueDepth: 동시 전송 수
+ *@return:  bulkTransferLarge() 와 같다
+ */
+/********************************************************************************/
+qint64 UsbComm::bulkTransferLargeImpl(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, qint64 length,
+                                      quint32 timeout, bool sendZeroLengthPacket, int chunkSize, int queueDepth)
+{
+    if (!isUsbDeviceOpened(deviceHandle)) {
+        return -100;
+    }
+
+    if (length <= 0)
+        return 0;
+
+    /* chunk 크기는 max packet 의 배수로 내린다 (중간 chunk 가 short packet 으로 끝나지 않게) */
+    int maxPacketSize = endpointMaxPacketSize(deviceHandle, endpoint);
+    chunkSize = qMax(maxPacketSize, chunkSize / maxPacketSize * maxPacketSize);
+    queueDepth = qMax(1, queueDepth);
+
+    LargeTransferState state;
+    state.deviceHandle = deviceHandle;
+    state.base = data;
+    state.length = length;
+    state.nextOffset = 0;
+    state.endOffset = length;
+    state.chunkSize = chunkSize;
+    state.isIn = (endpoint & LIBUSB_ENDPOINT_IN);
+    state.sendZeroLengthPacket = sendZeroLengthPacket && (length % maxPacketSize) == 0;
+    state.stopping = false;
+    state.error = 0;
+    state.inFlight = 0;
+    state.allDone = 0;
+    /* counter 는 이 함수가 끝날 때까지 traffic 이 잡아둔다 (callback 은 lock 없이 센다) */
+    QSharedPointer<UsbTrafficCounters> traffic = getTrafficCounters(deviceHandle, endpoint);
+    state.traffic = traffic.data();
+    state.clock.start();
+
+    int depth = (int)qMin<qint64>(queueDepth, (length + chunkSize - 1) / chunkSize);
+    for (int i = 0; i < depth; i++) {
+        libusb_transfer *transfer = libusb_alloc_transfer(0);
+        if (transfer == NULL)
+            break;
+        libusb_fill_bulk_transfer(transfer, deviceHandle, endpoint, data, 0, largeTransferCallback, &state, timeout);
+        state.transfers.append(transfer);
+        state.submitNs.append(0);
+    }
+    if (state.transfers.isEmpty())
+        return LIBUSB_ERROR_NO_MEM;
+
+    /* callback 은 event thread(startEventHandler) 또는 아래 libusb_handle_events_completed() 를 호출한 이 thread 에서 실행된다.
+     * event thread 가 돌고 있으면 최초 submit 도중에 callback 이 실행될 수 있으므로 state.mutex 로 보호한다 */
+    state.mutex.lock();
+    for (int i = 0; i < state.transfers.size() && !state.stopping && state.nextOffset < length; i++)
+        submitNextChunk(&state, state.transfers.at(i));
+    if (state.inFlight == 0)
+        state.allDone = 1;
+    state.mutex.unlock();
+
+    /* 모든 chunk 의 완료를 기다린다 (libusb_bulk_transfer() 내부의 동기 대기와 같은 방식) */
+    while (!state.allDone) {
+        int err = libusb_handle_events_completed(contextOf(deviceHandle), &state.allDone);
+        if (err < 0 && err != LIBUSB_ERROR_INTERRUPTED) {
+            qDebug() << "libusb_handle_events_completed error:" << libusb_error_name(err);
+        }
+    }
+
+    /* 마지막 callback 이 state.mutex 를 놓을 때까지 기다린 후에 state 를 해제한다 */
+    state.mutex.lock();
+    state.mutex.unlock();
+
+    for (int i = 0; i < state.transfers.size(); i++)
+        libusb_free_transfer(state.transfers.at(i));
+
+    if (state.error != 0 && state.error != LIBUSB_ERROR_TIMEOUT) {
+        if (state.error == LIBUSB_ERROR_PIPE) {
+            libusb_clear_halt(deviceHandle, endpoint);
+        }
+        qDebug() << "bulkTransferLarge error:" << libusb_error_name(state.error);
+        return state.error;
+    }
+
+    return qMin(state.endOffset, state.nextOffset);
+}
+
+/********************************************************************************/
+/*
+ *@brief: endpoint handle 로 대용량 전송
+ *@param:   endpoint: getEndpoint()/findEndpoint() 로 취득한 endpoint
+ *@return:  bulkTransferLarge() 와 같다
+ */
+/********************************************************************************/
+qint64 UsbComm::bulkTransferLarge(const UsbEndpoint &endpoint, quint8 *data, qint64 length, quint32 timeout,
+                                  bool sendZeroLengthPacket)
+{
+    if (!endpoint.isValid() || !endpoint.info().isBulk())
+        return LIBUSB_ERROR_INVALID_PARAM;
+    return bulkTransferLarge(endpoint.deviceHandle(), endpoint.address(), data, length, timeout, sendZeroLengthPacket);
+}
+
+/********************************************************************************/
+/*
+ * @brief: bulkTransferLarge 의 chunk 전송 완료 callback
+ *
+ * NOTE: 같은 endpoint 의 전송은 submit 순서대로 완료되므로,
+ * 		short packet 이 온 chunk 앞의 chunk 들은 모두 요청 길이만큼 완료된 상태이다.
+ *
+ *@return:
+ */
+/********************************************************************************/
+void LIBUSB_CALL UsbComm::largeTransferCallback(libusb_transfer *transfer)
+{
+    LargeTransferState *state = (LargeTransferState *)transfer->user_data;
+    qint64 offset = transfer->buffer - state->base;
+
+    /* submitNs 는 이 transfer 를 다시 submit 할 때(아래, 이 callback 안)에만 바뀌므로 lock 없이 읽는다 */
+    qint64 submitNs = state->submitNs.at(state->transfers.indexOf(transfer));
+    state->traffic->recordTransfer(transfer, (state->clock.nsecsElapsed() - submitNs) / 1000);
+
+    QMutexLocker locker(&state->mutex);
+    state->inFlight--;
+
+    bool finished = false;
+    if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+        /* IN 의 short packet: device 쪽 전송의 끝 */
+        if (state->isIn && transfer->actual_length < transfer->length && !state->stopping) {
+            state->endOffset = offset + transfer->actual_length;
+            finished = true;
+        }
+    } else if (transfer->status != LIBUSB_TRANSFER_CANCELLED) {
+        /* timeout 은 그때까지의 길이를 결과로 하고, 그 외에는 에러 */
+        if (!state->stopping) {
+            state->endOffset = offset + transfer->actual_length;
+            if (state->error == 0)
+                state->error = transferStatusToError(transfer->status);
+        }
+        finished = true;
+    }
+
+    if (finished && !state->stopping) {
+        state->stopping = true;
+        /* 뒤에 submit 해둔 chunk 들은 취소 (완료된 전송의 취소는 LIBUSB_ERROR_NOT_FOUND 로 무시된다) */
+        for (int i = 0; i < state->transfers.size(); i++) {
+            if (state->transfers.at(i) != transfer)
+                libusb_cancel_transfer(state->transfers.at(i));
+        }
+    }
+
+    if (!state->stopping && state->nextOffset < state->length)
+        submitNextChunk(state, transfer);
+
+    if (state->inFlight == 0)
+        state->allDone = 1;
+}
+
+/********************************************************************************/
+/*
+ * chunk 크기 sweep benchmark
+ *
+ * chunk 크기별로 bytesPerRun 만큼 bulkTransferLarge 를 실행하여 속도를 측정한다.
+ * IN endpoint 는 device 가 계속 데이터를 보내고 있어야 하고, OUT endpoint 는 0 으로 채운 데이터를 보낸다.
+ *
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: bulk endpoint 주소
+ *@param:   bytesPerRun: 측정 1회의 전송량
+ *@param:   chunkSizes: 측정할 chunk 크기 목록
+ *@param:   apply: true 면 가장 빠른 chunk 크기를 적용한다
+ *@return:  chunk 크기별 결과
+ */
+/********************************************************************************/
+QList<UsbChunkBenchResult> UsbComm::benchmarkChunkSizes(libusb_device_handle *deviceHandle, quint8 endpoint, qint64 bytesPerRun,
+                                                       const QList<int> &chunkSizes, bool apply)
+{
+    QList<UsbChunkBenchResult> results;
+    if (!isUsbDeviceOpened(deviceHandle) || bytesPerRun <= 0)
+        return results;
+
+    int maxPacketSize = endpointMaxPacketSize(deviceHandle, endpoint);
+
+    QByteArray buffer(bytesPerRun, 0);
+    int bestChunkSize = largeChunkSize;
+    double bestMbps = 0;
+
+    for (int i = 0; i < chunkSizes.size(); i++) {
+        int chunkSize = qMax(maxPacketSize, chunkSizes.at(i) / maxPacketSize * maxPacketSize);
+        UsbTuneResult run = measureRun(deviceHandle, endpoint, (quint8 *)buffer.data(), bytesPerRun, chunkSize, largeQueueDepth);
+
+        UsbChunkBenchResult result;
+        result.chunkSize = run.transferSize;
+        result.bytes = run.bytes;
+        result.mbps = run.mbps;
+        result.error = run.error;
+        results.append(result);
+
+        if (result.error == 0 && result.mbps > bestMbps) {
+            bestMbps = result.mbps;
+            bestChunkSize = result.chunkSize;
+        }
+    }
+
+    if (apply)
+        largeChunkSize = bestChunkSize;
+    return results;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 측정 1회 (bulkTransferLargeImpl 을 1번 실행하여 속도와 process CPU 사용률을 잰다, 결과 출력은 호출측)
+ *@param:   data/length: 전송 buffer 와 전송량
+ *@param:   transferSize: chunk 크기 (max packet 의 배수)
+ *@param:   queueDepth: 동시 전송 수
+ *@return:  측정 결과
+ */
+/********************************************************************************/
+UsbTuneResult UsbComm::measureRun(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, qint64 length,
+                                  int transferSize, int queueDepth)
+{
+    UsbTuneResult result;
+    result.transferSize = transferSize;
+    result.queueDepth = queueDepth;
+
+    qint64 cpuStartUs = ProcStats::cpuTimeUs();
+    QElapsedTimer timer;
+    timer.start();
+    qint64 ret = bulkTransferLargeImpl(deviceHandle, endpoint, data, length, 5000, false, transferSize, queueDepth);
+    qint64 ns = qMax<qint64>(1, timer.nsecsElapsed());
+    qint64 cpuUs = ProcStats::cpuTimeUs() - cpuStartUs;
+
+    result.error = ret < 0 ? (int)ret : 0;
+    result.bytes = ret < 0 ? 0 : ret;
+    result.mbps = result.bytes * 1e3 / ns;
+    result.cpuPercent = cpuStartUs < 0 ? 0 : cpuUs * 1e5 / ns;
+    return result;
+}
+
+/********************************************************************************/
+/*
+ * 전송 크기 x 동시 전송 수 자동 조정
+ *
+ * NOTE:
+ * 1. 조합마다 bytesPerRun 만큼 bulkTransferLarge 를 실행하여 속도와 process CPU 사용률(event thread 포함)을 측정한다.
+ * 	IN endpoint 는 device 가 계속 데이터를 보내고 있어야 하고, OUT endpoint 는 0 으로 채운 데이터를 보낸다.
+ *
+ * 2. 최적값(UsbTuning::selectBest)은 이 handle/endpoint 의 bulkTransferLarge 에 바로 적용되고,
+ * 	save=true 면 VID/PID + 속도 + endpoint 를 key 로 설정 파일에 저장되어 다음 openUsbDevice() 때 다시 읽힌다.
+ *
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: bulk endpoint 주소
+ *@param:   bytesPerRun: 측정 1회의 전송량
+ *@param:   transferSizes: 측정할 전송 크기 목록
+ *@param:   queueDepths: 측정할 동시 전송 수 목록
+ *@param:   save: true 면 설정 파일에 저장한다
+ *@return:  조합별 결과 (최적값은 getTunedProfile() 로 취득)
+ */
+/********************************************************************************/
+QList<UsbTuneResult> UsbComm::autoTune(libusb_device_handle *deviceHandle, quint8 endpoint, qint64 bytesPerRun,
+                                       const QList<int> &transferSizes, const QList<int> &queueDepths, bool save)
+{
+    QList<UsbTuneResult> results;
+    if (!isUsbDeviceOpened(deviceHandle) || bytesPerRun <= 0)
+        return results;
+
+    int maxPacketSize = endpointMaxPacketSize(deviceHandle, endpoint);
+    QByteArray buffer(bytesPerRun, 0);
+
+    for (int i = 0; i < transferSizes.size(); i++) {
+        for (int j = 0; j < queueDepths.size(); j++) {
+            int transferSize = qMax(maxPacketSize, transferSizes.at(i) / maxPacketSize * maxPacketSize);
+            results.append(measureRun(deviceHandle, endpoint, (quint8 *)buffer.data(), bytesPerRun,
+                                      transferSize, qMax(1, queueDepths.at(j))));
+        }
+    }
+
+    int best = UsbTuning::selectBest(results);
+    if (best < 0)
+        return results;
+
+    libusb_device *usbDevice = libusb_get_device(deviceHandle);
+    libusb_device_descriptor deviceDesc;
+    if (libusb_get_device_descriptor(usbDevice, &deviceDesc) != LIBUSB_SUCCESS)
+        return results;
+
+    UsbTuneProfile profile;
+    profile.vid = deviceDesc.idVendor;
+    profile.pid = deviceDesc.idProduct;
+    profile.speed = libusb_get_device_speed(usbDevice);
+    profile.endpoint = endpoint;
+    profile.transferSize = results.at(best).transferSize;
+    profile.queueDepth = results.at(best).queueDepth;
+    profile.mbps = results.at(best).mbps;
+    profile.cpuPercent = results.at(best).cpuPercent;
+    profile.tunedAt = QDateTime::currentDateTime();
+
+    QMutexLocker locker(&deviceListMutex);
+    tunedProfiles.insert(qMakePair(deviceHandle, endpoint), profile);
+    QString storePath = tuningStorePath;
+    locker.unlock();
+
+    /* 파일 쓰기는 lock 밖에서 한다 (다른 thread 의 open/전송을 막지 않도록) */
+    if (save)
+        UsbTuning::saveProfile(storePath, profile);
+
+    return results;
+}
+
+/********************************************************************************/
+/*
+ *@brief: endpoint 의 자동 조정 설정 (open 시에 설정 파일에서 읽은 것 / autoTune() 결과)
+ *@param:
+ *@return:  설정 (없으면 isValid() == false)
+ */
+/********************************************************************************/
+UsbTuneProfile UsbComm::getTunedProfile(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    QMutexLocker locker(&deviceListMutex);
+    return tunedProfiles.value(qMakePair(deviceHandle, endpoint));
+}
+
+/********************************************************************************/
+/*
+ *@brief: 자동 조정 설정 파일 경로 (빈 문자열이면 저장/읽기를 하지 않는다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::setTuningStorePath(const QString &path)
+{
+    QMutexLocker locker(&deviceListMutex);
+    tuningStorePath = path;
+}
+
+QString UsbComm::getTuningStorePath()
+{
+    QMutexLocker locker(&deviceListMutex);
+    return tuningStorePath;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 설정 파일에서 device 의 자동 조정 설정을 읽는다
+ *
+ * NOTE: 설정 파일을 parse 하므로 병렬 bring-up 에서는 deviceListMutex 밖에서 호출한다.
+ *
+ *@param:   storePath: 설정 파일 경로 (비어있으면 읽지 않는다)
+ *@param:   usbDevice: device
+ *@return:  endpoint 별 설정
+ */
+/********************************************************************************/
+QList<UsbTuneProfile> UsbComm::readTunedProfiles(const QString &storePath, libusb_device *usbDevice)
+{
+    if (storePath.isEmpty())
+        return QList<UsbTuneProfile>();
+
+    libusb_device_descriptor deviceDesc;
+    if (libusb_get_device_descriptor(usbDevice, &deviceDesc) != LIBUSB_SUCCESS)
+        return QList<UsbTuneProfile>();
+
+    return UsbTuning::loadProfiles(storePath, deviceDesc.idVendor, deviceDesc.idProduct, libusb_get_device_speed(usbDevice));
+}
+
+/********************************************************************************/
+/*
+ * scatter/gather 쓰기
+ *
+ * spans 를 순서대로 이어붙인 데이터를 OUT endpoint 에 보낸다. header 와 payload 가 다른 buffer 에 있어도
+ * 호출 측에서 조립(memcpy, QByteArray 할당)할 필요가 없다.
+ *
+ * NOTE:
+ * 1. 작은 span 들은 pool 의 buffer(kWritePoolSlotSize) 에 채워서 전송 1개로 보낸다.
+ * 	큰 span(slot 크기 이상)은 복사하지 않고, 호출자의 buffer 를 그대로 전송에 사용한다.
+ * 	이 함수는 모든 전송이 끝난 후에 return 하므로 호출자의 buffer 는 그 동안만 유효하면 된다.
+ *
+ * 2. 여러 전송으로 나뉘어도 device 에는 하나의 연속된 데이터로 보여야 하므로,
+ * 	마지막이 아닌 전송의 길이는 항상 max packet 의 배수로 맞춘다 (중간에 short packet 이 나가지 않게).
+ *
+ * 3. pool 의 slot 과 libusb_transfer 를 재사용하므로 호출마다 heap 할당이 없다.
+ *
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: bulk OUT endpoint 주소
+ *@param:   spans: buffer 목록
+ *@param:   count: buffer 수
+ *@param:   timeout: 전송 1개의 timeout (ms)
+ *@param:   sendZeroLengthPacket: 전체 길이가 max packet 의 배수일 때 ZLP 를 보낼지 여부
+ *@return:  전송된 bytes, 에러면 음수 (libusb error code)
+ */
+/********************************************************************************/
+qint64 UsbComm::bulkWriteV(libusb_device_handle *deviceHandle, quint8 endpoint, const UsbBufferSpan *spans, int count,
+                           quint32 timeout, bool sendZeroLengthPacket)
+{
+    if (!isUsbDeviceOpened(deviceHandle)) {
+        return -100;
+    }
+
+    if (endpoint & LIBUSB_ENDPOINT_IN)
+        return LIBUSB_ERROR_INVALID_PARAM;
+
+    qint64 total = 0;
+    for (int i = 0; i < count; i++)
+        total += spans[i].length;
+    if (total == 0)
+        return 0;
+
+    {
+        QMutexLocker locker(&writePoolMutex);
+        if (writePool == NULL)
+            writePool = new UsbTransferPool(kWritePoolSlotCount, kWritePoolSlotSize);
+    }
+
+    int maxPacketSize = endpointMaxPacketSize(deviceHandle, endpoint);
+    /* 전송 완료는 device 의 shard context 에서 기다린다 */
+    libusb_context *deviceContext = contextOf(deviceHandle);
+
+    GatherWriteState state;
+    state.pool = writePool;
+    state.deviceHandle = deviceHandle;
+    state.endpoint = endpoint;
+    state.timeout = timeout;
+    state.total = total;
+    state.queued = 0;
+    state.bytesDone = 0;
+    state.sendZeroLengthPacket = sendZeroLengthPacket && (total % maxPacketSize) == 0;
+    state.error = 0;
+    state.inFlight = 0;
+    state.wakeup = 0;
+    /* counter 는 이 함수가 끝날 때까지 traffic 이 잡아둔다 (callback 은 lock 없이 센다) */
+    QSharedPointer<UsbTrafficCounters> traffic = cachedTrafficCounters(deviceHandle, endpoint);
+    state.traffic = traffic.data();
+    state.clock.start();
+
+    /* 큰 span 을 직접 보낼 때의 전송 1개 최대 크기 (max packet 의 배수) */
+    int directChunk = qMax(maxPacketSize, largeChunkSize / maxPacketSize * maxPacketSize);
+
+    UsbTransferPool::Slot *slot = NULL;
+    int fill = 0;
+    bool ok = true;
+
+    for (int i = 0; i < count && ok; i++) {
+        const quint8 *p = spans[i].data;
+        qint64 remain = spans[i].length;
+
+        if (remain >= writePool->slotSize()) {
+            /* 1. 채우던 slot 을 max packet 경계까지 채워서 먼저 보낸다 */
+            if (slot != NULL && (fill % maxPacketSize) != 0) {
+                int n = (int)qMin<qint64>(remain, maxPacketSize - fill % maxPacketSize);
+                memcpy(slot->buffer + fill, p, n);
+                fill += n;
+                p += n;
+                remain -= n;
+            }
+            if (slot != NULL && fill > 0) {
+                ok = submitGatherSlot(&state, slot, slot->buffer, fill, gatherWriteCallback);
+                slot = NULL;
+                fill = 0;
+            }
+
+            /* 2. 가운데 부분은 복사 없이 호출자 buffer 로 보낸다 (마지막 span 이 아니면 max packet 배수까지만) */
+            qint64 direct = (i == count - 1) ? remain : remain / maxPacketSize * maxPacketSize;
+            while (ok && direct > 0) {
+                UsbTransferPool::Slot *directSlot = acquireGatherSlot(deviceContext, &state);
+                if (directSlot == NULL) {
+                    ok = false;
+                    break;
+                }
+                int n = (int)qMin<qint64>(direct, directChunk);
+                ok = submitGatherSlot(&state, directSlot, p, n, gatherWriteCallback);
+                p += n;
+                remain -= n;
+                direct -= n;
+            }
+        }
+
+        /* 3. 작은 span (또는 큰 span 의 꼬리)은 slot 에 채운다 */
+        while (ok && remain > 0) {
+            if (slot == NULL) {
+                slot = acquireGatherSlot(deviceContext, &state);
+                if (slot == NULL) {
+                    ok = false;
+                    break;
+                }
+                fill = 0;
+            }
+
+            int n = (int)qMin<qint64>(remain, slot->capacity - fill);
+            memcpy(slot->buffer + fill, p, n);
+            fill += n;
+            p += n;
+            remain -= n;
+
+            if (fill == slot->capacity) {
+                ok = submitGatherSlot(&state, slot, slot->buffer, fill, gatherWriteCallback);
+                slot = NULL;
+                fill = 0;
+            }
+        }
+    }
+
+    if (slot != NULL) {
+        if (ok && fill > 0)
+            submitGatherSlot(&state, slot, slot->buffer, fill, gatherWriteCallback);
+        else
+            writePool->release(slot);
+    }
+
+    /* 모든 전송의 완료를 기다린다 */
+    forever {
+        {
+            QMutexLocker locker(&state.mutex);
+            if (state.inFlight == 0)
+                break;
+        }
+        waitGatherWakeup(deviceContext, &state);
+    }
+
+    /* 마지막 callback 이 state.mutex 를 놓을 때까지 기다린 후에 state 를 해제한다 */
+    state.mutex.lock();
+    state.mutex.unlock();
+
+    if (state.error != 0) {
+        if (state.error == LIBUSB_ERROR_PIPE) {
+            libusb_clear_halt(deviceHandle, endpoint);
+        }
+        qDebug() << "bulkWriteV error:" << libusb_error_name(state.error);
+        return state.error;
+    }
+
+    return state.bytesDone;
+}
+
+/********************************************************************************/
+/*
+ * @brief: bulkWriteV 의 전송 완료 callback, slot 을 pool 에 돌려주고 대기중인 호출자를 깨운다
+ *@return:
+ */
+/********************************************************************************/
+void LIBUSB_CALL UsbComm::gatherWriteCallback(libusb_transfer *transfer)
+{
+    UsbTransferPool::Slot *slot = (UsbTransferPool::Slot *)transfer->user_data;
+    GatherWriteState *state = (GatherWriteState *)slot->owner;
+
+    state->traffic->recordTransfer(transfer, (state->clock.nsecsElapsed() - slot->submitNs) / 1000);
+
+    QMutexLocker locker(&state->mutex);
+    /* 완료된 전송을 목록에서 빼고 마지막 항목으로 채운다 (순서는 필요 없다) */
+    for (int i = 0; i < state->inFlight; i++) {
+        if (state->inFlightTransfers[i] == transfer) {
+            state->inFlightTransfers[i] = state->inFlightTransfers[state->inFlight - 1];
+            break;
+        }
+    }
+    state->inFlight--;
+    state->bytesDone += transfer->actual_length;
+    if (transfer->status != LIBUSB_TRANSFER_COMPLETED && state->error == 0) {
+        state->error = transferStatusToError(transfer->status);
+        /* 뒤에 submit 해둔 전송은 취소한다 (largeTransferCallback 과 같다, 완료된 전송의 취소는 무시된다) */
+        for (int i = 0; i < state->inFlight; i++)
+            libusb_cancel_transfer(state->inFlightTransfers[i]);
+    }
+
+    state->pool->release(slot);
+    state->wakeup = 1;
+}
+
+/********************************************************************************/
+/*
+ *@brief: openUsbDevice() 의 비동기 버전 (worker pool 에서 실행)
+ *@param:   vpidMap: <vid, pid> table
+ *@return:  결과 future (openUsbDevice() 의 반환값)
+ */
+/********************************************************************************/
+QFuture<bool> UsbComm::openUsbDeviceAsync(const QMultiMap<quint16, quint16> &vpidMap)
+{
+    return QtConcurrent::run(asyncPool, [this, vpidMap]() mutable {
+        applyWorkerThreadSchedConfig();
+        return openUsbDevice(vpidMap);
+    });
+}
+
+/********************************************************************************/
+/*
+ *@brief: openUsbDeviceByIdentity() 의 비동기 버전 (worker pool 에서 실행)
+ *@param:   identity: device 정보
+ *@return:  결과 future (openUsbDeviceByIdentity() 의 반환값)
+ */
+/********************************************************************************/
+QFuture<libusb_device_handle *> UsbComm::openUsbDeviceByIdentityAsync(const UsbDeviceIdentity &identity)
+{
+    return QtConcurrent::run(asyncPool, [this, identity]() {
+        applyWorkerThreadSchedConfig();
+        return openUsbDeviceByIdentity(identity);
+    });
+}
+
+/********************************************************************************/
+/*
+ *@brief: bringUpDevices() 의 비동기 버전 (worker pool 에서 실행, 각 device 는 bring-up 전용 pool 에서 병렬로 처리)
+ *@param:
+ *@return:  결과 future (bringUpDevices() 의 반환값)
+ */
+/********************************************************************************/
+QFuture<QList<UsbBringUpResult> > UsbComm::bringUpDevicesAsync(const UsbDeviceMatcher &matcher, const UsbBringUpConfig &config)
+{
+    return QtConcurrent::run(asyncPool, [this, matcher, config]() {
+        applyWorkerThreadSchedConfig();
+        return bringUpDevices(matcher, config);
+    });
+}
+
+/********************************************************************************/
+/*
+ *@brief: claimUsbInterface() 의 비동기 버전 (worker pool 에서 실행)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+QFuture<bool> UsbComm::claimUsbInterfaceAsync(libusb_device_handle *deviceHandle, int interfaceNumber)
+{
+    return QtConcurrent::run(asyncPool, [this, deviceHandle, interfaceNumber]() {
+        applyWorkerThreadSchedConfig();
+        return claimUsbInterface(deviceHandle, interfaceNumber);
+    });
+}
+
+/********************************************************************************/
+/*
+ * resetUsbDevice() 의 비동기 버전 (worker pool 에서 실행)
+ *
+ * NOTE: libusb_reset_device() 는 device 의 재열거를 기다리므로 수백 ms ~ 수 초 걸린다.
+ * 		여러 device 를 동시에 reset 해도 worker 수(kAsyncPoolThreadCount)까지는 병렬로 진행된다.
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+QFuture<bool> UsbComm::resetUsbDeviceAsync(libusb_device_handle *deviceHandle)
+{
+    return QtConcurrent::run(asyncPool, [this, deviceHandle]() {
+        applyWorkerThreadSchedConfig();
+        return resetUsbDevice(deviceHandle);
+    });
+}
+
+/********************************************************************************/
+/*
+ *@brief: setUsbInterfaceAltSetting() 의 비동기 버전 (worker pool 에서 실행)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+QFuture<bool> UsbComm::setUsbInterfaceAltSettingAsync(libusb_device_handle *deviceHandle, int interfaceNumber,
+                                                      int bAlternateSetting)
+{
+    return QtConcurrent::run(asyncPool, [this, deviceHandle, interfaceNumber, bAlternateSetting]() {
+        applyWorkerThreadSchedConfig();
+        return setUsbInterfaceAltSetting(deviceHandle, interfaceNumber, bAlternateSetting);
+    });
+}
+
+/********************************************************************************/
+/*
+ *@brief: clearHalt() 의 비동기 버전 (worker pool 에서 실행)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+QFuture<bool> UsbComm::clearHaltAsync(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    return QtConcurrent::run(asyncPool, [this, deviceHandle, endpoint]() {
+        applyWorkerThreadSchedConfig();
+        return clearHalt(deviceHandle, endpoint);
+    });
+}
+
+/********************************************************************************/
+/*
+ * bulkTransfer() 의 비동기 버전
+ *
+ * NOTE:
+ * 	libusb 비동기 전송으로 처리하므로 thread 를 점유하지 않는다. 결과는 event thread 에서 설정된다.
+ * 	STALL 시 bulkTransfer() 는 clear halt 까지 하지만, callback 안에서는 동기 호출을 할 수 없으므로
+ * 	LIBUSB_ERROR_PIPE 만 반환한다 (호출 측에서 필요하면 clear halt 한다).
+ *
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: bulk endpoint 주소
+ *@param:   data: 전송 buffer (future 가 끝날 때까지 유효해야 한다)
+ *@param:   length: 전송 길이
+ *@param:   timeout: timeout (ms)
+ *@return:  결과 future (전송된 bytes, timeout 이면 그때까지의 bytes, 에러면 음수)
+ */
+/********************************************************************************/
+QFuture<int> UsbComm::bulkTransferAsync(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, int length,
+                                        quint32 timeout)
+{
+    AsyncTransferState *state = new AsyncTransferState;
+    state->endpoint = endpoint;
+    QFuture<int> future = state->promise.future();
+    state->promise.start();
+
+    int err = LIBUSB_SUCCESS;
+    libusb_transfer *transfer = NULL;
+
+    if (!isUsbDeviceOpened(deviceHandle)) {
+        err = -100;
+    } else if (!startEventHandler()) {
+        err = LIBUSB_ERROR_OTHER;
+    } else if ((transfer = libusb_alloc_transfer(0)) == NULL) {
+        err = LIBUSB_ERROR_NO_MEM;
+    } else {
+        libusb_fill_bulk_transfer(transfer, deviceHandle, endpoint, data, length, asyncTransferCallback, state, timeout);
+        state->traffic = getTrafficCounters(deviceHandle, endpoint);
+        state->timer.start();
+        err = libusb_submit_transfer(transfer);
+        if (err != LIBUSB_SUCCESS)
+            qDebug() << "libusb_submit_transfer error:" << libusb_error_name(err);
+    }
+
+    if (err != LIBUSB_SUCCESS) {
+        libusb_free_transfer(transfer);
+        state->promise.addResult(err);
+        state->promise.finish();
+        delete state;
+    }
+
+    return future;
+}
+
+/********************************************************************************/
+/*
+ * @brief: bulkTransferAsync 의 전송 완료 callback, future 에 결과를 설정한다
+ *@return:
+ */
+/********************************************************************************/
+void LIBUSB_CALL UsbComm::asyncTransferCallback(libusb_transfer *transfer)
+{
+    AsyncTransferState *state = (AsyncTransferState *)transfer->user_data;
+    state->traffic->recordTransfer(transfer, state->timer.nsecsElapsed() / 1000);
+
+    int result;
+    if (transfer->status == LIBUSB_TRANSFER_COMPLETED || transfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
+        result = transfer->actual_length;
+    } else {
+        result = transferStatusToError(transfer->status);
+        qDebug() << "bulkTransferAsync error:" << libusb_error_name(result) << "endpoint" << Qt::hex << state->endpoint;
+    }
+
+    state->promise.addResult(result);
+    state->promise.finish();
+    delete state;
+    libusb_free_transfer(transfer);
+}
+
+/********************************************************************************/
+/*
+ *@brief:
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+libusb_device_handle *UsbComm::getDeviceHandleFromIndex(int index)
+{
+    QMutexLocker locker(&deviceListMutex);
+    if (index >= 0 && index < deviceHandleList.size())
+        return deviceHandleList.at(index);
+
+    return NULL;
+}
+
+/********************************************************************************/
+/*
+ *@brief:
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+libusb_device_handle *UsbComm::getDeviceHandleFromVpidAndPort(quint16 vid, quint16 pid, qint16 port)
+{
+    QMutexLocker locker(&deviceListMutex);
+    for (int i = 0; i < deviceHandleList.size(); i++) {
+        libusb_device *dev = libusb_get_device(deviceHandleList.at(i));
+        libusb_device_descriptor deviceDesc;
+
+        int err = libusb_get_device_descriptor(dev, &deviceDesc);
+        if (err != LIBUSB_SUCCESS) {
+            continue;
+        }
+
+        /* 매칭되는 디바이스 찾기 */
+        if (deviceDesc.idVendor == vid && deviceDesc.idProduct == pid) {
+            if (port == -1) {
+                return deviceHandleList.at(i);
+            } else {
+                if (libusb_get_port_number(dev) == port) {
+                    return deviceHandleList.at(i);
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+/********************************************************************************/
+/*
+ *@brief: open 시에 읽어둔 endpoint 목록
+ *@param:
+ *@return:  모든 interface/altsetting 의 endpoint (open 되지 않은 handle 이면 비어 있다)
+ */
+/********************************************************************************/
+QList<UsbEndpointInfo> UsbComm::getEndpoints(libusb_device_handle *deviceHandle)
+{
+    QMutexLocker locker(&deviceListMutex);
+    return endpointMap.value(deviceHandle);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 altsetting 의 endpoint handle 취득
+ *@param:   address: endpoint 주소 (예: 0x81)
+ *@return:  endpoint handle (없으면 isValid() == false)
+ */
+/********************************************************************************/
+UsbEndpoint UsbComm::getEndpoint(libusb_device_handle *deviceHandle, quint8 address)
+{
+    QMutexLocker locker(&deviceListMutex);
+
+    const QList<UsbEndpointInfo> endpoints = endpointMap.value(deviceHandle);
+    for (int i = 0; i < endpoints.size(); i++) {
+        const UsbEndpointInfo &info = endpoints.at(i);
+        if (info.address == address
+            && info.altSetting == currentAltSettings.value(qMakePair(deviceHandle, info.interfaceNumber), 0))
+            return UsbEndpoint(deviceHandle, info);
+    }
+    return UsbEndpoint();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 altsetting 에서 type/방향이 맞는 첫 endpoint
+ *@param:   transferType: enum libusb_transfer_type
+ *@param:   in: true=IN  false=OUT
+ *@param:   interfaceNumber: 찾을 interface (-1 이면 모든 interface)
+ *@return:  endpoint handle (없으면 isValid() == false)
+ */
+/********************************************************************************/
+UsbEndpoint UsbComm::findEndpoint(libusb_device_handle *deviceHandle, int transferType, bool in, int interfaceNumber)
+{
+    QMutexLocker locker(&deviceListMutex);
+
+    const QList<UsbEndpointInfo> endpoints = endpointMap.value(deviceHandle);
+    for (int i = 0; i < endpoints.size(); i++) {
+        const UsbEndpointInfo &info = endpoints.at(i);
+        if (info.transferType != transferType || info.isIn() != in)
+            continue;
+        if (interfaceNumber != -1 && info.interfaceNumber != interfaceNumber)
+            continue;
+        if (info.altSetting == currentAltSettings.value(qMakePair(deviceHandle, info.interfaceNumber), 0))
+            return UsbEndpoint(deviceHandle, info);
+    }
+    return UsbEndpoint();
+}
+
+/********************************************************************************/
+/*
+ * open 한 device 의 endpoint 목록 작성 (deviceListMutex 를 잡고 호출)
+ *
+ * NOTE:
+ * 	active configuration 을 읽는다 (아직 설정되지 않았으면 첫 configuration).
+ * 	SuperSpeed 이상이면 endpoint companion descriptor 에서 burst 정보를 읽는다.
+ *
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::buildEndpointMap(libusb_device_handle *deviceHandle)
+{
+    libusb_device *usbDevice = libusb_get_device(deviceHandle);
+    int speed = libusb_get_device_speed(usbDevice);
+
+    libusb_config_descriptor *configDesc = NULL;
+    int err = libusb_get_active_config_descriptor(usbDevice, &configDesc);
+    if (err == LIBUSB_ERROR_NOT_FOUND)
+        err = libusb_get_config_descriptor(usbDevice, 0, &configDesc);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_get_config_descriptor error:" << libusb_error_name(err);
+        return;
+    }
+
+    QList<UsbEndpointInfo> endpoints;
+
+    /* interface */
+    for (int j = 0; j < (int)configDesc->bNumInterfaces; j++) {
+        const libusb_interface *usbInterface = &configDesc->interface[j];
+
+        /* alt setting */
+        for (int k = 0; k < usbInterface->num_altsetting; k++) {
+            const libusb_interface_descriptor *interfaceDesc = &usbInterface->altsetting[k];
+
+            /* endpoint */
+            for (int m = 0; m < (int)interfaceDesc->bNumEndpoints; m++) {
+                const libusb_endpoint_descriptor *endpointDesc = &interfaceDesc->endpoint[m];
+
+                UsbEndpointInfo info;
+                info.address = endpointDesc->bEndpointAddress;
+                info.transferType = endpointDesc->bmAttributes & 0x03;
+                info.maxPacketSize = endpointDesc->wMaxPacketSize & 0x07ff;
+                info.interval = endpointDesc->bInterval;
+                info.interfaceNumber = interfaceDesc->bInterfaceNumber;
+                info.altSetting = interfaceDesc->bAlternateSetting;
+                info.speed = speed;
+
+                /* high speed 주기 전송은 micro frame 당 최대 3 transaction */
+                if (speed == LIBUSB_SPEED_HIGH && !info.isBulk())
+                    info.packetsPerMicroframe = ((endpointDesc->wMaxPacketSize >> 11) & 0x03) + 1;
+
+                if (speed >= LIBUSB_SPEED_SUPER) {
+                    libusb_ss_endpoint_companion_descriptor *companion = NULL;
+                    if (libusb_get_ss_endpoint_companion_descriptor(contextOf(deviceHandle), endpointDesc, &companion) == LIBUSB_SUCCESS) {
+                        info.maxBurst = companion->bMaxBurst + 1;
+                        if (info.isIsochronous())
+                            info.mult = (companion->bmAttributes & 0x03) + 1;
+                        info.bytesPerInterval = companion->wBytesPerInterval;
+                        libusb_free_ss_endpoint_companion_descriptor(companion);
+                    }
+                }
+
+                endpoints.append(info);
+            }
+        }
+    }
+
+    libusb_free_config_descriptor(configDesc);
+    endpointMap.insert(deviceHandle, endpoints);
+}
+
+/********************************************************************************/
+/*
+ *@brief: endpoint 의 max packet 크기
+ *@param:
+ *@return:  bytes
+ */
+/********************************************************************************/
+int UsbComm::endpointMaxPacketSize(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    UsbEndpoint ep = getEndpoint(deviceHandle, endpoint);
+    if (ep.isValid() && ep.maxPacketSize() > 0)
+        return ep.maxPacketSize();
+
+    int maxPacketSize = libusb_get_max_packet_size(libusb_get_device(deviceHandle), endpoint);
+    return maxPacketSize > 0 ? maxPacketSize : 512;
+}
+
+/********************************************************************************/
+/*
+ *@brief:
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbComm::printDevInfo(libusb_device *usbDevice)
+{
+    /* device */
+    libusb_device_descriptor deviceDesc;
+
+    int err = libusb_get_device_descriptor(usbDevice, &deviceDesc);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_get_device_descriptor error:" << libusb_error_name(err);
+        return;
+    }
+
+    // if (!(deviceDesc.idVendor == 0x04b4 && deviceDesc.idProduct == 0x00f1)) {
+    //        return;
+    // }
+
+    QString vid, pid;
+
+    qDebug() << "********************************************************************************";
+    qDebug() << "Bus: "<<(int)libusb_get_bus_number(usbDevice);						/* 현재 bus */
+    qDebug() << "Device Address: " <<(int)libusb_get_device_address(usbDevice);				/* bus 에서의 주소 */
+    qDebug() << "Device Port: " <<(int)libusb_get_port_number(usbDevice);					/* device end point number */
+    qDebug() << "Device Speed: " <<(int)libusb_get_device_speed(usbDevice);					/* device 속도, 자세하게는 enum libusb_speed {} */
+    qDebug() << "Device Class: " <<QString("0x%1").arg((int)deviceDesc.bDeviceClass, 2, 16, QChar('0'));	/* device class */
+
+    vid = QString("0x%1").arg((int)deviceDesc.idVendor, 4, 16, QChar('0'));		/* VID */
+    pid = QString("0x%1").arg((int)deviceDesc.idProduct, 4, 16, QChar('0'));	/* PID */
+
+    qDebug() << "VendorID = " << vid;		/* VID */
+    qDebug() << "ProductID = " << pid;		/* PID */
+
+    /********************************************************************************/
+    /* Main Window 로 vid/pid 를 signal 로 보낸다 */
+    /********************************************************************************/
+    emit sigPutDevInfo2MainUI(vid, pid, UsbDeviceMatcher::portPathOf(usbDevice));
+
+    qDebug() << "Number of configurations: " <<(int)deviceDesc.bNumConfigurations;				/* configuration 개수 */
+
+    /* configuration 이하 (interface/altsetting/endpoint) 는 scan 마다 읽지 않는다.
+     * MainWindow 의 descriptor tree (DescriptorTreeModel) 가 펼칠 때 읽는다 */
+    qDebug() << "********************************************************************************";
+}
+
+
+
+
+/********************************************************************************/
+/* Part2: UsbMonitor */
+/********************************************************************************/
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbMonitor::UsbMonitor(QObject *parent) :QObject(parent)
+{
+    /* 맴버변수 초기화 */
+    context = NULL;
+    hotplugHandle = -1;
+    hotplugEventHandler = NULL;
+
+    /* libusb 초기화 */
+    int err = libusb_init(&context);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_init error:" << libusb_error_name(err);
+    }
+
+    /* log level 설정 */
+    libusb_set_debug(context, LIBUSB_LOG_LEVEL_WARNING);	//old
+    //libusb_set_option(context, LIBUSB_OPTION_LOG_LEVEL,LIBUSB_LOG_LEVEL_WARNING);	//new
+}
+
+/********************************************************************************/
+/* 소멸자 */
+/*
+ *@brief:
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbMonitor::~UsbMonitor()
+{
+    /* hot plug 서비스 등록 해제 */
+    deregisterHotplugMonitorService();
+
+    /* libusb 종료 */
+    libusb_exit(context);
+}
+
+
+/********************************************************************************/
+/*
+ *@brief:
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+bool UsbMonitor::registerHotplugMonitorService(int deviceClass, int vendorId, int productId)
+{
+    /* 현재 사용하고 있는 libusb 가 hot plug 감지를 지원하는지 체크 */
+    if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+        qDebug()<<"hotplug capabilites are not supported on this platform";
+        return false;
+    }
+
+    /* hot plug callback 함수 등록 */
+    int err = libusb_hotplug_register_callback(context,
+                                               (libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+                                               LIBUSB_HOTPLUG_NO_FLAGS,
+                                               vendorId,
+                                               productId,
+                                               deviceClass,
+                                               hotplugCallback,
+                                               (void *)this,
+                                               &hotplugHandle);
+
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_hotplug_register_callback error:" << libusb_error_name(err);
+        return false;
+    }
+
+    /* callback 함수는 event polling 후, 트리거 될 것이다 */
+    if (hotplugEventHandler == NULL) {
+        hotplugEventHandler = new UsbEventHandler(context,this);
+    }
+
+    hotplugEventHandler->setStopped(false);
+    hotplugEventHandler->start();
+
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief:
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbMonitor::deregisterHotplugMonitorService()
+{
+    /*  */
+    if (hotplugHandle != -1) {
+        libusb_hotplug_deregister_callback(context, hotplugHandle);
+        hotplugHandle = -1;
+    }
+
+    /* hot plug 이벤트 처리 쓰레드를 종료시킨다*/
+    if (hotplugEventHandler != NULL) {
+        hotplugEventHandler->setStopped(true);
+        /* 쓰레드 종료를 기다린다 */
+        hotplugEventHandler->wait();
+    }
+}
+
+/********************************************************************************/
+/*
+ * @brief: 핫 플러그 콜백 함수(UsbEventHandler 하위 스레드에서 실행)
+ *
+ * NOTE 1: 반드시 정적 멤버 함수 또는 전역 함수여야 한다.
+ * 			그렇지 않으면 this 포인터로 인해 콜백 등록 문이 컴파일되지 않는다.
+ * 			따라서 콜백 함수는 인스턴스 객체를 직접 사용할 수 없지만, 매개 변수 user_data를 통해 인스턴스 객체의 메서드와 데이터에 액세스할 수 있다.
+ *
+ * NOTE 2: 이 함수 내에서 user_data를 사용하여 인스턴스 객체의 신호를 발생시킨다.
+ * 			신호는 하위 스레드에서 발생하므로 연결된 슬롯은 주로 main 스레드에 있다.
+ * 			connect는 기본적으로 큐 연결을 사용하므로 이 함수가 최소한의 처리만 수행하고 불필요한 작업을 하지 않도록 보장한다.
+ *
+ *@return: int: 반환 값이 1 이면 등록 취소(deregistered)
+ */
+/********************************************************************************/
+int UsbMonitor::hotplugCallback(libusb_context *ctx, libusb_device *device, libusb_hotplug_event event, void *user_data)
+{
+    Q_UNUSED(ctx)
+
+    /* 강제로 hot plug 감시하는 object 로 캐스팅  */
+    UsbMonitor *tmpUsbMonitor = (UsbMonitor*)user_data;
+
+    /* device 정보 (device descriptor 는 hotplug callback 안에서도 읽을 수 있다) */
+    libusb_device_descriptor deviceDesc;
+    memset(&deviceDesc, 0, sizeof(deviceDesc));
+    libusb_get_device_descriptor(device, &deviceDesc);
+    QString portPath = UsbDeviceMatcher::portPathOf(device);
+
+    /* usb 삽입 */
+    if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+        emit tmpUsbMonitor->deviceHotplugSig(true);
+        emit tmpUsbMonitor->deviceHotplugDetailSig(true, portPath, deviceDesc.idVendor, deviceDesc.idProduct);
+    } else {
+        /* usb 제거 */
+        emit tmpUsbMonitor->deviceHotplugSig(false);
+        emit tmpUsbMonitor->deviceHotplugDetailSig(false, portPath, deviceDesc.idVendor, deviceDesc.idProduct);
+    }
+
+    return 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief:	생성자함수
+ *@param:	context: libusb 회화 세션
+ *@parent:	parent:
+ */
+/********************************************************************************/
+UsbEventHandler::UsbEventHandler(libusb_context *context, QObject *parent) :QThread(parent)
+{
+    this->context = context;
+    this->stopped = false;
+}
+
+/********************************************************************************/
+/*
+ *@brief: scheduling 설정 (pthread 설정은 대상 thread 안에서 하므로 run() 의 다음 loop 에서 적용한다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbEventHandler::setSchedConfig(const UsbThreadSchedConfig &config)
+{
+    QMutexLocker locker(&schedMutex);
+    schedConfig = config;
+    schedChanged.storeRelease(1);
+}
+
+/********************************************************************************/
+/*
+ *@brief: jitter 측정 간격
+ *@param:   intervalMs: 1 ~ 100 (0 이면 측정 안함)
+ *@return:
+ */
+/********************************************************************************/
+void UsbEventHandler::setJitterProbe(int intervalMs)
+{
+    jitterProbeMs.storeRelaxed(intervalMs <= 0 ? 0 : qBound(1, intervalMs, 100));
+}
+
+/********************************************************************************/
+/*
+ *@brief: jitter 측정 결과
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbJitterStats UsbEventHandler::jitterStats()
+{
+    QMutexLocker locker(&schedMutex);
+    return jitterMeter.stats();
+}
+
+void UsbEventHandler::resetJitterStats()
+{
+    QMutexLocker locker(&schedMutex);
+    jitterMeter.reset();
+}
+
+/********************************************************************************/
+/*
+ *@brief: Sub thread
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbEventHandler::run()
+{
+    /* timeout: 100 ms (jitter 측정중이면 측정 간격) */
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 100000;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (!this->stopped && context != NULL) {
+        /* scheduling 설정 변경 요청 */
+        if (schedChanged.testAndSetAcquire(1, 0)) {
+            schedMutex.lock();
+            UsbThreadSchedConfig config = schedConfig;
+            schedMutex.unlock();
+            UsbThreadSched::applyToCurrentThread(config);
+        }
+
+        int probeMs = jitterProbeMs.loadRelaxed();
+        tv.tv_usec = probeMs > 0 ? probeMs * 1000 : 100000;
+        qint64 startNs = timer.nsecsElapsed();
+
+        //qDebug()<<"libusb_handle_events().......";
+
+        /* pending중인 이벤트를 처리한다. blocking되지 않고 timeout되면 즉시 return한다.
+         * 처음에는 libusb_handle_events()로 블로킹 방식으로 작업을 수행했지만, 블로킹으로 인해 Thread가 제대로 종료되지 않았다.
+         * terminate()를 호출하여 강제로 종료한 후에 wait 작업을 실행하면 정지...
+         *
+         * 블로킹 작업이 kernel모드로 빠져서 user모드에서 thread를 강제로 종료할 수 없게 되는 것으로 의심.
+         *
+         * 참고:
+         * 		pending중인 핫플러그 이벤트가 있으면 등록된 콜백 함수가 이 thread 내에서 호출된다.
+         */
+        libusb_handle_events_timeout_completed(context, &tv, NULL);
+
+        /* jitter: timeout 으로 깨어난 시각이 예정보다 늦은 시간 (event 처리로 일찍 돌아온 경우는 표본으로 쓰지 않는다).
+         * 선점/CPU 경합이 있으면 이 값이 커지고, 같은 만큼 전송 완료 callback 도 늦어진다 */
+        if (probeMs > 0) {
+            qint64 lateNs = timer.nsecsElapsed() - startNs - (qint64)probeMs * 1000000;
+            if (lateNs >= 0) {
+                QMutexLocker locker(&schedMutex);
+                jitterMeter.addSample(lateNs);
+            }
+        }
+    }
+}
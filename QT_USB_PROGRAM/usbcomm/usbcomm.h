@@ -0,0 +1,576 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * USB "응용레이어" 통신 파트 (libusb API 에 한층 더 씌워서, 사용 편의성을 높인다)
+ *
+ * 크게는 2개 파트로 나눈다:
+ * 	1. USB device 와의 통신 (usbcomm)
+ * 	2. USB device 의 hot plug 감지 (usb monitor)
+ *
+ */
+#ifndef USBCOMM_H
+#define USBCOMM_H
+
+#include <QObject>
+#include <QThread>
+#include <QList>
+#include <QMultiMap>
+#include <QMutex>
+#include <QRecursiveMutex>
+#include <QFuture>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QVector>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <functional>
+#include "libusb-1.0/include/libusb.h"
+#include "usblatencytracker.h"
+#include "usbtrafficcounters.h"
+#include "usbdevicematcher.h"
+#include "usbendpoint.h"
+#include "usbtuning.h"
+#include "usbthreadsched.h"
+
+class UsbComm;
+class UsbEventHandler;
+class UsbTransferPool;
+class QThreadPool;
+
+/********************************************************************************/
+/* scatter/gather 전송의 buffer 1개 (UsbComm::bulkWriteV) */
+/********************************************************************************/
+struct UsbBufferSpan
+{
+    const quint8 *data;
+    int length;
+};
+
+/********************************************************************************/
+/* endpoint 1개의 전송 counter 값 (UsbComm::getTrafficSnapshots) */
+/********************************************************************************/
+struct UsbTrafficEndpoint
+{
+    libusb_device_handle *deviceHandle = NULL;
+    QString portPath;
+    quint8 endpoint = 0;
+    UsbTrafficSnapshot snapshot;
+};
+
+/********************************************************************************/
+/* bulkTransferEx 의 결과 */
+/********************************************************************************/
+struct UsbTransferResult
+{
+    enum Status {
+        Completed,		/* 요청한 길이를 모두 전송 */
+        ShortRead,		/* 요청보다 짧게 끝남 (IN: device 쪽 전송의 끝) */
+        TimedOut,		/* timeout (actualLength 는 그때까지의 길이) */
+        Error			/* 그 외 에러 (error 참조) */
+    };
+
+    Status status;
+    int actualLength;
+    int error;			/* libusb error code (Completed/ShortRead 이면 0) */
+    quint32 timeoutMs;	/* 실제로 사용한 timeout */
+    qint64 latencyUs;	/* 전송에 걸린 시간 */
+};
+
+/********************************************************************************/
+/* chunk 크기 sweep benchmark 결과 (UsbComm::benchmarkChunkSizes) */
+/********************************************************************************/
+struct UsbChunkBenchResult
+{
+    int chunkSize;		/* max packet 정렬 후 실제 chunk 크기 */
+    qint64 bytes;		/* 전송된 bytes */
+    double mbps;		/* MB/s */
+    int error;			/* 0 이면 정상, 음수면 libusb error code */
+};
+
+/********************************************************************************/
+/* device 의 string descriptor (UsbComm::getDeviceStrings) */
+/********************************************************************************/
+struct UsbDeviceStrings
+{
+    QString manufacturer;
+    QString product;
+    QString serialNumber;
+    int error = 0;					/* 0 이면 정상, open/read 실패 시 libusb error code */
+};
+
+/********************************************************************************/
+/* 병렬 bring-up 의 초기 control read 1개 (UsbBringUpConfig) */
+/********************************************************************************/
+struct UsbControlRead
+{
+    quint8 bmRequestType = LIBUSB_REQUEST_TYPE_STANDARD | LIBUSB_RECIPIENT_DEVICE;	/* IN 방향은 자동으로 붙인다 */
+    quint8 bRequest = LIBUSB_REQUEST_GET_DESCRIPTOR;
+    quint16 wValue = LIBUSB_DT_DEVICE << 8;
+    quint16 wIndex = 0;
+    quint16 length = LIBUSB_DT_DEVICE_SIZE;
+    quint32 timeout = 1000;
+};
+
+/********************************************************************************/
+/* 병렬 bring-up 설정 (UsbComm::bringUpDevices) */
+/********************************************************************************/
+struct UsbBringUpConfig
+{
+    /* 활성화할 configuration (-1 이면 변경하지 않는다) */
+    int configuration = -1;
+    /* 선언할 interface 번호 */
+    QList<int> interfaces;
+    /* claim 후에 순서대로 실행하는 control read (결과는 UsbBringUpResult::controlData) */
+    QList<UsbControlRead> controlReads;
+    /* 마지막에 실행하는 추가 초기화 (worker thread 에서 실행, false 면 실패로 보고 device 를 닫는다) */
+    std::function<bool(UsbComm *, libusb_device_handle *)> initialize;
+    /* 동시에 초기화하는 device 수 (0 이면 device 수 만큼) */
+    int maxParallel = 0;
+};
+
+/********************************************************************************/
+/* 병렬 bring-up 결과 (device 1개) */
+/********************************************************************************/
+struct UsbBringUpResult
+{
+    libusb_device_handle *deviceHandle = NULL;	/* 실패하면 NULL (device 는 닫혀 있다) */
+    QString portPath;
+    int shard = 0;
+    bool ok = false;
+    QString error;								/* 실패한 단계와 libusb error */
+    QList<QByteArray> controlData;				/* controlReads 의 응답 */
+
+    /* 단계별 시간 (ms), waitMs 는 bring-up 시작부터 worker 가 이 device 를 시작할 때까지 */
+    double waitMs = 0;
+    double openMs = 0;
+    double configMs = 0;
+    double claimMs = 0;
+    double initMs = 0;
+    double totalMs = 0;
+};
+
+/********************************************************************************/
+/* device 를 여러 libusb context / event thread 로 나누는 설정 (UsbComm::setShardConfig) */
+/********************************************************************************/
+struct UsbShardConfig
+{
+    enum Mode {
+        ByBus,			/* bus 번호 % shardCount */
+        ByPortPath,		/* bus + port path 의 hash % shardCount (재접속해도 같은 shard) */
+        Explicit		/* explicitShards 에 지정한 shard (목록에 없는 device 는 ByPortPath) */
+    };
+
+    int shardCount = 1;
+    Mode mode = ByPortPath;
+    /* Explicit: "bus-port.port" (예: "1-1.2", sysfs 와 같은 형식) -> shard 번호 */
+    QHash<QString, int> explicitShards;
+};
+
+/********************************************************************************/
+/* 파트1. USB device 와의 통신 (usbcomm) Class */
+/********************************************************************************/
+/*
+ * USB 통신 main 클래스
+ *
+ * 이 클래스는 USB 장치와의 통신 데이터 전송을 주로 구현한다.
+ *
+ * 이 클래스 내부에서는 필요에 따라 libusb의 메서드 인터페이스를 내부적으로 캡슐화하고,
+ * 현재 open된 장치 핸들 목록과 선언된 인터페이스 목록을 가지고 있는다.
+ *
+ * 따라서
+ * 장치 핸들 및 Interface와 관련된 작업은
+ * 가능한 이 클래스의 메서드를 사용하여 처리하되, 외부에서 libusb 오리지널 인터페이스를 직접 사용하지 않는다.
+ * (이 클래스의 내부 유지 관리 목록이 무효화되어, Exception 상황이  발생하지 않도록 하기 위함)
+*/
+class UsbComm : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UsbComm(QObject *parent = 0);
+    ~UsbComm();
+
+    /********************************************************************************/
+    /*  */
+    /********************************************************************************/
+    /* device 정보 출력 (sigPutDevInfo2MainUI), string descriptor 는 background 에서 읽어서 sigPutDevStrings2MainUI 로 알린다 */
+    void findUsbDevices();
+
+    /* 접속된 모든 device (ref 되어 있다, 호출 측이 libusb_unref_device) */
+    QList<libusb_device *> getDeviceList();
+
+    /* 일치하는 device 의 VID/PID/port path 목록 (open 하지 않고 출력도 하지 않는다, serial 조건은 무시) */
+    QList<UsbDeviceIdentity> enumerateDevices(const UsbDeviceMatcher &matcher);
+
+    /* background 에서 읽어둔 string descriptor (port path 별 cache, 아직 읽지 않았으면 false) */
+    bool getDeviceStrings(const QString &portPath, UsbDeviceStrings *strings);
+    void clearDeviceStringsCache();
+
+    /********************************************************************************/
+    /* Device 초기화 부분 */
+    /********************************************************************************/
+    /* 지정 device 열기 (여러개 있을 수 있다) */
+    bool openUsbDevice(QMultiMap<quint16,quint16> &vpidMap);
+    bool openUsbDevice(const UsbDeviceMatcher &matcher);
+    /* VID:PID + serial number/port path 등으로 device 1개만 열기 (다른 device 는 닫지 않는다, 특정할 수 없으면 NULL) */
+    libusb_device_handle *openUsbDeviceByIdentity(const UsbDeviceIdentity &identity);
+    /* 일치하는 device 를 병렬로 open + configuration + claim + 초기 control read 한다
+     * (이미 열린 device 는 닫지도 다시 열지도 않는다, 결과는 device 별 단계 시간 포함) */
+    QList<UsbBringUpResult> bringUpDevices(const UsbDeviceMatcher &matcher, const UsbBringUpConfig &config);
+
+    /* 지정 device 닫기 */
+    void closeUsbDevice(libusb_device_handle *deviceHandle);
+    /* 모든 device 닫기 */
+    void closeAllUsbDevice();
+
+    /* usb device 의 현재 config 활성화  */
+    bool setUsbConfig(libusb_device_handle *deviceHandle,int bConfigurationValue=1);
+    /* usb device 의 interface 선언  */
+    bool claimUsbInterface(libusb_device_handle *deviceHandle,int interfaceNumber);
+    /* usb device 의 interface 선언 취소 */
+    void releaseUsbInterface(libusb_device_handle *deviceHandle,int interfaceNumber);
+    /* usb interface 의 backup config 활성화  */
+    bool setUsbInterfaceAltSetting(libusb_device_handle *deviceHandle,int interfaceNumber,int bAlternateSetting);
+    bool resetUsbDevice(libusb_device_handle *deviceHandle);
+    /* endpoint 의 halt(STALL) 상태 해제 */
+    bool clearHalt(libusb_device_handle *deviceHandle, quint8 endpoint);
+
+    /********************************************************************************/
+    /* 데이터 전송 부분 */
+    /********************************************************************************/
+    /*  */
+    int bulkTransfer(libusb_device_handle *deviceHandle,quint8 endpoint, quint8 *data, int length, quint32 timeout);
+    int bulkTransfer(const UsbEndpoint &endpoint, quint8 *data, int length, quint32 timeout);
+
+    /* 결과를 완료/short read/timeout/에러로 구분해서 반환한다. timeout=0 이면 endpoint 의 지연 통계로 정한다 (적응형) */
+    UsbTransferResult bulkTransferEx(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, int length,
+                                     quint32 timeout = 0);
+    /* 적응형 timeout 설정 / endpoint 의 지연 통계 */
+    void setAdaptiveTimeoutConfig(const UsbAdaptiveTimeoutConfig &config);
+    UsbAdaptiveTimeoutConfig getAdaptiveTimeoutConfig();
+    UsbLatencyStats getLatencyStats(libusb_device_handle *deviceHandle, quint8 endpoint);
+
+    /* endpoint 별 전송 counter (없으면 만든다). 전송 측은 이 pointer 로 lock 없이 센다 */
+    QSharedPointer<UsbTrafficCounters> getTrafficCounters(libusb_device_handle *deviceHandle, quint8 endpoint);
+    /* 모든 endpoint 의 counter 현재 값 (port path, endpoint 순), dashboard 가 timer 로 읽는다 */
+    QList<UsbTrafficEndpoint> getTrafficSnapshots();
+
+    /* 대용량 전송: max packet 정렬 chunk 로 나누어 여러개를 동시에 in flight 로 두고 전송한다 */
+    qint64 bulkTransferLarge(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, qint64 length,
+                             quint32 timeout, bool sendZeroLengthPacket = false);
+    qint64 bulkTransferLarge(const UsbEndpoint &endpoint, quint8 *data, qint64 length, quint32 timeout,
+                             bool sendZeroLengthPacket = false);
+    /* bulkTransferLarge 의 chunk 크기 (max packet 의 배수로 내림) / 동시 전송 수 (autoTune 설정이 있는 endpoint 는 그쪽이 우선) */
+    void setLargeTransferChunkSize(int chunkSize){largeChunkSize = qMax(1, chunkSize);}
+    int getLargeTransferChunkSize(){return largeChunkSize;}
+    void setLargeTransferQueueDepth(int depth){largeQueueDepth = qMax(1, depth);}
+    int getLargeTransferQueueDepth(){return largeQueueDepth;}
+    /* chunk 크기별 전송 속도 측정 (apply=true 면 가장 빠른 크기를 setLargeTransferChunkSize 로 적용) */
+    QList<UsbChunkBenchResult> benchmarkChunkSizes(libusb_device_handle *deviceHandle, quint8 endpoint, qint64 bytesPerRun,
+                                                  const QList<int> &chunkSizes, bool apply = true);
+    /* 전송 크기 x 동시 전송 수 자동 조정 (최적값은 이 endpoint 의 bulkTransferLarge 에 적용, save=true 면 설정 파일에 저장) */
+    QList<UsbTuneResult> autoTune(libusb_device_handle *deviceHandle, quint8 endpoint, qint64 bytesPerRun,
+                                  const QList<int> &transferSizes, const QList<int> &queueDepths, bool save = true);
+    /* endpoint 의 자동 조정 설정 (open 시에 설정 파일에서 읽은 것 / autoTune 결과), 없으면 isValid() == false */
+    UsbTuneProfile getTunedProfile(libusb_device_handle *deviceHandle, quint8 endpoint);
+    /* 자동 조정 설정 파일 (default: UsbTuning::defaultStorePath(), 빈 문자열이면 저장/읽기 안함) */
+    void setTuningStorePath(const QString &path);
+    QString getTuningStorePath();
+
+    /* scatter/gather 쓰기: 여러 buffer 를 하나의 연속된 데이터로 OUT endpoint 에 보낸다 (조립용 memcpy/heap 할당 없음) */
+    qint64 bulkWriteV(libusb_device_handle *deviceHandle, quint8 endpoint, const UsbBufferSpan *spans, int count,
+                      quint32 timeout, bool sendZeroLengthPacket = false);
+
+    /********************************************************************************/
+    /* 비동기(QFuture) 버전 - 호출 thread(GUI thread 등)를 막지 않는다 */
+    /********************************************************************************/
+    /*
+     * open/claim/reset 은 UsbComm 전용 worker pool 에서 동기 버전을 실행하고,
+     * bulk 전송은 libusb 비동기 전송으로 처리한다 (thread 를 사용하지 않는다).
+     * 결과는 완료된 thread(worker 또는 event thread)에서 설정되므로, GUI 를 갱신하는 continuation 은
+     * future.then(this, ...) 처럼 context 를 지정한다. 여러 device 에 대한 요청은 QtFuture::whenAll() 로 묶을 수 있다.
+     */
+    QFuture<bool> openUsbDeviceAsync(const QMultiMap<quint16,quint16> &vpidMap);
+    QFuture<libusb_device_handle *> openUsbDeviceByIdentityAsync(const UsbDeviceIdentity &identity);
+    QFuture<QList<UsbBringUpResult> > bringUpDevicesAsync(const UsbDeviceMatcher &matcher, const UsbBringUpConfig &config);
+    QFuture<bool> claimUsbInterfaceAsync(libusb_device_handle *deviceHandle, int interfaceNumber);
+    QFuture<bool> resetUsbDeviceAsync(libusb_device_handle *deviceHandle);
+    QFuture<bool> setUsbInterfaceAltSettingAsync(libusb_device_handle *deviceHandle, int interfaceNumber, int bAlternateSetting);
+    QFuture<bool> clearHaltAsync(libusb_device_handle *deviceHandle, quint8 endpoint);
+    /* 결과는 bulkTransfer() 와 같다 (data 는 future 가 끝날 때까지 유효해야 한다) */
+    QFuture<int> bulkTransferAsync(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, int length,
+                                   quint32 timeout);
+
+    /********************************************************************************/
+    /* USB Device 정보 쿼리 */
+    /********************************************************************************/
+    /* 현재 open된 디바이스 수량 취득 */
+    int getOpenedDeviceCount(){QMutexLocker locker(&deviceListMutex); return deviceHandleList.size();}
+    /* 지정 handle 이 이 class 에서 open 된 것인지 확인 */
+    bool isUsbDeviceOpened(libusb_device_handle *deviceHandle){QMutexLocker locker(&deviceListMutex); return deviceHandleList.contains(deviceHandle);}
+
+    /* open 시에 읽어둔 active configuration 의 endpoint 목록 (모든 interface/altsetting) */
+    QList<UsbEndpointInfo> getEndpoints(libusb_device_handle *deviceHandle);
+    /* 현재 altsetting 의 endpoint handle 취득 (없으면 isValid() == false) */
+    UsbEndpoint getEndpoint(libusb_device_handle *deviceHandle, quint8 address);
+    /* 현재 altsetting 에서 type/방향이 맞는 첫 endpoint (interfaceNumber=-1 이면 모든 interface) */
+    UsbEndpoint findEndpoint(libusb_device_handle *deviceHandle, int transferType, bool in, int interfaceNumber = -1);
+
+    /********************************************************************************/
+    /* 비동기 전송(libusb_submit_transfer) 용 event 처리 thread */
+    /********************************************************************************/
+    /* 비동기 전송을 사용하는 class(UsbRecorder 등)는 전송 submit 전에 호출한다 (이미 실행중이면 아무것도 안함)
+     * shard 가 여러개면 shard 마다 event thread 가 있고, device 의 전송 완료 callback 은 그 device 의 shard thread 에서 실행된다 */
+    bool startEventHandler();
+    /* event 처리 thread 종료 (진행중인 비동기 전송이 모두 끝난 후에 호출해야 한다) */
+    void stopEventHandler();
+    /* event 처리 thread 의 scheduling 설정 (실시간 policy, CPU affinity, memory lock), 실행중이면 다음 loop 에서 적용 (모든 shard) */
+    void setEventThreadSchedConfig(const UsbThreadSchedConfig &config);
+    UsbThreadSchedConfig getEventThreadSchedConfig();
+    /* worker thread (비동기 버전의 pool, bring-up pool, UsbFirmwareLoader/UsbFleetManager 의 pool, UsbRecorder 의 writer) 의 scheduling 설정.
+     * 설정이 바뀐 후 각 thread 가 다음 작업을 시작할 때 적용된다 */
+    void setWorkerThreadSchedConfig(const UsbThreadSchedConfig &config);
+    UsbThreadSchedConfig getWorkerThreadSchedConfig();
+    /* 호출한 worker thread 에 설정을 적용한다 (이 thread 에 적용한 후 바뀌지 않았으면 아무것도 안함, 작업 시작 시에 호출) */
+    void applyWorkerThreadSchedConfig();
+    /* event 처리 thread 가 깨어나는 지연(jitter) 측정, intervalMs 마다 깨어나서 잰다 (0 이면 측정 안함) */
+    void setEventThreadJitterProbe(int intervalMs);
+    UsbJitterStats getEventThreadJitterStats(int shard = 0);
+
+    /********************************************************************************/
+    /* context/event thread 분할 (많은 device 를 동시에 streaming 할 때) */
+    /********************************************************************************/
+    /* device 를 shardCount 개의 libusb context/event thread 로 나눈다
+     * (device 를 open 하기 전, event thread 시작 전에만 변경할 수 있다. 나머지 API 는 shard 를 의식하지 않아도 된다) */
+    bool setShardConfig(const UsbShardConfig &config);
+    UsbShardConfig getShardConfig(){return shardConfig;}
+    int getShardCount(){return contexts.size();}
+    /* device 가 속한 shard (open 되지 않은 handle 이면 -1) */
+    int getDeviceShard(libusb_device_handle *deviceHandle);
+
+    /********************************************************************************/
+    /* 이 클래스의 모든 메서드에서 매개변수(libusb_device_handle deviceHandle)는 다음의 getDeviceHandleFrom_xxx 메서드를 사용하여 가져와야 합니다. */
+    /********************************************************************************/
+    /* index 를 통하여 open 된 device handle 취득 */
+    libusb_device_handle *getDeviceHandleFromIndex(int index);
+
+    /* vid, pid와 port번호로 open 된 device handle 취득 */
+    libusb_device_handle *getDeviceHandleFromVpidAndPort(quint16 vid,quint16 pid,qint16 port);
+
+private:
+    /* usb device 정보 출력 */
+    void printDevInfo(libusb_device *usbDevice);
+    /* string descriptor 를 cache 에서 알리거나, 없으면 worker 에서 읽기 시작한다 */
+    void requestDeviceStrings(libusb_device *usbDevice);
+    /* string descriptor 읽기 (worker thread 에서 실행, usbDevice 는 ref 된 상태로 받아서 unref 한다) */
+    void fetchDeviceStrings(libusb_device *usbDevice, const QString &portPath, const libusb_device_descriptor &deviceDesc);
+    /* open 한 device 의 endpoint 목록 작성 (deviceListMutex 를 잡고 호출) */
+    void buildEndpointMap(libusb_device_handle *deviceHandle);
+    /* endpoint 의 max packet 크기 (endpoint 목록에 없으면 libusb 에 묻는다, 그래도 모르면 512) */
+    int endpointMaxPacketSize(libusb_device_handle *deviceHandle, quint8 endpoint);
+    /* device handle 의 context (전송 완료를 직접 기다릴 때 사용) */
+    libusb_context *contextOf(libusb_device_handle *deviceHandle);
+    /* device 를 open 할 shard */
+    int selectShard(libusb_device *usbDevice);
+    /* 매칭 조건과 일치하는 device 를 open 한다 (목록 등록은 registerOpenedDevice, deviceListMutex 를 잡고 호출) */
+    int openMatchedDevices(const UsbDeviceMatcher &matcher, int maxCount, QList<QPair<libusb_device_handle *, int> > *opened);
+    /* profiles 는 readTunedProfiles() 로 미리 읽어서 넘긴다 */
+    void registerOpenedDevice(libusb_device_handle *deviceHandle, int shard, const QList<UsbTuneProfile> &profiles);
+    /* bringUpDevices() 의 device 1개 처리 (worker thread 에서 실행) */
+    UsbBringUpResult bringUpDevice(libusb_device *usbDevice, int shard, const UsbDeviceMatcher &matcher,
+                                   const UsbBringUpConfig &config, const QElapsedTimer &startTimer);
+    /* 설정 파일에서 device 의 자동 조정 설정을 읽는다 (file I/O 이므로 병렬 경로에서는 deviceListMutex 밖에서 호출) */
+    static QList<UsbTuneProfile> readTunedProfiles(const QString &storePath, libusb_device *usbDevice);
+
+    /* bulkTransferLarge 본체 (chunk 크기/동시 전송 수 지정) */
+    qint64 bulkTransferLargeImpl(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, qint64 length,
+                                 quint32 timeout, bool sendZeroLengthPacket, int chunkSize, int queueDepth);
+    /* benchmarkChunkSizes()/autoTune() 의 측정 1회 (bulkTransferLargeImpl 1회의 속도와 CPU 사용률) */
+    UsbTuneResult measureRun(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, qint64 length,
+                             int transferSize, int queueDepth);
+
+    /* bulkTransferLarge 의 chunk 전송 완료 callback */
+    static void LIBUSB_CALL largeTransferCallback(libusb_transfer *transfer);
+    /* bulkWriteV 의 전송 완료 callback */
+    static void LIBUSB_CALL gatherWriteCallback(libusb_transfer *transfer);
+    /* bulkTransferAsync 의 전송 완료 callback */
+    static void LIBUSB_CALL asyncTransferCallback(libusb_transfer *transfer);
+
+    /* libusb의 하나의 "회화세션", libusb_init() 생성자 함수가 신규 (shard 0, device 탐색에 사용) */
+    libusb_context *context;
+    /* shard 별 context (contexts[0] == context) 와 device handle 의 shard 번호 (deviceListMutex 로 보호) */
+    QVector<libusb_context *> contexts;
+    QHash<libusb_device_handle *, int> handleShards;
+    UsbShardConfig shardConfig;
+
+    /* open된 usb device handle list */
+    QList<libusb_device_handle *> deviceHandleList;
+    /* deviceHandleList, handleClaimedInterfacesMap 보호 (비동기 버전이 worker thread 에서 접근한다) */
+    mutable QRecursiveMutex deviceListMutex;
+    /* 비동기 버전(open/claim/reset)의 worker pool */
+    QThreadPool *asyncPool;
+
+    /* 비동기 전송의 event 처리 thread, shard 마다 1개 (startEventHandler() 호출 시 생성) */
+    QVector<UsbEventHandler *> eventHandlers;
+    UsbThreadSchedConfig eventThreadSchedConfig;
+    int eventThreadJitterProbeMs;
+    /* eventHandlers 와 그 설정 보호 (startEventHandler() 는 bulkTransferAsync 등으로 어느 thread 에서든 호출된다).
+     * deviceListMutex 와 함께 잡을 때는 deviceListMutex 를 먼저 잡는다 */
+    QMutex eventHandlerMutex;
+    /* worker thread 의 scheduling 설정 (workerSchedMutex 로 보호), 바뀔 때마다 workerSchedGeneration 이 바뀐다 */
+    UsbThreadSchedConfig workerThreadSchedConfig;
+    QAtomicInt workerSchedGeneration;
+    QMutex workerSchedMutex;
+
+    /* bulkTransferLarge 설정 */
+    int largeChunkSize;
+    int largeQueueDepth;
+
+    /* bulkWriteV 의 전송 pool (최초 호출 시 생성) */
+    UsbTransferPool *writePool;
+    QMutex writePoolMutex;
+
+    /* bulkTransferEx 의 endpoint 별 지연 통계 (latencyMutex 로 보호) */
+    QHash<QPair<libusb_device_handle *, quint8>, UsbLatencyTracker> latencyTrackers;
+    UsbAdaptiveTimeoutConfig adaptiveTimeoutConfig;
+    QMutex latencyMutex;
+
+    /* endpoint 별 전송 counter 와 device 의 port path (trafficMutex 로 보호, counter 자체는 lock 없이 증가한다) */
+    struct TrafficEntry
+    {
+        QString portPath;
+        QSharedPointer<UsbTrafficCounters> counters;
+    };
+    QHash<QPair<libusb_device_handle *, quint8>, TrafficEntry> trafficCounters;
+    QMutex trafficMutex;
+    /* trafficCounters 에서 삭제할 때마다 바뀐다 (cachedTrafficCounters 의 thread 별 cache 무효화) */
+    QAtomicInt trafficGeneration;
+    QSharedPointer<UsbTrafficCounters> cachedTrafficCounters(libusb_device_handle *deviceHandle, quint8 endpoint);
+
+    /* handle 과 해당interface list들의 map */
+    QMap<libusb_device_handle *, QList<int> > handleClaimedInterfacesMap;
+
+    /* device 별 endpoint 목록, setUsbInterfaceAltSetting 으로 선택한 altsetting (<handle, interface>, 없으면 0)
+     * (deviceListMutex 로 보호) */
+    QHash<libusb_device_handle *, QList<UsbEndpointInfo> > endpointMap;
+    QHash<QPair<libusb_device_handle *, int>, int> currentAltSettings;
+    /* endpoint 별 자동 조정 설정과 설정 파일 경로 (deviceListMutex 로 보호) */
+    QHash<QPair<libusb_device_handle *, quint8>, UsbTuneProfile> tunedProfiles;
+    QString tuningStorePath;
+
+    /* port path 별 string descriptor cache (같은 port 에 다른 device 가 꽂히면 VID/PID/address 로 구분한다)
+     * 와 읽는 중인 port path (stringsMutex 로 보호) */
+    struct DeviceStringsEntry
+    {
+        quint16 vid;
+        quint16 pid;
+        quint8 address;
+        UsbDeviceStrings strings;
+        QElapsedTimer fetched;		/* 읽은 시각 (실패한 결과는 kDeviceStringsRetryMs 후에 다시 읽는다) */
+    };
+    QHash<QString, DeviceStringsEntry> deviceStringsCache;
+    QSet<QString> pendingDeviceStrings;
+    QMutex stringsMutex;
+
+
+signals:
+    void sigPutDevInfo2MainUI(QString vid, QString pid, QString portPath);
+    /* string descriptor 를 읽었을 때 (worker thread 에서 발생, cache 에 있으면 findUsbDevices() 안에서 발생) */
+    void sigPutDevStrings2MainUI(QString portPath, QString manufacturer, QString product, QString serialNumber);
+};
+
+
+
+
+
+/********************************************************************************/
+/* 파트2. USB hot plug 감지 Class */
+/********************************************************************************/
+/*
+ * 이 클래스는
+ * 전역 obj 를 정의(긴 생명주기)하여, usb device 에 대해서 hot plug 감지를 하는데 사용하면 된다.
+ */
+class UsbMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    UsbMonitor(QObject *parent = 0);
+    ~UsbMonitor();
+
+    /* hot plug 감시서비스 등록하기 */
+    bool registerHotplugMonitorService(int deviceClass=LIBUSB_HOTPLUG_MATCH_ANY,
+                                int vendorId=LIBUSB_HOTPLUG_MATCH_ANY,
+                                int productId=LIBUSB_HOTPLUG_MATCH_ANY);
+    /* hot plug 감시서비스 등록해제 하기 */
+    void deregisterHotplugMonitorService();
+
+signals:
+    /* hot plug signal */
+    void deviceHotplugSig(bool isAttached);
+    /* hot plug signal (device 정보 포함, hotplug event thread 에서 발생) */
+    void deviceHotplugDetailSig(bool isAttached, QString portPath, quint16 vid, quint16 pid);
+
+private:
+    /* hot plug callback 함수 */
+    static int LIBUSB_CALL hotplugCallback(libusb_context *ctx,libusb_device *device,
+                                           libusb_hotplug_event event,void *user_data);
+
+    /* libusb의 하나의 "회화세션", libusb_init() 생성자 함수가 신규 */
+    libusb_context *context;
+    /* hot plug callback handle */
+    libusb_hotplug_callback_handle hotplugHandle;
+    /* hot plug event의 처리 */
+    UsbEventHandler *hotplugEventHandler;
+
+};
+
+
+
+/********************************************************************************/
+/* USB event 처리 Class */
+/********************************************************************************/
+/*
+ * 이 클래스는 QThread를 상속하고 run() 메서드를 재정의하여
+ * 서브스레드에서 보류 중인 이벤트(주로 USB 장치의 핫 플러그 이벤트)를 처리하고, 핫 플러그 콜백 함수가 트리거되게 한다.
+ *
+ * 현재 이 클래스는 UsbMonitor의 핫 플러그 감지 인터페이스와,
+ * UsbComm 의 비동기 전송 완료 처리(startEventHandler())에 사용되며,
+ * 관련 처리는 인터페이스 내에서 이미 캡슐화되어 있으므로 다른 사용법은 생각하지 않아도 된다.
+ */
+class UsbEventHandler : public QThread
+{
+    Q_OBJECT
+public:
+    UsbEventHandler(libusb_context *context, QObject *parent = 0);
+
+    /* Thread 종료 제어 flag 설정 */
+    void setStopped(bool stopped){this->stopped = stopped;}
+
+    /* scheduling 설정 (이 thread 안에서 적용해야 하므로, 다음 loop 에서 적용한다) */
+    void setSchedConfig(const UsbThreadSchedConfig &config);
+    /* jitter 측정 간격 (ms, 1 ~ 100, 0 이면 측정 안함) / 측정 결과 */
+    void setJitterProbe(int intervalMs);
+    UsbJitterStats jitterStats();
+    void resetJitterStats();
+
+protected:
+    virtual void run();
+
+private:
+    /* libusb의 하나의 "회화세션", libusb_init() 생성자 함수가 신규 */
+    libusb_context *context;
+    /* Thread 종료 제어 flag */
+    volatile bool stopped;
+
+    /* scheduling 설정 변경 요청, jitter 측정 (schedMutex 로 보호) */
+    QMutex schedMutex;
+    UsbThreadSchedConfig schedConfig;
+    QAtomicInt schedChanged;
+    QAtomicInt jitterProbeMs;
+    UsbJitterMeter jitterMeter;
+};
+
+#endif // USBCOMM_H
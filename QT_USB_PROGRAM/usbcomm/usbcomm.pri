@@ -0,0 +1,17 @@
+################################################################################
+#
+# usbcomm library 를 사용하는 project (app, cli) 에서 include 한다
+#
+################################################################################
+# usbcomm 의 비동기(QFuture) API 가 QtConcurrent 를 사용한다
+QT += concurrent
+
+INCLUDEPATH += $$PWD $$PWD/../3rdparty/
+DEPENDPATH  += $$PWD
+
+LIBS += -L$$OUT_PWD/../usbcomm -lusbcomm
+LIBS += -L$$PWD/../3rdparty/libusb-1.0/lib -lusb-1.0
+
+!usbcomm_shared {
+    unix: PRE_TARGETDEPS += $$OUT_PWD/../usbcomm/libusbcomm.a
+}
@@ -0,0 +1,71 @@
+################################################################################
+#
+# USB 통신 library (usbcomm)
+#
+# GUI(widgets) 에 의존하지 않는다. app(GUI), cli(headless) 양쪽에서 link 해서 사용한다.
+#
+################################################################################
+TEMPLATE = lib
+TARGET = usbcomm
+
+QT       = core concurrent
+
+# usbawait.h (co_await 전송) 에 C++20 coroutine 이 필요하다
+CONFIG += c++20
+
+usbcomm_shared {
+    CONFIG += shared
+} else {
+    CONFIG += staticlib
+}
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+INCLUDEPATH += $$PWD/../3rdparty/
+
+SOURCES += \
+        procstats.cpp \
+        usbawait.cpp \
+        usbcomm.cpp \
+        usbdevicematcher.cpp \
+        usbendpoint.cpp \
+        usbfirmware.cpp \
+        usbfleet.cpp \
+        usbframeparser.cpp \
+        usblatencytracker.cpp \
+        usbrecorder.cpp \
+        usbreplayer.cpp \
+        usbretry.cpp \
+        usbrpcclient.cpp \
+        usbstreamreader.cpp \
+        usbthreadsched.cpp \
+        usbtrafficcounters.cpp \
+        usbtransferpool.cpp \
+        usbtuning.cpp
+
+HEADERS += \
+        procstats.h \
+        usbawait.h \
+        usbcomm.h \
+        usbdevicematcher.h \
+        usbendpoint.h \
+        usbfirmware.h \
+        usbfleet.h \
+        usbframeparser.h \
+        usblatencytracker.h \
+        usbrecorder.h \
+        usbreplayer.h \
+        usbretry.h \
+        usbrpcclient.h \
+        usbstreamreader.h \
+        usbthreadsched.h \
+        usbtrafficcounters.h \
+        usbtransferpool.h \
+        usbtuning.h
+
+################################################################################
+#
+################################################################################
+LIBS += -L$$PWD/../3rdparty/libusb-1.0/lib -lusb-1.0
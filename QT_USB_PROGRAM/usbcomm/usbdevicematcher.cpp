@@ -0,0 +1,230 @@
+/********************************************************************************/
+/* device 매칭 조건 Part */
+/********************************************************************************/
+#include "usbdevicematcher.h"
+#include <QStringList>
+#include <QDebug>
+#include <cstring>
+
+/********************************************************************************/
+/*
+ *@brief: identity 1개로 조건 생성
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbDeviceMatcher::UsbDeviceMatcher(const UsbDeviceIdentity &identity)
+{
+    addId(identity.vid, identity.pid);
+    setSerialNumber(identity.serialNumber);
+    /* port 조건을 빼고 매칭하면 VID/PID 가 같은 다른 device 와 일치해버리므로 무효로 한다 */
+    if (!identity.portPath.isEmpty() && !setPortPath(identity.portPath)) {
+        qDebug() << "UsbDeviceMatcher: invalid port path:" << identity.portPath;
+        valid = false;
+    }
+    setInterfaceClass(identity.interfaceClass);
+}
+
+/********************************************************************************/
+/*
+ *@brief: VID:PID 추가
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbDeviceMatcher::addId(quint16 vid, quint16 pid)
+{
+    ids.insert(idKey(vid, pid));
+}
+
+/********************************************************************************/
+/*
+ *@brief: <vid, pid> table 의 모든 VID:PID 추가
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbDeviceMatcher::addIds(const QMultiMap<quint16, quint16> &vpidMap)
+{
+    for (QMultiMap<quint16, quint16>::const_iterator it = vpidMap.constBegin(); it != vpidMap.constEnd(); ++it)
+        addId(it.key(), it.value());
+}
+
+/********************************************************************************/
+/*
+ *@brief: serial number 조건 (string descriptor 는 ASCII 로 비교한다)
+ *@param:   serialNumber: 비어있으면 조건 해제
+ *@return:
+ */
+/********************************************************************************/
+void UsbDeviceMatcher::setSerialNumber(const QString &serialNumber)
+{
+    this->serialNumber = serialNumber.toLatin1();
+}
+
+/********************************************************************************/
+/*
+ *@brief: port path 조건
+ *@param:   portPath: "bus-port.port" (예: "1-1.2"), root hub 는 "bus-0", 비어있으면 조건 해제
+ *@return:  true=OK  false=NG (형식 에러, 조건은 변경하지 않는다)
+ */
+/********************************************************************************/
+bool UsbDeviceMatcher::setPortPath(const QString &portPath)
+{
+    if (portPath.isEmpty()) {
+        bus = -1;
+        return true;
+    }
+
+    QStringList busAndPorts = portPath.split('-');
+    bool ok = false;
+    int busNumber = busAndPorts.value(0).toInt(&ok);
+    if (busAndPorts.size() != 2 || !ok || busNumber < 0 || busNumber > 255)
+        return false;
+
+    quint8 parsed[sizeof(ports)];
+    int depth = 0;
+    if (busAndPorts.at(1) != "0") {
+        const QStringList items = busAndPorts.at(1).split('.');
+        if (items.size() > (int)sizeof(ports))
+            return false;
+        for (int i = 0; i < items.size(); i++) {
+            int port = items.at(i).toInt(&ok);
+            if (!ok || port <= 0 || port > 255)
+                return false;
+            parsed[depth++] = (quint8)port;
+        }
+    }
+
+    bus = busNumber;
+    portDepth = depth;
+    memcpy(ports, parsed, depth);
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: interface class 조건
+ *@param:   interfaceClass: enum libusb_class_code, -1 이면 조건 해제
+ *@return:
+ */
+/********************************************************************************/
+void UsbDeviceMatcher::setInterfaceClass(int interfaceClass)
+{
+    this->interfaceClass = interfaceClass;
+}
+
+/********************************************************************************/
+/*
+ *@brief: open 하지 않고 비교할 수 있는 조건 비교
+ *@param:   usbDevice: 비교할 device
+ *@param:   deviceDesc: usbDevice 의 device descriptor
+ *@return:  true=일치  false=불일치
+ */
+/********************************************************************************/
+bool UsbDeviceMatcher::matchesDevice(libusb_device *usbDevice, const libusb_device_descriptor &deviceDesc) const
+{
+    if (!valid)
+        return false;
+
+    /* 1. VID:PID */
+    if (!ids.contains(idKey(deviceDesc.idVendor, deviceDesc.idProduct)))
+        return false;
+
+    /* 2. port path */
+    if (bus >= 0) {
+        if (libusb_get_bus_number(usbDevice) != bus)
+            return false;
+
+        quint8 devicePorts[sizeof(ports)];
+        int depth = libusb_get_port_numbers(usbDevice, devicePorts, sizeof(devicePorts));
+        if (depth < 0)
+            depth = 0;
+        if (depth != portDepth || memcmp(devicePorts, ports, depth) != 0)
+            return false;
+    }
+
+    /* 3. interface class */
+    if (interfaceClass >= 0 && !hasInterfaceClass(usbDevice, deviceDesc))
+        return false;
+
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: serial number 비교
+ *@param:   deviceHandle: open 한 handle
+ *@param:   deviceDesc: device descriptor (iSerialNumber)
+ *@return:  true=일치 (조건이 없으면 항상)  false=불일치 또는 읽기 실패
+ */
+/********************************************************************************/
+bool UsbDeviceMatcher::matchesSerialNumber(libusb_device_handle *deviceHandle, const libusb_device_descriptor &deviceDesc) const
+{
+    if (serialNumber.isEmpty())
+        return true;
+    if (deviceDesc.iSerialNumber == 0)
+        return false;
+
+    unsigned char text[256];
+    int length = libusb_get_string_descriptor_ascii(deviceHandle, deviceDesc.iSerialNumber, text, sizeof(text));
+    if (length < 0) {
+        qDebug() << "libusb_get_string_descriptor_ascii error:" << libusb_error_name(length);
+        return false;
+    }
+    return length == serialNumber.size() && memcmp(text, serialNumber.constData(), length) == 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: device 또는 active configuration 의 interface 중 하나라도 class 가 일치하는지 확인
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+bool UsbDeviceMatcher::hasInterfaceClass(libusb_device *usbDevice, const libusb_device_descriptor &deviceDesc) const
+{
+    if (deviceDesc.bDeviceClass == interfaceClass)
+        return true;
+
+    libusb_config_descriptor *configDesc = NULL;
+    int err = libusb_get_active_config_descriptor(usbDevice, &configDesc);
+    if (err == LIBUSB_ERROR_NOT_FOUND)
+        err = libusb_get_config_descriptor(usbDevice, 0, &configDesc);
+    if (err != LIBUSB_SUCCESS)
+        return false;
+
+    bool found = false;
+    for (int i = 0; i < (int)configDesc->bNumInterfaces && !found; i++) {
+        const libusb_interface *usbInterface = &configDesc->interface[i];
+        for (int j = 0; j < usbInterface->num_altsetting && !found; j++)
+            found = usbInterface->altsetting[j].bInterfaceClass == interfaceClass;
+    }
+
+    libusb_free_config_descriptor(configDesc);
+    return found;
+}
+
+/********************************************************************************/
+/*
+ *@brief: device 의 "bus-port.port" 경로 (sysfs 와 같은 형식, 예: "1-1.2")
+ *@param:
+ *@return:  root hub 는 "bus-0"
+ */
+/********************************************************************************/
+QString UsbDeviceMatcher::portPathOf(libusb_device *usbDevice)
+{
+    quint8 devicePorts[8];
+    int depth = libusb_get_port_numbers(usbDevice, devicePorts, sizeof(devicePorts));
+
+    QString path = QString::number(libusb_get_bus_number(usbDevice)) + '-';
+    if (depth <= 0)
+        return path + '0';
+
+    for (int i = 0; i < depth; i++) {
+        if (i > 0)
+            path += '.';
+        path += QString::number(devicePorts[i]);
+    }
+    return path;
+}
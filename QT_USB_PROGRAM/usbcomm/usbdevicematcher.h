@@ -0,0 +1,84 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * device 매칭 조건 (UsbComm::openUsbDevice / openUsbDeviceByIdentity)
+ *
+ * VID:PID 는 hash set 으로, port path 는 숫자 배열로 미리 변환해둔다.
+ * 매칭 시에 list 를 만들거나 문자열을 변환하지 않으므로, device 수가 많은 bus 에서도 device 마다 드는 비용이 작다.
+ *
+ * 비교 순서 (비용이 작은 것부터):
+ * 	1. VID:PID			device descriptor (libusb 가 cache)
+ * 	2. port path		bus 번호 + port 번호 ("1-1.2")
+ * 	3. interface class	device class 또는 config descriptor 의 interface class
+ * 	4. serial number	device 를 open 해서 string descriptor 를 읽는다 (1~3 이 일치한 device 만)
+ */
+#ifndef USBDEVICEMATCHER_H
+#define USBDEVICEMATCHER_H
+
+#include <QtGlobal>
+#include <QSet>
+#include <QString>
+#include <QByteArray>
+#include <QMultiMap>
+#include "libusb-1.0/include/libusb.h"
+
+/********************************************************************************/
+/* device 1개를 특정하는 정보 (재접속/재부팅 후에도 변하지 않는 값) */
+/********************************************************************************/
+struct UsbDeviceIdentity
+{
+    quint16 vid = 0;
+    quint16 pid = 0;
+    QString serialNumber;			/* 비어있으면 비교하지 않는다 */
+    QString portPath;				/* "bus-port.port" (예: "1-1.2"), 비어있으면 비교하지 않는다 */
+    int interfaceClass = -1;		/* enum libusb_class_code, -1 이면 비교하지 않는다 */
+};
+
+/********************************************************************************/
+/* 매칭 조건 */
+/********************************************************************************/
+class UsbDeviceMatcher
+{
+public:
+    UsbDeviceMatcher() {}
+    /* identity 의 port path 형식이 잘못되었으면 isValid() == false (어떤 device 와도 일치하지 않는다) */
+    explicit UsbDeviceMatcher(const UsbDeviceIdentity &identity);
+
+    /* VID:PID 추가 (하나라도 일치하면 된다) */
+    void addId(quint16 vid, quint16 pid);
+    void addIds(const QMultiMap<quint16, quint16> &vpidMap);
+    /* 추가 조건 (모두 일치해야 한다) */
+    void setSerialNumber(const QString &serialNumber);
+    bool setPortPath(const QString &portPath);
+    void setInterfaceClass(int interfaceClass);
+
+    bool isEmpty() const {return ids.isEmpty();}
+    bool isValid() const {return valid;}
+    /* VID:PID 만 비교 (hotplug 통지 등 libusb_device 가 없을 때) */
+    bool matchesId(quint16 vid, quint16 pid) const {return ids.contains(idKey(vid, pid));}
+    bool hasSerialNumber() const {return !serialNumber.isEmpty();}
+
+    /* open 하지 않고 비교할 수 있는 조건 (VID:PID, port path, interface class) */
+    bool matchesDevice(libusb_device *usbDevice, const libusb_device_descriptor &deviceDesc) const;
+    /* serial number 비교 (open 한 handle 로 string descriptor 를 읽는다, 조건이 없으면 true) */
+    bool matchesSerialNumber(libusb_device_handle *deviceHandle, const libusb_device_descriptor &deviceDesc) const;
+
+    /* device 의 "bus-port.port" 경로 (root hub 는 "bus-0") */
+    static QString portPathOf(libusb_device *usbDevice);
+
+private:
+    static quint32 idKey(quint16 vid, quint16 pid) {return ((quint32)vid << 16) | pid;}
+    bool hasInterfaceClass(libusb_device *usbDevice, const libusb_device_descriptor &deviceDesc) const;
+
+    bool valid = true;
+    QSet<quint32> ids;
+    QByteArray serialNumber;
+    /* port path (bus < 0 이면 비교 안함) */
+    int bus = -1;
+    quint8 ports[8];
+    int portDepth = 0;
+    int interfaceClass = -1;
+};
+
+#endif // USBDEVICEMATCHER_H
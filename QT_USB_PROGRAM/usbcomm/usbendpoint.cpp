@@ -0,0 +1,69 @@
+/********************************************************************************/
+/* endpoint 정보와 endpoint handle Part */
+/********************************************************************************/
+#include "usbendpoint.h"
+
+namespace {
+
+/* bulk 전송 1개의 상한 */
+const int kMaxSuggestedTransferSize = 1024 * 1024;
+
+}
+
+/********************************************************************************/
+/*
+ *@brief: burst 1회 (주기 전송이면 service interval 1회) 에 전송할 수 있는 bytes
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbEndpointInfo::burstBytes() const
+{
+    if (bytesPerInterval > 0 && !isBulk())
+        return bytesPerInterval;
+    return qMax(1, maxPacketSize) * packetsPerMicroframe * maxBurst * mult;
+}
+
+/********************************************************************************/
+/*
+ * endpoint 의 속도/burst 에 맞는 전송 1개의 크기
+ *
+ * NOTE:
+ * 	bulk 는 전송 1개가 bus 시간으로 약 1ms 이상이 되도록 한다 (전송 사이의 완료 처리/재submit 간격을 숨기기 위함).
+ * 	SuperSpeed 는 burst 32회 분, 그 외는 packet 128개 분 (high speed 512 bytes 면 64KB).
+ * 	주기 전송(interrupt/isochronous)은 service interval 1회 분.
+ *
+ *@param:
+ *@return:  bytes (max packet 의 배수)
+ */
+/********************************************************************************/
+int UsbEndpoint::suggestedTransferSize() const
+{
+    int packet = qMax(1, endpointInfo.maxPacketSize);
+
+    if (!endpointInfo.isBulk())
+        return endpointInfo.burstBytes();
+
+    int size = endpointInfo.speed >= LIBUSB_SPEED_SUPER ? endpointInfo.burstBytes() * 32 : packet * 128;
+    size = qMin(size, kMaxSuggestedTransferSize);
+    return qMax(packet, size / packet * packet);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 동시에 submit 해둘 전송 수
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbEndpoint::suggestedQueueDepth() const
+{
+    switch (endpointInfo.transferType) {
+    case LIBUSB_TRANSFER_TYPE_INTERRUPT:
+        return 2;
+    case LIBUSB_TRANSFER_TYPE_ISOCHRONOUS:
+        return 8;
+    default:
+        return endpointInfo.speed >= LIBUSB_SPEED_SUPER ? 16 : 8;
+    }
+}
@@ -0,0 +1,74 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * endpoint 정보와 endpoint handle
+ *
+ * UsbComm 은 device 를 open 할 때 active configuration 의 모든 interface/altsetting/endpoint 를 읽어서
+ * device 별 endpoint 목록을 만들어둔다 (UsbComm::getEndpoints/getEndpoint/findEndpoint).
+ *
+ * UsbEndpoint 는 device handle + endpoint 정보를 묶은 값 type 으로, 복사해서 넘겨도 된다.
+ * 전송 함수에 넘기면 endpoint 주소를 하드코딩하지 않아도 되고,
+ * suggestedTransferSize()/suggestedQueueDepth() 로 endpoint 의 속도/burst 에 맞는 전송 크기와 동시 전송 수를 정할 수 있다.
+ */
+#ifndef USBENDPOINT_H
+#define USBENDPOINT_H
+
+#include <QtGlobal>
+#include "libusb-1.0/include/libusb.h"
+
+/********************************************************************************/
+/* endpoint 정보 (descriptor 에서 읽은 값) */
+/********************************************************************************/
+struct UsbEndpointInfo
+{
+    quint8 address = 0;					/* bEndpointAddress */
+    int transferType = LIBUSB_TRANSFER_TYPE_BULK;	/* enum libusb_transfer_type */
+    int maxPacketSize = 0;				/* wMaxPacketSize 의 packet 크기 (bit 0~10) */
+    int packetsPerMicroframe = 1;		/* high speed 주기 전송의 추가 transaction (bit 11~12) + 1 */
+    int interval = 0;					/* bInterval */
+    int maxBurst = 1;					/* SuperSpeed companion 의 bMaxBurst + 1 (SuperSpeed 가 아니면 1) */
+    int mult = 1;						/* SuperSpeed isochronous 의 Mult + 1 */
+    int bytesPerInterval = 0;			/* SuperSpeed companion 의 wBytesPerInterval (주기 전송) */
+    int interfaceNumber = 0;
+    int altSetting = 0;
+    int speed = LIBUSB_SPEED_UNKNOWN;	/* device 속도 (enum libusb_speed) */
+
+    bool isIn() const {return address & LIBUSB_ENDPOINT_IN;}
+    bool isBulk() const {return transferType == LIBUSB_TRANSFER_TYPE_BULK;}
+    bool isInterrupt() const {return transferType == LIBUSB_TRANSFER_TYPE_INTERRUPT;}
+    bool isIsochronous() const {return transferType == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS;}
+
+    /* burst 1회 (주기 전송이면 service interval 1회) 에 전송할 수 있는 bytes */
+    int burstBytes() const;
+};
+
+/********************************************************************************/
+/* endpoint handle */
+/********************************************************************************/
+class UsbEndpoint
+{
+public:
+    UsbEndpoint() : handle(NULL) {}
+    UsbEndpoint(libusb_device_handle *deviceHandle, const UsbEndpointInfo &info) : handle(deviceHandle), endpointInfo(info) {}
+
+    /* UsbComm::getEndpoint() 등에서 찾지 못했으면 false */
+    bool isValid() const {return handle != NULL;}
+
+    libusb_device_handle *deviceHandle() const {return handle;}
+    const UsbEndpointInfo &info() const {return endpointInfo;}
+    quint8 address() const {return endpointInfo.address;}
+    bool isIn() const {return endpointInfo.isIn();}
+    int maxPacketSize() const {return endpointInfo.maxPacketSize;}
+
+    /* endpoint 의 속도/burst 에 맞는 전송 1개의 크기 (max packet 의 배수) */
+    int suggestedTransferSize() const;
+    /* 동시에 submit 해둘 전송 수 */
+    int suggestedQueueDepth() const;
+
+private:
+    libusb_device_handle *handle;
+    UsbEndpointInfo endpointInfo;
+};
+
+#endif // USBENDPOINT_H
@@ -0,0 +1,590 @@
+/********************************************************************************/
+/* 여러 device 동시 firmware download Part */
+/********************************************************************************/
+#include "usbfirmware.h"
+#include <QDebug>
+#include <QtEndian>
+#include <QDeadlineTimer>
+#include <cstring>
+#include <sys/mman.h>
+
+namespace {
+
+/* prepare/verify worker 수의 상한 */
+const int kMaxWorkers = 64;
+/* ReadBack 검증에서 1번에 읽는 크기의 상한 */
+const qint64 kMaxReadBackBlock = 4 * 1024 * 1024;
+
+/* 전송 실패 내용 */
+QString transferStatusName(int status)
+{
+    switch (status) {
+    case LIBUSB_TRANSFER_TIMED_OUT:	return "timeout";
+    case LIBUSB_TRANSFER_CANCELLED:	return "cancelled";
+    case LIBUSB_TRANSFER_STALL:		return "stall";
+    case LIBUSB_TRANSFER_NO_DEVICE:	return "no device";
+    case LIBUSB_TRANSFER_OVERFLOW:	return "overflow";
+    default:						return "error";
+    }
+}
+
+}
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:   usbComm: device 를 open 한 UsbComm (event thread 를 사용한다)
+ *@return:
+ */
+/********************************************************************************/
+UsbFirmwareLoader::UsbFirmwareLoader(UsbComm *usbComm, QObject *parent) : QObject(parent)
+{
+    this->usbComm = usbComm;
+    mapped = NULL;
+    mappedSize = 0;
+    crc = 0;
+    remaining = 0;
+    succeeded = 0;
+    cancelled = false;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자 (진행중이면 중단하고 끝날 때까지 기다린다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbFirmwareLoader::~UsbFirmwareLoader()
+{
+    cancel();
+    waitForFinished();
+    workerPool.waitForDone();
+    freeDownloads();
+
+    if (mapped != NULL) {
+        file.unmap((uchar *)mapped);
+        file.close();
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: image 파일 memory map 과 CRC-32 계산
+ *@param:   path: image 파일
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbFirmwareLoader::loadImage(const QString &path)
+{
+    if (isRunning()) {
+        qDebug() << "UsbFirmwareLoader: download is running";
+        return false;
+    }
+
+    if (mapped != NULL) {
+        file.unmap((uchar *)mapped);
+        file.close();
+        mapped = NULL;
+        mappedSize = 0;
+    }
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        qDebug() << "UsbFirmwareLoader: open error:" << path << file.errorString();
+        file.close();
+        return false;
+    }
+    mappedSize = file.size();
+    mapped = file.map(0, mappedSize);
+    if (mapped == NULL) {
+        qDebug() << "UsbFirmwareLoader: map error:" << file.errorString();
+        file.close();
+        mappedSize = 0;
+        return false;
+    }
+    /* 모든 device 가 앞에서부터 순서대로 읽는다 */
+    posix_madvise((void *)mapped, mappedSize, POSIX_MADV_SEQUENTIAL);
+
+    crc = crc32(mapped, mappedSize);
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: download 시작
+ *@param:   devices: download 할 device (interface 는 미리 선언해둔다)
+ *@param:   config: 설정
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbFirmwareLoader::start(const QList<libusb_device_handle *> &devices, const UsbFirmwareConfig &config)
+{
+    if (mapped == NULL) {
+        qDebug() << "UsbFirmwareLoader: no image";
+        return false;
+    }
+    if (devices.isEmpty() || config.transferSize <= 0 || config.transferCount <= 0)
+        return false;
+    if (isRunning()) {
+        qDebug() << "UsbFirmwareLoader: download is running";
+        return false;
+    }
+    if (!usbComm->startEventHandler())
+        return false;
+
+    workerPool.waitForDone();
+    freeDownloads();
+
+    this->config = config;
+    cancelled = false;
+    succeeded = 0;
+    remaining = devices.size();
+    workerPool.setMaxThreadCount(qMin(devices.size(), kMaxWorkers));
+
+    for (int i = 0; i < devices.size(); i++) {
+        Download *download = new Download;
+        download->loader = this;
+        download->index = i;
+        download->deviceHandle = devices.at(i);
+        download->nextOffset = 0;
+        download->bytesSent = 0;
+        download->inFlight = 0;
+        download->stopping = false;
+        download->state = UsbFirmwareProgress::Pending;
+        download->downloadSec = 0;
+        download->verifySec = 0;
+        download->traffic = usbComm->getTrafficCounters(devices.at(i), config.outEndpoint);
+
+        /* image 가 max packet 의 배수로 끝나면 ZLP 가 필요하다 */
+        UsbEndpoint ep = usbComm->getEndpoint(devices.at(i), config.outEndpoint);
+        int maxPacketSize = ep.isValid() && ep.maxPacketSize() > 0 ? ep.maxPacketSize() : 512;
+        download->sendZeroLengthPacket = config.sendZeroLengthPacket && (mappedSize % maxPacketSize) == 0;
+
+        for (int j = 0; j < config.transferCount; j++) {
+            libusb_transfer *transfer = libusb_alloc_transfer(0);
+            if (transfer == NULL)
+                break;
+            download->transfers.append(transfer);
+            download->submitNs.append(0);
+        }
+        downloads.append(download);
+    }
+
+    for (int i = 0; i < downloads.size(); i++) {
+        Download *download = downloads.at(i);
+        workerPool.start([this, download]() {
+            usbComm->applyWorkerThreadSchedConfig();
+            beginDevice(download);
+        });
+    }
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 중단 (진행중인 전송을 취소한다, 완료된 전송의 취소는 LIBUSB_ERROR_NOT_FOUND 로 무시된다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFirmwareLoader::cancel()
+{
+    QMutexLocker locker(&mutex);
+    cancelled = true;
+    /* submit 하지 않은 transfer (image 가 transferSize * transferCount 보다 작은 경우 등) 는 취소하지 않는다 */
+    for (int i = 0; i < downloads.size(); i++)
+        cancelInFlight(downloads.at(i));
+}
+
+/********************************************************************************/
+/*
+ *@brief: 모든 device 가 끝날 때까지 대기
+ *@param:   timeoutMs: < 0 이면 무한
+ *@return:  true=모두 끝났다  false=timeout
+ */
+/********************************************************************************/
+bool UsbFirmwareLoader::waitForFinished(int timeoutMs)
+{
+    QMutexLocker locker(&mutex);
+    QDeadlineTimer deadline = timeoutMs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(timeoutMs);
+    while (remaining > 0) {
+        if (!finishedCondition.wait(&mutex, deadline))
+            return remaining == 0;
+    }
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: download 진행중인지
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+bool UsbFirmwareLoader::isRunning() const
+{
+    QMutexLocker locker(&mutex);
+    return remaining > 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: device 별 진행 상태
+ *@param:
+ *@return:  start() 에 넘긴 device 순서
+ */
+/********************************************************************************/
+QList<UsbFirmwareProgress> UsbFirmwareLoader::progress() const
+{
+    QList<UsbFirmwareProgress> list;
+
+    QMutexLocker locker(&mutex);
+    for (int i = 0; i < downloads.size(); i++) {
+        const Download *download = downloads.at(i);
+        UsbFirmwareProgress p;
+        p.deviceHandle = download->deviceHandle;
+        p.state = download->state;
+        p.bytesSent = download->bytesSent;
+        p.bytesTotal = mappedSize;
+        p.downloadSec = download->state == UsbFirmwareProgress::Downloading ? download->timer.nsecsElapsed() / 1e9
+                                                                           : download->downloadSec;
+        p.verifySec = download->verifySec;
+        p.error = download->error;
+        list.append(p);
+    }
+    return list;
+}
+
+/********************************************************************************/
+/*
+ *@brief: CRC-32 (IEEE 802.3, 반사 다항식 0xEDB88320)
+ *@param:   crc: 이어서 계산할 때의 이전 결과 (처음은 0)
+ *@return:
+ */
+/********************************************************************************/
+quint32 UsbFirmwareLoader::crc32(const quint8 *data, qint64 length, quint32 crc)
+{
+    static const QVector<quint32> table = []() {
+        QVector<quint32> t(256);
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (qint64 i = 0; i < length; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+/********************************************************************************/
+/*
+ *@brief: USB 전송 완료 callback (UsbComm event thread 에서 실행), 다음 chunk 를 submit 한다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void LIBUSB_CALL UsbFirmwareLoader::transferCallback(libusb_transfer *transfer)
+{
+    Download *download = (Download *)transfer->user_data;
+    UsbFirmwareLoader *loader = download->loader;
+    bool done = false;
+
+    /* submitNs 는 이 transfer 를 다시 submit 할 때(이 callback 안)에만 바뀌므로 lock 없이 읽는다 */
+    qint64 submitNs = download->submitNs.at(download->transfers.indexOf(transfer));
+    download->traffic->recordTransfer(transfer, (download->timer.nsecsElapsed() - submitNs) / 1000);
+
+    {
+        QMutexLocker locker(&loader->mutex);
+        download->inFlight--;
+        download->inFlightTransfers.removeOne(transfer);
+
+        if (transfer->status == LIBUSB_TRANSFER_COMPLETED && transfer->actual_length == transfer->length) {
+            download->bytesSent += transfer->actual_length;
+        } else {
+            if (download->error.isEmpty()) {
+                download->error = transfer->status == LIBUSB_TRANSFER_COMPLETED
+                                  ? QString("short write at %1").arg(download->bytesSent)
+                                  : "download: " + transferStatusName(transfer->status);
+            }
+            /* 뒤에 submit 해둔 chunk 는 취소한다 (device 가 중간이 빠진 image 를 받지 않도록) */
+            if (!download->stopping) {
+                download->stopping = true;
+                cancelInFlight(download);
+            }
+        }
+
+        if (!download->stopping && !loader->cancelled && download->nextOffset < loader->mappedSize)
+            loader->submitNext(download, transfer);
+
+        if (download->inFlight == 0) {
+            done = true;
+            download->downloadSec = download->timer.nsecsElapsed() / 1e9;
+            if (loader->cancelled && download->error.isEmpty())
+                download->error = "cancelled";
+            download->state = download->error.isEmpty() ? UsbFirmwareProgress::Verifying : UsbFirmwareProgress::Failed;
+        }
+    }
+
+    /* 검증은 전송을 기다리므로 event thread 가 아니라 worker 에서 한다 */
+    if (done) {
+        loader->workerPool.start([loader, download]() {
+            loader->usbComm->applyWorkerThreadSchedConfig();
+            loader->finishDevice(download);
+        });
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: 다음 chunk 를 transfer 에 채워서 submit 한다 (mutex 를 잡고 호출)
+ *@param:
+ *@return:  true=OK  false=NG (download 를 멈춘다)
+ */
+/********************************************************************************/
+bool UsbFirmwareLoader::submitNext(Download *download, libusb_transfer *transfer)
+{
+    qint64 offset = download->nextOffset;
+    int length = (int)qMin<qint64>(config.transferSize, mappedSize - offset);
+
+    /* OUT 전송이므로 map 된 영역(read only)을 그대로 buffer 로 사용한다 */
+    libusb_fill_bulk_transfer(transfer, download->deviceHandle, config.outEndpoint, (unsigned char *)(mapped + offset),
+                              length, transferCallback, download, config.timeout);
+    transfer->flags = 0;
+    if (download->sendZeroLengthPacket && offset + length == mappedSize)
+        transfer->flags |= LIBUSB_TRANSFER_ADD_ZERO_PACKET;
+
+    download->submitNs[download->transfers.indexOf(transfer)] = download->timer.nsecsElapsed();
+    int err = libusb_submit_transfer(transfer);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "libusb_submit_transfer error:" << libusb_error_name(err);
+        if (download->error.isEmpty())
+            download->error = QString("submit: %1").arg(libusb_error_name(err));
+        download->stopping = true;
+        cancelInFlight(download);
+        return false;
+    }
+
+    download->nextOffset += length;
+    download->inFlight++;
+    download->inFlightTransfers.append(transfer);
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 진행중인 전송을 모두 취소한다 (mutex 를 잡고 호출, 완료 처리는 각 callback 에서 한다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFirmwareLoader::cancelInFlight(Download *download)
+{
+    for (int i = 0; i < download->inFlightTransfers.size(); i++)
+        libusb_cancel_transfer(download->inFlightTransfers.at(i));
+}
+
+/********************************************************************************/
+/*
+ *@brief: prepare hook 실행 후 전송을 transferCount 개 submit 한다 (worker thread)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFirmwareLoader::beginDevice(Download *download)
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (cancelled) {
+            locker.unlock();
+            completeDevice(download, false, "cancelled");
+            return;
+        }
+        download->state = UsbFirmwareProgress::Preparing;
+    }
+
+    if (config.prepare && !config.prepare(usbComm, download->deviceHandle, mappedSize)) {
+        completeDevice(download, false, "prepare");
+        return;
+    }
+    if (download->transfers.isEmpty()) {
+        completeDevice(download, false, "libusb_alloc_transfer");
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+    download->state = UsbFirmwareProgress::Downloading;
+    download->timer.start();
+    for (int i = 0; i < download->transfers.size() && download->nextOffset < mappedSize; i++) {
+        if (!submitNext(download, download->transfers.at(i)))
+            break;
+    }
+
+    /* 1개도 submit 하지 못했으면 callback 이 오지 않는다 */
+    if (download->inFlight == 0) {
+        QString error = download->error;
+        locker.unlock();
+        completeDevice(download, false, error);
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: download 가 끝난 device 의 검증과 완료 처리 (worker thread)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFirmwareLoader::finishDevice(Download *download)
+{
+    QString error;
+    {
+        QMutexLocker locker(&mutex);
+        error = download->error;
+    }
+    if (!error.isEmpty()) {
+        completeDevice(download, false, error);
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool ok = true;
+    if (config.verify != UsbFirmwareConfig::None) {
+        if (config.requestVerify && !config.requestVerify(usbComm, download->deviceHandle)) {
+            ok = false;
+            error = "request verify";
+        } else if (config.verify == UsbFirmwareConfig::ReadBack) {
+            ok = verifyReadBack(download, &error);
+        } else {
+            ok = verifyDeviceCrc(download, &error);
+        }
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        download->verifySec = timer.nsecsElapsed() / 1e9;
+    }
+    completeDevice(download, ok, error);
+}
+
+/********************************************************************************/
+/*
+ *@brief: IN endpoint 로 image 크기만큼 읽어서 비교 (block 단위로 읽어서 memory 사용량을 제한한다)
+ *@param:
+ *@return:  true=일치  false=불일치 또는 읽기 실패 (error 에 내용)
+ */
+/********************************************************************************/
+bool UsbFirmwareLoader::verifyReadBack(Download *download, QString *error)
+{
+    qint64 blockSize = qMin<qint64>(kMaxReadBackBlock, (qint64)config.transferSize * config.transferCount);
+    QByteArray buffer((int)qMin(blockSize, mappedSize), 0);
+
+    for (qint64 offset = 0; offset < mappedSize; offset += buffer.size()) {
+        {
+            QMutexLocker locker(&mutex);
+            if (cancelled) {
+                *error = "cancelled";
+                return false;
+            }
+        }
+
+        qint64 length = qMin<qint64>(buffer.size(), mappedSize - offset);
+        qint64 received = usbComm->bulkTransferLarge(download->deviceHandle, config.inEndpoint, (quint8 *)buffer.data(),
+                                                     length, config.timeout);
+        if (received != length) {
+            *error = received < 0 ? QString("read back: %1").arg(libusb_error_name((int)received))
+                                  : QString("read back: short read at %1").arg(offset + qMax<qint64>(received, 0));
+            return false;
+        }
+        if (memcmp(buffer.constData(), mapped + offset, length) != 0) {
+            *error = QString("read back: mismatch in block at %1").arg(offset);
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: IN endpoint 로 device 가 계산한 CRC-32 (4 bytes, little endian) 를 읽어서 비교
+ *@param:
+ *@return:  true=일치  false=불일치 또는 읽기 실패 (error 에 내용)
+ */
+/********************************************************************************/
+bool UsbFirmwareLoader::verifyDeviceCrc(Download *download, QString *error)
+{
+    quint8 value[4];
+    int length = usbComm->bulkTransfer(download->deviceHandle, config.inEndpoint, value, sizeof(value), config.timeout);
+    if (length != (int)sizeof(value)) {
+        *error = length < 0 ? QString("crc: %1").arg(libusb_error_name(length)) : QString("crc: short read");
+        return false;
+    }
+
+    quint32 deviceCrc = qFromLittleEndian<quint32>(value);
+    if (deviceCrc != crc) {
+        *error = QString("crc mismatch (device %1, image %2)").arg(deviceCrc, 8, 16, QChar('0')).arg(crc, 8, 16, QChar('0'));
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: device 1개 종료 (모두 끝났으면 대기중인 waitForFinished() 를 깨운다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFirmwareLoader::completeDevice(Download *download, bool ok, const QString &error)
+{
+    {
+        QMutexLocker locker(&mutex);
+        download->state = ok ? UsbFirmwareProgress::Done : UsbFirmwareProgress::Failed;
+        if (!ok && download->error.isEmpty())
+            download->error = error;
+    }
+
+    emit sigDeviceFinished(download->index, ok, error);
+
+    int total, okCount;
+    bool last;
+    {
+        QMutexLocker locker(&mutex);
+        if (ok)
+            succeeded++;
+        remaining--;
+        last = remaining == 0;
+        total = downloads.size();
+        okCount = succeeded;
+        if (last)
+            finishedCondition.wakeAll();
+    }
+
+    if (last)
+        emit sigFinished(okCount, total - okCount);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 전송과 device 별 상태 해제 (진행중이 아닐 때 호출)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFirmwareLoader::freeDownloads()
+{
+    QMutexLocker locker(&mutex);
+    for (int i = 0; i < downloads.size(); i++) {
+        for (int j = 0; j < downloads.at(i)->transfers.size(); j++)
+            libusb_free_transfer(downloads.at(i)->transfers.at(j));
+        delete downloads.at(i);
+    }
+    downloads.clear();
+}
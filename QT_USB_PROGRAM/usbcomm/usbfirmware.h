@@ -0,0 +1,186 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * 여러 device 에 firmware 를 동시에 download 하는 파트
+ *
+ * image 파일은 1번만 memory map 하고, 모든 device 의 전송 buffer 로 map 된 영역을 그대로 사용한다 (복사 없음).
+ * device 마다 transferCount 개의 전송을 in flight 로 유지하며 (완료 callback 에서 다음 chunk 를 submit),
+ * 모든 device 가 동시에 진행되므로 전체 시간은 가장 느린 device 1개의 시간에 가깝다.
+ *
+ * 진행 순서 (device 별):
+ * 	1. prepare		: 사용자 hook (bootloader 진입 명령 등, worker thread)
+ * 	2. download		: OUT endpoint 로 image 전송 (UsbComm event thread 의 callback 으로 진행)
+ * 	3. verify		: worker thread 에서
+ * 					  ReadBack  - IN endpoint 로 image 크기만큼 읽어서 비교
+ * 					  DeviceCrc - IN endpoint 로 4 bytes (CRC-32, little endian) 를 읽어서 host 계산값과 비교
+ * 					  (읽기 전에 requestVerify hook 으로 device 에 요청을 보낼 수 있다)
+ *
+ * NOTE:
+ * 1. 각 device 의 interface 는 미리 선언해둔다.
+ * 2. image 파일은 download 가 끝날 때까지 변경하지 않는다 (map 된 영역을 전송 buffer 로 사용한다).
+ */
+#ifndef USBFIRMWARE_H
+#define USBFIRMWARE_H
+
+#include <QObject>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QVector>
+#include <functional>
+#include <usbcomm.h>
+
+/********************************************************************************/
+/* download 설정 */
+/********************************************************************************/
+struct UsbFirmwareConfig
+{
+    enum Verify {
+        None,
+        ReadBack,
+        DeviceCrc
+    };
+
+    quint8 outEndpoint = 0x01;
+    /* ReadBack/DeviceCrc 의 응답 endpoint */
+    quint8 inEndpoint = 0x81;
+    /* USB 전송 1개의 크기 / device 별 동시 전송 수 */
+    int transferSize = 64 * 1024;
+    int transferCount = 4;
+    /* 전송 timeout (ms, 0 = 무한) */
+    quint32 timeout = 5000;
+    /* image 가 max packet 의 배수로 끝나면 ZLP 로 끝을 알린다 */
+    bool sendZeroLengthPacket = true;
+    Verify verify = DeviceCrc;
+
+    /* download 전 / verify 읽기 전 hook (worker thread 에서 실행, false 면 그 device 는 실패) */
+    std::function<bool(UsbComm *, libusb_device_handle *, qint64 imageSize)> prepare;
+    std::function<bool(UsbComm *, libusb_device_handle *)> requestVerify;
+};
+
+/********************************************************************************/
+/* device 별 진행 상태 */
+/********************************************************************************/
+struct UsbFirmwareProgress
+{
+    enum State {
+        Pending,
+        Preparing,
+        Downloading,
+        Verifying,
+        Done,
+        Failed
+    };
+
+    libusb_device_handle *deviceHandle = NULL;
+    State state = Pending;
+    qint64 bytesSent = 0;
+    qint64 bytesTotal = 0;
+    double downloadSec = 0;			/* download 경과 시간 (진행중이면 지금까지) */
+    double verifySec = 0;
+    QString error;
+
+    double percent() const {return bytesTotal > 0 ? bytesSent * 100.0 / bytesTotal : 0;}
+    double downloadMBps() const {return downloadSec > 0 ? bytesSent / 1e6 / downloadSec : 0;}
+};
+
+/********************************************************************************/
+/* firmware download Class */
+/********************************************************************************/
+class UsbFirmwareLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UsbFirmwareLoader(UsbComm *usbComm, QObject *parent = 0);
+    ~UsbFirmwareLoader();
+
+    /* image 파일 memory map 과 CRC-32 계산 (download 중에는 호출할 수 없다) */
+    bool loadImage(const QString &path);
+    qint64 imageSize() const {return mappedSize;}
+    quint32 imageCrc() const {return crc;}
+
+    /* download 시작 (deviceHandle 은 UsbComm::getDeviceHandleFrom_xxx 로 취득) */
+    bool start(const QList<libusb_device_handle *> &devices, const UsbFirmwareConfig &config = UsbFirmwareConfig());
+    /* 중단 (진행중인 전송 취소, 남은 device 는 실패로 끝난다) */
+    void cancel();
+    /* 모든 device 가 끝날 때까지 대기 (timeoutMs < 0 이면 무한), 끝났으면 true */
+    bool waitForFinished(int timeoutMs = -1);
+
+    bool isRunning() const;
+
+    /* device 별 진행 상태 (어느 thread 에서든 호출 가능) */
+    QList<UsbFirmwareProgress> progress() const;
+
+    /* CRC-32 (IEEE 802.3, DeviceCrc 검증과 같은 계산) */
+    static quint32 crc32(const quint8 *data, qint64 length, quint32 crc = 0);
+
+signals:
+    /* device 1개가 끝났을 때 / 모든 device 가 끝났을 때 (worker thread 에서 발생) */
+    void sigDeviceFinished(int index, bool ok, QString error);
+    void sigFinished(int succeeded, int failed);
+
+private:
+    /* device 1개의 download 상태 (mutex 로 보호) */
+    struct Download
+    {
+        UsbFirmwareLoader *loader;
+        int index;
+        libusb_device_handle *deviceHandle;
+        QVector<libusb_transfer *> transfers;
+        QVector<qint64> submitNs;					/* transfers 와 같은 순서, 각 전송의 submit 시각 (timer 기준, 지연 계산용) */
+        QList<libusb_transfer *> inFlightTransfers;	/* submit 해서 아직 callback 이 오지 않은 전송 (취소 대상) */
+        qint64 nextOffset;
+        qint64 bytesSent;
+        int inFlight;
+        bool stopping;
+        bool sendZeroLengthPacket;
+        UsbFirmwareProgress::State state;
+        QString error;
+        QElapsedTimer timer;
+        QSharedPointer<UsbTrafficCounters> traffic;	/* OUT endpoint 의 전송 counter (dashboard 용) */
+        double downloadSec;
+        double verifySec;
+    };
+
+    /* USB 전송 완료 callback (UsbComm event thread 에서 실행) */
+    static void LIBUSB_CALL transferCallback(libusb_transfer *transfer);
+    /* 다음 chunk 를 transfer 에 채워서 submit 한다 (mutex 를 잡고 호출) */
+    bool submitNext(Download *download, libusb_transfer *transfer);
+    /* 진행중인 전송을 모두 취소한다 (mutex 를 잡고 호출) */
+    static void cancelInFlight(Download *download);
+    /* prepare + 최초 submit (worker thread) */
+    void beginDevice(Download *download);
+    /* verify + 완료 처리 (worker thread) */
+    void finishDevice(Download *download);
+    bool verifyReadBack(Download *download, QString *error);
+    bool verifyDeviceCrc(Download *download, QString *error);
+    /* device 1개 종료 (mutex 를 잡지 않고 호출) */
+    void completeDevice(Download *download, bool ok, const QString &error);
+
+    void freeDownloads();
+
+    UsbComm *usbComm;
+    UsbFirmwareConfig config;
+
+    /* memory map 된 image */
+    QFile file;
+    const quint8 *mapped;
+    qint64 mappedSize;
+    quint32 crc;
+
+    /* device 별 상태, 남은 device 수 (mutex 로 보호) */
+    QVector<Download *> downloads;
+    int remaining;
+    int succeeded;
+    bool cancelled;
+    mutable QMutex mutex;
+    QWaitCondition finishedCondition;
+
+    /* prepare/verify 를 실행하는 worker (device 수 만큼) */
+    QThreadPool workerPool;
+};
+
+#endif // USBFIRMWARE_H
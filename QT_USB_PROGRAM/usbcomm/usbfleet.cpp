@@ -0,0 +1,618 @@
+/********************************************************************************/
+/* 여러 device 의 lifecycle 관리 (fleet manager) Part */
+/********************************************************************************/
+#include "usbfleet.h"
+#include <QDebug>
+#include <algorithm>
+#include <climits>
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:   usbComm: device 를 open 할 UsbComm
+ *@return:
+ */
+/********************************************************************************/
+UsbFleetManager::UsbFleetManager(UsbComm *usbComm, QObject *parent) : QObject(parent)
+{
+    this->usbComm = usbComm;
+    monitor = NULL;
+    clock.start();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자 (open 한 device 는 UsbComm 이 닫는다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbFleetManager::~UsbFleetManager()
+{
+    stop();
+    qDeleteAll(devices);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 관리할 device 의 VID:PID
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::setDeviceIds(const QMultiMap<quint16, quint16> &vpidMap)
+{
+    matcher = UsbDeviceMatcher();
+    matcher.addIds(vpidMap);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 설정 (start() 전에 호출)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::setConfig(const UsbFleetConfig &config)
+{
+    this->config = config;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 관리 시작
+ *
+ * NOTE: hotplug 감시를 먼저 시작하고 나서 현재 접속된 device 를 탐색한다 (그 사이에 접속된 device 를 놓치지 않도록).
+ * 	양쪽에서 같은 device 가 통지되어도 이미 Discovered 이후의 상태면 무시된다.
+ *
+ *@param:
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbFleetManager::start()
+{
+    if (matcher.isEmpty()) {
+        qDebug() << "UsbFleetManager: no device ids";
+        return false;
+    }
+
+    workerPool.setMaxThreadCount(qMax(1, config.workerCount));
+
+    if (monitor == NULL) {
+        monitor = new UsbMonitor(this);
+        /* hotplug event thread 에서 바로 queue 에 넣는다 (GUI thread 를 거치지 않는다) */
+        connect(monitor, &UsbMonitor::deviceHotplugDetailSig, this,
+                [this](bool isAttached, QString portPath, quint16 vid, quint16 pid) {
+                    onHotplug(isAttached, portPath, vid, pid);
+                }, Qt::DirectConnection);
+    }
+    if (!monitor->registerHotplugMonitorService())
+        qDebug() << "UsbFleetManager: hotplug is not available, only devices present now are managed";
+
+    const QList<UsbDeviceIdentity> present = usbComm->enumerateDevices(matcher);
+    for (int i = 0; i < present.size(); i++)
+        onHotplug(true, present.at(i).portPath, present.at(i).vid, present.at(i).pid);
+
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: hotplug 감시를 멈추고 처리중인 event 가 끝날 때까지 기다린다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::stop()
+{
+    if (monitor != NULL)
+        monitor->deregisterHotplugMonitorService();
+    workerPool.waitForDone();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 전송 결과 보고
+ *
+ * NOTE: 성공은 연속 에러 수만 0 으로 하고 event 를 만들지 않는다.
+ * 	timeout 은 IN endpoint 에 data 가 없을 때도 발생하므로 에러로 세지 않는다.
+ *
+ *@param:   deviceHandle: 전송한 device
+ *@param:   error: 전송 결과 (0 이상이면 성공, 음수면 libusb error code)
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::reportTransferResult(libusb_device_handle *deviceHandle, int error)
+{
+    Device *device = NULL;
+    {
+        QMutexLocker locker(&mutex);
+        Device *found = handleDevices.value(deviceHandle, NULL);
+        if (found == NULL)
+            return;
+
+        if (error >= 0 || error == LIBUSB_ERROR_TIMEOUT) {
+            found->consecutiveErrors = 0;
+            return;
+        }
+
+        if (countTransferResults(found, 0, 1))
+            device = found;
+    }
+
+    if (device != NULL) {
+        Event event = {TransferFailed, deviceHandle, QString("transfer: %1").arg(libusb_error_name(error))};
+        postEvent(device, event);
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: 연속 전송 시작/종료 보고
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::reportStreaming(libusb_device_handle *deviceHandle, bool streaming)
+{
+    Device *device;
+    {
+        QMutexLocker locker(&mutex);
+        device = handleDevices.value(deviceHandle, NULL);
+    }
+    if (device == NULL)
+        return;
+
+    Event event = {streaming ? StreamStarted : StreamStopped, deviceHandle, QString()};
+    postEvent(device, event);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 주기 처리
+ *
+ * 1. backoff 가 끝난 device 의 Retry
+ * 2. 전송 counter 반영 (trafficFromCounters)
+ * 	이전 poll() 이후 성공이 있으면 연속 에러 수를 0 으로 하고 Streaming, 전송이 없으면 Configured 로 돌린다.
+ * 	에러 (timeout 제외) 는 reportTransferResult() 와 같이 세고, errorThreshold 에 도달하면 Error.
+ *
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::poll()
+{
+    QHash<libusb_device_handle *, QPair<quint64, quint64> > totals;		/* <전송 수, 에러 수> */
+    if (config.trafficFromCounters) {
+        const QList<UsbTrafficEndpoint> endpoints = usbComm->getTrafficSnapshots();
+        for (int i = 0; i < endpoints.size(); i++) {
+            QPair<quint64, quint64> &total = totals[endpoints.at(i).deviceHandle];
+            total.first += endpoints.at(i).snapshot.transfers;
+            total.second += endpoints.at(i).snapshot.errors;
+        }
+    }
+
+    QList<QPair<Device *, Event> > events;
+    {
+        QMutexLocker locker(&mutex);
+        qint64 now = clock.nsecsElapsed();
+
+        for (QHash<QString, Device *>::iterator it = devices.begin(); it != devices.end(); ++it) {
+            Device *device = it.value();
+            if (device->retryAtNs >= 0 && now >= device->retryAtNs) {
+                device->retryAtNs = -1;
+                events.append(qMakePair(device, Event{Retry, NULL, QString()}));
+            }
+        }
+
+        for (QHash<libusb_device_handle *, Device *>::iterator it = handleDevices.begin();
+             config.trafficFromCounters && it != handleDevices.end(); ++it) {
+            Device *device = it.value();
+            QPair<quint64, quint64> total = totals.value(it.key());
+            /* counter 는 handle 을 닫으면 없어지므로 줄어든 경우는 처음부터 센다 */
+            quint64 successes = total.first >= device->lastTransfers ? total.first - device->lastTransfers : total.first;
+            quint64 errors = total.second >= device->lastErrors ? total.second - device->lastErrors : total.second;
+            device->lastTransfers = total.first;
+            device->lastErrors = total.second;
+
+            if (countTransferResults(device, successes, errors)) {
+                events.append(qMakePair(device, Event{TransferFailed, it.key(),
+                                                      QString("transfer: %1 errors").arg(device->consecutiveErrors)}));
+            } else if (successes > 0 && device->info.state == UsbFleetDevice::Configured) {
+                events.append(qMakePair(device, Event{StreamStarted, it.key(), QString()}));
+            } else if (successes == 0 && device->info.state == UsbFleetDevice::Streaming) {
+                events.append(qMakePair(device, Event{StreamStopped, it.key(), QString()}));
+            }
+        }
+    }
+
+    for (int i = 0; i < events.size(); i++)
+        postEvent(events.at(i).first, events.at(i).second);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 모든 device 의 현재 상태
+ *@param:
+ *@return:  port path 순
+ */
+/********************************************************************************/
+QList<UsbFleetDevice> UsbFleetManager::snapshot() const
+{
+    QList<UsbFleetDevice> list;
+
+    QMutexLocker locker(&mutex);
+    QStringList portPaths = devices.keys();
+    std::sort(portPaths.begin(), portPaths.end());
+    for (int i = 0; i < portPaths.size(); i++) {
+        const Device *device = devices.value(portPaths.at(i));
+        UsbFleetDevice info = device->info;
+        info.stateSec = device->stateTimer.nsecsElapsed() / 1e9;
+        list.append(info);
+    }
+    return list;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 상태별 device 수
+ *@param:
+ *@return:  index = UsbFleetDevice::State
+ */
+/********************************************************************************/
+QVector<int> UsbFleetManager::stateCounts() const
+{
+    QVector<int> counts(UsbFleetDevice::Detached + 1, 0);
+
+    QMutexLocker locker(&mutex);
+    for (QHash<QString, Device *>::const_iterator it = devices.constBegin(); it != devices.constEnd(); ++it)
+        counts[it.value()->info.state]++;
+    return counts;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 상태 이름 (log 용)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+const char *UsbFleetManager::stateName(int state)
+{
+    static const char *names[] = {"discovered", "opened", "configured", "streaming", "error", "detached"};
+    if (state < 0 || state > UsbFleetDevice::Detached)
+        return "unknown";
+    return names[state];
+}
+
+/********************************************************************************/
+/*
+ *@brief: hotplug 통지 (hotplug event thread 에서 실행, queue 에 넣기만 한다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::onHotplug(bool isAttached, const QString &portPath, quint16 vid, quint16 pid)
+{
+    if (!matcher.matchesId(vid, pid))
+        return;
+
+    Event event = {isAttached ? Attached : Removed, NULL, QString()};
+    postEvent(portPath, vid, pid, event);
+}
+
+/********************************************************************************/
+/*
+ *@brief: port path 의 device 에 event 추가 (처음 보는 device 는 Detached 로 만들어서 Attached 로 Discovered 가 된다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::postEvent(const QString &portPath, quint16 vid, quint16 pid, const Event &event)
+{
+    QMutexLocker locker(&mutex);
+
+    Device *device = devices.value(portPath, NULL);
+    if (device == NULL) {
+        if (event.type != Attached)
+            return;
+        device = new Device;
+        device->info.portPath = portPath;
+        device->info.state = UsbFleetDevice::Detached;
+        device->scheduled = false;
+        device->consecutiveErrors = 0;
+        device->stateTimer.start();
+        device->retryAtNs = -1;
+        device->lastTransfers = 0;
+        device->lastErrors = 0;
+        devices.insert(portPath, device);
+    }
+
+    /* 같은 port 에 다른 device 가 꽂힐 수 있다, 복구 시도 횟수는 접속마다 */
+    if (event.type == Attached && device->info.state == UsbFleetDevice::Detached) {
+        device->info.vid = vid;
+        device->info.pid = pid;
+        device->info.recoveryAttempts = 0;
+        device->retryAtNs = -1;
+    }
+
+    device->events.enqueue(event);
+    if (!device->scheduled) {
+        device->scheduled = true;
+        workerPool.start([this, device]() {
+            usbComm->applyWorkerThreadSchedConfig();
+            drainEvents(device);
+        });
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: device 에 event 추가 (mutex 를 잡지 않고 호출)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::postEvent(Device *device, const Event &event)
+{
+    QMutexLocker locker(&mutex);
+    device->events.enqueue(event);
+    if (!device->scheduled) {
+        device->scheduled = true;
+        workerPool.start([this, device]() {
+            usbComm->applyWorkerThreadSchedConfig();
+            drainEvents(device);
+        });
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: device 의 event 를 순서대로 처리 (worker thread, 같은 device 는 동시에 1개의 worker 만 처리한다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::drainEvents(Device *device)
+{
+    forever {
+        UsbFleetDevice::State from, to;
+        libusb_device_handle *staleHandle = NULL;
+        {
+            QMutexLocker locker(&mutex);
+            if (device->events.isEmpty()) {
+                device->scheduled = false;
+                return;
+            }
+
+            Event event = device->events.dequeue();
+            from = device->info.state;
+            to = nextState(from, event.type);
+
+            if (!event.error.isEmpty())
+                device->info.lastError = event.error;
+
+            /* open 한 handle 은 Opened 로 전이할 때만 받는다 (그 사이에 분리됐으면 닫는다) */
+            if (event.type == OpenOk) {
+                if (to == UsbFleetDevice::Opened) {
+                    device->info.deviceHandle = event.deviceHandle;
+                    device->lastTransfers = 0;
+                    device->lastErrors = 0;
+                    handleDevices.insert(event.deviceHandle, device);
+                } else {
+                    staleHandle = event.deviceHandle;
+                }
+            }
+
+            if (to != from) {
+                device->info.state = to;
+                device->info.transitions++;
+                device->stateTimer.restart();
+                if (to == UsbFleetDevice::Configured)
+                    device->consecutiveErrors = 0;
+            }
+        }
+
+        if (staleHandle != NULL)
+            usbComm->closeUsbDevice(staleHandle);
+
+        if (to == from)
+            continue;
+
+        emit sigStateChanged(device->info.portPath, from, to);
+        enterState(device, to);
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: 상태 전이표
+ *@param:   from: 현재 상태
+ *@param:   event: event
+ *@return:  다음 상태 (전이하지 않으면 from)
+ */
+/********************************************************************************/
+UsbFleetDevice::State UsbFleetManager::nextState(UsbFleetDevice::State from, EventType event)
+{
+    switch (event) {
+    case Attached:
+        return from == UsbFleetDevice::Detached ? UsbFleetDevice::Discovered : from;
+    case Removed:
+        return UsbFleetDevice::Detached;
+    case OpenOk:
+        return from == UsbFleetDevice::Discovered ? UsbFleetDevice::Opened : from;
+    case ConfigureOk:
+        return (from == UsbFleetDevice::Opened || from == UsbFleetDevice::Error) ? UsbFleetDevice::Configured : from;
+    case BringUpFailed:
+        return (from == UsbFleetDevice::Discovered || from == UsbFleetDevice::Opened) ? UsbFleetDevice::Error : from;
+    case StreamStarted:
+        return from == UsbFleetDevice::Configured ? UsbFleetDevice::Streaming : from;
+    case StreamStopped:
+        return from == UsbFleetDevice::Streaming ? UsbFleetDevice::Configured : from;
+    case TransferFailed:
+        return (from == UsbFleetDevice::Configured || from == UsbFleetDevice::Streaming) ? UsbFleetDevice::Error : from;
+    case Retry:
+        return from == UsbFleetDevice::Error ? UsbFleetDevice::Discovered : from;
+    }
+    return from;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 상태 진입 동작 (worker thread)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::enterState(Device *device, UsbFleetDevice::State state)
+{
+    switch (state) {
+    case UsbFleetDevice::Discovered:
+        if (config.autoBringUp)
+            bringUp(device);
+        break;
+    case UsbFleetDevice::Error:
+        if (config.autoRecover)
+            recover(device);
+        break;
+    case UsbFleetDevice::Detached: {
+        /* 분리된 device 의 handle 은 닫는다 */
+        libusb_device_handle *deviceHandle;
+        {
+            QMutexLocker locker(&mutex);
+            deviceHandle = device->info.deviceHandle;
+            device->info.deviceHandle = NULL;
+            device->consecutiveErrors = 0;
+            device->retryAtNs = -1;
+            handleDevices.remove(deviceHandle);
+        }
+        if (deviceHandle != NULL)
+            usbComm->closeUsbDevice(deviceHandle);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: device 1개 bring-up (open + configuration + claim, UsbComm::bringUpDevices 사용)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::bringUp(Device *device)
+{
+    UsbDeviceMatcher deviceMatcher;
+    {
+        QMutexLocker locker(&mutex);
+        deviceMatcher.addId(device->info.vid, device->info.pid);
+        deviceMatcher.setPortPath(device->info.portPath);
+    }
+
+    UsbBringUpConfig bringUpConfig = config.bringUp;
+    bringUpConfig.maxParallel = 1;
+    const QList<UsbBringUpResult> results = usbComm->bringUpDevices(deviceMatcher, bringUpConfig);
+
+    if (results.size() == 1 && results.first().ok) {
+        Event opened = {OpenOk, results.first().deviceHandle, QString()};
+        Event configured = {ConfigureOk, results.first().deviceHandle, QString()};
+        postEvent(device, opened);
+        postEvent(device, configured);
+    } else {
+        Event failed = {BringUpFailed, NULL, results.isEmpty() ? QString("bring-up: not found or already opened")
+                                                               : "bring-up: " + results.first().error};
+        postEvent(device, failed);
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: Error 상태의 복구 시도 (handle 이 있으면 reset 후 interface 재선언, 없거나 실패하면 backoff 후 bring-up 재시도)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::recover(Device *device)
+{
+    libusb_device_handle *deviceHandle;
+    {
+        QMutexLocker locker(&mutex);
+        if (device->info.recoveryAttempts >= config.maxRecoveryAttempts) {
+            /* 더 이상 시도하지 않는다 (다시 접속되면 횟수는 초기화된다) */
+            device->info.lastError = QString("recover: gave up after %1 attempts").arg(device->info.recoveryAttempts);
+            return;
+        }
+        device->info.recoveryAttempts++;
+        deviceHandle = device->info.deviceHandle;
+    }
+
+    if (deviceHandle == NULL) {
+        retryLater(device, QString());
+        return;
+    }
+
+    if (!usbComm->resetUsbDevice(deviceHandle)) {
+        /* reset 중에 device 가 없어졌으면 UsbComm 이 handle 을 닫았다. 남아있어도 bring-up 부터 다시 한다 */
+        retryLater(device, usbComm->isUsbDeviceOpened(deviceHandle) ? "recover: reset failed" : "reset: device lost");
+        return;
+    }
+
+    for (int i = 0; i < config.bringUp.interfaces.size(); i++) {
+        if (!usbComm->claimUsbInterface(deviceHandle, config.bringUp.interfaces.at(i))) {
+            retryLater(device, QString("recover: claim interface %1").arg(config.bringUp.interfaces.at(i)));
+            return;
+        }
+    }
+
+    Event configured = {ConfigureOk, deviceHandle, QString()};
+    postEvent(device, configured);
+}
+
+/********************************************************************************/
+/*
+ *@brief: handle 을 닫고 backoff 후 Retry (bring-up 부터 다시) 를 예약한다 (worker thread)
+ *
+ * NOTE: Retry 는 poll() 이 backoff 가 끝난 후에 넣는다. Error 에서 다른 event 로는 빠져나가지 않으므로
+ * 	예약하지 않고 return 하면 device 는 Error 에 계속 남는다.
+ *
+ *@param:   error: lastError (비어있으면 그대로)
+ *@return:
+ */
+/********************************************************************************/
+void UsbFleetManager::retryLater(Device *device, const QString &error)
+{
+    libusb_device_handle *deviceHandle;
+    {
+        QMutexLocker locker(&mutex);
+        deviceHandle = device->info.deviceHandle;
+        device->info.deviceHandle = NULL;
+        handleDevices.remove(deviceHandle);
+        if (!error.isEmpty())
+            device->info.lastError = error;
+
+        qint64 backoffMs = qMin<qint64>((qint64)config.recoveryBackoffMs << qMin(device->info.recoveryAttempts - 1, 20),
+                                        config.maxRecoveryBackoffMs);
+        device->retryAtNs = clock.nsecsElapsed() + qMax<qint64>(0, backoffMs) * 1000000;
+    }
+
+    if (deviceHandle != NULL && usbComm->isUsbDeviceOpened(deviceHandle))
+        usbComm->closeUsbDevice(deviceHandle);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 성공/에러 수 반영 (mutex 를 잡고 호출)
+ *@param:   successes: 성공한 전송 수 (1개라도 있으면 연속 에러 수를 0 으로 한 후에 에러를 센다)
+ *@param:   errors: 에러로 끝난 전송 수 (timeout 제외)
+ *@return:  이번에 연속 에러 수가 errorThreshold 에 도달했으면 true
+ */
+/********************************************************************************/
+bool UsbFleetManager::countTransferResults(Device *device, quint64 successes, quint64 errors)
+{
+    int before = successes > 0 ? 0 : device->consecutiveErrors;
+    device->info.transferErrors += errors;
+    device->consecutiveErrors = (int)qMin<quint64>(before + errors, INT_MAX);
+    return before < config.errorThreshold && device->consecutiveErrors >= config.errorThreshold;
+}
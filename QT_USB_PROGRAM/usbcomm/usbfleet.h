@@ -0,0 +1,192 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * 여러 device 의 lifecycle 관리 (fleet manager)
+ *
+ * device 마다 상태 머신을 두고, hotplug 와 전송 결과를 event 로 받아서 상태를 바꾼다.
+ *
+ * 상태:
+ * 	Discovered	: 접속을 감지했다 (아직 open 하지 않음)
+ * 	Opened		: open 했다
+ * 	Configured	: configuration/interface 선언까지 끝났다 (전송 가능)
+ * 	Streaming	: 연속 전송중 (reportStreaming(true))
+ * 	Error		: bring-up 실패 또는 연속 전송 에러 (autoRecover 면 reset 으로 복구를 시도한다)
+ * 	Detached	: 분리됐다 (handle 은 닫는다, 다시 접속되면 Discovered)
+ *
+ * 전송 결과:
+ * 	poll() 을 주기적으로 호출하면 UsbComm 의 전송 counter (getTrafficSnapshots) 를 읽어서
+ * 	성공/에러 수를 reportTransferResult() 와 같이 반영하고, 전송이 있으면 Streaming, 없어지면 Configured 로 한다.
+ * 	(전송 경로에 fleet 을 넘기지 않아도 된다. 직접 reportTransferResult()/reportStreaming() 을 호출해도 된다)
+ * 	복구 재시도의 backoff 도 poll() 에서 처리한다.
+ *
+ * 처리 구조:
+ * 	hotplug thread / 전송 thread -> postEvent() 로 device 별 event queue 에 넣기만 한다
+ * 	worker pool -> device 별 queue 를 순서대로 처리 (같은 device 의 event 는 순서대로, 다른 device 는 병렬로)
+ * 				  상태 변화 시 sigStateChanged (worker thread 에서 발생), 진입 동작(open/reset/close)도 worker 에서 실행
+ *
+ * GUI 는 sigStateChanged 를 queued 로 받거나, timer 로 snapshot()/stateCounts() 를 읽는다.
+ * device 별 처리는 모두 worker 에서 하므로 device 수가 늘어도 GUI thread 의 부하는 늘지 않는다.
+ */
+#ifndef USBFLEET_H
+#define USBFLEET_H
+
+#include <QObject>
+#include <QMutex>
+#include <QHash>
+#include <QQueue>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <usbcomm.h>
+
+/********************************************************************************/
+/* fleet 설정 */
+/********************************************************************************/
+struct UsbFleetConfig
+{
+    /* Discovered 가 되면 자동으로 open + configuration + claim 한다 (UsbComm::bringUpDevices 와 같은 설정) */
+    bool autoBringUp = true;
+    UsbBringUpConfig bringUp;
+    /* Error 가 되면 reset(handle 이 없으면 bring-up 재시도)으로 복구를 시도한다 */
+    bool autoRecover = true;
+    int maxRecoveryAttempts = 3;
+    /* 복구 실패 후 bring-up 재시도까지의 대기 (시도마다 2배, poll() 에서 처리) */
+    int recoveryBackoffMs = 500;
+    int maxRecoveryBackoffMs = 10000;
+    /* poll() 에서 전송 counter 를 읽어서 전송 결과/Streaming 상태를 반영한다 */
+    bool trafficFromCounters = true;
+    /* 이 횟수만큼 연속으로 전송이 실패하면 Error */
+    int errorThreshold = 3;
+    /* 상태 머신을 처리하는 worker 수 */
+    int workerCount = 8;
+};
+
+/********************************************************************************/
+/* device 1개의 상태 (snapshot) */
+/********************************************************************************/
+struct UsbFleetDevice
+{
+    enum State {
+        Discovered,
+        Opened,
+        Configured,
+        Streaming,
+        Error,
+        Detached
+    };
+
+    QString portPath;
+    quint16 vid = 0;
+    quint16 pid = 0;
+    State state = Discovered;
+    libusb_device_handle *deviceHandle = NULL;	/* Opened ~ Error 에서 유효 */
+    QString lastError;
+    quint64 transferErrors = 0;					/* 누적 전송 에러 */
+    quint64 transitions = 0;					/* 상태 변화 횟수 */
+    int recoveryAttempts = 0;
+    double stateSec = 0;						/* 현재 상태가 된 후의 경과 시간 */
+};
+
+/********************************************************************************/
+/* fleet manager Class */
+/********************************************************************************/
+class UsbFleetManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UsbFleetManager(UsbComm *usbComm, QObject *parent = 0);
+    ~UsbFleetManager();
+
+    /* 관리할 device 의 VID:PID (start() 전에 설정) */
+    void setDeviceIds(const QMultiMap<quint16, quint16> &vpidMap);
+    void setConfig(const UsbFleetConfig &config);
+
+    /* 현재 접속된 device 를 Discovered 로 등록하고 hotplug 감시를 시작한다 */
+    bool start();
+    /* hotplug 감시를 멈추고 처리중인 event 가 끝날 때까지 기다린다 (open 한 device 는 그대로) */
+    void stop();
+
+    /* 전송 결과 보고 (어느 thread 에서든 호출 가능, 성공은 event 를 만들지 않으므로 전송마다 호출해도 된다) */
+    void reportTransferResult(libusb_device_handle *deviceHandle, int error);
+    /* 연속 전송 시작/종료 보고 */
+    void reportStreaming(libusb_device_handle *deviceHandle, bool streaming);
+
+    /* 주기적으로 호출한다 (예: 1초): 전송 counter 반영, backoff 가 끝난 복구 재시도 */
+    void poll();
+
+    /* 모든 device 의 현재 상태 (port path 순) */
+    QList<UsbFleetDevice> snapshot() const;
+    /* 상태별 device 수 (index = UsbFleetDevice::State) */
+    QVector<int> stateCounts() const;
+
+    static const char *stateName(int state);
+
+signals:
+    /* 상태 변화 (worker thread 에서 발생) */
+    void sigStateChanged(QString portPath, int oldState, int newState);
+
+private:
+    enum EventType {
+        Attached,			/* hotplug 접속 / 최초 탐색 */
+        Removed,			/* hotplug 분리 */
+        OpenOk,
+        ConfigureOk,
+        BringUpFailed,
+        StreamStarted,
+        StreamStopped,
+        TransferFailed,		/* 연속 에러가 errorThreshold 에 도달 */
+        Retry				/* Error 에서 bring-up 재시도 (handle 은 닫은 상태) */
+    };
+
+    struct Event
+    {
+        EventType type;
+        libusb_device_handle *deviceHandle;
+        QString error;
+    };
+
+    /* device 1개 (mutex 로 보호, start() 이후 삭제하지 않는다) */
+    struct Device
+    {
+        UsbFleetDevice info;
+        QQueue<Event> events;
+        bool scheduled;				/* worker 에 drain 을 예약했다 */
+        int consecutiveErrors;
+        QElapsedTimer stateTimer;
+        qint64 retryAtNs;			/* Retry 예정 시각 (clock 기준, 없으면 -1) */
+        quint64 lastTransfers;		/* poll() 에서 읽은 전송 counter (handle 의 모든 endpoint 합계) */
+        quint64 lastErrors;
+    };
+
+    /* hotplug 통지 (hotplug event thread 에서 direct 로 호출) */
+    void onHotplug(bool isAttached, const QString &portPath, quint16 vid, quint16 pid);
+    /* device 의 event queue 에 추가하고 필요하면 worker 에 drain 을 예약한다 */
+    void postEvent(const QString &portPath, quint16 vid, quint16 pid, const Event &event);
+    void postEvent(Device *device, const Event &event);
+    /* device 의 event 를 순서대로 처리 (worker thread) */
+    void drainEvents(Device *device);
+    /* 상태 전이표 (전이하지 않는 event 면 from 을 반환) */
+    static UsbFleetDevice::State nextState(UsbFleetDevice::State from, EventType event);
+    /* 상태 진입 동작 (worker thread) */
+    void enterState(Device *device, UsbFleetDevice::State state);
+    void bringUp(Device *device);
+    void recover(Device *device);
+    /* handle 을 닫고 backoff 후 bring-up 부터 재시도한다 (worker thread) */
+    void retryLater(Device *device, const QString &error);
+    /* 성공/에러 수 반영 (mutex 를 잡고 호출), errorThreshold 에 도달하면 true */
+    bool countTransferResults(Device *device, quint64 successes, quint64 errors);
+
+    UsbComm *usbComm;
+    UsbMonitor *monitor;
+    UsbDeviceMatcher matcher;
+    UsbFleetConfig config;
+
+    QHash<QString, Device *> devices;
+    QHash<libusb_device_handle *, Device *> handleDevices;
+    mutable QMutex mutex;
+    QElapsedTimer clock;			/* retryAtNs 의 기준 */
+
+    QThreadPool workerPool;
+};
+
+#endif // USBFLEET_H
@@ -0,0 +1,252 @@
+/********************************************************************************/
+/* bulk 수신 데이터의 frame 분리 */
+/********************************************************************************/
+#include "usbframeparser.h"
+#include <QDebug>
+#include <cstring>
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:   config: frame 설정
+ *@return:
+ */
+/********************************************************************************/
+UsbFrameParser::UsbFrameParser(const UsbFrameConfig &config)
+{
+    this->config = config;
+    pos = 0;
+
+    if (this->config.mode == UsbFrameConfig::LengthPrefix && this->config.headerSize != 1 && this->config.headerSize != 2
+        && this->config.headerSize != 4) {
+        qDebug() << "UsbFrameParser: invalid headerSize" << this->config.headerSize << ", use 4";
+        this->config.headerSize = 4;
+    }
+    if (this->config.mode == UsbFrameConfig::Delimiter && this->config.delimiter.isEmpty())
+        this->config.delimiter = QByteArray(1, '\n');
+}
+
+/********************************************************************************/
+/*
+ * 수신 buffer 추가
+ *
+ * 이전 buffer 에 남은 데이터(미완성 frame)는 carry 로 복사해두고, 새 buffer 는 공유만 한다.
+ * 이전 buffer 의 frame 을 next() 로 모두 꺼낸 후에 호출하면, 복사되는 것은 경계에 걸친 frame 1개뿐이다.
+ *@param:   buffer: 수신 데이터
+ *@return:
+ */
+/********************************************************************************/
+void UsbFrameParser::feed(const QByteArray &buffer)
+{
+    int remain = current.size() - pos;
+    if (remain > 0) {
+        carry.append(current.constData() + pos, remain);
+        frameStats.bytesCopied += remain;
+    }
+
+    current = buffer;
+    pos = 0;
+    frameStats.bytesIn += buffer.size();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 다음 frame
+ *@param:   frame: 결과 (이전 내용은 release 된다)
+ *@return:  완성된 frame 이 있으면 true
+ */
+/********************************************************************************/
+bool UsbFrameParser::next(UsbFrame *frame)
+{
+    frame->release();
+
+    /* 1. 이전 buffer 에서 이어지는 frame */
+    if (!carry.isEmpty())
+        return assemble(frame);
+
+    /* 2. 현재 buffer 안에 완결된 frame 은 복사 없이 가리키기만 한다 */
+    const quint8 *data = (const quint8 *)current.constData() + pos;
+    qint64 size = frameSize(data, current.size() - pos);
+    if (size < 0) {
+        dropAll();
+        return false;
+    }
+    if (size == 0)
+        return false;
+
+    frame->storage = current;
+    frame->data = data + payloadOffset();
+    frame->length = payloadLength(size);
+    frame->copied = false;
+    pos += size;
+    frameStats.frames++;
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 남아있는 데이터를 모두 버린다 (통계는 유지)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFrameParser::reset()
+{
+    carry.clear();
+    current.clear();
+    pos = 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: frame 전체 길이 (header/delimiter 포함)
+ *@param:   data: frame 시작 위치
+ *@param:   length: data 의 유효 길이
+ *@return:  frame 길이, 아직 알 수 없으면 0, 이상하면 -1
+ */
+/********************************************************************************/
+qint64 UsbFrameParser::frameSize(const quint8 *data, qint64 length) const
+{
+    if (config.mode == UsbFrameConfig::Delimiter) {
+        const QByteArray &delimiter = config.delimiter;
+        int index = QByteArray::fromRawData((const char *)data, (int)length).indexOf(delimiter);
+        if (index >= 0)
+            return index + delimiter.size();
+        if (length > (qint64)config.maxFrameSize + delimiter.size())
+            return -1;
+        return 0;
+    }
+
+    int headerSize = config.headerSize;
+    if (length < headerSize)
+        return 0;
+
+    quint32 value = 0;
+    for (int i = 0; i < headerSize; i++) {
+        int shift = config.bigEndian ? (headerSize - 1 - i) * 8 : i * 8;
+        value |= (quint32)data[i] << shift;
+    }
+
+    qint64 payload = config.lengthIncludesHeader ? (qint64)value - headerSize : (qint64)value;
+    if (payload < 0 || payload > config.maxFrameSize)
+        return -1;
+    return headerSize + payload;
+}
+
+/********************************************************************************/
+/*
+ *@brief: payload 의 시작 위치
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbFrameParser::payloadOffset() const
+{
+    return config.mode == UsbFrameConfig::LengthPrefix ? config.headerSize : 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: payload 길이
+ *@param:   frameSize: frame 전체 길이
+ *@return:
+ */
+/********************************************************************************/
+int UsbFrameParser::payloadLength(qint64 frameSize) const
+{
+    if (config.mode == UsbFrameConfig::LengthPrefix)
+        return (int)(frameSize - config.headerSize);
+    return (int)(frameSize - config.delimiter.size());
+}
+
+/********************************************************************************/
+/*
+ * buffer 경계에 걸친 frame 조립
+ *
+ * 현재 buffer 에서 frame 완성에 필요한 만큼만 carry 로 옮긴다.
+ * (delimiter 가 두 buffer 에 나뉘어 있는 경우도 처리한다)
+ *@param:   frame: 결과
+ *@return:  frame 이 완성되었으면 true
+ */
+/********************************************************************************/
+bool UsbFrameParser::assemble(UsbFrame *frame)
+{
+    qint64 size;
+
+    forever {
+        size = frameSize((const quint8 *)carry.constData(), carry.size());
+        if (size < 0) {
+            dropAll();
+            return false;
+        }
+        if (size > 0 && carry.size() >= size)
+            break;
+
+        int avail = current.size() - pos;
+        if (avail <= 0)
+            return false;
+
+        const char *src = current.constData() + pos;
+        int count = avail;
+
+        if (config.mode == UsbFrameConfig::LengthPrefix) {
+            int need = (size == 0) ? config.headerSize - carry.size() : (int)(size - carry.size());
+            count = qMin(need, avail);
+        } else {
+            const QByteArray &delimiter = config.delimiter;
+
+            /* delimiter 의 앞부분이 carry 끝에, 나머지가 현재 buffer 앞에 있는 경우 */
+            int split = 0;
+            for (int k = qMin(delimiter.size() - 1, carry.size()); k > 0 && split == 0; k--) {
+                if (carry.endsWith(delimiter.left(k)) && avail >= delimiter.size() - k
+                    && memcmp(src, delimiter.constData() + k, delimiter.size() - k) == 0) {
+                    split = delimiter.size() - k;
+                }
+            }
+
+            if (split > 0) {
+                count = split;
+            } else {
+                int index = current.indexOf(delimiter, pos);
+                if (index >= 0)
+                    count = index - pos + delimiter.size();
+            }
+        }
+
+        carry.append(src, count);
+        pos += count;
+        frameStats.bytesCopied += count;
+    }
+
+    if (carry.size() == size) {
+        frame->storage = carry;
+        carry.clear();
+    } else {
+        /* feed() 전에 꺼내지 않은 frame 이 여러개 carry 에 들어있는 경우 */
+        frame->storage = carry.left((int)size);
+        carry.remove(0, (int)size);
+        frameStats.bytesCopied += size;
+    }
+
+    frame->data = (const quint8 *)frame->storage.constData() + payloadOffset();
+    frame->length = payloadLength(size);
+    frame->copied = true;
+    frameStats.frames++;
+    frameStats.copiedFrames++;
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 길이 이상 등으로 stream 을 따라갈 수 없을 때 남은 데이터를 버린다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbFrameParser::dropAll()
+{
+    qDebug() << "UsbFrameParser: invalid frame, drop" << carry.size() + current.size() - pos << "bytes";
+    frameStats.errors++;
+    carry.clear();
+    pos = current.size();
+}
@@ -0,0 +1,109 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * bulk 수신 데이터의 frame 분리 (length-prefix / delimiter)
+ *
+ * 수신 buffer(QByteArray) 를 feed() 로 넘기면, next() 가 buffer 안의 frame 위치를 가리키는 UsbFrame 을 반환한다.
+ * UsbFrame 은 수신 buffer 를 공유(참조 카운트)만 하고 복사하지 않으며, release() 하거나 소멸될 때까지 유효하다.
+ * frame 이 두 buffer 에 걸쳐 있을 때만 그 frame 을 별도 buffer 로 조립(복사)한다.
+ *
+ * NOTE:
+ * 	수신 buffer 를 재사용할 때는 buffer.isDetached() 를 확인한다.
+ * 	아직 release 되지 않은 frame 이 남아 있으면 그대로 쓰면 detach(복사)가 발생하므로 새 buffer 를 사용한다.
+ */
+#ifndef USBFRAMEPARSER_H
+#define USBFRAMEPARSER_H
+
+#include <QByteArray>
+
+/********************************************************************************/
+/* frame 설정 */
+/********************************************************************************/
+struct UsbFrameConfig
+{
+    enum Mode {
+        LengthPrefix,	/* 앞의 headerSize bytes 가 길이 */
+        Delimiter		/* delimiter 로 끝나는 frame */
+    };
+
+    Mode mode = LengthPrefix;
+    /* length header 의 크기 (1, 2, 4 bytes) */
+    int headerSize = 4;
+    /* length header 가 big endian 인지 여부 */
+    bool bigEndian = false;
+    /* length 값이 header 자신의 크기를 포함하는지 여부 */
+    bool lengthIncludesHeader = false;
+    /* Delimiter mode 의 구분자 */
+    QByteArray delimiter = QByteArray(1, '\n');
+    /* payload 최대 크기, 넘으면 stream 이상으로 보고 버퍼를 버린다 */
+    int maxFrameSize = 16 * 1024 * 1024;
+};
+
+/********************************************************************************/
+/* frame (수신 buffer 를 가리키는 view) */
+/********************************************************************************/
+struct UsbFrame
+{
+    const quint8 *data = NULL;	/* payload (header/delimiter 제외) */
+    int length = 0;
+    bool copied = false;		/* buffer 경계에 걸쳐서 조립된 frame 인지 여부 */
+
+    /* 참조중인 buffer 해제 (이후 data 는 무효) */
+    void release() {storage.clear(); data = NULL; length = 0;}
+
+private:
+    friend class UsbFrameParser;
+    QByteArray storage;			/* 수신 buffer 또는 조립 buffer (공유) */
+};
+
+/********************************************************************************/
+/* 통계 */
+/********************************************************************************/
+struct UsbFrameStats
+{
+    quint64 frames = 0;			/* 분리한 frame 수 */
+    quint64 bytesIn = 0;		/* feed() 된 bytes */
+    quint64 bytesCopied = 0;	/* buffer 경계 처리로 복사한 bytes */
+    quint64 copiedFrames = 0;	/* 조립(복사)된 frame 수 */
+    quint64 errors = 0;			/* 길이 이상 등으로 buffer 를 버린 횟수 */
+
+    double copiedBytesPerFrame() const {return frames ? (double)bytesCopied / frames : 0;}
+};
+
+/********************************************************************************/
+/* frame parser */
+/********************************************************************************/
+class UsbFrameParser
+{
+public:
+    explicit UsbFrameParser(const UsbFrameConfig &config = UsbFrameConfig());
+
+    /* 수신 buffer 추가 (buffer 는 복사하지 않고 공유한다) */
+    void feed(const QByteArray &buffer);
+    /* 다음 frame, 완성된 frame 이 없으면 false */
+    bool next(UsbFrame *frame);
+    /* 남아있는 데이터를 모두 버린다 */
+    void reset();
+
+    const UsbFrameStats &stats() const {return frameStats;}
+
+private:
+    /* data 의 앞부분에서 frame 전체 길이(header/delimiter 포함)를 구한다. 아직 모르면 0, 이상이면 -1 */
+    qint64 frameSize(const quint8 *data, qint64 length) const;
+    /* frame 전체 길이에서 payload 의 시작 위치/길이 */
+    int payloadOffset() const;
+    int payloadLength(qint64 frameSize) const;
+    /* 현재 buffer 의 앞부분을 조립 buffer 로 옮겨서 frame 을 완성한다 */
+    bool assemble(UsbFrame *frame);
+    void dropAll();
+
+    UsbFrameConfig	config;
+    UsbFrameStats	frameStats;
+
+    QByteArray	current;		/* 현재 parsing 중인 수신 buffer */
+    int			pos;			/* current 내 다음 frame 의 시작 위치 */
+    QByteArray	carry;		/* 이전 buffer 에서 넘어온 미완성 frame (복사본) */
+};
+
+#endif // USBFRAMEPARSER_H
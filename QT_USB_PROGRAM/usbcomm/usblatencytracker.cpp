@@ -0,0 +1,141 @@
+/********************************************************************************/
+/* endpoint 별 전송 지연 통계와 적응형 timeout */
+/********************************************************************************/
+#include "usblatencytracker.h"
+#include <algorithm>
+#include <cmath>
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:   windowSize: 통계에 사용하는 최근 sample 수
+ *@return:
+ */
+/********************************************************************************/
+UsbLatencyTracker::UsbLatencyTracker(int windowSize)
+{
+    window.resize(qMax(1, windowSize));
+    sorted.reserve(window.size());
+    next = 0;
+    count = 0;
+    windowSumUs = 0;
+
+    samples = 0;
+    timeouts = 0;
+    shortReads = 0;
+    consecutiveTimeouts = 0;
+
+    dirty = true;
+    cachedPercentile = -1;
+    cachedPercentileUs = 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 전송 완료 sample 추가
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbLatencyTracker::addSample(qint64 latencyUs, bool shortRead)
+{
+    if (count == window.size())
+        windowSumUs -= window.at(next);
+    else
+        count++;
+
+    window[next] = latencyUs;
+    windowSumUs += latencyUs;
+    next = (next + 1) % window.size();
+
+    samples++;
+    if (shortRead)
+        shortReads++;
+    consecutiveTimeouts = 0;
+    dirty = true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 전송 timeout (지연 sample 로는 사용하지 않는다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbLatencyTracker::addTimeout()
+{
+    timeouts++;
+    consecutiveTimeouts++;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 다음 전송의 timeout
+ *@param:   config: 적응형 timeout 설정
+ *@return:  timeout (ms)
+ */
+/********************************************************************************/
+quint32 UsbLatencyTracker::timeoutMs(const UsbAdaptiveTimeoutConfig &config)
+{
+    qint64 timeout;
+    if (count < config.minSamples) {
+        timeout = config.initialTimeoutMs;
+    } else {
+        double baseMs = percentileUs(config.percentile) / 1000.0;
+        timeout = (qint64)std::ceil(baseMs * config.margin) + config.marginMs;
+        timeout = qBound<qint64>(config.minTimeoutMs, timeout, config.maxTimeoutMs);
+    }
+
+    /* 연속 timeout 시에는 2배씩 늘린다 */
+    for (int i = 0; i < consecutiveTimeouts && timeout < config.maxTimeoutMs; i++)
+        timeout *= 2;
+
+    return (quint32)qMin<qint64>(timeout, config.maxTimeoutMs);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 통계
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbLatencyStats UsbLatencyTracker::stats(const UsbAdaptiveTimeoutConfig &config)
+{
+    UsbLatencyStats s;
+    s.samples = samples;
+    s.timeouts = timeouts;
+    s.shortReads = shortReads;
+    s.meanUs = count ? (double)windowSumUs / count : 0;
+    s.percentileUs = count ? percentileUs(config.percentile) : 0;
+    s.timeoutMs = timeoutMs(config);
+    return s;
+}
+
+/********************************************************************************/
+/*
+ *@brief: window 의 percentile 지연
+ *@param:
+ *@return:  us
+ */
+/********************************************************************************/
+qint64 UsbLatencyTracker::percentileUs(double percentile)
+{
+    if (count == 0)
+        return 0;
+
+    if (!dirty && cachedPercentile == percentile)
+        return cachedPercentileUs;
+
+    /* window 는 수백개 이하이므로 nth_element 로 충분하다 (sorted 는 reserve 해둔 작업용 buffer) */
+    sorted.resize(count);
+    std::copy(window.constBegin(), window.constBegin() + count, sorted.begin());
+
+    int index = qBound(0, (int)std::ceil(percentile * count) - 1, count - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+
+    cachedPercentileUs = sorted.at(index);
+    cachedPercentile = percentile;
+    dirty = false;
+    return cachedPercentileUs;
+}
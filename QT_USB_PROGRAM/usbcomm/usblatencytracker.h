@@ -0,0 +1,89 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * endpoint 별 전송 지연 통계와 적응형 timeout
+ *
+ * 최근 windowSize 개 전송의 완료 지연(submit ~ 완료)을 기록해두고,
+ * timeout = percentile 지연 * margin + marginMs 로 정한다 (min/max 로 제한).
+ * 정상 device 는 수 ms 안에 응답하므로, 멈춘 device 를 수 초가 아니라 수십 ms 만에 감지할 수 있다.
+ *
+ * timeout 이 연속으로 나면 device 가 실제로 느려진 경우를 위해 다음 timeout 을 2배씩 늘린다 (maxTimeoutMs 까지).
+ * 이 class 는 thread safe 가 아니다 (UsbComm 이 mutex 로 보호한다).
+ */
+#ifndef USBLATENCYTRACKER_H
+#define USBLATENCYTRACKER_H
+
+#include <QtGlobal>
+#include <QVector>
+
+/********************************************************************************/
+/* 적응형 timeout 설정 */
+/********************************************************************************/
+struct UsbAdaptiveTimeoutConfig
+{
+    /* 기준 지연의 percentile (0.0 ~ 1.0) */
+    double percentile = 0.99;
+    /* 기준 지연에 곱하는 배수와 더하는 여유 (ms) */
+    double margin = 1.5;
+    quint32 marginMs = 2;
+    /* timeout 의 하한/상한 (ms) */
+    quint32 minTimeoutMs = 10;
+    quint32 maxTimeoutMs = 5000;
+    /* sample 이 minSamples 개 모일 때까지 사용하는 timeout (ms) */
+    quint32 initialTimeoutMs = 1000;
+    int minSamples = 16;
+};
+
+/********************************************************************************/
+/* endpoint 의 지연 통계 */
+/********************************************************************************/
+struct UsbLatencyStats
+{
+    quint64 samples = 0;			/* 완료된 전송 수 (short read 포함) */
+    quint64 timeouts = 0;			/* timeout 으로 끝난 전송 수 */
+    quint64 shortReads = 0;			/* 요청보다 짧게 끝난 전송 수 */
+    double meanUs = 0;				/* window 내 평균 지연 */
+    double percentileUs = 0;		/* window 내 percentile 지연 */
+    quint32 timeoutMs = 0;			/* 다음 전송에 사용할 timeout */
+};
+
+/********************************************************************************/
+/* 지연 추적 Class */
+/********************************************************************************/
+class UsbLatencyTracker
+{
+public:
+    explicit UsbLatencyTracker(int windowSize = 256);
+
+    /* 전송 완료 (latencyUs: submit ~ 완료, shortRead: 요청보다 짧게 끝남) */
+    void addSample(qint64 latencyUs, bool shortRead);
+    /* 전송 timeout */
+    void addTimeout();
+
+    /* 다음 전송의 timeout (ms) */
+    quint32 timeoutMs(const UsbAdaptiveTimeoutConfig &config);
+    UsbLatencyStats stats(const UsbAdaptiveTimeoutConfig &config);
+
+private:
+    /* window 의 percentile 지연 (us), sample 이 추가된 경우에만 다시 계산한다 */
+    qint64 percentileUs(double percentile);
+
+    QVector<qint64> window;		/* ring buffer */
+    int next;
+    int count;
+    qint64 windowSumUs;
+
+    quint64 samples;
+    quint64 timeouts;
+    quint64 shortReads;
+    int consecutiveTimeouts;
+
+    /* percentile 계산 cache */
+    QVector<qint64> sorted;
+    bool dirty;
+    double cachedPercentile;
+    qint64 cachedPercentileUs;
+};
+
+#endif // USBLATENCYTRACKER_H
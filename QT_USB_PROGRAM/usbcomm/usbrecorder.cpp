@@ -0,0 +1,575 @@
+/********************************************************************************/
+/* bulk IN endpoint 연속 기록 (capture) Part */
+/********************************************************************************/
+#include "usbrecorder.h"
+#include <QDebug>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* O_DIRECT 의 buffer 주소/크기/파일 offset 정렬 단위 */
+static const int kDirectIoAlign = 4096;
+
+/* n 을 align 의 배수로 올림 */
+static inline qint64 alignUp(qint64 n, qint64 align)
+{
+    return (n + align - 1) / align * align;
+}
+
+/********************************************************************************/
+/* Part1: UsbRecorder */
+/********************************************************************************/
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:   usbComm: device handle 을 관리하는 UsbComm (event thread 도 이 obj 의 것을 사용한다)
+ *@return:
+ */
+/********************************************************************************/
+UsbRecorder::UsbRecorder(UsbComm *usbComm, QObject *parent) : QObject(parent)
+{
+    this->usbComm = usbComm;
+    deviceHandle = NULL;
+    endpoint = 0;
+    recording.storeRelaxed(0);
+
+    fd = -1;
+    directIo = false;
+    fileOffset = 0;
+    indexFd = -1;
+    storedBytes = 0;
+    indexCapacity = 0;
+
+    inFlight = 0;
+    fillBlock = -1;
+    writerStopping = false;
+    writer = NULL;
+
+    maxQueueDepth = 0;
+    elapsedMsAtStop = 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자, 기록중이면 종료한다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbRecorder::~UsbRecorder()
+{
+    stop();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 기록 시작
+ *
+ * NOTE:
+ * 	O_DIRECT 는 page cache 를 거치지 않으므로, 수십 GB 를 기록해도 page cache 가 오염되지 않고
+ * 	write 지연이 disk 성능에 직접 비례하게 된다.
+ * 	대신 buffer 주소, 크기, 파일 offset 이 모두 4KB 정렬이어야 하므로 block 은 posix_memalign 으로 할당하고,
+ * 	마지막 block 만 padding 해서 쓴 후 파일 크기를 ftruncate 로 맞춘다.
+ *
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: bulk IN endpoint 주소
+ *@param:   filePath: 기록 파일 (덮어쓴다)
+ *@param:   config: 기록 설정
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbRecorder::start(libusb_device_handle *deviceHandle, quint8 endpoint, const QString &filePath, const UsbRecorderConfig &config)
+{
+    if (recording.loadAcquire())
+        return false;
+
+    /* 모든 전송이 에러로 끝나 recording 만 내려간 경우, 남은 파일/자원을 먼저 정리한다 */
+    stop();
+
+    if (!usbComm->isUsbDeviceOpened(deviceHandle)) {
+        qDebug() << "UsbRecorder: device is not opened";
+        return false;
+    }
+
+    if (!(endpoint & LIBUSB_ENDPOINT_IN) || config.transferSize <= 0 || config.transferCount <= 0
+            || config.blockSize <= 0 || config.blockCount <= 0) {
+        qDebug() << "UsbRecorder: invalid config";
+        return false;
+    }
+
+    this->deviceHandle = deviceHandle;
+    this->endpoint = endpoint;
+    this->config = config;
+    this->config.blockSize = alignUp(config.blockSize, kDirectIoAlign);
+
+    /* 기록 파일 열기 */
+    QByteArray path = filePath.toLocal8Bit();
+    directIo = false;
+#ifdef O_DIRECT
+    if (this->config.directIo) {
+        fd = ::open(path.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        directIo = (fd >= 0);
+        if (fd < 0)
+            qDebug() << "UsbRecorder: O_DIRECT is not supported, fall back to buffered I/O:" << strerror(errno);
+    }
+#endif
+    if (fd < 0)
+        fd = ::open(path.constData(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        qDebug() << "UsbRecorder: open error:" << filePath << strerror(errno);
+        return false;
+    }
+    fileOffset = 0;
+    storedBytes = 0;
+
+    /* timestamp index 파일 */
+    if (this->config.timestampIndex) {
+        QByteArray indexPath = path + ".idx";
+        indexFd = ::open(indexPath.constData(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (indexFd < 0)
+            qDebug() << "UsbRecorder: index open error:" << strerror(errno);
+    }
+
+    /* block 의 index 크기: 짧은 전송도 보통 max packet 단위로 끝나므로 max packet 수 만큼 잡는다
+     * (1 packet 보다 짧은 전송이 계속되면 넘칠 수 있으므로 넘친 entry 는 indexDropped 로 센다) */
+    indexCapacity = 0;
+    if (indexFd >= 0) {
+        int maxPacket = libusb_get_max_packet_size(libusb_get_device(deviceHandle), endpoint);
+        if (maxPacket <= 0)
+            maxPacket = 512;
+        indexCapacity = this->config.blockSize / maxPacket + 2;
+    }
+
+    /* block pool */
+    blocks.resize(this->config.blockCount);
+    for (int i = 0; i < blocks.size(); i++) {
+        void *mem = NULL;
+        if (posix_memalign(&mem, kDirectIoAlign, this->config.blockSize) != 0) {
+            qDebug() << "UsbRecorder: block alloc error";
+            blocks.resize(i);
+            freeBuffers();
+            ::close(fd);
+            fd = -1;
+            if (indexFd >= 0) {
+                ::close(indexFd);
+                indexFd = -1;
+            }
+            return false;
+        }
+        blocks[i].data = (quint8 *)mem;
+        blocks[i].used = 0;
+        if (indexFd >= 0)
+            blocks[i].index.reserve(indexCapacity);
+        freeBlocks.enqueue(i);
+    }
+    fillBlock = -1;
+
+    /* 통계 초기화 */
+    bytesReceived.storeRelaxed(0);
+    bytesWritten.storeRelaxed(0);
+    bytesDropped.storeRelaxed(0);
+    dropEvents.storeRelaxed(0);
+    transferErrors.storeRelaxed(0);
+    indexDropped.storeRelaxed(0);
+    writeBusyNs.storeRelaxed(0);
+    maxQueueDepth = 0;
+
+    /* writer thread 시작 */
+    writerStopping = false;
+    if (writer == NULL)
+        writer = new UsbRecorderWriter(this, this);
+    writer->start();
+
+    /* USB 전송 submit */
+    if (!usbComm->startEventHandler()) {
+        stop();
+        return false;
+    }
+
+    stopping.storeRelease(0);
+    /* elapsedTimer 를 먼저 시작한다 (recording 을 본 stats() 가 시작 전의 timer 를 읽지 않도록) */
+    elapsedTimer.start();
+    recording.storeRelease(1);
+
+    for (int i = 0; i < this->config.transferCount; i++) {
+        libusb_transfer *transfer = libusb_alloc_transfer(0);
+        void *mem = NULL;
+        if (transfer == NULL || posix_memalign(&mem, kDirectIoAlign, this->config.transferSize) != 0) {
+            qDebug() << "UsbRecorder: transfer alloc error";
+            libusb_free_transfer(transfer);
+            break;
+        }
+
+        /* timeout 0: 데이터가 올 때까지 기다린다 (연속 streaming) */
+        libusb_fill_bulk_transfer(transfer, deviceHandle, endpoint, (unsigned char *)mem,
+                                  this->config.transferSize, transferCallback, this, 0);
+        transfers.append(transfer);
+
+        QMutexLocker locker(&inFlightMutex);
+        int err = libusb_submit_transfer(transfer);
+        if (err != LIBUSB_SUCCESS) {
+            qDebug() << "UsbRecorder: libusb_submit_transfer error:" << libusb_error_name(err);
+            break;
+        }
+        inFlight++;
+    }
+
+    if (inFlight == 0) {
+        stop();
+        return false;
+    }
+
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 기록 종료
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRecorder::stop()
+{
+    if (!recording.loadAcquire() && fd < 0)
+        return;
+
+    /* 1. 재submit 을 멈추고 진행중인 전송을 취소한다.
+     *    callback 이 stopping 을 확인한 직후에 재submit 하는 경우가 있으므로, 모두 끝날 때까지 반복해서 취소한다 */
+    stopping.storeRelease(1);
+    inFlightMutex.lock();
+    while (inFlight > 0) {
+        inFlightMutex.unlock();
+        for (int i = 0; i < transfers.size(); i++)
+            libusb_cancel_transfer(transfers.at(i));
+        inFlightMutex.lock();
+        inFlightDone.wait(&inFlightMutex, 100);
+    }
+    inFlightMutex.unlock();
+
+    /* 2. 채우던 block 을 넘기고 writer 가 queue 를 모두 비울 때까지 기다린다 */
+    if (fillBlock >= 0) {
+        if (blocks.at(fillBlock).used > 0) {
+            queueFillBlock();
+        } else {
+            QMutexLocker locker(&queueMutex);
+            freeBlocks.enqueue(fillBlock);
+            fillBlock = -1;
+        }
+    }
+
+    if (writer != NULL && writer->isRunning()) {
+        queueMutex.lock();
+        writerStopping = true;
+        queueNotEmpty.wakeAll();
+        queueMutex.unlock();
+        writer->wait();
+    }
+
+    /* 3. O_DIRECT 의 padding 을 잘라내고 파일을 닫는다 */
+    if (fd >= 0) {
+        if (ftruncate(fd, fileOffset) != 0)
+            qDebug() << "UsbRecorder: ftruncate error:" << strerror(errno);
+        ::close(fd);
+        fd = -1;
+    }
+    if (indexFd >= 0) {
+        ::close(indexFd);
+        indexFd = -1;
+    }
+
+    if (recording.loadAcquire())
+        elapsedMsAtStop = elapsedTimer.elapsed();
+    recording.storeRelease(0);
+
+    freeBuffers();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 통계
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbRecorderStats UsbRecorder::stats() const
+{
+    UsbRecorderStats s;
+    s.bytesReceived = bytesReceived.loadRelaxed();
+    s.bytesWritten = bytesWritten.loadRelaxed();
+    s.bytesDropped = bytesDropped.loadRelaxed();
+    s.dropEvents = dropEvents.loadRelaxed();
+    s.transferErrors = transferErrors.loadRelaxed();
+    s.indexDropped = indexDropped.loadRelaxed();
+    s.writeBusySec = writeBusyNs.loadRelaxed() / 1e9;
+    s.elapsedSec = (recording.loadAcquire() ? elapsedTimer.elapsed() : elapsedMsAtStop) / 1e3;
+    s.directIo = directIo;
+
+    QMutexLocker locker(&queueMutex);
+    s.maxQueueDepth = maxQueueDepth;
+    return s;
+}
+
+/********************************************************************************/
+/*
+ * @brief: USB 전송 완료 callback (UsbComm event thread 에서 실행)
+ *
+ * NOTE: callback 안에서는 blocking 처리(disk I/O, 동기 libusb 함수)를 하지 않는다.
+ * 		수신 데이터를 block 에 복사하고 바로 재submit 한다.
+ *
+ *@return:
+ */
+/********************************************************************************/
+void LIBUSB_CALL UsbRecorder::transferCallback(libusb_transfer *transfer)
+{
+    UsbRecorder *recorder = (UsbRecorder *)transfer->user_data;
+
+    if (transfer->actual_length > 0)
+        recorder->storeReceivedData(transfer->buffer, transfer->actual_length, recorder->elapsedTimer.nsecsElapsed());
+
+    bool resubmit = false;
+    switch (transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED:
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        resubmit = !recorder->stopping.loadAcquire();
+        break;
+    case LIBUSB_TRANSFER_CANCELLED:
+        break;
+    default:
+        /* STALL, NO_DEVICE, OVERFLOW, ERROR: 이 전송은 더 이상 재submit 하지 않는다 */
+        recorder->transferErrors.fetchAndAddRelaxed(1);
+        emit recorder->sigRecordError(QString("transfer error: status %1").arg(transfer->status));
+        break;
+    }
+
+    if (resubmit) {
+        int err = libusb_submit_transfer(transfer);
+        if (err == LIBUSB_SUCCESS)
+            return;
+        recorder->transferErrors.fetchAndAddRelaxed(1);
+        emit recorder->sigRecordError(QString("libusb_submit_transfer error: %1").arg(libusb_error_name(err)));
+    }
+
+    QMutexLocker locker(&recorder->inFlightMutex);
+    if (--recorder->inFlight == 0) {
+        /* stop() 없이 마지막 전송이 끝났다 = 모든 전송이 에러로 끝남. 기록은 더 진행되지 않으므로 recording 을 내린다 */
+        if (!recorder->stopping.loadAcquire() && recorder->recording.loadAcquire()) {
+            recorder->elapsedMsAtStop = recorder->elapsedTimer.elapsed();
+            recorder->recording.storeRelease(0);
+        }
+        recorder->inFlightDone.wakeAll();
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: 수신 데이터를 block 에 채운다 (event thread 전용, fillBlock 은 이 함수와 stop() 만 사용)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRecorder::storeReceivedData(const quint8 *data, int length, qint64 timestampNs)
+{
+    bytesReceived.fetchAndAddRelaxed(length);
+    bool indexed = false;
+
+    while (length > 0) {
+        if (fillBlock < 0) {
+            QMutexLocker locker(&queueMutex);
+            if (freeBlocks.isEmpty()) {
+                /* writer 가 따라오지 못함: USB 쪽을 막지 않고 버린다 */
+                bytesDropped.fetchAndAddRelaxed(length);
+                dropEvents.fetchAndAddRelaxed(1);
+                return;
+            }
+            fillBlock = freeBlocks.dequeue();
+            blocks[fillBlock].used = 0;
+            blocks[fillBlock].index.clear();
+        }
+
+        Block &block = blocks[fillBlock];
+        if (indexFd >= 0 && !indexed) {
+            if (block.index.size() < indexCapacity)
+                block.index.append({storedBytes, (quint64)timestampNs});
+            else
+                indexDropped.fetchAndAddRelaxed(1);
+            indexed = true;
+        }
+
+        int n = qMin(length, config.blockSize - block.used);
+        memcpy(block.data + block.used, data, n);
+        block.used += n;
+        storedBytes += n;
+        data += n;
+        length -= n;
+
+        if (block.used == config.blockSize)
+            queueFillBlock();
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: 채우던 block 을 writer queue 에 넘긴다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRecorder::queueFillBlock()
+{
+    QMutexLocker locker(&queueMutex);
+    fullBlocks.enqueue(fillBlock);
+    maxQueueDepth = qMax(maxQueueDepth, fullBlocks.size());
+    fillBlock = -1;
+    queueNotEmpty.wakeOne();
+}
+
+/********************************************************************************/
+/*
+ *@brief: writer thread main loop, stop() 에서 writerStopping 이 설정되면 queue 를 비운 후 종료한다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRecorder::writeLoop()
+{
+    bool writeFailed = false;
+
+    forever {
+        int index;
+        {
+            QMutexLocker locker(&queueMutex);
+            while (fullBlocks.isEmpty() && !writerStopping)
+                queueNotEmpty.wait(&queueMutex);
+            if (fullBlocks.isEmpty())
+                break;
+            index = fullBlocks.dequeue();
+        }
+
+        /* write 에러 후에는 block 을 버리기만 한다 (USB 쪽에는 drop 으로 보인다) */
+        if (!writeFailed && !writeBlock(blocks.at(index))) {
+            writeFailed = true;
+            emit sigRecordError(QString("write error: %1").arg(strerror(errno)));
+        }
+        if (writeFailed) {
+            bytesDropped.fetchAndAddRelaxed(blocks.at(index).used);
+            dropEvents.fetchAndAddRelaxed(1);
+        }
+
+        QMutexLocker locker(&queueMutex);
+        freeBlocks.enqueue(index);
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: block 1개를 파일에 기록한다
+ *@param:
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbRecorder::writeBlock(const Block &block)
+{
+    /* O_DIRECT 는 크기도 정렬되어야 하므로, 마지막(부분) block 은 0 으로 padding 해서 쓴다 */
+    qint64 length = block.used;
+    if (directIo && (length % kDirectIoAlign) != 0) {
+        qint64 padded = alignUp(length, kDirectIoAlign);
+        memset(block.data + length, 0, padded - length);
+        length = padded;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    qint64 done = 0;
+    while (done < length) {
+        ssize_t n = ::pwrite(fd, block.data + done, length - done, fileOffset + done);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        done += n;
+    }
+
+    writeBusyNs.fetchAndAddRelaxed(timer.nsecsElapsed());
+    fileOffset += block.used;
+    bytesWritten.fetchAndAddRelaxed(block.used);
+
+    /* index 는 data 보다 먼저 기록되지 않도록 block 기록 후에 쓴다 (entry 가 작아서 일반 I/O 로 충분) */
+    if (indexFd >= 0 && !block.index.isEmpty()) {
+        const char *p = (const char *)block.index.constData();
+        qint64 size = block.index.size() * (qint64)sizeof(UsbCaptureIndexEntry);
+        while (size > 0) {
+            ssize_t n = ::write(indexFd, p, size);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            p += n;
+            size -= n;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 전송/block 자원 해제 (전송이 모두 끝나고 writer 가 종료된 후에만 호출)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRecorder::freeBuffers()
+{
+    for (int i = 0; i < transfers.size(); i++) {
+        free(transfers.at(i)->buffer);
+        libusb_free_transfer(transfers.at(i));
+    }
+    transfers.clear();
+
+    for (int i = 0; i < blocks.size(); i++)
+        free(blocks.at(i).data);
+    blocks.clear();
+
+    freeBlocks.clear();
+    fullBlocks.clear();
+    fillBlock = -1;
+    inFlight = 0;
+}
+
+
+
+
+/********************************************************************************/
+/* Part2: UsbRecorderWriter */
+/********************************************************************************/
+
+/********************************************************************************/
+/*
+ *@brief:	생성자함수
+ *@param:	recorder: queue 를 소유한 UsbRecorder
+ *@parent:	parent:
+ */
+/********************************************************************************/
+UsbRecorderWriter::UsbRecorderWriter(UsbRecorder *recorder, QObject *parent) : QThread(parent)
+{
+    this->recorder = recorder;
+}
+
+/********************************************************************************/
+/*
+ *@brief: Sub thread
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRecorderWriter::run()
+{
+    recorder->usbComm->applyWorkerThreadSchedConfig();
+    recorder->writeLoop();
+}
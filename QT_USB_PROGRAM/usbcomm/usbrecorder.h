@@ -0,0 +1,202 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * bulk IN endpoint 의 데이터를 파일로 연속 기록(capture)하는 파트
+ *
+ * 구조:
+ * 	USB 완료 callback (UsbComm event thread)
+ * 		-> 수신 데이터를 aligned block 에 채운다
+ * 		-> 가득 찬 block 을 bounded queue 에 넘긴다
+ * 	writer thread (UsbRecorderWriter)
+ * 		-> queue 에서 block 을 꺼내 O_DIRECT 로 파일에 쓴다
+ *
+ * disk 가 느려서 빈 block 이 없으면, 수신 데이터는 버리고(drop 통계에 기록) 전송은 계속 재submit 한다.
+ * 즉, disk 쪽이 USB device 에 backpressure 를 걸지 않는다.
+ */
+#ifndef USBRECORDER_H
+#define USBRECORDER_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QVector>
+#include <QElapsedTimer>
+#include <usbcomm.h>
+
+/********************************************************************************/
+/* 기록 설정 */
+/********************************************************************************/
+struct UsbRecorderConfig
+{
+    /* USB 전송 1개의 크기 (wMaxPacketSize 의 배수로 지정) */
+    int transferSize = 256 * 1024;
+    /* 동시에 submit 해두는 전송 수 */
+    int transferCount = 8;
+    /* disk write 단위 (O_DIRECT 정렬 단위의 배수) */
+    int blockSize = 8 * 1024 * 1024;
+    /* block 수 (= writer 쪽 bounded queue 의 최대 깊이) */
+    int blockCount = 8;
+    /* O_DIRECT 사용 여부 (파일시스템이 지원하지 않으면 자동으로 일반 I/O 로 전환) */
+    bool directIo = true;
+    /* 전송 완료 시각 index 파일(<기록파일>.idx) 생성 여부 (UsbReplayer 의 timestamp 재생에 사용) */
+    bool timestampIndex = false;
+};
+
+/********************************************************************************/
+/* timestamp index 파일의 1 entry (little endian, 전송 완료 1회당 1개) */
+/********************************************************************************/
+struct UsbCaptureIndexEntry
+{
+    quint64 offset;			/* 기록 파일 내 offset (이 전송 데이터의 시작 위치) */
+    quint64 timestampNs;	/* 기록 시작부터 전송 완료까지의 시간 (ns) */
+};
+
+/********************************************************************************/
+/* 기록 통계 */
+/********************************************************************************/
+struct UsbRecorderStats
+{
+    quint64 bytesReceived = 0;		/* USB 로 수신한 bytes */
+    quint64 bytesWritten = 0;		/* 파일에 기록한 bytes */
+    quint64 bytesDropped = 0;		/* 빈 block 이 없어서 버린 bytes */
+    quint64 dropEvents = 0;			/* drop 발생 횟수 (전송 단위) */
+    quint64 transferErrors = 0;		/* 전송 에러 횟수 */
+    quint64 indexDropped = 0;		/* block 의 index 가 가득 차서 기록하지 못한 timestamp 수 */
+    int maxQueueDepth = 0;			/* writer queue 의 최대 깊이 */
+    double elapsedSec = 0;			/* 기록 시작부터의 경과 시간 */
+    double writeBusySec = 0;		/* writer thread 가 write() 에 소비한 시간 */
+    bool directIo = false;			/* 실제로 O_DIRECT 로 열렸는지 */
+
+    /* 지속 기록 속도 (MB/s) */
+    double writeMBps() const {return elapsedSec > 0 ? bytesWritten / 1e6 / elapsedSec : 0;}
+    /* disk 만의 기록 속도 (MB/s, write() 중인 시간 기준) */
+    double diskMBps() const {return writeBusySec > 0 ? bytesWritten / 1e6 / writeBusySec : 0;}
+};
+
+class UsbRecorderWriter;
+
+/********************************************************************************/
+/* 파트1. 기록 Class */
+/********************************************************************************/
+class UsbRecorder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UsbRecorder(UsbComm *usbComm, QObject *parent = 0);
+    ~UsbRecorder();
+
+    /* 기록 시작 (deviceHandle 은 UsbComm::getDeviceHandleFrom_xxx 로 취득, interface 는 미리 선언해둔다) */
+    bool start(libusb_device_handle *deviceHandle, quint8 endpoint, const QString &filePath,
+               const UsbRecorderConfig &config = UsbRecorderConfig());
+    /* 기록 종료 (진행중인 전송 취소 -> 남은 block flush -> 파일 닫기) */
+    void stop();
+
+    /* 모든 전송이 에러로 끝나면 stop() 전에도 false 가 된다 (파일/자원 정리는 stop() 에서 한다) */
+    bool isRecording() const {return recording.loadAcquire();}
+
+    /* 현재 통계 (어느 thread 에서든 호출 가능) */
+    UsbRecorderStats stats() const;
+
+signals:
+    /* 전송 에러, 파일 write 에러 등 (전송 에러는 event thread, write 에러는 writer thread 에서 발생하므로 queued connection 으로 받는다) */
+    void sigRecordError(QString message);
+
+private:
+    friend class UsbRecorderWriter;
+
+    /* data block (파일 write 단위) */
+    struct Block
+    {
+        quint8 *data;
+        int used;
+        /* 이 block 안에서 시작하는 전송들의 timestamp (timestampIndex 일 때만, indexCapacity 만큼 미리 reserve 하고 넘치면 버린다) */
+        QVector<UsbCaptureIndexEntry> index;
+    };
+
+    /* USB 전송 완료 callback (UsbComm event thread 에서 실행) */
+    static void LIBUSB_CALL transferCallback(libusb_transfer *transfer);
+    /* 수신 데이터를 block 에 채운다 (event thread 전용) */
+    void storeReceivedData(const quint8 *data, int length, qint64 timestampNs);
+    /* 채우던 block 을 writer queue 로 넘긴다 */
+    void queueFillBlock();
+    /* writer thread 의 main loop */
+    void writeLoop();
+    /* block 1개 기록 (O_DIRECT 정렬 처리 포함) */
+    bool writeBlock(const Block &block);
+
+    /* 자원 해제 */
+    void freeBuffers();
+
+    UsbComm *usbComm;
+    libusb_device_handle *deviceHandle;
+    quint8 endpoint;
+    UsbRecorderConfig config;
+    /* stats()/isRecording() 는 다른 thread (GUI timer 등) 에서도 읽는다 */
+    QAtomicInt recording;
+
+    /* 기록 파일 */
+    int fd;
+    bool directIo;
+    quint64 fileOffset;
+    /* timestamp index 파일 (사용하지 않으면 -1) */
+    int indexFd;
+    /* block 에 저장한 누적 bytes (event thread 전용, index 의 offset) */
+    quint64 storedBytes;
+    /* block 1개의 index entry 최대 수 (callback 에서 재할당하지 않도록 이 이상은 기록하지 않는다) */
+    int indexCapacity;
+
+    /* USB 전송 */
+    QVector<libusb_transfer *> transfers;
+    QAtomicInt stopping;
+    int inFlight;
+    QMutex inFlightMutex;
+    QWaitCondition inFlightDone;
+
+    /* block pool 과 writer queue (freeBlocks/fullBlocks 는 queueMutex 로 보호) */
+    QVector<Block> blocks;
+    QQueue<int> freeBlocks;
+    QQueue<int> fullBlocks;
+    int fillBlock;					/* event thread 가 채우고 있는 block (없으면 -1) */
+    bool writerStopping;
+    mutable QMutex queueMutex;
+    QWaitCondition queueNotEmpty;
+    UsbRecorderWriter *writer;
+
+    /* 통계 */
+    QAtomicInteger<quint64> bytesReceived;
+    QAtomicInteger<quint64> bytesWritten;
+    QAtomicInteger<quint64> bytesDropped;
+    QAtomicInteger<quint64> dropEvents;
+    QAtomicInteger<quint64> transferErrors;
+    QAtomicInteger<quint64> indexDropped;
+    QAtomicInteger<qint64> writeBusyNs;
+    int maxQueueDepth;
+    QElapsedTimer elapsedTimer;
+    qint64 elapsedMsAtStop;
+};
+
+
+/********************************************************************************/
+/* 파트2. 파일 기록 thread */
+/********************************************************************************/
+/*
+ * UsbRecorder 의 writer queue 를 비우는 전용 thread.
+ * USB 완료 처리(event thread)와 disk I/O 를 분리하기 위해서만 사용한다.
+ */
+class UsbRecorderWriter : public QThread
+{
+    Q_OBJECT
+public:
+    UsbRecorderWriter(UsbRecorder *recorder, QObject *parent = 0);
+
+protected:
+    virtual void run();
+
+private:
+    UsbRecorder *recorder;
+};
+
+#endif // USBRECORDER_H
@@ -0,0 +1,498 @@
+/********************************************************************************/
+/* 기록 파일의 bulk OUT endpoint 재생 (replay) Part */
+/********************************************************************************/
+#include "usbreplayer.h"
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <time.h>
+#include <sys/mman.h>
+
+/* sleep 후 남은 시간을 spin 으로 맞추는 구간 (ns). scheduler 깨어나는 지연을 흡수한다 */
+static const qint64 kSpinMarginNs = 50 * 1000;
+/* pacing 대기 중 stopping 을 확인하는 간격 */
+static const qint64 kSleepSliceNs = 10 * 1000 * 1000;
+/* 이 이상 늦게 submit 되면 late 로 집계 (ns) */
+static const qint64 kLateThresholdNs = 1000 * 1000;
+
+/* CLOCK_MONOTONIC 현재 시각 (ns) */
+static inline qint64 monotonicNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (qint64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/********************************************************************************/
+/* Part1: UsbReplayer */
+/********************************************************************************/
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:   usbComm: device handle 을 관리하는 UsbComm (event thread 도 이 obj 의 것을 사용한다)
+ *@return:
+ */
+/********************************************************************************/
+UsbReplayer::UsbReplayer(UsbComm *usbComm, QObject *parent) : QObject(parent)
+{
+    this->usbComm = usbComm;
+    deviceHandle = NULL;
+    endpoint = 0;
+
+    mapped = NULL;
+    mappedSize = 0;
+    submitter = NULL;
+
+    startNs = 0;
+    jitterCount = 0;
+    jitterMean = 0;
+    jitterM2 = 0;
+    jitterMin = 0;
+    jitterMax = 0;
+    lateCount = 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자, 재생중이면 중단한다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbReplayer::~UsbReplayer()
+{
+    stop();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 재생 시작
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: bulk OUT endpoint 주소
+ *@param:   filePath: 재생 파일
+ *@param:   config: 재생 설정
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbReplayer::start(libusb_device_handle *deviceHandle, quint8 endpoint, const QString &filePath, const UsbReplayConfig &config)
+{
+    if (isReplaying())
+        return false;
+
+    /* 지난 재생이 stop() 없이 끝났으면 전송/map/파일이 남아있으므로 먼저 해제한다
+     * (submit thread 는 모든 전송이 끝난 후에 종료하므로 in flight 전송은 없다) */
+    stop();
+
+    if (!usbComm->isUsbDeviceOpened(deviceHandle)) {
+        qDebug() << "UsbReplayer: device is not opened";
+        return false;
+    }
+
+    if ((endpoint & LIBUSB_ENDPOINT_IN) || config.transferSize <= 0 || config.transferCount <= 0
+            || (config.mode == UsbReplayConfig::ByteRate && config.bytesPerSec <= 0)) {
+        qDebug() << "UsbReplayer: invalid config";
+        return false;
+    }
+
+    this->deviceHandle = deviceHandle;
+    this->endpoint = endpoint;
+    this->config = config;
+
+    /* 파일 memory map */
+    file.setFileName(filePath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        qDebug() << "UsbReplayer: open error:" << filePath << file.errorString();
+        file.close();
+        return false;
+    }
+    mappedSize = file.size();
+    mapped = file.map(0, mappedSize);
+    if (mapped == NULL) {
+        qDebug() << "UsbReplayer: map error:" << file.errorString();
+        file.close();
+        return false;
+    }
+    /* 앞에서부터 순서대로 읽으므로 kernel 의 readahead 를 크게 한다 */
+    posix_madvise((void *)mapped, mappedSize, POSIX_MADV_SEQUENTIAL);
+
+    if (config.mode == UsbReplayConfig::Timestamps) {
+        if (!loadIndex(config.indexPath.isEmpty() ? filePath + ".idx" : config.indexPath)) {
+            file.unmap((uchar *)mapped);
+            file.close();
+            mapped = NULL;
+            return false;
+        }
+    }
+
+    /* 전송 할당 (buffer 는 submit 시에 map 영역을 가리키도록 설정한다) */
+    for (int i = 0; i < config.transferCount; i++) {
+        libusb_transfer *transfer = libusb_alloc_transfer(0);
+        if (transfer == NULL)
+            break;
+        transfers.append(transfer);
+        idleTransfers.push(transfer);
+    }
+    freeSlots.acquire(freeSlots.available());
+    freeSlots.release(transfers.size());
+
+    if (transfers.isEmpty() || !usbComm->startEventHandler()) {
+        freeTransfers();
+        file.unmap((uchar *)mapped);
+        file.close();
+        mapped = NULL;
+        return false;
+    }
+
+    /* 통계 초기화 */
+    bytesSent.storeRelaxed(0);
+    transfersCompleted.storeRelaxed(0);
+    transferErrors.storeRelaxed(0);
+    endNs.storeRelaxed(0);
+    jitterCount = 0;
+    jitterMean = 0;
+    jitterM2 = 0;
+    jitterMin = 0;
+    jitterMax = 0;
+    lateCount = 0;
+
+    stopping.storeRelease(0);
+    failed.storeRelease(0);
+
+    if (submitter == NULL)
+        submitter = new UsbReplaySubmitter(this, this);
+    startNs = monotonicNowNs();
+    submitter->start();
+
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 재생 중단
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbReplayer::stop()
+{
+    if (submitter != NULL && submitter->isRunning()) {
+        stopping.storeRelease(1);
+        for (int i = 0; i < transfers.size(); i++)
+            libusb_cancel_transfer(transfers.at(i));
+        submitter->wait();
+    }
+
+    freeTransfers();
+
+    if (mapped != NULL) {
+        file.unmap((uchar *)mapped);
+        mapped = NULL;
+    }
+    file.close();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 재생중 여부
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+bool UsbReplayer::isReplaying() const
+{
+    return submitter != NULL && submitter->isRunning();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 통계
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbReplayStats UsbReplayer::stats() const
+{
+    UsbReplayStats s;
+    s.bytesTotal = mappedSize;
+    s.bytesSent = bytesSent.loadRelaxed();
+    s.transfersCompleted = transfersCompleted.loadRelaxed();
+    s.transferErrors = transferErrors.loadRelaxed();
+
+    qint64 end = endNs.loadRelaxed();
+    if (startNs != 0)
+        s.elapsedSec = ((end != 0 ? end : monotonicNowNs()) - startNs) / 1e9;
+
+    QMutexLocker locker(&statsMutex);
+    s.pacedSubmits = jitterCount;
+    s.jitterMeanUs = jitterMean / 1e3;
+    s.jitterStdDevUs = jitterCount > 1 ? std::sqrt(jitterM2 / (jitterCount - 1)) / 1e3 : 0;
+    s.jitterMinUs = jitterMin / 1e3;
+    s.jitterMaxUs = jitterMax / 1e3;
+    s.lateSubmits = lateCount;
+    return s;
+}
+
+/********************************************************************************/
+/*
+ * @brief: USB 전송 완료 callback (UsbComm event thread 에서 실행)
+ *
+ * 통계만 갱신하고 전송을 idle 로 돌려준다. 다음 submit 은 submit thread 가 한다.
+ *
+ *@return:
+ */
+/********************************************************************************/
+void LIBUSB_CALL UsbReplayer::transferCallback(libusb_transfer *transfer)
+{
+    UsbReplayer *replayer = (UsbReplayer *)transfer->user_data;
+
+    if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+        replayer->bytesSent.fetchAndAddRelaxed(transfer->actual_length);
+        replayer->transfersCompleted.fetchAndAddRelaxed(1);
+    } else if (transfer->status != LIBUSB_TRANSFER_CANCELLED) {
+        /* TIMED_OUT, STALL, NO_DEVICE 등: 일부만 전송된 상태이므로 재생을 중단한다 */
+        replayer->bytesSent.fetchAndAddRelaxed(transfer->actual_length);
+        replayer->transferErrors.fetchAndAddRelaxed(1);
+        replayer->failed.storeRelease(1);
+    }
+
+    replayer->transferMutex.lock();
+    replayer->idleTransfers.push(transfer);
+    replayer->transferMutex.unlock();
+    replayer->freeSlots.release();
+}
+
+/********************************************************************************/
+/*
+ *@brief: submit thread main loop
+ *
+ * 1. 다음 chunk 와 예정 시각을 정한다
+ * 2. idle 전송이 생길 때까지 기다린다 (= in flight 전송 수 제한)
+ * 3. 예정 시각까지 sleep 후, map 영역을 가리키도록 전송을 채워 submit 한다
+ *
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbReplayer::submitLoop()
+{
+    quint64 offset = 0;
+    int entry = 0;
+
+    while (offset < mappedSize && !stopping.loadAcquire() && !failed.loadAcquire()) {
+        /* 1. chunk 범위와 예정 시각 */
+        quint64 chunkEnd = mappedSize;
+        qint64 deadlineNs = -1;
+
+        if (config.mode == UsbReplayConfig::ByteRate) {
+            deadlineNs = startNs + (qint64)(offset * 1e9 / config.bytesPerSec);
+        } else if (config.mode == UsbReplayConfig::Timestamps) {
+            while (entry + 1 < index.size() && index.at(entry + 1).offset <= offset)
+                entry++;
+            /* entry 의 첫 chunk 만 원래 시각에 맞추고, transferSize 로 나눈 나머지 chunk 는 바로 이어서 보낸다 */
+            if (index.at(entry).offset == offset)
+                deadlineNs = startNs + (qint64)(index.at(entry).timestampNs - index.at(0).timestampNs);
+            if (entry + 1 < index.size())
+                chunkEnd = qMin<quint64>(index.at(entry + 1).offset, mappedSize);
+        }
+
+        int length = (int)qMin<quint64>(config.transferSize, chunkEnd - offset);
+
+        /* 2. idle 전송 대기 */
+        bool acquired = false;
+        while (!acquired && !stopping.loadAcquire())
+            acquired = freeSlots.tryAcquire(1, 100);
+        if (!acquired)
+            break;
+
+        /* 3. pacing */
+        if (deadlineNs >= 0) {
+            if (!sleepUntil(deadlineNs)) {
+                freeSlots.release();
+                break;
+            }
+            addJitterSample(monotonicNowNs() - deadlineNs);
+        }
+
+        transferMutex.lock();
+        libusb_transfer *transfer = idleTransfers.pop();
+        transferMutex.unlock();
+
+        /* OUT 전송은 buffer 를 읽기만 하므로, read-only map 영역을 그대로 넘긴다 */
+        libusb_fill_bulk_transfer(transfer, deviceHandle, endpoint, (unsigned char *)(mapped + offset),
+                                  length, transferCallback, this, config.timeout);
+
+        int err = libusb_submit_transfer(transfer);
+        if (err != LIBUSB_SUCCESS) {
+            qDebug() << "UsbReplayer: libusb_submit_transfer error:" << libusb_error_name(err);
+            transferErrors.fetchAndAddRelaxed(1);
+            failed.storeRelease(1);
+            transferMutex.lock();
+            idleTransfers.push(transfer);
+            transferMutex.unlock();
+            freeSlots.release();
+            break;
+        }
+
+        offset += length;
+    }
+
+    /* in flight 전송이 모두 끝날 때까지 기다린다 (stop 이면 반복해서 취소) */
+    while (!freeSlots.tryAcquire(transfers.size(), 100)) {
+        if (stopping.loadAcquire()) {
+            for (int i = 0; i < transfers.size(); i++)
+                libusb_cancel_transfer(transfers.at(i));
+        }
+    }
+    freeSlots.release(transfers.size());
+
+    endNs.storeRelaxed(monotonicNowNs());
+
+    emit sigReplayFinished(!failed.loadAcquire() && bytesSent.loadRelaxed() == mappedSize);
+}
+
+/********************************************************************************/
+/*
+ *@brief: timestamp index 파일(UsbCaptureIndexEntry 배열) 읽기
+ *@param:
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbReplayer::loadIndex(const QString &indexPath)
+{
+    QFile indexFile(indexPath);
+    if (!indexFile.open(QIODevice::ReadOnly)) {
+        qDebug() << "UsbReplayer: index open error:" << indexPath << indexFile.errorString();
+        return false;
+    }
+
+    QByteArray data = indexFile.readAll();
+    int count = data.size() / sizeof(UsbCaptureIndexEntry);
+    if (count == 0) {
+        qDebug() << "UsbReplayer: index is empty:" << indexPath;
+        return false;
+    }
+
+    index.resize(count);
+    memcpy(index.data(), data.constData(), count * sizeof(UsbCaptureIndexEntry));
+
+    /* 재생 파일보다 긴 부분은 무시하고, 첫 entry 는 offset 0 부터 시작하게 한다 */
+    while (!index.isEmpty() && index.last().offset >= mappedSize)
+        index.removeLast();
+    if (index.isEmpty())
+        return false;
+    index[0].offset = 0;
+
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 예정 시각까지 대기
+ *
+ * clock_nanosleep(TIMER_ABSTIME) 으로 대부분을 자고, 마지막 kSpinMarginNs 는 spin 한다.
+ * 상대 시간 sleep 을 반복하면 오차가 누적되므로 항상 절대 시각을 기준으로 한다.
+ * 낮은 rate 나 index 의 긴 공백에서도 stop() 이 바로 반영되도록, kSleepSliceNs 마다 stopping 을 확인한다.
+ *
+ *@param:   deadlineNs: CLOCK_MONOTONIC 기준 절대 시각
+ *@return:  true=예정 시각 도달  false=stop() 되었다
+ */
+/********************************************************************************/
+bool UsbReplayer::sleepUntil(qint64 deadlineNs)
+{
+    qint64 sleepUntilNs = deadlineNs - kSpinMarginNs;
+    for (;;) {
+        if (stopping.loadAcquire())
+            return false;
+
+        qint64 nowNs = monotonicNowNs();
+        if (nowNs >= sleepUntilNs)
+            break;
+
+        qint64 wakeNs = qMin(sleepUntilNs, nowNs + kSleepSliceNs);
+        struct timespec ts;
+        ts.tv_sec = wakeNs / 1000000000LL;
+        ts.tv_nsec = wakeNs % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+    }
+
+    while (monotonicNowNs() < deadlineNs) {
+    }
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: jitter 표본 누적 (Welford 방식으로 평균/분산을 한번에 계산)
+ *@param:   jitterNs: 실제 submit 시각 - 예정 시각
+ *@return:
+ */
+/********************************************************************************/
+void UsbReplayer::addJitterSample(qint64 jitterNs)
+{
+    QMutexLocker locker(&statsMutex);
+
+    double x = (double)jitterNs;
+    jitterCount++;
+    double delta = x - jitterMean;
+    jitterMean += delta / jitterCount;
+    jitterM2 += delta * (x - jitterMean);
+
+    if (jitterCount == 1 || x < jitterMin)
+        jitterMin = x;
+    if (jitterCount == 1 || x > jitterMax)
+        jitterMax = x;
+
+    if (jitterNs > kLateThresholdNs)
+        lateCount++;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 전송 해제 (in flight 전송이 없을 때만 호출)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbReplayer::freeTransfers()
+{
+    for (int i = 0; i < transfers.size(); i++)
+        libusb_free_transfer(transfers.at(i));
+    transfers.clear();
+    idleTransfers.clear();
+}
+
+
+
+
+/********************************************************************************/
+/* Part2: UsbReplaySubmitter */
+/********************************************************************************/
+
+/********************************************************************************/
+/*
+ *@brief:	생성자함수
+ *@param:	replayer: 재생 상태를 소유한 UsbReplayer
+ *@parent:	parent:
+ */
+/********************************************************************************/
+UsbReplaySubmitter::UsbReplaySubmitter(UsbReplayer *replayer, QObject *parent) : QThread(parent)
+{
+    this->replayer = replayer;
+}
+
+/********************************************************************************/
+/*
+ *@brief: Sub thread
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbReplaySubmitter::run()
+{
+    if (!replayer->config.submitterSched.isDefault())
+        UsbThreadSched::applyToCurrentThread(replayer->config.submitterSched);
+    replayer->submitLoop();
+}
@@ -0,0 +1,178 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * 기록 파일을 bulk OUT endpoint 로 재생(replay)하는 파트
+ *
+ * 파일은 memory map 하여, 전송 buffer 로 map 된 영역을 그대로 사용한다 (복사 없음).
+ *
+ * 재생 mode:
+ * 	MaxSpeed   : 가능한 최대 속도 (전송 N개를 항상 in flight 로 유지)
+ * 	ByteRate   : 지정 bytes/s 로 pacing
+ * 	Timestamps : UsbRecorder 가 만든 timestamp index(<파일>.idx)의 원래 시각대로 pacing
+ *
+ * pacing 은 submit thread(UsbReplaySubmitter)가 절대 시각까지 sleep 한 후 submit 하며,
+ * 예정 시각과 실제 submit 시각의 차이를 jitter 통계로 남긴다.
+ */
+#ifndef USBREPLAYER_H
+#define USBREPLAYER_H
+
+#include <QObject>
+#include <QThread>
+#include <QFile>
+#include <QMutex>
+#include <QSemaphore>
+#include <QVector>
+#include <QStack>
+#include <usbcomm.h>
+#include <usbrecorder.h>
+
+/********************************************************************************/
+/* 재생 설정 */
+/********************************************************************************/
+struct UsbReplayConfig
+{
+    enum Mode {
+        MaxSpeed,
+        ByteRate,
+        Timestamps
+    };
+
+    Mode mode = MaxSpeed;
+    /* ByteRate mode 의 목표 속도 (bytes/s) */
+    double bytesPerSec = 0;
+    /* Timestamps mode 의 index 파일 (비어있으면 <파일>.idx) */
+    QString indexPath;
+    /* USB 전송 1개의 최대 크기 */
+    int transferSize = 256 * 1024;
+    /* 동시에 in flight 로 두는 전송 수 */
+    int transferCount = 8;
+    /* 전송 timeout (ms, 0 = 무한) */
+    quint32 timeout = 5000;
+    /* submit thread 의 scheduling 설정 (pacing 정확도용, 기본값이면 변경하지 않는다) */
+    UsbThreadSchedConfig submitterSched;
+};
+
+/********************************************************************************/
+/* 재생 통계 */
+/********************************************************************************/
+struct UsbReplayStats
+{
+    quint64 bytesTotal = 0;			/* 재생할 파일 크기 */
+    quint64 bytesSent = 0;			/* 전송 완료된 bytes */
+    quint64 transfersCompleted = 0;
+    quint64 transferErrors = 0;
+    double elapsedSec = 0;
+
+    /* pacing jitter (실제 submit 시각 - 예정 시각, us). MaxSpeed mode 에서는 집계하지 않는다 */
+    quint64 pacedSubmits = 0;
+    double jitterMeanUs = 0;
+    double jitterStdDevUs = 0;
+    double jitterMinUs = 0;
+    double jitterMaxUs = 0;
+    /* in flight 전송이 모두 사용중이라 예정 시각을 놓친 횟수 (1ms 이상 늦음) */
+    quint64 lateSubmits = 0;
+
+    double sendMBps() const {return elapsedSec > 0 ? bytesSent / 1e6 / elapsedSec : 0;}
+};
+
+class UsbReplaySubmitter;
+
+/********************************************************************************/
+/* 파트1. 재생 Class */
+/********************************************************************************/
+class UsbReplayer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UsbReplayer(UsbComm *usbComm, QObject *parent = 0);
+    ~UsbReplayer();
+
+    /* 재생 시작 (deviceHandle 은 UsbComm::getDeviceHandleFrom_xxx 로 취득, interface 는 미리 선언해둔다) */
+    bool start(libusb_device_handle *deviceHandle, quint8 endpoint, const QString &filePath,
+               const UsbReplayConfig &config = UsbReplayConfig());
+    /* 재생 중단 (진행중인 전송 취소) */
+    void stop();
+
+    bool isReplaying() const;
+
+    /* 현재 통계 (어느 thread 에서든 호출 가능) */
+    UsbReplayStats stats() const;
+
+signals:
+    /* 파일 끝까지 재생했거나, 에러/stop() 으로 끝났을 때 (submit thread 에서 발생) */
+    void sigReplayFinished(bool ok);
+
+private:
+    friend class UsbReplaySubmitter;
+
+    /* USB 전송 완료 callback (UsbComm event thread 에서 실행) */
+    static void LIBUSB_CALL transferCallback(libusb_transfer *transfer);
+    /* submit thread 의 main loop */
+    void submitLoop();
+    /* Timestamps mode 의 index 파일 읽기 */
+    bool loadIndex(const QString &indexPath);
+    /* 예정 시각(CLOCK_MONOTONIC ns)까지 대기 (stop() 되면 false) */
+    bool sleepUntil(qint64 deadlineNs);
+    /* pacing jitter 누적 */
+    void addJitterSample(qint64 jitterNs);
+
+    void freeTransfers();
+
+    UsbComm *usbComm;
+    libusb_device_handle *deviceHandle;
+    quint8 endpoint;
+    UsbReplayConfig config;
+
+    /* memory map 된 재생 파일 */
+    QFile file;
+    const quint8 *mapped;
+    quint64 mappedSize;
+    QVector<UsbCaptureIndexEntry> index;
+
+    /* USB 전송 (idleTransfers 는 transferMutex 로 보호, freeSlots 는 idle 전송의 수) */
+    QVector<libusb_transfer *> transfers;
+    QStack<libusb_transfer *> idleTransfers;
+    QMutex transferMutex;
+    QSemaphore freeSlots;
+    QAtomicInt stopping;
+    QAtomicInt failed;
+    UsbReplaySubmitter *submitter;
+
+    /* 통계 (jitter 는 statsMutex 로 보호) */
+    QAtomicInteger<quint64> bytesSent;
+    QAtomicInteger<quint64> transfersCompleted;
+    QAtomicInteger<quint64> transferErrors;
+    qint64 startNs;
+    QAtomicInteger<qint64> endNs;
+    mutable QMutex statsMutex;
+    quint64 jitterCount;
+    double jitterMean;
+    double jitterM2;
+    double jitterMin;
+    double jitterMax;
+    quint64 lateCount;
+};
+
+
+/********************************************************************************/
+/* 파트2. submit thread */
+/********************************************************************************/
+/*
+ * UsbReplayer 의 pacing 과 submit 만 담당하는 thread.
+ * event thread 에서 sleep 할 수 없으므로 pacing 대기는 이 thread 에서 한다.
+ */
+class UsbReplaySubmitter : public QThread
+{
+    Q_OBJECT
+public:
+    UsbReplaySubmitter(UsbReplayer *replayer, QObject *parent = 0);
+
+protected:
+    virtual void run();
+
+private:
+    UsbReplayer *replayer;
+};
+
+#endif // USBREPLAYER_H
@@ -0,0 +1,345 @@
+/********************************************************************************/
+/* 전송 재시도 정책 (backoff + 복구 동작) Part */
+/********************************************************************************/
+#include "usbretry.h"
+#include <QDebug>
+#include <QTimer>
+#include <QRandomGenerator>
+#include <utility>
+
+namespace {
+
+/* libusb_transfer 완료 상태 -> UsbComm::bulkTransfer() 와 같은 결과 값 */
+int transferResult(const libusb_transfer *transfer)
+{
+    switch (transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED:	return transfer->actual_length;
+    /* 일부라도 전송됐으면 성공으로 본다 (bulkTransfer() 와 같다), 0 bytes 면 재시도 판단을 위해 에러로 한다 */
+    case LIBUSB_TRANSFER_TIMED_OUT:	return transfer->actual_length > 0 ? transfer->actual_length : LIBUSB_ERROR_TIMEOUT;
+    case LIBUSB_TRANSFER_CANCELLED:	return LIBUSB_ERROR_INTERRUPTED;
+    case LIBUSB_TRANSFER_STALL:		return LIBUSB_ERROR_PIPE;
+    case LIBUSB_TRANSFER_NO_DEVICE:	return LIBUSB_ERROR_NO_DEVICE;
+    case LIBUSB_TRANSFER_OVERFLOW:	return LIBUSB_ERROR_OVERFLOW;
+    default:						return LIBUSB_ERROR_IO;
+    }
+}
+
+}
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:   usbComm: device handle 을 관리하는 UsbComm (event thread 와 worker pool 도 이 obj 의 것을 사용한다)
+ *@return:
+ */
+/********************************************************************************/
+UsbRetryExecutor::UsbRetryExecutor(UsbComm *usbComm, QObject *parent) : QObject(parent)
+{
+    this->usbComm = usbComm;
+    inFlight = 0;
+    stopping = false;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자, 진행중인 전송을 취소하고 남은 future 는 LIBUSB_ERROR_INTERRUPTED 로 끝낸다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbRetryExecutor::~UsbRetryExecutor()
+{
+    mutex.lock();
+    stopping = true;
+    while (inFlight > 0) {
+        /* lock 을 잡은 채로 transfer 목록을 복사한다 (취소는 lock 밖에서, 진행중이 아닌 transfer 는 LIBUSB_ERROR_NOT_FOUND 로 무시된다) */
+        QList<libusb_transfer *> transfers;
+        for (Operation *op : std::as_const(operations)) {
+            if (op->transfer != NULL)
+                transfers.append(op->transfer);
+        }
+        mutex.unlock();
+        for (libusb_transfer *transfer : transfers)
+            libusb_cancel_transfer(transfer);
+        mutex.lock();
+        if (inFlight > 0)
+            inFlightDone.wait(&mutex, 100);
+    }
+    mutex.unlock();
+
+    /* backoff/복구 동작 대기중인 것 포함 (timer 와 .then() 은 이 obj 와 함께 없어진다) */
+    while (!operations.isEmpty())
+        finish(*operations.constBegin(), LIBUSB_ERROR_INTERRUPTED);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 기본 정책으로 bulk 전송
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+QFuture<int> UsbRetryExecutor::bulkTransfer(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data,
+                                            int length, quint32 timeout)
+{
+    return bulkTransfer(deviceHandle, endpoint, data, length, timeout, defaultPolicy);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 재시도 정책을 적용한 bulk 전송
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: bulk endpoint 주소
+ *@param:   data: 전송 buffer (future 가 끝날 때까지 유효해야 한다, 재시도는 실패한 시도에서 전송된 bytes 다음부터 한다)
+ *@param:   length: 전송 길이
+ *@param:   timeout: 1회 시도의 timeout (ms)
+ *@param:   policy: 재시도 정책
+ *@return:  결과 future (전송된 bytes, 에러면 마지막 시도의 에러)
+ */
+/********************************************************************************/
+QFuture<int> UsbRetryExecutor::bulkTransfer(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data,
+                                            int length, quint32 timeout, const UsbRetryPolicy &policy)
+{
+    Operation *op = new Operation;
+    op->owner = this;
+    op->policy = policy;
+    op->deviceHandle = deviceHandle;
+    op->endpoint = endpoint;
+    op->data = data;
+    op->length = length;
+    op->timeout = timeout;
+    op->attempt = 0;
+    op->done = 0;
+    op->backoffMs = qMax(0, policy.initialBackoffMs);
+    op->transfer = NULL;
+
+    QFuture<int> future = op->promise.future();
+    op->promise.start();
+    mutex.lock();
+    operations.insert(op);
+    mutex.unlock();
+
+    if (!usbComm->startEventHandler()) {
+        finish(op, LIBUSB_ERROR_OTHER);
+    } else if ((op->transfer = libusb_alloc_transfer(0)) == NULL) {
+        finish(op, LIBUSB_ERROR_NO_MEM);
+    } else {
+        submitAttempt(op);
+    }
+
+    return future;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 복구 동작 통계
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbRecoveryCounters UsbRetryExecutor::counters() const
+{
+    UsbRecoveryCounters c;
+    c.attempts = attemptCount.loadRelaxed();
+    c.retries = retryCount.loadRelaxed();
+    c.clearHalts = clearHaltCount.loadRelaxed();
+    c.altSettingResets = altSettingResetCount.loadRelaxed();
+    c.deviceResets = deviceResetCount.loadRelaxed();
+    c.recovered = recoveredCount.loadRelaxed();
+    c.exhausted = exhaustedCount.loadRelaxed();
+    return c;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 1회 전송 submit
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRetryExecutor::submitAttempt(Operation *op)
+{
+    op->attempt++;
+    attemptCount.fetchAndAddRelaxed(1);
+
+    if (!usbComm->isUsbDeviceOpened(op->deviceHandle)) {
+        handleResult(op, -100, 0);
+        return;
+    }
+
+    /* 이전 시도에서 일부 전송된 경우는 이어서 한다 (OUT 을 처음부터 다시 보내면 device 는 같은 bytes 를 2번 받는다) */
+    libusb_fill_bulk_transfer(op->transfer, op->deviceHandle, op->endpoint, op->data + op->done, op->length - op->done,
+                              transferCallback, op, op->timeout);
+
+    QMutexLocker locker(&mutex);
+    int err = libusb_submit_transfer(op->transfer);
+    if (err == LIBUSB_SUCCESS) {
+        inFlight++;
+        return;
+    }
+    locker.unlock();
+
+    qDebug() << "UsbRetryExecutor: libusb_submit_transfer error:" << libusb_error_name(err);
+    handleResult(op, err, 0);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 1회 전송의 결과 처리 (이 obj 의 thread 에서 실행)
+ *@param:   result: 전송된 bytes, 에러면 LIBUSB_ERROR_xxx
+ *@param:   actualLength: 에러로 끝난 시도에서 전송된 bytes (재시도는 그 다음부터 한다)
+ *@return:
+ */
+/********************************************************************************/
+void UsbRetryExecutor::handleResult(Operation *op, int result, int actualLength)
+{
+    if (result >= 0) {
+        if (op->attempt > 1)
+            recoveredCount.fetchAndAddRelaxed(1);
+        finish(op, op->done + result);
+        return;
+    }
+
+    op->done += qMax(0, actualLength);
+    if (op->done >= op->length) {
+        finish(op, op->done);
+        return;
+    }
+
+    if (!op->policy.retriableErrors.contains(result)) {
+        finish(op, result);
+        return;
+    }
+
+    if (op->attempt >= op->policy.maxAttempts) {
+        qDebug() << "UsbRetryExecutor: gave up after" << op->attempt << "attempts:" << libusb_error_name(result)
+                 << "endpoint" << Qt::hex << op->endpoint;
+        if (op->attempt > 1)
+            exhaustedCount.fetchAndAddRelaxed(1);
+        finish(op, result);
+        return;
+    }
+
+    recoverAndRetry(op, result);
+}
+
+/********************************************************************************/
+/*
+ * 정책에 따른 복구 동작 후 backoff 해서 재전송
+ *
+ * NOTE:
+ * 	복구 동작은 동기 libusb 호출이므로 UsbComm 의 worker pool 에서 실행하고, 끝나면 이 obj 의 thread 로 돌아온다.
+ * 	같은 재시도에서 여러 조건에 해당하면 device reset > alt setting 재설정 > clear halt 순으로 하나만 한다
+ * 	(device reset / alt setting 재설정은 endpoint 의 halt 상태도 해제한다).
+ *
+ *@param:   error: 직전 시도의 에러
+ *@return:
+ */
+/********************************************************************************/
+void UsbRetryExecutor::recoverAndRetry(Operation *op, int error)
+{
+    const UsbRetryPolicy &policy = op->policy;
+    int retry = op->attempt;		/* 이번이 몇 번째 재시도인지 */
+    retryCount.fetchAndAddRelaxed(1);
+
+    if (policy.deviceResetAfter > 0 && retry % policy.deviceResetAfter == 0) {
+        usbComm->resetUsbDeviceAsync(op->deviceHandle).then(this, [this, op](bool ok) {
+            deviceResetCount.fetchAndAddRelaxed(1);
+            /* reset 후 device 가 다시 나타나지 않으면 (handle 이 닫혔으면) 더 이상 재시도하지 않는다 */
+            if (!ok && !usbComm->isUsbDeviceOpened(op->deviceHandle)) {
+                finish(op, LIBUSB_ERROR_NO_DEVICE);
+                return;
+            }
+            scheduleRetry(op);
+        });
+        return;
+    }
+
+    if (policy.altSettingResetAfter > 0 && retry % policy.altSettingResetAfter == 0) {
+        usbComm->setUsbInterfaceAltSettingAsync(op->deviceHandle, policy.interfaceNumber, policy.alternateSetting)
+            .then(this, [this, op](bool) {
+                altSettingResetCount.fetchAndAddRelaxed(1);
+                scheduleRetry(op);
+            });
+        return;
+    }
+
+    if (error == LIBUSB_ERROR_PIPE && policy.clearHaltOnStall) {
+        usbComm->clearHaltAsync(op->deviceHandle, op->endpoint).then(this, [this, op](bool) {
+            clearHaltCount.fetchAndAddRelaxed(1);
+            scheduleRetry(op);
+        });
+        return;
+    }
+
+    scheduleRetry(op);
+}
+
+/********************************************************************************/
+/*
+ *@brief: backoff 후 재전송 (backoff 는 시도마다 backoffMultiplier 배, maxBackoffMs 까지)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRetryExecutor::scheduleRetry(Operation *op)
+{
+    const UsbRetryPolicy &policy = op->policy;
+
+    double delay = qMin(op->backoffMs, policy.maxBackoffMs);
+    if (policy.jitter > 0)
+        delay *= 1.0 + policy.jitter * (QRandomGenerator::global()->generateDouble() * 2.0 - 1.0);
+    op->backoffMs = (int)qMin<double>(op->backoffMs * policy.backoffMultiplier, policy.maxBackoffMs);
+
+    QTimer::singleShot(qMax(0, qRound(delay)), this, [this, op]() {
+        submitAttempt(op);
+    });
+}
+
+/********************************************************************************/
+/*
+ *@brief: future 에 결과를 설정하고 operation 을 정리한다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRetryExecutor::finish(Operation *op, int result)
+{
+    mutex.lock();
+    operations.remove(op);
+    mutex.unlock();
+    op->promise.addResult(result);
+    op->promise.finish();
+    libusb_free_transfer(op->transfer);
+    delete op;
+}
+
+/********************************************************************************/
+/*
+ * @brief: USB 전송 완료 callback (UsbComm event thread 에서 실행)
+ *
+ * NOTE: 재시도 판단은 이 thread 에서 하지 않고 executor 의 thread 로 넘긴다 (복구 동작으로 event thread 를 막지 않도록).
+ *
+ *@return:
+ */
+/********************************************************************************/
+void LIBUSB_CALL UsbRetryExecutor::transferCallback(libusb_transfer *transfer)
+{
+    Operation *op = (Operation *)transfer->user_data;
+    UsbRetryExecutor *executor = op->owner;
+    int result = transferResult(transfer);
+    int actualLength = result < 0 ? transfer->actual_length : 0;
+
+    QMutexLocker locker(&executor->mutex);
+    executor->inFlight--;
+
+    /* 소멸자에서 취소한 경우는 소멸자가 정리한다 */
+    if (!executor->stopping) {
+        QMetaObject::invokeMethod(executor, [executor, op, result, actualLength]() {
+            executor->handleResult(op, result, actualLength);
+        }, Qt::QueuedConnection);
+    }
+
+    if (executor->inFlight == 0)
+        executor->inFlightDone.wakeAll();
+}
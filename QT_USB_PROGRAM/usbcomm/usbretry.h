@@ -0,0 +1,149 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * 전송 재시도 정책 (backoff + 복구 동작의 단계적 확대)
+ *
+ * 일시적인 에러(timeout, STALL, I/O 에러 등)로 capture 작업 전체가 중단되지 않도록,
+ * 실패한 전송을 정책에 따라 재시도한다.
+ *
+ * 재시도 1회마다:
+ * 	1. STALL(LIBUSB_ERROR_PIPE) 이면 clear halt
+ * 	2. deviceResetAfter 회째 마다 device reset, altSettingResetAfter 회째 마다 alt setting 재설정
+ * 	3. backoff (initialBackoffMs * backoffMultiplier^n, 최대 maxBackoffMs, ±jitter) 후 재전송
+ *
+ * event thread 를 막지 않는다:
+ * 	전송은 libusb 비동기 전송, 복구 동작은 UsbComm 의 worker pool(xxxAsync), backoff 는 QTimer 로 처리하고,
+ * 	재시도 판단은 UsbRetryExecutor 가 속한 thread 의 event loop 에서 한다.
+ */
+#ifndef USBRETRY_H
+#define USBRETRY_H
+
+#include <QObject>
+#include <QList>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInteger>
+#include <QFuture>
+#include <QPromise>
+#include <usbcomm.h>
+
+/********************************************************************************/
+/* 재시도 정책 */
+/********************************************************************************/
+struct UsbRetryPolicy
+{
+    /* 최대 시도 횟수 (최초 시도 포함, 1 이면 재시도 없음) */
+    int maxAttempts = 3;
+    /* backoff */
+    int initialBackoffMs = 10;
+    double backoffMultiplier = 2.0;
+    int maxBackoffMs = 1000;
+    /* backoff 를 ±jitter 비율만큼 흔든다 (여러 device 가 동시에 재시도하지 않도록) */
+    double jitter = 0.2;
+    /* 재시도 대상 에러 (LIBUSB_ERROR_xxx) */
+    QList<int> retriableErrors = {LIBUSB_ERROR_TIMEOUT, LIBUSB_ERROR_PIPE, LIBUSB_ERROR_IO,
+                                  LIBUSB_ERROR_BUSY, LIBUSB_ERROR_OVERFLOW, LIBUSB_ERROR_INTERRUPTED};
+
+    /* 복구 동작 */
+    bool clearHaltOnStall = true;
+    /* n 번째 재시도 마다 alt setting 재설정 (0 이면 하지 않는다) */
+    int altSettingResetAfter = 0;
+    int interfaceNumber = 0;
+    int alternateSetting = 0;
+    /* n 번째 재시도 마다 device reset (0 이면 하지 않는다) */
+    int deviceResetAfter = 0;
+};
+
+/********************************************************************************/
+/* 복구 동작 통계 */
+/********************************************************************************/
+struct UsbRecoveryCounters
+{
+    quint64 attempts = 0;			/* 전송 시도 수 (재시도 포함) */
+    quint64 retries = 0;			/* 재시도 수 */
+    quint64 clearHalts = 0;			/* clear halt 수 */
+    quint64 altSettingResets = 0;	/* alt setting 재설정 수 */
+    quint64 deviceResets = 0;		/* device reset 수 */
+    quint64 recovered = 0;			/* 재시도 후 성공한 전송 수 */
+    quint64 exhausted = 0;			/* 재시도 횟수를 다 쓰고 실패한 전송 수 */
+};
+
+/********************************************************************************/
+/* 재시도 실행 Class */
+/********************************************************************************/
+class UsbRetryExecutor : public QObject
+{
+    Q_OBJECT
+public:
+    /* 재시도 판단은 이 obj 의 thread 에서 하므로, 그 thread 에 event loop 가 필요하다 (bulkTransfer() 도 그 thread 에서 호출한다) */
+    explicit UsbRetryExecutor(UsbComm *usbComm, QObject *parent = 0);
+    ~UsbRetryExecutor();
+
+    /* 기본 정책 */
+    void setPolicy(const UsbRetryPolicy &policy) {defaultPolicy = policy;}
+    UsbRetryPolicy policy() const {return defaultPolicy;}
+
+    /* 재시도 정책을 적용한 bulk 전송, 결과는 UsbComm::bulkTransfer() 와 같다 (data 는 future 가 끝날 때까지 유효해야 한다)
+     * timeout 으로 0 bytes 만 전송된 경우는 LIBUSB_ERROR_TIMEOUT 으로 보고 재시도한다 */
+    QFuture<int> bulkTransfer(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, int length,
+                              quint32 timeout);
+    QFuture<int> bulkTransfer(libusb_device_handle *deviceHandle, quint8 endpoint, quint8 *data, int length,
+                              quint32 timeout, const UsbRetryPolicy &policy);
+
+    /* 복구 동작 통계 */
+    UsbRecoveryCounters counters() const;
+
+private:
+    /* 진행중인 전송 1개 (재시도 포함) */
+    struct Operation
+    {
+        QPromise<int> promise;
+        UsbRetryExecutor *owner;
+        UsbRetryPolicy policy;
+        libusb_device_handle *deviceHandle;
+        quint8 endpoint;
+        quint8 *data;
+        int length;
+        quint32 timeout;
+        int attempt;				/* 지금까지의 시도 수 */
+        int done;					/* 실패한 시도까지 전송된 bytes (재시도는 그 다음부터 한다) */
+        int backoffMs;				/* 다음 backoff (jitter 적용 전) */
+        libusb_transfer *transfer;	/* 재시도마다 같은 transfer 를 재사용한다 */
+    };
+
+    /* USB 전송 완료 callback (UsbComm event thread 에서 실행) */
+    static void LIBUSB_CALL transferCallback(libusb_transfer *transfer);
+
+    /* 1회 전송 */
+    void submitAttempt(Operation *op);
+    /* 전송 결과 처리 (이 obj 의 thread 에서 실행), actualLength: 에러로 끝난 시도에서 전송된 bytes */
+    void handleResult(Operation *op, int result, int actualLength);
+    /* 정책에 따른 복구 동작 (clear halt / alt setting 재설정 / device reset) */
+    void recoverAndRetry(Operation *op, int error);
+    /* backoff 후 재전송 */
+    void scheduleRetry(Operation *op);
+    void finish(Operation *op, int result);
+
+    UsbComm *usbComm;
+    UsbRetryPolicy defaultPolicy;
+
+    /* 진행중인 operation, 진행중인 libusb 전송 수 (소멸자에서 취소 후 대기) */
+    QSet<Operation *> operations;
+    int inFlight;
+    bool stopping;
+    QMutex mutex;
+    QWaitCondition inFlightDone;
+
+    /* 통계 */
+    QAtomicInteger<quint64> attemptCount;
+    QAtomicInteger<quint64> retryCount;
+    QAtomicInteger<quint64> clearHaltCount;
+    QAtomicInteger<quint64> altSettingResetCount;
+    QAtomicInteger<quint64> deviceResetCount;
+    QAtomicInteger<quint64> recoveredCount;
+    QAtomicInteger<quint64> exhaustedCount;
+};
+
+#endif // USBRETRY_H
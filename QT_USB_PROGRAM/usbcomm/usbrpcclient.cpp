@@ -0,0 +1,477 @@
+/********************************************************************************/
+/* bulk OUT/IN endpoint 쌍 위의 request/response RPC */
+/********************************************************************************/
+#include "usbrpcclient.h"
+#include "usbtransferpool.h"
+#include "usbframeparser.h"
+#include <QDebug>
+#include <cstdlib>
+#include <cstring>
+
+/* frame header: [u32 length][u32 id] */
+static const int kRpcHeaderSize = 8;
+/* deadline 확인 주기 (ms) */
+static const int kDeadlineCheckIntervalMs = 10;
+
+static inline void writeLe32(quint8 *p, quint32 value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static inline quint32 readLe32(const quint8 *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((quint32)p[3] << 24);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:   usbComm: device handle 을 관리하는 UsbComm (event thread 도 이 obj 의 것을 사용한다)
+ *@return:
+ */
+/********************************************************************************/
+UsbRpcClient::UsbRpcClient(UsbComm *usbComm, QObject *parent) : QObject(parent)
+{
+    this->usbComm = usbComm;
+    deviceHandle = NULL;
+    outEndpoint = 0;
+    inEndpoint = 0;
+    running.storeRelaxed(0);
+
+    nextId = 1;
+    writePool = NULL;
+    parser = NULL;
+    inFlight = 0;
+
+    deadlineTimer.setInterval(kDeadlineCheckIntervalMs);
+    connect(&deadlineTimer, &QTimer::timeout, this, &UsbRpcClient::checkDeadlines);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbRpcClient::~UsbRpcClient()
+{
+    stop();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 시작 (응답 수신용 IN 전송을 submit 해둔다)
+ *@param:   deviceHandle: device handle
+ *@param:   outEndpoint: 요청을 보낼 bulk OUT endpoint
+ *@param:   inEndpoint: 응답을 받을 bulk IN endpoint
+ *@param:   config: 설정
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbRpcClient::start(libusb_device_handle *deviceHandle, quint8 outEndpoint, quint8 inEndpoint,
+                         const UsbRpcConfig &config)
+{
+    if (running.loadAcquire())
+        return false;
+
+    if (!usbComm->isUsbDeviceOpened(deviceHandle)) {
+        qDebug() << "UsbRpcClient: device not opened";
+        return false;
+    }
+
+    if ((outEndpoint & LIBUSB_ENDPOINT_IN) || !(inEndpoint & LIBUSB_ENDPOINT_IN)) {
+        qDebug() << "UsbRpcClient: invalid endpoint" << outEndpoint << inEndpoint;
+        return false;
+    }
+
+    this->deviceHandle = deviceHandle;
+    this->outEndpoint = outEndpoint;
+    this->inEndpoint = inEndpoint;
+    this->config = config;
+
+    if (!usbComm->startEventHandler())
+        return false;
+
+    /* 응답 frame 분리: [u32 length] 뒤의 [u32 id][payload] 를 frame 으로 꺼낸다 */
+    UsbFrameConfig frameConfig;
+    frameConfig.mode = UsbFrameConfig::LengthPrefix;
+    frameConfig.headerSize = 4;
+    frameConfig.maxFrameSize = config.maxResponseSize + 4;
+    parser = new UsbFrameParser(frameConfig);
+
+    /* 송신 buffer 는 응답 대기 수만큼 (write 완료 전에 응답이 먼저 처리되는 경우를 위해 2배) */
+    writePool = new UsbTransferPool(config.maxOutstanding * 2, config.maxRequestSize);
+
+    requestCount.storeRelaxed(0);
+    responseCount.storeRelaxed(0);
+    timeoutCount.storeRelaxed(0);
+    errorCount.storeRelaxed(0);
+    unmatchedCount.storeRelaxed(0);
+
+    inFlightMutex.lock();
+    stopping.storeRelease(0);
+    running.storeRelease(1);
+    inFlightMutex.unlock();
+
+    for (int i = 0; i < config.readTransfers; i++) {
+        libusb_transfer *transfer = libusb_alloc_transfer(0);
+        unsigned char *buffer = (unsigned char *)malloc(config.readSize);
+        if (transfer == NULL || buffer == NULL) {
+            qDebug() << "UsbRpcClient: transfer alloc error";
+            libusb_free_transfer(transfer);
+            free(buffer);
+            break;
+        }
+
+        /* timeout 0: 응답이 올 때까지 기다린다 */
+        libusb_fill_bulk_transfer(transfer, deviceHandle, inEndpoint, buffer, config.readSize, readCallback, this, 0);
+        transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+        readTransfers.append(transfer);
+
+        QMutexLocker locker(&inFlightMutex);
+        int err = libusb_submit_transfer(transfer);
+        if (err != LIBUSB_SUCCESS) {
+            qDebug() << "UsbRpcClient: libusb_submit_transfer error:" << libusb_error_name(err);
+            break;
+        }
+        inFlight++;
+    }
+
+    if (inFlight == 0) {
+        stop();
+        return false;
+    }
+
+    deadlineTimer.start();
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 종료
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRpcClient::stop()
+{
+    if (!running.loadAcquire())
+        return;
+
+    deadlineTimer.stop();
+
+    /* 1. 응답 수신 전송을 취소하고, 송신중인 전송(writeTimeout 이내에 끝난다)과 함께 모두 끝날 때까지 기다린다.
+     * 	stopping 은 inFlightMutex 를 잡고 설정한다 (이후의 call() 은 submit 하지 않고, 진행중인 call() 은 submit 을 마친 후이다) */
+    inFlightMutex.lock();
+    stopping.storeRelease(1);
+    while (inFlight > 0) {
+        inFlightMutex.unlock();
+        for (int i = 0; i < readTransfers.size(); i++)
+            libusb_cancel_transfer(readTransfers.at(i));
+        inFlightMutex.lock();
+        inFlightDone.wait(&inFlightMutex, 100);
+    }
+    inFlightMutex.unlock();
+
+    /* 2. 응답을 받지 못한 요청은 실패로 통지 */
+    pendingMutex.lock();
+    QList<quint32> ids = pending.keys();
+    pending.clear();
+    pendingMutex.unlock();
+
+    for (int i = 0; i < ids.size(); i++) {
+        errorCount.fetchAndAddRelaxed(1);
+        emit sigRequestFailed(ids.at(i), LIBUSB_ERROR_INTERRUPTED);
+    }
+
+    running.storeRelease(0);
+    freeBuffers();
+}
+
+/********************************************************************************/
+/*
+ * 요청 송신
+ *
+ * NOTE:
+ * 	응답을 기다리지 않고 return 하므로, 호출 측은 maxOutstanding 까지 계속 call() 할 수 있다.
+ * 	frame 은 pool 의 buffer 에 한번만 복사해서 보낸다 (요청마다 heap 할당 없음).
+ * 	확인 ~ submit 은 inFlightMutex 를 잡고 한다. stop() 은 같은 lock 으로 stopping 을 설정하고
+ * 	inFlight 가 0 이 된 후에 writePool 을 해제하므로, 해제된 pool 을 쓰거나 통지되지 않는 요청이 남지 않는다.
+ *
+ *@param:   payload: 요청 내용
+ *@param:   timeoutMs: 응답 기한 (ms), 지나면 sigRequestFailed(LIBUSB_ERROR_TIMEOUT)
+ *@return:  correlation id, 보내지 못했으면 0
+ */
+/********************************************************************************/
+quint32 UsbRpcClient::call(const QByteArray &payload, int timeoutMs)
+{
+    QMutexLocker locker(&inFlightMutex);
+    if (!running.loadAcquire() || stopping.loadAcquire())
+        return 0;
+
+    int frameSize = kRpcHeaderSize + payload.size();
+    if (frameSize > config.maxRequestSize) {
+        qDebug() << "UsbRpcClient: request too large" << payload.size();
+        return 0;
+    }
+
+    quint32 id;
+    {
+        QMutexLocker locker(&pendingMutex);
+        if (pending.size() >= config.maxOutstanding)
+            return 0;
+
+        id = nextId++;
+        if (nextId == 0)
+            nextId = 1;
+        pending.insert(id, QDeadlineTimer(timeoutMs));
+    }
+
+    UsbTransferPool::Slot *slot = writePool->acquire();
+    if (slot == NULL) {
+        QMutexLocker locker(&pendingMutex);
+        pending.remove(id);
+        return 0;
+    }
+
+    writeLe32(slot->buffer, frameSize - 4);
+    writeLe32(slot->buffer + 4, id);
+    memcpy(slot->buffer + kRpcHeaderSize, payload.constData(), payload.size());
+    slot->owner = this;
+
+    libusb_fill_bulk_transfer(slot->transfer, deviceHandle, outEndpoint, slot->buffer, frameSize, writeCallback, slot,
+                              config.writeTimeout);
+    slot->transfer->flags = 0;
+
+    int err = libusb_submit_transfer(slot->transfer);
+    if (err != LIBUSB_SUCCESS) {
+        qDebug() << "UsbRpcClient: libusb_submit_transfer error:" << libusb_error_name(err);
+        writePool->release(slot);
+
+        QMutexLocker pendingLocker(&pendingMutex);
+        pending.remove(id);
+        errorCount.fetchAndAddRelaxed(1);
+        return 0;
+    }
+    inFlight++;
+    locker.unlock();
+
+    requestCount.fetchAndAddRelaxed(1);
+    return id;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 응답을 기다리는 요청 수
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbRpcClient::outstanding() const
+{
+    QMutexLocker locker(&pendingMutex);
+    return pending.size();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 통계
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbRpcStats UsbRpcClient::stats() const
+{
+    UsbRpcStats s;
+    s.requests = requestCount.loadRelaxed();
+    s.responses = responseCount.loadRelaxed();
+    s.timeouts = timeoutCount.loadRelaxed();
+    s.errors = errorCount.loadRelaxed();
+    s.unmatched = unmatchedCount.loadRelaxed();
+    return s;
+}
+
+/********************************************************************************/
+/*
+ *@brief: deadline 이 지난 요청을 실패로 통지한다 (deadlineTimer)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRpcClient::checkDeadlines()
+{
+    QList<quint32> expired;
+
+    pendingMutex.lock();
+    for (QHash<quint32, QDeadlineTimer>::iterator it = pending.begin(); it != pending.end();) {
+        if (it.value().hasExpired()) {
+            expired.append(it.key());
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    pendingMutex.unlock();
+
+    for (int i = 0; i < expired.size(); i++) {
+        timeoutCount.fetchAndAddRelaxed(1);
+        emit sigRequestFailed(expired.at(i), LIBUSB_ERROR_TIMEOUT);
+    }
+}
+
+/********************************************************************************/
+/*
+ * @brief: 응답 수신 완료 callback (UsbComm event thread 에서 실행)
+ *@return:
+ */
+/********************************************************************************/
+void LIBUSB_CALL UsbRpcClient::readCallback(libusb_transfer *transfer)
+{
+    UsbRpcClient *client = (UsbRpcClient *)transfer->user_data;
+
+    bool resubmit = false;
+    switch (transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED:
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        if (transfer->actual_length > 0)
+            client->handleReceivedData(transfer->buffer, transfer->actual_length);
+        resubmit = !client->stopping.loadAcquire();
+        break;
+    case LIBUSB_TRANSFER_CANCELLED:
+        break;
+    default:
+        /* STALL, NO_DEVICE, OVERFLOW, ERROR: 이 전송은 더 이상 재submit 하지 않는다 */
+        qDebug() << "UsbRpcClient: read transfer error, status" << transfer->status;
+        break;
+    }
+
+    if (resubmit) {
+        int err = libusb_submit_transfer(transfer);
+        if (err == LIBUSB_SUCCESS)
+            return;
+        qDebug() << "UsbRpcClient: libusb_submit_transfer error:" << libusb_error_name(err);
+    }
+
+    client->transferDone();
+}
+
+/********************************************************************************/
+/*
+ * @brief: 요청 송신 완료 callback (UsbComm event thread 에서 실행)
+ *@return:
+ */
+/********************************************************************************/
+void LIBUSB_CALL UsbRpcClient::writeCallback(libusb_transfer *transfer)
+{
+    UsbTransferPool::Slot *slot = (UsbTransferPool::Slot *)transfer->user_data;
+    UsbRpcClient *client = (UsbRpcClient *)slot->owner;
+
+    if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+        int error;
+        switch (transfer->status) {
+        case LIBUSB_TRANSFER_TIMED_OUT:	error = LIBUSB_ERROR_TIMEOUT;	break;
+        case LIBUSB_TRANSFER_STALL:		error = LIBUSB_ERROR_PIPE;		break;
+        case LIBUSB_TRANSFER_NO_DEVICE:	error = LIBUSB_ERROR_NO_DEVICE;	break;
+        default:						error = LIBUSB_ERROR_IO;		break;
+        }
+        client->failRequest(readLe32(slot->buffer + 4), error);
+    }
+
+    client->writePool->release(slot);
+    client->transferDone();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 수신 데이터에서 응답 frame 을 꺼내 pending 요청과 대응시킨다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRpcClient::handleReceivedData(const quint8 *data, int length)
+{
+    /* 전송 buffer 는 바로 재submit 하므로 수신 단위로 한번 복사해서 parser 에 넘긴다 (frame 단위 복사는 하지 않는다) */
+    parser->feed(QByteArray((const char *)data, length));
+
+    UsbFrame frame;
+    while (parser->next(&frame)) {
+        if (frame.length < 4) {
+            unmatchedCount.fetchAndAddRelaxed(1);
+            continue;
+        }
+
+        quint32 id = readLe32(frame.data);
+
+        pendingMutex.lock();
+        bool found = pending.remove(id) > 0;
+        pendingMutex.unlock();
+
+        if (!found) {
+            unmatchedCount.fetchAndAddRelaxed(1);
+            continue;
+        }
+
+        responseCount.fetchAndAddRelaxed(1);
+        emit sigResponse(id, QByteArray((const char *)frame.data + 4, frame.length - 4));
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: pending 에서 제거하고 실패 통지 (이미 응답/timeout 처리된 요청이면 무시)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRpcClient::failRequest(quint32 id, int error)
+{
+    pendingMutex.lock();
+    bool found = pending.remove(id) > 0;
+    pendingMutex.unlock();
+
+    if (!found)
+        return;
+
+    if (error == LIBUSB_ERROR_TIMEOUT)
+        timeoutCount.fetchAndAddRelaxed(1);
+    else
+        errorCount.fetchAndAddRelaxed(1);
+    emit sigRequestFailed(id, error);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 전송 1개 완료 (stop() 대기 해제)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRpcClient::transferDone()
+{
+    QMutexLocker locker(&inFlightMutex);
+    if (--inFlight == 0)
+        inFlightDone.wakeAll();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 자원 해제
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbRpcClient::freeBuffers()
+{
+    for (int i = 0; i < readTransfers.size(); i++)
+        libusb_free_transfer(readTransfers.at(i));
+    readTransfers.clear();
+
+    delete writePool;
+    writePool = NULL;
+    delete parser;
+    parser = NULL;
+}
@@ -0,0 +1,146 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * bulk OUT/IN endpoint 쌍 위의 request/response RPC
+ *
+ * 요청마다 correlation id 를 붙여서 OUT 으로 보내고, IN 으로 들어오는 응답을 id 로 찾아서 돌려준다.
+ * 응답을 기다리지 않고 maxOutstanding 개까지 요청을 계속 보낼 수 있으므로(pipeline),
+ * 명령 처리량이 bus 왕복 지연이 아니라 pipeline 깊이에 비례한다. 응답 순서는 요청 순서와 달라도 된다.
+ *
+ * frame 형식 (요청/응답 공통, little endian):
+ * 	[u32 length][u32 id][payload]		length = 4 + payload 크기 (length 필드 자신은 제외)
+ *
+ * 구조:
+ * 	call() -> pool 의 전송 buffer 에 frame 을 채워서 바로 submit (호출 thread)
+ * 	IN 전송 완료 callback (UsbComm event thread) -> UsbFrameParser 로 frame 분리 -> id 로 pending 검색 -> sigResponse
+ * 	deadline timer (UsbRpcClient 가 속한 thread) -> 기한이 지난 요청을 sigRequestFailed(LIBUSB_ERROR_TIMEOUT)
+ */
+#ifndef USBRPCCLIENT_H
+#define USBRPCCLIENT_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QDeadlineTimer>
+#include <QTimer>
+#include <QVector>
+#include <usbcomm.h>
+
+class UsbTransferPool;
+class UsbFrameParser;
+
+/********************************************************************************/
+/* RPC 설정 */
+/********************************************************************************/
+struct UsbRpcConfig
+{
+    /* 동시에 응답을 기다리는 요청의 최대 수 (pipeline 깊이) */
+    int maxOutstanding = 32;
+    /* 요청 frame 최대 크기 (= 송신 buffer 1개의 크기) */
+    int maxRequestSize = 16 * 1024;
+    /* 응답 수신용 IN 전송 1개의 크기와 수 */
+    int readSize = 16 * 1024;
+    int readTransfers = 4;
+    /* OUT 전송 1개의 timeout (ms) */
+    quint32 writeTimeout = 1000;
+    /* 응답 payload 최대 크기 (넘으면 stream 이상으로 본다) */
+    int maxResponseSize = 1024 * 1024;
+};
+
+/********************************************************************************/
+/* RPC 통계 */
+/********************************************************************************/
+struct UsbRpcStats
+{
+    quint64 requests = 0;		/* 보낸 요청 수 */
+    quint64 responses = 0;		/* 응답을 받은 요청 수 */
+    quint64 timeouts = 0;		/* deadline 이 지난 요청 수 */
+    quint64 errors = 0;			/* 전송 에러로 실패한 요청 수 */
+    quint64 unmatched = 0;		/* 대응하는 요청이 없는 응답 (deadline 이후 도착 등) */
+};
+
+/********************************************************************************/
+/* RPC client */
+/********************************************************************************/
+class UsbRpcClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UsbRpcClient(UsbComm *usbComm, QObject *parent = 0);
+    ~UsbRpcClient();
+
+    /* 시작 (deviceHandle 은 UsbComm::getDeviceHandleFrom_xxx 로 취득, interface 는 미리 선언해둔다) */
+    bool start(libusb_device_handle *deviceHandle, quint8 outEndpoint, quint8 inEndpoint,
+               const UsbRpcConfig &config = UsbRpcConfig());
+    /* 종료 (응답을 기다리던 요청은 sigRequestFailed(LIBUSB_ERROR_INTERRUPTED)) */
+    void stop();
+
+    bool isRunning() const {return running.loadAcquire();}
+
+    /* 요청 송신, 결과는 sigResponse/sigRequestFailed 로 통지된다 (어느 thread 에서든 호출 가능, stop() 과 동시에 호출해도 된다)
+     * @return: correlation id, 보내지 못했으면 0 (pipeline 이 가득 참, 크기 초과, submit 에러) */
+    quint32 call(const QByteArray &payload, int timeoutMs);
+
+    /* 응답을 기다리는 요청 수 */
+    int outstanding() const;
+
+    /* 현재 통계 (어느 thread 에서든 호출 가능) */
+    UsbRpcStats stats() const;
+
+signals:
+    /* 응답 수신 (event thread 에서 발생) */
+    void sigResponse(quint32 id, QByteArray payload);
+    /* 요청 실패 (error: LIBUSB_ERROR_TIMEOUT = deadline 초과, 그 외 전송 에러) */
+    void sigRequestFailed(quint32 id, int error);
+
+private slots:
+    /* deadline 이 지난 요청 처리 */
+    void checkDeadlines();
+
+private:
+    /* USB 전송 완료 callback (UsbComm event thread 에서 실행) */
+    static void LIBUSB_CALL readCallback(libusb_transfer *transfer);
+    static void LIBUSB_CALL writeCallback(libusb_transfer *transfer);
+    /* 수신 데이터에서 응답 frame 을 꺼내 pending 요청과 대응시킨다 (event thread 전용) */
+    void handleReceivedData(const quint8 *data, int length);
+    /* pending 에서 제거하고 실패 통지 */
+    void failRequest(quint32 id, int error);
+    /* 전송 1개 완료 */
+    void transferDone();
+
+    void freeBuffers();
+
+    UsbComm *usbComm;
+    libusb_device_handle *deviceHandle;
+    quint8 outEndpoint;
+    quint8 inEndpoint;
+    UsbRpcConfig config;
+    QAtomicInt running;
+
+    /* 응답 대기중인 요청 (id -> deadline) */
+    QHash<quint32, QDeadlineTimer> pending;
+    mutable QMutex pendingMutex;
+    quint32 nextId;
+    QTimer deadlineTimer;
+
+    /* USB 전송 */
+    UsbTransferPool *writePool;
+    QVector<libusb_transfer *> readTransfers;
+    UsbFrameParser *parser;
+    QAtomicInt stopping;
+    int inFlight;
+    /* inFlight 보호, call() 의 확인 ~ submit 과 stop() 의 stopping 설정을 직렬화한다 (writePool 해제와의 경합 방지) */
+    QMutex inFlightMutex;
+    QWaitCondition inFlightDone;
+
+    /* 통계 */
+    QAtomicInteger<quint64> requestCount;
+    QAtomicInteger<quint64> responseCount;
+    QAtomicInteger<quint64> timeoutCount;
+    QAtomicInteger<quint64> errorCount;
+    QAtomicInteger<quint64> unmatchedCount;
+};
+
+#endif // USBRPCCLIENT_H
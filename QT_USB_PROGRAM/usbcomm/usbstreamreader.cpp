@@ -0,0 +1,442 @@
+/********************************************************************************/
+/* bulk IN 연속 수신 (credit 방식 흐름 제어) Part */
+/********************************************************************************/
+#include "usbstreamreader.h"
+#include <QDebug>
+#include <QDeadlineTimer>
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:   usbComm: device handle 을 관리하는 UsbComm (event thread 도 이 obj 의 것을 사용한다)
+ *@return:
+ */
+/********************************************************************************/
+UsbStreamReader::UsbStreamReader(UsbComm *usbComm, QObject *parent) : QObject(parent)
+{
+    this->usbComm = usbComm;
+    deviceHandle = NULL;
+    endpoint = 0;
+    streaming.storeRelaxed(0);
+    pool = NULL;
+
+    stopping = false;
+    failed = false;
+    paused = false;
+    credits = -1;
+    pending = 0;
+    inFlight = 0;
+    callbacks = 0;
+
+    bytesReceived = 0;
+    chunkCount = 0;
+    transferErrors = 0;
+    pauseEvents = 0;
+    maxPending = 0;
+    stallNs = 0;
+    stallStartNs = -1;
+    elapsedMsAtStop = 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자, 수신중이면 종료한다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbStreamReader::~UsbStreamReader()
+{
+    stop();
+
+    /* release() 되지 않은 chunk 가 남아있어도 이 obj 와 함께 buffer 는 없어진다 */
+    delete pool;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 수신 시작
+ *@param:   deviceHandle: device handle
+ *@param:   endpoint: bulk IN endpoint 주소
+ *@param:   config: 수신 설정
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbStreamReader::start(libusb_device_handle *deviceHandle, quint8 endpoint, const UsbStreamConfig &config)
+{
+    if (streaming.loadAcquire())
+        return false;
+
+    /* 이전 수신의 chunk 가 아직 release() 되지 않았다 (그 buffer 를 쓰고 있다) */
+    if (pool != NULL) {
+        qDebug() << "UsbStreamReader: previous chunks are not released";
+        return false;
+    }
+
+    if (!usbComm->isUsbDeviceOpened(deviceHandle)) {
+        qDebug() << "UsbStreamReader: device not opened";
+        return false;
+    }
+
+    if (!(endpoint & LIBUSB_ENDPOINT_IN) || config.transferSize <= 0 || config.transferCount <= 0
+        || config.highWatermark <= 0 || config.lowWatermark < 0 || config.lowWatermark >= config.highWatermark) {
+        qDebug() << "UsbStreamReader: invalid config";
+        return false;
+    }
+
+    if (!usbComm->startEventHandler())
+        return false;
+
+    this->deviceHandle = deviceHandle;
+    traffic = usbComm->getTrafficCounters(deviceHandle, endpoint);
+    this->endpoint = endpoint;
+    this->config = config;
+
+    /* 진행중인 전송 + 처리 대기 chunk 의 상한만큼만 buffer 를 둔다 */
+    pool = new UsbTransferPool(config.transferCount + config.highWatermark, config.transferSize);
+
+    QMutexLocker locker(&mutex);
+    readyQueue.clear();
+    stopping = false;
+    failed = false;
+    paused = false;
+    credits = config.initialCredits < 0 ? -1 : config.initialCredits;
+    pending = 0;
+    inFlight = 0;
+
+    bytesReceived = 0;
+    chunkCount = 0;
+    transferErrors = 0;
+    pauseEvents = 0;
+    maxPending = 0;
+    stallNs = 0;
+    stallStartNs = -1;
+
+    streaming.storeRelease(1);
+    elapsedTimer.start();
+    submitTransfers();
+
+    /* credit 0 으로 시작하는 경우(grantCredits() 대기)가 아닌데 submit 하지 못했으면 실패 */
+    if (inFlight == 0 && credits != 0) {
+        locker.unlock();
+        stop();
+        return false;
+    }
+
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 수신 종료
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbStreamReader::stop()
+{
+    if (!streaming.loadAcquire())
+        return;
+
+    /* 재submit 을 멈추고 진행중인 전송을 모두 취소한다 */
+    mutex.lock();
+    stopping = true;
+    while (inFlight > 0 || callbacks > 0) {
+        mutex.unlock();
+        for (int i = 0; i < pool->slotCount(); i++)
+            libusb_cancel_transfer(pool->slotAt(i)->transfer);
+        mutex.lock();
+        inFlightDone.wait(&mutex, 100);
+    }
+
+    /* 처리 대기 chunk 는 버린다 */
+    while (!readyQueue.isEmpty()) {
+        pool->release(readyQueue.dequeue().slot);
+        pending--;
+    }
+
+    updateStall();
+    elapsedMsAtStop = elapsedTimer.elapsed();
+    streaming.storeRelease(0);
+    readyCondition.wakeAll();
+
+    /* 소비 측이 가진 chunk 가 있으면 buffer 는 마지막 release() 에서 해제한다 */
+    if (pending == 0) {
+        delete pool;
+        pool = NULL;
+    }
+    mutex.unlock();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 수신중 여부 / 에러로 멈췄는지
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+bool UsbStreamReader::isStreaming() const
+{
+    if (!streaming.loadAcquire())
+        return false;
+
+    QMutexLocker locker(&mutex);
+    return !failed;
+}
+
+bool UsbStreamReader::hasFailed() const
+{
+    QMutexLocker locker(&mutex);
+    return failed;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 수신 chunk 취득
+ *@param:   chunk: 결과 (처리 후 release() 한다)
+ *@param:   timeoutMs: 대기 시간 (ms)
+ *@return:  chunk 를 취득했으면 true
+ */
+/********************************************************************************/
+bool UsbStreamReader::read(UsbStreamChunk *chunk, int timeoutMs)
+{
+    QMutexLocker locker(&mutex);
+
+    QDeadlineTimer deadline(timeoutMs);
+    while (readyQueue.isEmpty() && streaming.loadRelaxed() && !failed && !deadline.hasExpired())
+        readyCondition.wait(&mutex, deadline);
+
+    if (readyQueue.isEmpty())
+        return false;
+
+    *chunk = readyQueue.dequeue();
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: chunk 의 buffer 반환, watermark 아래로 내려가면 수신을 재개한다
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbStreamReader::release(UsbStreamChunk *chunk)
+{
+    if (chunk->slot == NULL)
+        return;
+
+    QMutexLocker locker(&mutex);
+    if (pool != NULL) {
+        pool->release(chunk->slot);
+        pending--;
+        if (streaming.loadRelaxed()) {
+            submitTransfers();
+        } else if (pending == 0) {
+            /* stop() 후 마지막 chunk */
+            delete pool;
+            pool = NULL;
+        }
+    }
+
+    chunk->slot = NULL;
+    chunk->data = NULL;
+    chunk->length = 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: credit 추가 (credit 이 없어서 멈춰 있었으면 수신을 재개한다)
+ *@param:   credits: 추가할 credit 수 (전송 1개 = 1 credit)
+ *@return:
+ */
+/********************************************************************************/
+void UsbStreamReader::grantCredits(int credits)
+{
+    QMutexLocker locker(&mutex);
+    if (!streaming.loadRelaxed() || this->credits < 0 || credits <= 0)
+        return;
+
+    this->credits += credits;
+    submitTransfers();
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 통계
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbStreamStats UsbStreamReader::stats() const
+{
+    QMutexLocker locker(&mutex);
+
+    UsbStreamStats s;
+    s.bytesReceived = bytesReceived;
+    s.chunks = chunkCount;
+    s.transferErrors = transferErrors;
+    s.pauseEvents = pauseEvents;
+    s.credits = credits;
+    s.pending = pending;
+    s.maxPending = maxPending;
+    s.inFlight = inFlight;
+
+    qint64 stall = stallNs;
+    if (stallStartNs >= 0 && streaming.loadRelaxed())
+        stall += elapsedTimer.nsecsElapsed() - stallStartNs;
+    s.stallSec = stall / 1e9;
+    s.elapsedSec = (streaming.loadRelaxed() ? elapsedTimer.elapsed() : elapsedMsAtStop) / 1e3;
+    return s;
+}
+
+/********************************************************************************/
+/*
+ * 흐름 제어 조건이 허락하는 만큼 전송을 submit 한다 (mutex 를 잡고 호출)
+ *
+ * NOTE:
+ * 	pending 이 highWatermark 에 도달하면 paused 로 하고, lowWatermark 까지 내려갈 때까지 유지한다.
+ * 	(조금 처리될 때마다 1개씩 재submit 하면서 상한 근처에서 흔들리지 않도록 하기 위함)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbStreamReader::submitTransfers()
+{
+    bool throttled = false;
+
+    if (paused && pending <= config.lowWatermark)
+        paused = false;
+
+    while (!stopping && !failed && inFlight < config.transferCount) {
+        if (!paused && pending >= config.highWatermark)
+            paused = true;
+        if (paused || credits == 0) {
+            throttled = true;
+            break;
+        }
+
+        UsbTransferPool::Slot *slot = pool->acquire();
+        if (slot == NULL)
+            break;
+
+        /* timeout 0: 데이터가 올 때까지 기다린다 (연속 streaming) */
+        slot->owner = this;
+        slot->submitNs = elapsedTimer.nsecsElapsed();
+        libusb_fill_bulk_transfer(slot->transfer, deviceHandle, endpoint, slot->buffer, slot->capacity,
+                                  transferCallback, slot, 0);
+
+        int err = libusb_submit_transfer(slot->transfer);
+        if (err != LIBUSB_SUCCESS) {
+            qDebug() << "UsbStreamReader: libusb_submit_transfer error:" << libusb_error_name(err);
+            pool->release(slot);
+            transferErrors++;
+            failed = true;
+            /* read() 에서 기다리는 쪽을 깨운다 */
+            readyCondition.wakeAll();
+            break;
+        }
+
+        inFlight++;
+        if (credits > 0)
+            credits--;
+    }
+
+    /* 전송이 모두 끝난 시점에 흐름 제어 때문에 submit 하지 못하면 1회의 정지로 센다 */
+    if (throttled && inFlight == 0 && stallStartNs < 0)
+        pauseEvents++;
+
+    updateStall();
+}
+
+/********************************************************************************/
+/*
+ *@brief: stall(흐름 제어로 진행중인 전송이 없는 구간) 시간 누적 (mutex 를 잡고 호출)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbStreamReader::updateStall()
+{
+    bool stalled = inFlight == 0 && !stopping && !failed && (paused || credits == 0);
+    qint64 now = elapsedTimer.nsecsElapsed();
+
+    if (stalled && stallStartNs < 0) {
+        stallStartNs = now;
+    } else if (!stalled && stallStartNs >= 0) {
+        stallNs += now - stallStartNs;
+        stallStartNs = -1;
+    }
+}
+
+/********************************************************************************/
+/*
+ * @brief: USB 전송 완료 callback (UsbComm event thread 에서 실행)
+ *
+ * NOTE: 수신 buffer 는 복사하지 않고 그대로 chunk 로 넘긴다. 재submit 은 빈 buffer 로 한다.
+ *
+ *@return:
+ */
+/********************************************************************************/
+void LIBUSB_CALL UsbStreamReader::transferCallback(libusb_transfer *transfer)
+{
+    UsbTransferPool::Slot *slot = (UsbTransferPool::Slot *)transfer->user_data;
+    UsbStreamReader *reader = (UsbStreamReader *)slot->owner;
+
+    bool queued = false;
+    QString errorMessage;
+
+    reader->traffic->recordTransfer(transfer, (reader->elapsedTimer.nsecsElapsed() - slot->submitNs) / 1000);
+
+    reader->mutex.lock();
+    reader->inFlight--;
+    reader->callbacks++;
+
+    switch (transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED:
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        if (transfer->actual_length > 0) {
+            UsbStreamChunk chunk;
+            chunk.data = slot->buffer;
+            chunk.length = transfer->actual_length;
+            chunk.slot = slot;
+            reader->readyQueue.enqueue(chunk);
+            reader->pending++;
+            reader->maxPending = qMax(reader->maxPending, reader->pending);
+            reader->bytesReceived += transfer->actual_length;
+            reader->chunkCount++;
+            queued = true;
+        } else {
+            reader->pool->release(slot);
+            /* 데이터 없이 끝난 전송의 credit 은 돌려준다 */
+            if (reader->credits >= 0)
+                reader->credits++;
+        }
+        break;
+    case LIBUSB_TRANSFER_CANCELLED:
+        reader->pool->release(slot);
+        break;
+    default:
+        /* STALL, NO_DEVICE, OVERFLOW, ERROR: 더 이상 재submit 하지 않는다 */
+        reader->pool->release(slot);
+        reader->transferErrors++;
+        reader->failed = true;
+        errorMessage = QString("transfer error: status %1").arg(transfer->status);
+        break;
+    }
+
+    reader->submitTransfers();
+
+    if (queued || reader->failed)
+        reader->readyCondition.wakeAll();
+    reader->mutex.unlock();
+
+    if (queued)
+        emit reader->sigDataReady();
+    if (!errorMessage.isEmpty())
+        emit reader->sigStreamError(errorMessage);
+
+    /* emit 이 끝날 때까지 stop() 이 return 하지 않도록 마지막에 callback 종료를 알린다 */
+    QMutexLocker locker(&reader->mutex);
+    if (--reader->callbacks == 0 && reader->inFlight == 0)
+        reader->inFlightDone.wakeAll();
+}
@@ -0,0 +1,163 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * bulk IN 연속 수신 (credit 방식 흐름 제어)
+ *
+ * 소비 측(처리 thread)이 처리 속도에 맞춰 credit 을 주고, 엔진은 credit 이 있을 때만 IN 전송을 재submit 한다.
+ * 소비가 늦어지면 수신이 멈추므로(device 쪽에서 NAK), 데이터를 조용히 버리지도, 무한히 쌓지도 않는다.
+ *
+ * 흐름 제어:
+ * 	credit		: 전송 1개(transferSize) 의 submit 권한. grantCredits() 로 추가하고 submit 할 때 1개 소비한다.
+ * 				  initialCredits < 0 이면 credit 을 사용하지 않는다 (watermark 만으로 제어).
+ * 	watermark	: 수신했지만 아직 release() 되지 않은 chunk 수가 highWatermark 이상이면 재submit 을 멈추고,
+ * 				  lowWatermark 이하로 내려가면 자동으로 재개한다. (메모리 상한 = (transferCount + highWatermark) * transferSize)
+ * 	stall		: 흐름 제어 때문에 진행중인 전송이 하나도 없는 시간을 누적한다.
+ *
+ * 구조:
+ * 	USB 완료 callback (UsbComm event thread) -> chunk 를 ready queue 에 넣고 sigDataReady -> 가능하면 재submit
+ * 	소비 측 -> read() 로 chunk 취득 -> 처리 -> release() (buffer 반환, 필요하면 재submit)
+ */
+#ifndef USBSTREAMREADER_H
+#define USBSTREAMREADER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <usbcomm.h>
+#include "usbtransferpool.h"
+
+/********************************************************************************/
+/* 수신 설정 */
+/********************************************************************************/
+struct UsbStreamConfig
+{
+    /* USB 전송 1개의 크기 (wMaxPacketSize 의 배수로 지정) */
+    int transferSize = 64 * 1024;
+    /* 동시에 submit 해두는 전송 수 */
+    int transferCount = 8;
+    /* 처음 credit 수 (음수면 credit 을 사용하지 않는다) */
+    int initialCredits = -1;
+    /* 처리 대기 chunk 수의 상한/재개 기준 */
+    int highWatermark = 32;
+    int lowWatermark = 8;
+};
+
+/********************************************************************************/
+/* 수신 데이터 1개 (release() 할 때까지 유효) */
+/********************************************************************************/
+struct UsbStreamChunk
+{
+    const quint8 *data = NULL;
+    int length = 0;
+
+private:
+    friend class UsbStreamReader;
+    UsbTransferPool::Slot *slot = NULL;
+};
+
+/********************************************************************************/
+/* 수신 통계 */
+/********************************************************************************/
+struct UsbStreamStats
+{
+    quint64 bytesReceived = 0;		/* 수신 bytes */
+    quint64 chunks = 0;				/* 수신 chunk 수 */
+    quint64 transferErrors = 0;		/* 전송 에러 횟수 */
+    quint64 pauseEvents = 0;		/* 흐름 제어로 재submit 을 멈춘 횟수 */
+    int credits = 0;				/* 남은 credit (credit 미사용이면 -1) */
+    int pending = 0;				/* release 되지 않은 chunk 수 */
+    int maxPending = 0;				/* pending 의 최대값 */
+    int inFlight = 0;				/* 진행중인 전송 수 */
+    double stallSec = 0;			/* 흐름 제어로 전송이 하나도 없었던 누적 시간 */
+    double elapsedSec = 0;			/* 수신 시작부터의 경과 시간 */
+
+    double receiveMBps() const {return elapsedSec > 0 ? bytesReceived / 1e6 / elapsedSec : 0;}
+};
+
+/********************************************************************************/
+/* 수신 Class */
+/********************************************************************************/
+class UsbStreamReader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UsbStreamReader(UsbComm *usbComm, QObject *parent = 0);
+    ~UsbStreamReader();
+
+    /* 수신 시작 (deviceHandle 은 UsbComm::getDeviceHandleFrom_xxx 로 취득, interface 는 미리 선언해둔다) */
+    bool start(libusb_device_handle *deviceHandle, quint8 endpoint, const UsbStreamConfig &config = UsbStreamConfig());
+    /* 수신 종료 (진행중인 전송 취소, 처리 대기 chunk 는 버린다. 이미 read() 한 chunk 는 release() 할 때까지 유효) */
+    void stop();
+
+    /* 수신중 (전송 에러로 멈췄으면 stop() 전이라도 false) */
+    bool isStreaming() const;
+    /* 전송 에러로 수신이 멈췄다 */
+    bool hasFailed() const;
+
+    /* 수신 chunk 취득 (timeoutMs 동안 기다린다, 0 이면 바로 return), 처리 후 release() 해야 한다 */
+    bool read(UsbStreamChunk *chunk, int timeoutMs = 0);
+    /* chunk 의 buffer 반환 */
+    void release(UsbStreamChunk *chunk);
+    /* credit 추가 (credit 미사용 설정이면 무시) */
+    void grantCredits(int credits);
+
+    /* 현재 통계 (어느 thread 에서든 호출 가능) */
+    UsbStreamStats stats() const;
+
+signals:
+    /* 새 chunk 가 ready queue 에 들어왔을 때 (event thread 에서 발생) */
+    void sigDataReady();
+    /* 전송 에러로 수신이 더 이상 진행될 수 없을 때 (event thread 에서 발생) */
+    void sigStreamError(QString message);
+
+private:
+    /* USB 전송 완료 callback (UsbComm event thread 에서 실행) */
+    static void LIBUSB_CALL transferCallback(libusb_transfer *transfer);
+    /* 흐름 제어 조건이 허락하는 만큼 전송을 submit 한다 (mutex 를 잡고 호출) */
+    void submitTransfers();
+    /* stall 구간 시작/종료 (mutex 를 잡고 호출) */
+    void updateStall();
+
+    UsbComm *usbComm;
+    libusb_device_handle *deviceHandle;
+    quint8 endpoint;
+    UsbStreamConfig config;
+    QAtomicInt streaming;			/* start() ~ stop() (다른 thread 에서 읽는다) */
+
+    /* 전송 + 수신 buffer (transferCount + highWatermark 개)
+     * stop() 후에도 소비 측이 가진 chunk 가 있으면 마지막 release() 때까지 남겨둔다 */
+    UsbTransferPool *pool;
+
+    /* 아래는 mutex 로 보호 */
+    mutable QMutex mutex;
+    QWaitCondition readyCondition;
+    QWaitCondition inFlightDone;
+    QQueue<UsbStreamChunk> readyQueue;
+    bool stopping;
+    bool failed;
+    bool paused;					/* highWatermark 에 도달해서 멈춘 상태 */
+    int credits;
+    int pending;					/* ready queue + 소비 측이 가진 chunk 수 */
+    int inFlight;
+    int callbacks;					/* 실행중인 완료 callback 수 (stop() 의 대기용) */
+
+    /* 통계 (mutex 로 보호) */
+    quint64 bytesReceived;
+    quint64 chunkCount;
+    quint64 transferErrors;
+    quint64 pauseEvents;
+    int maxPending;
+    qint64 stallNs;
+    qint64 stallStartNs;			/* stall 중이면 시작 시각, 아니면 -1 */
+    QElapsedTimer elapsedTimer;
+    qint64 elapsedMsAtStop;
+
+    /* dashboard 용 전송 counter (callback 에서 lock 없이 센다) */
+    QSharedPointer<UsbTrafficCounters> traffic;
+};
+
+#endif // USBSTREAMREADER_H
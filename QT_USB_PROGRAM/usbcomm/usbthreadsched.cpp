@@ -0,0 +1,208 @@
+/********************************************************************************/
+/* USB 처리 thread 의 scheduling 설정과 jitter 측정 Part */
+/********************************************************************************/
+#include "usbthreadsched.h"
+#include <QDebug>
+#include <QStringList>
+#include <cmath>
+
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+
+/* 이 값(ns) 이상 늦으면 late 로 센다 */
+const qint64 kLateThresholdNs = 1000000;
+
+}
+
+/********************************************************************************/
+/*
+ *@brief: 통계 초기화
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbJitterMeter::reset()
+{
+    count = 0;
+    mean = 0;
+    m2 = 0;
+    min = 0;
+    max = 0;
+    late = 0;
+}
+
+/********************************************************************************/
+/*
+ *@brief: jitter 표본 누적 (Welford 방식으로 평균/분산을 한번에 계산)
+ *@param:   jitterNs: 예정 시각보다 늦은 시간 (ns)
+ *@return:
+ */
+/********************************************************************************/
+void UsbJitterMeter::addSample(qint64 jitterNs)
+{
+    double x = (double)jitterNs;
+    count++;
+    double delta = x - mean;
+    mean += delta / count;
+    m2 += delta * (x - mean);
+
+    if (count == 1 || x < min)
+        min = x;
+    if (count == 1 || x > max)
+        max = x;
+
+    if (jitterNs > kLateThresholdNs)
+        late++;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 통계
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbJitterStats UsbJitterMeter::stats() const
+{
+    UsbJitterStats s;
+    s.samples = count;
+    s.meanUs = mean / 1e3;
+    s.stdDevUs = count > 1 ? std::sqrt(m2 / (count - 1)) / 1e3 : 0;
+    s.minUs = min / 1e3;
+    s.maxUs = max / 1e3;
+    s.lateSamples = late;
+    return s;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 호출한 thread 에 scheduling 설정 적용
+ *@param:   config: 설정
+ *@return:  true=모두 적용  false=일부 실패 (실패한 항목은 qDebug 로 출력)
+ */
+/********************************************************************************/
+bool UsbThreadSched::applyToCurrentThread(const UsbThreadSchedConfig &config)
+{
+#ifdef Q_OS_LINUX
+    bool ok = true;
+
+    /* 1. scheduling policy / 우선순위 */
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    int policy = SCHED_OTHER;
+    if (config.policy == UsbThreadSchedConfig::Fifo)
+        policy = SCHED_FIFO;
+    else if (config.policy == UsbThreadSchedConfig::RoundRobin)
+        policy = SCHED_RR;
+    if (policy != SCHED_OTHER)
+        param.sched_priority = qBound(sched_get_priority_min(policy), config.priority, sched_get_priority_max(policy));
+
+    int err = pthread_setschedparam(pthread_self(), policy, &param);
+    if (err != 0) {
+        qDebug() << "pthread_setschedparam error:" << strerror(err) << "(real-time scheduling needs CAP_SYS_NICE or RLIMIT_RTPRIO)";
+        ok = false;
+    }
+
+    /* 2. CPU affinity */
+    if (!config.cpus.isEmpty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int i = 0; i < config.cpus.size(); i++) {
+            if (config.cpus.at(i) >= 0 && config.cpus.at(i) < CPU_SETSIZE)
+                CPU_SET(config.cpus.at(i), &set);
+        }
+        err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            qDebug() << "pthread_setaffinity_np error:" << strerror(err);
+            ok = false;
+        }
+    }
+
+    /* 3. memory lock (process 전체) */
+    if (config.lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        qDebug() << "mlockall error:" << strerror(errno) << "(needs RLIMIT_MEMLOCK)";
+        ok = false;
+    }
+
+    return ok;
+#else
+    Q_UNUSED(config)
+    return false;
+#endif
+}
+
+/********************************************************************************/
+/*
+ *@brief: "fifo" / "rr" / "other" 문자열 변환
+ *@param:
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbThreadSched::parsePolicy(const QString &text, UsbThreadSchedConfig::Policy *policy)
+{
+    QString name = text.trimmed().toLower();
+    if (name == "fifo")
+        *policy = UsbThreadSchedConfig::Fifo;
+    else if (name == "rr")
+        *policy = UsbThreadSchedConfig::RoundRobin;
+    else if (name == "other")
+        *policy = UsbThreadSchedConfig::Other;
+    else
+        return false;
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: "2,3" 형식 CPU 목록 변환
+ *@param:
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbThreadSched::parseCpuList(const QString &text, QList<int> *cpus)
+{
+    cpus->clear();
+    const QStringList items = text.split(',', Qt::SkipEmptyParts);
+    for (int i = 0; i < items.size(); i++) {
+        bool ok = false;
+        int cpu = items.at(i).trimmed().toInt(&ok);
+        if (!ok || cpu < 0)
+            return false;
+        cpus->append(cpu);
+    }
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 로그용 문자열
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+QString UsbThreadSched::describe(const UsbThreadSchedConfig &config)
+{
+    static const char *names[] = {"other", "fifo", "rr"};
+
+    QString text = names[config.policy];
+    if (config.policy != UsbThreadSchedConfig::Other)
+        text += QString(":%1").arg(config.priority);
+
+    if (!config.cpus.isEmpty()) {
+        QStringList cpus;
+        for (int i = 0; i < config.cpus.size(); i++)
+            cpus.append(QString::number(config.cpus.at(i)));
+        text += " cpus " + cpus.join(',');
+    }
+
+    if (config.lockMemory)
+        text += " mlock";
+    return text;
+}
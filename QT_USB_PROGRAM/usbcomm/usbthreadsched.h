@@ -0,0 +1,94 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * USB 처리 thread 의 scheduling 설정 (실시간 policy, CPU affinity, memory lock) 과 jitter 측정
+ *
+ * 계산 부하가 높을 때 event thread 가 선점되면 전송 완료 처리가 늦어져 isochronous packet 을 잃는다.
+ * SCHED_FIFO/SCHED_RR 과 CPU 고정으로 event thread 를 부하에서 분리한다.
+ *
+ * NOTE:
+ * 1. 실시간 policy 는 권한(CAP_SYS_NICE 또는 RLIMIT_RTPRIO)이 필요하다. 권한이 없으면 qDebug 로 알리고
+ * 	기본 policy 로 계속 동작한다 (affinity/memory lock 등 나머지 설정은 적용한다).
+ * 2. memory lock(mlockall)은 process 전체에 적용된다 (page fault 로 인한 지연 방지, RLIMIT_MEMLOCK 필요).
+ * 3. Linux 외에서는 아무것도 하지 않고 false 를 반환한다.
+ */
+#ifndef USBTHREADSCHED_H
+#define USBTHREADSCHED_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QString>
+
+/********************************************************************************/
+/* thread scheduling 설정 */
+/********************************************************************************/
+struct UsbThreadSchedConfig
+{
+    enum Policy {
+        Other,			/* SCHED_OTHER (기본) */
+        Fifo,			/* SCHED_FIFO */
+        RoundRobin		/* SCHED_RR */
+    };
+
+    Policy policy = Other;
+    /* 실시간 우선순위 (Fifo/RoundRobin: 1 ~ 99) */
+    int priority = 0;
+    /* 실행할 CPU 번호 (비어있으면 변경하지 않는다) */
+    QList<int> cpus;
+    /* process memory 를 RAM 에 고정한다 */
+    bool lockMemory = false;
+
+    bool isDefault() const {return policy == Other && cpus.isEmpty() && !lockMemory;}
+};
+
+/********************************************************************************/
+/* jitter 통계 (us) */
+/********************************************************************************/
+struct UsbJitterStats
+{
+    quint64 samples = 0;
+    double meanUs = 0;
+    double stdDevUs = 0;
+    double minUs = 0;
+    double maxUs = 0;
+    quint64 lateSamples = 0;		/* 1ms 이상 늦은 횟수 */
+};
+
+/********************************************************************************/
+/* jitter 누적 (thread safe 가 아니다) */
+/********************************************************************************/
+class UsbJitterMeter
+{
+public:
+    UsbJitterMeter() {reset();}
+
+    void reset();
+    void addSample(qint64 jitterNs);
+    UsbJitterStats stats() const;
+
+private:
+    quint64 count;
+    double mean;
+    double m2;
+    double min;
+    double max;
+    quint64 late;
+};
+
+namespace UsbThreadSched {
+
+/* 호출한 thread 에 설정을 적용한다 (일부라도 실패하면 false, 실패한 항목 외에는 적용된다) */
+bool applyToCurrentThread(const UsbThreadSchedConfig &config);
+
+/* "fifo" / "rr" / "other" 문자열 변환 */
+bool parsePolicy(const QString &text, UsbThreadSchedConfig::Policy *policy);
+/* "2,3" 형식 CPU 목록 변환 */
+bool parseCpuList(const QString &text, QList<int> *cpus);
+
+/* 로그용 문자열 ("fifo:50 cpus 2,3 mlock") */
+QString describe(const UsbThreadSchedConfig &config);
+
+}
+
+#endif // USBTHREADSCHED_H
@@ -0,0 +1,112 @@
+/********************************************************************************/
+/* endpoint 별 전송 counter (throughput dashboard 용) */
+/********************************************************************************/
+#include "usbtrafficcounters.h"
+#include <QtAlgorithms>
+
+/********************************************************************************/
+/*
+ *@brief: 생성자
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbTrafficCounters::UsbTrafficCounters()
+    : bytes(0), transfers(0), errors(0), timeouts(0)
+{
+    for (int i = 0; i < UsbTrafficSnapshot::LatencyBuckets; i++)
+        latencyBuckets[i].store(0, std::memory_order_relaxed);
+}
+
+/********************************************************************************/
+/*
+ *@brief: 현재 값
+ *
+ * NOTE: 각 counter 를 하나씩 읽으므로 counter 사이에는 수 us 의 차이가 있을 수 있다 (표시용으로는 충분하다).
+ *
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbTrafficSnapshot UsbTrafficCounters::snapshot() const
+{
+    UsbTrafficSnapshot snapshot;
+    snapshot.bytes = bytes.load(std::memory_order_relaxed);
+    snapshot.transfers = transfers.load(std::memory_order_relaxed);
+    snapshot.errors = errors.load(std::memory_order_relaxed);
+    snapshot.timeouts = timeouts.load(std::memory_order_relaxed);
+    for (int i = 0; i < UsbTrafficSnapshot::LatencyBuckets; i++)
+        snapshot.latencyBuckets[i] = latencyBuckets[i].load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 지연의 bucket 번호 (bucket i = [2^i, 2^(i+1)) us, 1us 미만은 0)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+int UsbTrafficCounters::bucketOf(qint64 latencyUs)
+{
+    if (latencyUs < 2)
+        return 0;
+    int bucket = 63 - qCountLeadingZeroBits((quint64)latencyUs);
+    return qMin(bucket, UsbTrafficSnapshot::LatencyBuckets - 1);
+}
+
+/********************************************************************************/
+/*
+ *@brief: histogram 의 percentile 지연 (bucket 의 상한으로 근사)
+ *@param:   percentile: 0.0 ~ 1.0
+ *@return:  us (sample 이 없으면 0)
+ */
+/********************************************************************************/
+double UsbTrafficSnapshot::latencyPercentileUs(double percentile) const
+{
+    quint64 total = 0;
+    for (int i = 0; i < LatencyBuckets; i++)
+        total += latencyBuckets[i];
+    if (total == 0)
+        return 0;
+
+    quint64 rank = (quint64)(percentile * (total - 1)) + 1;
+    quint64 seen = 0;
+    for (int i = 0; i < LatencyBuckets; i++) {
+        seen += latencyBuckets[i];
+        if (seen >= rank)
+            return (double)(2ULL << i);
+    }
+    return (double)(2ULL << (LatencyBuckets - 1));
+}
+
+/********************************************************************************/
+/*
+ *@brief: 두 snapshot 사이의 속도
+ *@param:   previous: 이전 snapshot
+ *@param:   current: 현재 snapshot
+ *@param:   intervalSec: 두 snapshot 사이의 시간
+ *@return:
+ */
+/********************************************************************************/
+UsbTrafficRate UsbTrafficRate::between(const UsbTrafficSnapshot &previous, const UsbTrafficSnapshot &current,
+                                       double intervalSec)
+{
+    UsbTrafficRate rate;
+    rate.errors = current.errors;
+    rate.timeouts = current.timeouts;
+    if (intervalSec <= 0)
+        return rate;
+
+    rate.MBps = (current.bytes - previous.bytes) / 1e6 / intervalSec;
+    rate.transfersPerSec = (current.transfers - previous.transfers) / intervalSec;
+
+    /* 구간 내의 지연만 본다 */
+    UsbTrafficSnapshot delta;
+    for (int i = 0; i < UsbTrafficSnapshot::LatencyBuckets; i++)
+        delta.latencyBuckets[i] = current.latencyBuckets[i] - previous.latencyBuckets[i];
+    rate.p50Us = delta.latencyPercentileUs(0.50);
+    rate.p99Us = delta.latencyPercentileUs(0.99);
+
+    return rate;
+}
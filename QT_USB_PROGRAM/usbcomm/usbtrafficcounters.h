@@ -0,0 +1,96 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * endpoint 별 전송 counter (throughput dashboard 용)
+ *
+ * 전송 완료 시에는 atomic 증가만 한다 (lock 도 signal 도 없다).
+ * 표시하는 쪽은 timer 로 주기적으로 snapshot() 을 읽고, 이전 snapshot 과의 차이로 속도를 계산한다 (UsbTrafficRate).
+ * 따라서 표시 비용은 전송 속도와 무관하게 (endpoint 수 x refresh 주기) 로 일정하다.
+ *
+ * 지연은 log2 histogram (bucket i = [2^i, 2^(i+1)) us) 으로 세고, percentile 은 bucket 의 상한으로 근사한다.
+ */
+#ifndef USBTRAFFICCOUNTERS_H
+#define USBTRAFFICCOUNTERS_H
+
+#include <QtGlobal>
+#include <atomic>
+#include "libusb-1.0/include/libusb.h"
+
+/********************************************************************************/
+/* counter 의 어느 시점의 값 */
+/********************************************************************************/
+struct UsbTrafficSnapshot
+{
+    static const int LatencyBuckets = 32;
+
+    quint64 bytes = 0;				/* 전송 bytes (short/timeout 전송의 실제 길이 포함) */
+    quint64 transfers = 0;			/* 완료된 전송 수 */
+    quint64 errors = 0;				/* 에러로 끝난 전송 수 (timeout 제외) */
+    quint64 timeouts = 0;			/* timeout 으로 끝난 전송 수 */
+    quint64 latencyBuckets[LatencyBuckets] = {};
+
+    /* histogram 의 percentile 지연 (us, sample 이 없으면 0) */
+    double latencyPercentileUs(double percentile) const;
+};
+
+/********************************************************************************/
+/* 두 snapshot 사이의 속도 */
+/********************************************************************************/
+struct UsbTrafficRate
+{
+    double MBps = 0;
+    double transfersPerSec = 0;
+    quint64 errors = 0;				/* 누적 */
+    quint64 timeouts = 0;			/* 누적 */
+    double p50Us = 0;				/* 구간 내 지연 */
+    double p99Us = 0;
+
+    static UsbTrafficRate between(const UsbTrafficSnapshot &previous, const UsbTrafficSnapshot &current, double intervalSec);
+};
+
+/********************************************************************************/
+/* counter Class (어느 thread 에서든 lock 없이 호출 가능) */
+/********************************************************************************/
+class UsbTrafficCounters
+{
+public:
+    UsbTrafficCounters();
+
+    /* 전송 완료 (latencyUs < 0 이면 지연은 세지 않는다) */
+    void addTransfer(qint64 bytes, qint64 latencyUs = -1)
+    {
+        this->bytes.fetch_add(bytes, std::memory_order_relaxed);
+        transfers.fetch_add(1, std::memory_order_relaxed);
+        if (latencyUs >= 0)
+            latencyBuckets[bucketOf(latencyUs)].fetch_add(1, std::memory_order_relaxed);
+    }
+    /* 전송 에러 (timeout 이면 그때까지의 bytes 도 센다) */
+    void addError(bool timeout, qint64 bytes = 0)
+    {
+        this->bytes.fetch_add(bytes, std::memory_order_relaxed);
+        (timeout ? timeouts : errors).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /* libusb 비동기 전송의 완료 callback 에서 (status 로 완료/timeout/에러를 구분한다, 취소는 세지 않는다) */
+    void recordTransfer(const libusb_transfer *transfer, qint64 latencyUs = -1)
+    {
+        if (transfer->status == LIBUSB_TRANSFER_COMPLETED)
+            addTransfer(transfer->actual_length, latencyUs);
+        else if (transfer->status != LIBUSB_TRANSFER_CANCELLED)
+            addError(transfer->status == LIBUSB_TRANSFER_TIMED_OUT, transfer->actual_length);
+    }
+
+    UsbTrafficSnapshot snapshot() const;
+
+private:
+    static int bucketOf(qint64 latencyUs);
+
+    std::atomic<quint64> bytes;
+    std::atomic<quint64> transfers;
+    std::atomic<quint64> errors;
+    std::atomic<quint64> timeouts;
+    std::atomic<quint64> latencyBuckets[UsbTrafficSnapshot::LatencyBuckets];
+};
+
+#endif // USBTRAFFICCOUNTERS_H
@@ -0,0 +1,94 @@
+/********************************************************************************/
+/* libusb_transfer + 전송 buffer pool */
+/********************************************************************************/
+#include "usbtransferpool.h"
+#include <QDebug>
+#include <cstdlib>
+
+/********************************************************************************/
+/*
+ *@brief: 생성자, slot 을 모두 미리 할당한다
+ *@param:   slotCount: slot 수
+ *@param:   slotSize: slot 1개의 buffer 크기
+ *@return:
+ */
+/********************************************************************************/
+UsbTransferPool::UsbTransferPool(int slotCount, int slotSize)
+{
+    size = slotSize;
+    slots.reserve(slotCount);
+    freeList.reserve(slotCount);
+
+    for (int i = 0; i < slotCount; i++) {
+        Slot slot;
+        void *mem = NULL;
+        slot.transfer = libusb_alloc_transfer(0);
+        if (slot.transfer == NULL || posix_memalign(&mem, 4096, slotSize) != 0) {
+            qDebug() << "UsbTransferPool: alloc error";
+            libusb_free_transfer(slot.transfer);
+            break;
+        }
+        slot.buffer = (quint8 *)mem;
+        slot.capacity = slotSize;
+        slot.owner = NULL;
+        slot.submitNs = 0;
+        slots.append(slot);
+    }
+
+    /* slots 는 더 이상 재할당되지 않으므로 원소의 주소를 그대로 사용한다 */
+    for (int i = 0; i < slots.size(); i++) {
+        slots[i].transfer->user_data = &slots[i];
+        freeList.append(&slots[i]);
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: 소멸자 (사용중인 slot 이 없을 때 해제해야 한다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+UsbTransferPool::~UsbTransferPool()
+{
+    if (freeList.size() != slots.size())
+        qDebug() << "UsbTransferPool: destroyed with slots in use";
+
+    for (int i = 0; i < slots.size(); i++) {
+        libusb_free_transfer(slots.at(i).transfer);
+        free(slots.at(i).buffer);
+    }
+}
+
+/********************************************************************************/
+/*
+ *@brief: 빈 slot 취득
+ *@param:
+ *@return:  slot, 없으면 NULL
+ */
+/********************************************************************************/
+UsbTransferPool::Slot *UsbTransferPool::acquire()
+{
+    QMutexLocker locker(&mutex);
+    if (freeList.isEmpty())
+        return NULL;
+    return freeList.takeLast();
+}
+
+/********************************************************************************/
+/*
+ *@brief: slot 반환
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+void UsbTransferPool::release(Slot *slot)
+{
+    if (slot == NULL)
+        return;
+
+    QMutexLocker locker(&mutex);
+    slot->owner = NULL;
+    slot->submitNs = 0;
+    freeList.append(slot);
+}
@@ -0,0 +1,52 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * 미리 할당해둔 libusb_transfer + 전송 buffer 의 pool
+ *
+ * 작은 메시지를 자주 보내는 경로에서 메시지마다 libusb_alloc_transfer()/malloc() 을 하지 않기 위해 사용한다.
+ * acquire()/release() 는 어느 thread 에서든(USB 완료 callback 포함) 호출할 수 있으며, heap 할당을 하지 않는다.
+ */
+#ifndef USBTRANSFERPOOL_H
+#define USBTRANSFERPOOL_H
+
+#include <QVector>
+#include <QMutex>
+#include "libusb-1.0/include/libusb.h"
+
+class UsbTransferPool
+{
+public:
+    /* pool 의 원소 1개 */
+    struct Slot
+    {
+        libusb_transfer *transfer;	/* user_data 는 이 Slot 을 가리킨다 */
+        quint8 *buffer;				/* capacity bytes, 4KB 정렬 */
+        int capacity;
+        void *owner;				/* 사용하는 쪽의 상태 (callback 에서 사용) */
+        qint64 submitNs;			/* 사용하는 쪽이 기록하는 submit 시각 (지연 계산용) */
+    };
+
+    UsbTransferPool(int slotCount, int slotSize);
+    ~UsbTransferPool();
+
+    /* 빈 slot 취득, 없으면 NULL */
+    Slot *acquire();
+    /* slot 반환 */
+    void release(Slot *slot);
+
+    int slotSize() const {return size;}
+    int slotCount() const {return slots.size();}
+    /* index 로 slot 참조 (사용중 여부와 무관, 진행중인 전송의 일괄 취소 등에 사용) */
+    Slot *slotAt(int index) {return &slots[index];}
+
+private:
+    Q_DISABLE_COPY(UsbTransferPool)
+
+    int size;
+    QVector<Slot> slots;
+    QVector<Slot *> freeList;	/* slotCount 만큼 reserve 해두므로 push/pop 에서 할당하지 않는다 */
+    QMutex mutex;
+};
+
+#endif // USBTRANSFERPOOL_H
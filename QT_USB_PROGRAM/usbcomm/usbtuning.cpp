@@ -0,0 +1,219 @@
+/********************************************************************************/
+/* 전송 크기 / 동시 전송 수 자동 조정 결과의 저장과 report Part */
+/********************************************************************************/
+#include "usbtuning.h"
+#include <QSettings>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDebug>
+
+namespace {
+
+/* 최고 속도 대비 이 비율 이상이면 같은 속도로 보고 CPU 사용률로 고른다 */
+const double kThroughputTolerance = 0.95;
+
+/* 설정 파일의 device group 이름 */
+QString deviceGroup(quint16 vid, quint16 pid, int speed)
+{
+    return QString("%1_%2_speed%3").arg(vid, 4, 16, QChar('0')).arg(pid, 4, 16, QChar('0')).arg(speed);
+}
+
+}
+
+/********************************************************************************/
+/*
+ *@brief: 결과 중 최적 선택
+ *
+ * NOTE: 속도가 거의 같으면(최고 속도의 95% 이상) CPU 사용률이 낮은 쪽, 그것도 같으면 전송 크기/동시 전송 수가 작은 쪽
+ * 	(메모리 사용량과 latency 가 적다) 을 고른다.
+ *
+ *@param:
+ *@return:  index, 유효한 결과가 없으면 -1
+ */
+/********************************************************************************/
+int UsbTuning::selectBest(const QList<UsbTuneResult> &results)
+{
+    double bestMbps = 0;
+    for (int i = 0; i < results.size(); i++) {
+        if (results.at(i).error == 0)
+            bestMbps = qMax(bestMbps, results.at(i).mbps);
+    }
+    if (bestMbps <= 0)
+        return -1;
+
+    int best = -1;
+    for (int i = 0; i < results.size(); i++) {
+        const UsbTuneResult &r = results.at(i);
+        if (r.error != 0 || r.mbps < bestMbps * kThroughputTolerance)
+            continue;
+
+        if (best < 0) {
+            best = i;
+            continue;
+        }
+
+        const UsbTuneResult &b = results.at(best);
+        if (r.cpuPercent < b.cpuPercent
+            || (r.cpuPercent == b.cpuPercent && (qint64)r.transferSize * r.queueDepth < (qint64)b.transferSize * b.queueDepth))
+            best = i;
+    }
+    return best;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 기본 설정 파일 경로 (app/cli 가 같은 파일을 사용하도록 application 이름과 무관하게 정한다)
+ *@param:
+ *@return:
+ */
+/********************************************************************************/
+QString UsbTuning::defaultStorePath()
+{
+    return QDir::homePath() + "/.config/qt_usb_program/tuning.ini";
+}
+
+/********************************************************************************/
+/*
+ *@brief: 설정 파일에 저장 (같은 device/endpoint 의 이전 값은 덮어쓴다)
+ *@param:
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbTuning::saveProfile(const QString &path, const UsbTuneProfile &profile)
+{
+    if (!profile.isValid())
+        return false;
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSettings settings(path, QSettings::IniFormat);
+    settings.beginGroup(deviceGroup(profile.vid, profile.pid, profile.speed));
+    settings.beginGroup(QString("ep%1").arg((int)profile.endpoint, 2, 16, QChar('0')));
+    settings.setValue("transferSize", profile.transferSize);
+    settings.setValue("queueDepth", profile.queueDepth);
+    settings.setValue("mbps", profile.mbps);
+    settings.setValue("cpuPercent", profile.cpuPercent);
+    settings.setValue("tunedAt", profile.tunedAt.toString(Qt::ISODate));
+    settings.endGroup();
+    settings.endGroup();
+    settings.sync();
+
+    if (settings.status() != QSettings::NoError) {
+        qDebug() << "UsbTuning: save error:" << path;
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************/
+/*
+ *@brief: 설정 파일에서 device 의 모든 endpoint 설정을 읽는다
+ *@param:
+ *@return:  설정 목록 (없으면 비어 있다)
+ */
+/********************************************************************************/
+QList<UsbTuneProfile> UsbTuning::loadProfiles(const QString &path, quint16 vid, quint16 pid, int speed)
+{
+    QList<UsbTuneProfile> profiles;
+    if (path.isEmpty() || !QFile::exists(path))
+        return profiles;
+
+    QSettings settings(path, QSettings::IniFormat);
+    settings.beginGroup(deviceGroup(vid, pid, speed));
+
+    const QStringList endpoints = settings.childGroups();
+    for (int i = 0; i < endpoints.size(); i++) {
+        bool ok = false;
+        quint8 endpoint = endpoints.at(i).mid(2).toUShort(&ok, 16);
+        if (!endpoints.at(i).startsWith("ep") || !ok)
+            continue;
+
+        settings.beginGroup(endpoints.at(i));
+        UsbTuneProfile profile;
+        profile.vid = vid;
+        profile.pid = pid;
+        profile.speed = speed;
+        profile.endpoint = endpoint;
+        profile.transferSize = settings.value("transferSize").toInt();
+        profile.queueDepth = settings.value("queueDepth").toInt();
+        profile.mbps = settings.value("mbps").toDouble();
+        profile.cpuPercent = settings.value("cpuPercent").toDouble();
+        profile.tunedAt = QDateTime::fromString(settings.value("tunedAt").toString(), Qt::ISODate);
+        settings.endGroup();
+
+        if (profile.isValid())
+            profiles.append(profile);
+    }
+
+    settings.endGroup();
+    return profiles;
+}
+
+/********************************************************************************/
+/*
+ *@brief: sweep 결과 report 출력
+ *@param:   path: 출력 파일 (.json 이면 JSON, 그 외는 CSV)
+ *@param:   best: 선택된 설정
+ *@param:   results: sweep 결과
+ *@return:  true=OK  false=NG
+ */
+/********************************************************************************/
+bool UsbTuning::exportReport(const QString &path, const UsbTuneProfile &best, const QList<UsbTuneResult> &results)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qDebug() << "UsbTuning: cannot open" << path;
+        return false;
+    }
+
+    if (path.endsWith(".json", Qt::CaseInsensitive)) {
+        QJsonObject device;
+        device["vid"] = QString("%1").arg(best.vid, 4, 16, QChar('0'));
+        device["pid"] = QString("%1").arg(best.pid, 4, 16, QChar('0'));
+        device["speed"] = best.speed;
+        device["endpoint"] = QString("0x%1").arg((int)best.endpoint, 2, 16, QChar('0'));
+
+        QJsonObject selected;
+        selected["transferSize"] = best.transferSize;
+        selected["queueDepth"] = best.queueDepth;
+        selected["mbps"] = best.mbps;
+        selected["cpuPercent"] = best.cpuPercent;
+
+        QJsonArray runs;
+        for (int i = 0; i < results.size(); i++) {
+            const UsbTuneResult &r = results.at(i);
+            QJsonObject run;
+            run["transferSize"] = r.transferSize;
+            run["queueDepth"] = r.queueDepth;
+            run["bytes"] = r.bytes;
+            run["mbps"] = r.mbps;
+            run["cpuPercent"] = r.cpuPercent;
+            run["error"] = r.error;
+            runs.append(run);
+        }
+
+        QJsonObject root;
+        root["device"] = device;
+        root["tunedAt"] = best.tunedAt.toString(Qt::ISODate);
+        root["best"] = selected;
+        root["results"] = runs;
+        file.write(QJsonDocument(root).toJson());
+    } else {
+        QTextStream out(&file);
+        out << "transfer_size,queue_depth,bytes,mbps,cpu_percent,error,best\n";
+        for (int i = 0; i < results.size(); i++) {
+            const UsbTuneResult &r = results.at(i);
+            bool isBest = r.transferSize == best.transferSize && r.queueDepth == best.queueDepth;
+            out << r.transferSize << ',' << r.queueDepth << ',' << r.bytes << ','
+                << QString::number(r.mbps, 'f', 2) << ',' << QString::number(r.cpuPercent, 'f', 1) << ','
+                << r.error << ',' << (isBest ? 1 : 0) << '\n';
+        }
+    }
+
+    return file.error() == QFile::NoError;
+}
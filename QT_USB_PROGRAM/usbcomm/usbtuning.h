@@ -0,0 +1,73 @@
+/********************************************************************************/
+/*  */
+/********************************************************************************/
+/*
+ * 전송 크기 / 동시 전송 수 자동 조정 결과의 저장과 report
+ *
+ * UsbComm::autoTune() 이 전송 크기 x 동시 전송 수를 sweep 한 결과에서 최적값을 골라
+ * VID/PID + device 속도 + endpoint 를 key 로 설정 파일(ini)에 저장한다.
+ * 이후 UsbComm::openUsbDevice() 가 같은 device 를 열면 저장된 값을 읽어서 bulkTransferLarge() 에 사용한다.
+ *
+ * 설정 파일 형식:
+ * 	[04b4_00f1_speed3]
+ * 	ep81\transferSize=65536
+ * 	ep81\queueDepth=8
+ * 	...
+ */
+#ifndef USBTUNING_H
+#define USBTUNING_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QList>
+#include <QDateTime>
+
+/********************************************************************************/
+/* sweep 1회의 측정 결과 */
+/********************************************************************************/
+struct UsbTuneResult
+{
+    int transferSize = 0;		/* max packet 정렬 후 실제 전송 크기 */
+    int queueDepth = 0;			/* 동시 전송 수 */
+    qint64 bytes = 0;			/* 전송된 bytes */
+    double mbps = 0;			/* MB/s */
+    double cpuPercent = 0;		/* 측정 구간의 process CPU 사용률 (core 1개 = 100%) */
+    int error = 0;				/* 0 이면 정상, 음수면 libusb error code */
+};
+
+/********************************************************************************/
+/* device/endpoint 별 최적 설정 */
+/********************************************************************************/
+struct UsbTuneProfile
+{
+    quint16 vid = 0;
+    quint16 pid = 0;
+    int speed = 0;				/* enum libusb_speed */
+    quint8 endpoint = 0;
+    int transferSize = 0;
+    int queueDepth = 0;
+    double mbps = 0;
+    double cpuPercent = 0;
+    QDateTime tunedAt;
+
+    bool isValid() const {return transferSize > 0 && queueDepth > 0;}
+};
+
+namespace UsbTuning {
+
+/* 결과 중 최적의 index (최고 속도의 95% 이상 중 CPU 사용률이 가장 낮은 것), 유효한 결과가 없으면 -1 */
+int selectBest(const QList<UsbTuneResult> &results);
+
+/* 기본 설정 파일 경로 (~/.config/qt_usb_program/tuning.ini) */
+QString defaultStorePath();
+
+/* 설정 파일에 저장 / 설정 파일에서 device 의 모든 endpoint 설정을 읽는다 */
+bool saveProfile(const QString &path, const UsbTuneProfile &profile);
+QList<UsbTuneProfile> loadProfiles(const QString &path, quint16 vid, quint16 pid, int speed);
+
+/* sweep 결과 report 출력 (확장자가 .json 이면 JSON, 그 외는 CSV) */
+bool exportReport(const QString &path, const UsbTuneProfile &best, const QList<UsbTuneResult> &results);
+
+}
+
+#endif // USBTUNING_H